@@ -111,31 +111,118 @@ namespace Assets
         }
     }
 
-    static std::vector<DirectoryChunk::Block> LoadBlockList(const char filename[])
+    class ArchiveCache::DirectoryIndex
     {
-            // note --  we could potentially just keep the directory information in memory
-            //          but; currently we'll open the file and read it in again every time
-            //          Maybe we should use a memory mapped file for the directory...
+    public:
+        const DirectoryChunk::Block*    _blocksBegin;
+        const DirectoryChunk::Block*    _blocksEnd;
+        const uint8*                    _flattenedSpanningHeap;
+        unsigned                        _spanningHeapSize;
+
+        std::shared_ptr<MemoryMappedFile> _directoryFile;
+        std::shared_ptr<MemoryMappedFile> _mainFile;
+
+        const DirectoryChunk::Block* Find(uint64 id) const
+        {
+            auto bi = std::lower_bound(_blocksBegin, _blocksEnd, id, DirectoryChunk::CompareBlock());
+            if (bi != _blocksEnd && bi->_id == id) { return bi; }
+            return nullptr;
+        }
+
+        DirectoryIndex(const char directoryFilename[], const char mainFilename[]);
+    };
+
+    ArchiveCache::DirectoryIndex::DirectoryIndex(const char directoryFilename[], const char mainFilename[])
+    {
+            //  Map the directory file, and find the directory chunk within it.
+            //  The blocks array and flattened spanning heap are used directly from
+            //  the mapped memory (so lookups afterwards never touch the file system).
+            //  Any failures here just leave us with an empty index (as if the archive
+            //  did not exist yet).
         using namespace Serialization::ChunkFile;
-        BasicFile directoryFile(filename, "rb");
-        auto chunkTable = LoadChunkTable(directoryFile);
-        auto chunk = FindChunk(filename, chunkTable, ChunkType_ArchiveDirectory, 0);
+        _blocksBegin = _blocksEnd = nullptr;
+        _flattenedSpanningHeap = nullptr;
+        _spanningHeapSize = 0;
+
+        const auto shareMode = BasicFile::ShareMode::Read | BasicFile::ShareMode::Write;
+        auto directoryFile = std::make_shared<MemoryMappedFile>(directoryFilename, 0, MemoryMappedFile::Access::Read, shareMode);
+        if (!directoryFile->IsValid()) { return; }
+
+        auto fileStart = (const uint8*)directoryFile->GetData();
+        auto fileEnd = PtrAdd(fileStart, size_t(directoryFile->GetSize()));
+        if (size_t(fileEnd - fileStart) < sizeof(ChunkFileHeader)) { return; }
+
+        auto& fileHeader = *(const ChunkFileHeader*)fileStart;
+        if (fileHeader._magic != MagicHeader || fileHeader._fileVersionNumber != ChunkFileVersion) { return; }
+
+            //  Block ids are hash values; if the archive was built with a different hash 
+            //  function, none of them will match. We treat it as empty, and it will be rebuilt
+        if (fileHeader._hashFamily != HashFamily_Active) {
+            LogWarning << "Ignoring archive cache built with a different hash function: " << directoryFilename;
+            return;
+        }
 
-        DirectoryChunk dirHdr;
-        directoryFile.Seek(chunk._fileOffset, SEEK_SET);
-        directoryFile.Read(&dirHdr, sizeof(dirHdr), 1);
+        auto chunkHeaders = (const ChunkHeader*)PtrAdd(fileStart, sizeof(ChunkFileHeader));
+        if ((const uint8*)&chunkHeaders[fileHeader._chunkCount] > fileEnd) { return; }
 
-        std::vector<DirectoryChunk::Block> blocks;  // note -- use a fixed size vector here?
-        blocks.resize(dirHdr._blockCount);
-        directoryFile.Read(AsPointer(blocks.begin()), sizeof(DirectoryChunk::Block), dirHdr._blockCount);
+        const ChunkHeader* dirChunk = nullptr;
+        for (unsigned c=0; c<fileHeader._chunkCount; ++c) {
+            if (chunkHeaders[c]._type == ChunkType_ArchiveDirectory && chunkHeaders[c]._chunkVersion == 0) {
+                dirChunk = &chunkHeaders[c];
+                break;
+            }
+        }
+        if (!dirChunk || (dirChunk->_fileOffset + sizeof(DirectoryChunk)) > size_t(fileEnd - fileStart)) { return; }
+
+        auto& dirHdr = *(const DirectoryChunk*)PtrAdd(fileStart, dirChunk->_fileOffset);
+        auto blocksBegin = (const DirectoryChunk::Block*)PtrAdd(&dirHdr, sizeof(DirectoryChunk));
+        auto blocksEnd = &blocksBegin[dirHdr._blockCount];
+        auto heapStart = (const uint8*)blocksEnd;
+        if (PtrAdd(heapStart, dirHdr._spanningHeapSize) > fileEnd) { return; }
+
+        _blocksBegin = blocksBegin;
+        _blocksEnd = blocksEnd;
+        _flattenedSpanningHeap = heapStart;
+        _spanningHeapSize = dirHdr._spanningHeapSize;
+        _directoryFile = std::move(directoryFile);
+
+            //  The main file is mapped so that block payloads can be returned without
+            //  a copy. We must allow other handles to write to the file, because
+            //  views returned from OpenViewFromCache may still be alive when FlushToDisk
+            //  writes new blocks.
+        if (_blocksBegin != _blocksEnd) {
+            auto mainFile = std::make_shared<MemoryMappedFile>(mainFilename, 0, MemoryMappedFile::Access::Read, shareMode);
+            if (mainFile->IsValid()) {
+                _mainFile = std::move(mainFile);
+            } else {
+                    //  Without the main file, none of the blocks can be read. Drop the
+                    //  directory and the heap together with the block list, so that
+                    //  FlushToDisk never writes out a heap that has spans allocated
+                    //  for blocks it no longer knows about.
+                LogWarning << "Ignoring archive cache directory, because the main file could not be mapped: " << mainFilename;
+                _blocksBegin = _blocksEnd = nullptr;
+                _flattenedSpanningHeap = nullptr;
+                _spanningHeapSize = 0;
+                _directoryFile.reset();
+            }
+        }
+    }
 
-        return std::move(blocks);
+    auto ArchiveCache::GetDirectoryIndex() const -> const DirectoryIndex*
+    {
+            // (caller must hold _pendingBlocksLock)
+        if (!_directoryIndexValid) {
+            _directoryIndex.reset();
+            _directoryIndex = std::make_unique<DirectoryIndex>(_directoryFileName.c_str(), _mainFileName.c_str());
+            _directoryIndexValid = true;
+        }
+        return _directoryIndex.get();
     }
 
     auto ArchiveCache::OpenFromCache(uint64 id) -> BlockAndSize
     {
             // first, check our pending commits
-            // if it's not there, we have to lock and open the file
+            // if it's not there, we have to look in the directory index
             // note that we're keeping the pending block lock permanently locked
         ScopedLock(_pendingBlocksLock);
         auto i = std::lower_bound(_pendingBlocks.begin(), _pendingBlocks.end(), id, ComparePendingCommit());
@@ -143,27 +230,39 @@ namespace Assets
             return i->_data;
         }
 
-            // lock and open the directory, and look for the given item
-            // note that a flush could be happening in a background 
-            // thread -- in that case, we need to stall waiting for the
-            // flush to complete.
-
-        {
-            auto blocks = LoadBlockList(_directoryFileName.c_str());
-                // we maintain the blocks array sorted by id to make this check faster...
-            auto bi = std::lower_bound(blocks.begin(), blocks.end(), id, DirectoryChunk::CompareBlock());
-            if (bi != blocks.end() && bi->_id == id) {
-                BasicFile dataFile(_mainFileName.c_str(), "rb");
-                dataFile.Seek(bi->_start, SEEK_SET);
-
-                auto result = std::make_shared<std::vector<uint8>>(bi->_size);
-                dataFile.Read(AsPointer(result->begin()), 1, bi->_size);
-                return result;
-            }
+            // the index is rebuilt lazily after FlushToDisk; otherwise this is 
+            // just a binary search and a copy from the mapped main file
+        auto* index = GetDirectoryIndex();
+        auto* bi = index->Find(id);
+        if (bi && (bi->_start + bi->_size) <= index->_mainFile->GetSize()) {
+            auto src = PtrAdd(index->_mainFile->GetData(), bi->_start);
+            return std::make_shared<std::vector<uint8>>((const uint8*)src, (const uint8*)PtrAdd(src, bi->_size));
         }
 
         return nullptr;     // this block doesn't exist in the cache
     }
+
+    auto ArchiveCache::OpenViewFromCache(uint64 id) -> BlockView
+    {
+        ScopedLock(_pendingBlocksLock);
+        BlockView result;
+        auto i = std::lower_bound(_pendingBlocks.begin(), _pendingBlocks.end(), id, ComparePendingCommit());
+        if (i!=_pendingBlocks.end() && i->_id == id) {
+            result._pendingData = i->_data;
+            result._data = AsPointer(i->_data->cbegin());
+            result._size = i->_data->size();
+            return result;
+        }
+
+        auto* index = GetDirectoryIndex();
+        auto* bi = index->Find(id);
+        if (bi && (bi->_start + bi->_size) <= index->_mainFile->GetSize()) {
+            result._mappedFile = index->_mainFile;
+            result._data = PtrAdd(index->_mainFile->GetData(), bi->_start);
+            result._size = bi->_size;
+        }
+        return result;
+    }
     
     bool ArchiveCache::HasItem(uint64 id) const
     {
@@ -173,13 +272,7 @@ namespace Assets
             return true;
         }
 
-        TRY {
-            auto blocks = LoadBlockList(_directoryFileName.c_str());
-            auto bi = std::lower_bound(blocks.begin(), blocks.end(), id, DirectoryChunk::CompareBlock());
-            return (bi != blocks.end() && bi->_id == id);
-        } CATCH (...) {
-            return false;
-        } CATCH_END
+        return GetDirectoryIndex()->Find(id) != nullptr;
     }
 
     void ArchiveCache::FlushToDisk()
@@ -206,22 +299,27 @@ namespace Assets
             std::vector<DirectoryChunk::Block> blocks;
             std::unique_ptr<uint8[]> flattenedSpanningHeap;
         
+                //  Take a copy of the directory from the index, and then release
+                //  the index (so the directory file is no longer mapped while we
+                //  write it). It will be rebuilt on the next lookup.
+            {
+                auto* index = GetDirectoryIndex();
+                if (index->_directoryFile) {
+                    blocks.assign(index->_blocksBegin, index->_blocksEnd);
+                    dirHdr._blockCount = unsigned(blocks.size());
+                    dirHdr._spanningHeapSize = index->_spanningHeapSize;
+                    flattenedSpanningHeap = std::make_unique<uint8[]>(dirHdr._spanningHeapSize);
+                    XlCopyMemory(flattenedSpanningHeap.get(), index->_flattenedSpanningHeap, dirHdr._spanningHeapSize);
+                }
+                _directoryIndex.reset();
+                _directoryIndexValid = false;
+            }
+
             BasicFile directoryFile;
             bool directoryFileOpened = false;
 
             TRY {
                 directoryFile = BasicFile(_directoryFileName.c_str(), "r+b");
-
-                auto chunkTable = LoadChunkTable(directoryFile);
-                auto chunk = FindChunk(_directoryFileName.c_str(), chunkTable, ChunkType_ArchiveDirectory, 0);
-
-                directoryFile.Seek(chunk._fileOffset, SEEK_SET);
-                directoryFile.Read(&dirHdr, sizeof(dirHdr), 1);
-
-                blocks.resize(dirHdr._blockCount);
-                directoryFile.Read(AsPointer(blocks.begin()), sizeof(DirectoryChunk::Block), dirHdr._blockCount);
-                flattenedSpanningHeap = std::make_unique<uint8[]>(dirHdr._spanningHeapSize);
-                directoryFile.Read(flattenedSpanningHeap.get(), 1, dirHdr._spanningHeapSize);
                 directoryFileOpened = true;
             } CATCH (...) {
                     // any exceptions indicate the current file is empty
@@ -317,10 +415,11 @@ namespace Assets
                 ChunkFileHeader fileHeader;
                 XlZeroMemory(fileHeader);
                 fileHeader._magic = MagicHeader;
-                fileHeader._fileVersionNumber = 0;
+                fileHeader._fileVersionNumber = ChunkFileVersion;
                 XlCopyString(fileHeader._buildVersion, dimof(fileHeader._buildVersion), _buildVersionString);
                 XlCopyString(fileHeader._buildDate, dimof(fileHeader._buildDate), _buildDateString);
                 fileHeader._chunkCount = 1;
+                fileHeader._hashFamily = HashFamily_Active;
 
                 auto flattenedHeap = spanningHeap.Flatten();
             
@@ -423,21 +522,12 @@ namespace Assets
             // We need to open the file and get metrics information
             // for the blocks contained within
         ////////////////////////////////////////////////////////////////////////////////////
+        ScopedLock(_pendingBlocksLock);
         std::vector<DirectoryChunk::Block> fileBlocks;
-        TRY {
-            BasicFile directoryFile(_directoryFileName.c_str(), "rb");
-
-            auto chunkTable = LoadChunkTable(directoryFile);
-            auto chunk = FindChunk(_directoryFileName.c_str(), chunkTable, ChunkType_ArchiveDirectory, 0);
-
-            directoryFile.Seek(chunk._fileOffset, SEEK_SET);
-            DirectoryChunk dirHdr;
-            directoryFile.Read(&dirHdr, sizeof(dirHdr), 1);
-
-            fileBlocks.resize(dirHdr._blockCount);
-            directoryFile.Read(AsPointer(fileBlocks.begin()), sizeof(DirectoryChunk::Block), dirHdr._blockCount);
-        } CATCH (...) {
-        } CATCH_END
+        {
+            auto* index = GetDirectoryIndex();
+            fileBlocks.assign(index->_blocksBegin, index->_blocksEnd);
+        }
 
         ////////////////////////////////////////////////////////////////////////////////////
         #if defined(ARCHIVE_CACHE_ATTACHED_STRINGS)
@@ -526,6 +616,7 @@ namespace Assets
         : _mainFileName(archiveName)
         , _buildVersionString(buildVersionString)
         , _buildDateString(buildDateString)
+        , _directoryIndexValid(false)
     {
         _directoryFileName = _mainFileName + ".dir";
 
@@ -14,6 +14,8 @@
 
 #define ARCHIVE_CACHE_ATTACHED_STRINGS
 
+namespace Utility { class MemoryMappedFile; }
+
 namespace Assets
 {
     class ArchiveCache
@@ -21,8 +23,26 @@ namespace Assets
     public:
         typedef std::shared_ptr<std::vector<uint8>> BlockAndSize;
 
+        /// <summary>Read-only view of a block within the cache</summary>
+        /// For blocks that have been flushed to disk, this points directly
+        /// into the memory mapped archive file (no copy is made). The view
+        /// keeps the mapping alive, but the contents are only guaranteed to be
+        /// unchanged until the next FlushToDisk() that writes the same id.
+        class BlockView
+        {
+        public:
+            const void*     _data;
+            size_t          _size;
+
+            BlockAndSize                        _pendingData;
+            std::shared_ptr<Utility::MemoryMappedFile> _mappedFile;
+
+            BlockView() : _data(nullptr), _size(0) {}
+        };
+
         void            Commit(uint64 id, BlockAndSize&& data, const std::string& attachedString);
         BlockAndSize    OpenFromCache(uint64 id);
+        BlockView       OpenViewFromCache(uint64 id);
         bool            HasItem(uint64 id) const;
         void            FlushToDisk();
         
@@ -77,6 +97,12 @@ namespace Assets
         const char*     _buildVersionString;
         const char*     _buildDateString;
 
+        class DirectoryIndex;
+        mutable std::unique_ptr<DirectoryIndex> _directoryIndex;
+        mutable bool _directoryIndexValid;
+
+        const DirectoryIndex* GetDirectoryIndex() const;
+
         class ComparePendingCommit
         {
         public:
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "CompileAndAsyncManager.h"
+#include "ConcurrentAssetTable.h"
 #include "../Utility/Streams/FileSystemMonitor.h"       // (for OnChangeCallback base class)
 #include "../Utility/IteratorUtils.h"
 #include "../Utility/Threading/ThreadingUtils.h"
@@ -34,10 +35,12 @@ namespace Assets
             ~AssetSet();
             void Clear();
             void LogReport();
+            void OnFrameBarrier();
 
-            static std::vector<std::pair<uint64, std::unique_ptr<AssetType>>> _assets;
+            static ConcurrentAssetTable<AssetType> _assets;
             #if defined(ASSETS_STORE_NAMES)
                 static std::vector<std::pair<uint64, std::string>> _assetNames;
+                static Threading::Mutex _assetNamesLock;
             #endif
         };
 
@@ -52,19 +55,23 @@ namespace Assets
         template<typename AssetType>
             AssetSet<AssetType>& GetAssetSet() 
         {
-            static AssetSet<AssetType>* set = nullptr;
-            if (!set) {
-                auto s = std::make_unique<AssetSet<AssetType>>();
-                set = s.get();
+                //  Asset sets can be requested from any thread. The first request
+                //  for a given type registers the set with the AssetSetManager
+                //  (under the manager's lock, so only one set is ever created)
+            static AssetSet<AssetType>* volatile set = nullptr;
+            auto* result = (AssetSet<AssetType>*)Interlocked::LoadPointer((void*volatile const*)&set);
+            if (!result) {
                 auto& assetSets = CompileAndAsyncManager::GetInstance().GetAssetSets();
-                assetSets.Add(std::move(s));
+                ScopedLock(assetSets.GetLock());
+                result = set;
+                if (!result) {
+                    auto s = std::make_unique<AssetSet<AssetType>>();
+                    result = s.get();
+                    assetSets.Add(std::move(s));
+                    Interlocked::ExchangePointer((void*volatile*)&set, result);
+                }
             }
-            assert(CompileAndAsyncManager::GetInstance().GetAssetSets().BoundThreadId() == Threading::CurrentThreadId());  // currently not thread safe; we have to check the thread ids
-            #if defined(ASSETS_STORE_NAMES)
-                    // These should agree. If there's a mismatch, there may be a threading problem
-                assert(set->_assets.size() == set->_assetNames.size());
-            #endif
-            return *set;
+            return *result;
         }
 
         template<typename AssetType> struct Ptr
@@ -123,30 +130,26 @@ namespace Assets
                     //          * otherwise return the existing asset
                     //      * otherwise we build a new asset
                     //
+                    //  This can be called from any thread. If multiple threads request
+                    //  the same asset at the same time, only one will construct it (the
+                    //  others will wait for it to complete).
+                    //
                 auto hash = BuildHash(init);
-                auto& assetSet = GetAssetSet<AssetType>()._assets;
-                auto i = LowerBound(assetSet, hash);
-                if (i != assetSet.end() && i->first == hash) {
-                    if (CheckDependancy<DoCheckDependancy>::NeedsRefresh(i->second.get())) {
-                            // note --  old resource will stay in memory until the new one has been constructed
-                            //          If we get an exception during construct, we'll be left with a null ptr
-                            //          in this asset set
-                        auto oldResource = std::move(i->second);
-                        i->second = ConstructAsset<DoBackgroundCompile>::Create<AssetType>(init);
-                    }
-                    return *i->second;
-                }
-
-                auto newAsset = ConstructAsset<DoBackgroundCompile>::Create<AssetType>(init);
-                #if defined(ASSETS_STORE_NAMES)
-                        // This is extra functionality designed for debugging and profiling
-                        // attach a name to this hash value, so we can query the contents
-                        // of an asset set and get meaningful values
-                        //  (only insert after we've completed creation; because creation can throw an exception)
-                    InsertAssetName(GetAssetSet<AssetType>()._assetNames, hash, (const char**)&init, InitCount);
-                #endif
-
-                return *assetSet.insert(i, std::make_pair(hash, std::move(newAsset)))->second;
+                return GetAssetSet<AssetType>()._assets.FindOrCreate(
+                    hash,
+                    [&]() { return ConstructAsset<DoBackgroundCompile>::Create<AssetType>(init); },
+                    [](const AssetType* asset) { return CheckDependancy<DoCheckDependancy>::NeedsRefresh(asset); },
+                    [&]()
+                    {
+                        #if defined(ASSETS_STORE_NAMES)
+                                // This is extra functionality designed for debugging and profiling
+                                // attach a name to this hash value, so we can query the contents
+                                // of an asset set and get meaningful values
+                                //  (only called after we've completed creation; because creation can throw an exception)
+                            ScopedLock(GetAssetSet<AssetType>()._assetNamesLock);
+                            InsertAssetName(GetAssetSet<AssetType>()._assetNames, hash, (const char**)&init, InitCount);
+                        #endif
+                    });
             }
 
         template <typename AssetType>
@@ -155,48 +158,59 @@ namespace Assets
         template <typename AssetType>
             void AssetSet<AssetType>::Clear() 
             {
-                _assets.clear();
+                _assets.Clear();
                 #if defined(ASSETS_STORE_NAMES)
+                    ScopedLock(_assetNamesLock);
                     _assetNames.clear();
                 #endif
             }
 
+        template <typename AssetType>
+            void AssetSet<AssetType>::OnFrameBarrier() 
+            {
+                _assets.OnFrameBarrier();
+            }
+
         template <typename AssetType>
             void AssetSet<AssetType>::LogReport() 
             {
-                LogHeader(unsigned(_assets.size()), typeid(AssetType).name());
+                auto hashes = _assets.GetHashes();
+                LogHeader(unsigned(hashes.size()), typeid(AssetType).name());
                 #if defined(ASSETS_STORE_NAMES)
-                    auto i = _assets.cbegin();
+                    ScopedLock(_assetNamesLock);
+                    auto i = hashes.cbegin();
                     auto ni = _assetNames.cbegin();
                     unsigned index = 0;
-                    for (;i != _assets.cend(); ++i, ++index) {
-                        while (ni->first < i->first && ni != _assetNames.cend()) { ++ni; }
-                        if (ni != _assetNames.cend() && ni->first == i->first) {
+                    for (;i != hashes.cend(); ++i, ++index) {
+                        while (ni != _assetNames.cend() && ni->first < *i) { ++ni; }
+                        if (ni != _assetNames.cend() && ni->first == *i) {
                             LogAssetName(index, ni->second.c_str());
                         } else {
                             char buffer[256];
                             _snprintf_s(buffer, _TRUNCATE, "Unnamed asset with hash (0x%08x%08x)", 
-                                uint32(i->first>>32), uint32(i->first));
+                                uint32(*i>>32), uint32(*i));
                             LogAssetName(index, buffer);
                         }
                     }
                 #else
-                    auto i = _assets.cbegin();
+                    auto i = hashes.cbegin();
                     unsigned index = 0;
-                    for (;i != _assets.cend(); ++i, ++index) {
+                    for (;i != hashes.cend(); ++i, ++index) {
                         char buffer[256];
                         _snprintf_s(buffer, _TRUNCATE, "Unnamed asset with hash (0x%08x%08x)", 
-                            uint32(i->first>>32), uint32(i->first));
+                            uint32(*i>>32), uint32(*i));
                         LogAssetName(index, buffer);
                     }
                 #endif
             }
 
         template <typename AssetType>
-            std::vector<std::pair<uint64, std::unique_ptr<AssetType>>> AssetSet<AssetType>::_assets;
+            ConcurrentAssetTable<AssetType> AssetSet<AssetType>::_assets;
         #if defined(ASSETS_STORE_NAMES)
             template <typename AssetType>
                 std::vector<std::pair<uint64, std::string>> AssetSet<AssetType>::_assetNames;
+            template <typename AssetType>
+                Threading::Mutex AssetSet<AssetType>::_assetNamesLock;
         #endif
     }
 
@@ -7,7 +7,9 @@
 #define _SCL_SECURE_NO_WARNINGS
 
 #include "BlockSerializer.h"
+#include "RelativePtr.h"
 #include "../Utility/MemoryUtils.h"
+#include <algorithm>
 
 namespace Serialization
 {
@@ -38,6 +40,27 @@ namespace Serialization
             _memory.insert(_memory.end(), sizeof(std::unique_ptr<void, BlockSerializerDeleter<void>>), 0);
         } else if (specialBuffer == SpecialBuffer::Unknown) {
             PushBackPointer(0);
+        } else if (specialBuffer == SpecialBuffer::RelativePtr) {
+            _memory.insert(_memory.end(), sizeof(RelativePtr<uint8>), 0);
+        } else if (specialBuffer == SpecialBuffer::RelativeArray) {
+            _memory.insert(_memory.end(), sizeof(RelativeArray<uint8>), 0);
+        } else if (specialBuffer == SpecialBuffer::RelativeString) {
+            _memory.insert(_memory.end(), sizeof(RelativeString), 0);
+        }
+    }
+
+    auto    NascentBlockSerializer::AsStoredType(SpecialBuffer::Enum specialBuffer) const -> SpecialBuffer::Enum
+    {
+        if (!(_flags & Flags::Relocatable)) {
+            return specialBuffer;
+        }
+
+        switch (specialBuffer) {
+        case SpecialBuffer::Unknown:
+        case SpecialBuffer::UniquePtr:  return SpecialBuffer::RelativePtr;
+        case SpecialBuffer::Vector:     return SpecialBuffer::RelativeArray;
+        case SpecialBuffer::String:     return SpecialBuffer::RelativeString;
+        default:                        return specialBuffer;
         }
     }
 
@@ -45,6 +68,8 @@ namespace Serialization
                     SpecialBuffer::Enum specialBuffer, 
                     const void* begin, const void* end)
     {
+        specialBuffer = AsStoredType(specialBuffer);
+
         InternalPointer newPointer;
         newPointer._pointerOffset    = _memory.size();
         newPointer._subBlockOffset   = _trailingSubBlocks.size();
@@ -53,6 +78,10 @@ namespace Serialization
         _internalPointers.push_back(newPointer);
 
         std::copy((const uint8*)begin, (const uint8*)end, std::back_inserter(_trailingSubBlocks));
+        if (specialBuffer == SpecialBuffer::RelativeString) {
+                // (the terminator isn't included in _subBlockSize)
+            _trailingSubBlocks.push_back(0);
+        }
 
             //
             //      =<>=    Write blank space for this special buffer   =<>=
@@ -114,6 +143,8 @@ namespace Serialization
             //      an internal pointer record for it.
             //
 
+        specialBuffer = AsStoredType(specialBuffer);
+
         InternalPointer ptr;
         ptr._pointerOffset   = _memory.size();
         ptr._subBlockOffset  = _trailingSubBlocks.size();
@@ -162,16 +193,27 @@ namespace Serialization
         size_t  _internalPointerCount;
     };
     
+    static bool IsRelative(NascentBlockSerializer::SpecialBuffer::Enum specialBuffer)
+    {
+        return  specialBuffer == NascentBlockSerializer::SpecialBuffer::RelativePtr
+            ||  specialBuffer == NascentBlockSerializer::SpecialBuffer::RelativeArray
+            ||  specialBuffer == NascentBlockSerializer::SpecialBuffer::RelativeString;
+    }
+    
     std::unique_ptr<uint8[]>      NascentBlockSerializer::AsMemoryBlock()
     {
+        auto absolutePointerCount = std::count_if(
+            _internalPointers.cbegin(), _internalPointers.cend(),
+            [](const InternalPointer& p) { return !IsRelative(p._specialBuffer); });
+
         std::unique_ptr<uint8[]> result = std::make_unique<uint8[]>(
             sizeof(Header)
             + _memory.size()
             + _trailingSubBlocks.size()
-            + _internalPointers.size() * sizeof(InternalPointer));
+            + absolutePointerCount * sizeof(InternalPointer));
 
         ((Header*)result.get())->_rawMemorySize = _memory.size() + _trailingSubBlocks.size();
-        ((Header*)result.get())->_internalPointerCount = _internalPointers.size();
+        ((Header*)result.get())->_internalPointerCount = absolutePointerCount;
 
         std::copy(  AsPointer(_memory.begin()), AsPointer(_memory.end()),
                     PtrAdd(result.get(), sizeof(Header)));
@@ -180,20 +222,34 @@ namespace Serialization
                     PtrAdd(result.get(), _memory.size() + sizeof(Header)));
 
         InternalPointer* d = (InternalPointer*)PtrAdd(result.get(), _memory.size() + _trailingSubBlocks.size() + sizeof(Header));
-        for (auto i=_internalPointers.cbegin(); i!=_internalPointers.cend(); ++i, ++d) {
-            *d = *i;
+        for (auto i=_internalPointers.cbegin(); i!=_internalPointers.cend(); ++i) {
+            InternalPointer p = *i;
                 //      pointers in the subblock part are marked as negative... But what about zero? 
                 //      It could be in the memory part, or the subblock part
-            if (d->_pointerOffset & PtrFlagBit) {
-                d->_pointerOffset = (d->_pointerOffset&PtrMask) + _memory.size();
+            if (p._pointerOffset & PtrFlagBit) {
+                p._pointerOffset = (p._pointerOffset&PtrMask) + _memory.size();
+            }
+            p._subBlockOffset += _memory.size();
+
+            if (IsRelative(p._specialBuffer)) {
+                    //  Relative pointers can be resolved now, because they only
+                    //  depend on the positions within the block. Write them in
+                    //  directly (the layouts match the types in RelativePtr.h)
+                int64* o = (int64*)PtrAdd(result.get(), sizeof(Header)+p._pointerOffset);
+                o[0] = int64(p._subBlockOffset) - int64(p._pointerOffset);
+                if (p._specialBuffer != SpecialBuffer::RelativePtr) {
+                    ((uint64*)o)[1] = uint64(p._subBlockSize);
+                }
+            } else {
+                *d++ = p;
             }
-            d->_subBlockOffset += _memory.size();
         }
 
         return result;
     }
 
-    NascentBlockSerializer::NascentBlockSerializer()
+    NascentBlockSerializer::NascentBlockSerializer(Flags::BitField flags)
+    : _flags(flags)
     {
     }
 
@@ -246,6 +302,7 @@ namespace Serialization
                 o[0] = (ptr._subBlockOffset + size_t(base) + sizeof(Header));
                 *(unsigned*)(&o[1]) = 1;
             }
+                // (relative pointers are resolved in AsMemoryBlock(), and never appear here)
         }
     }
 
@@ -264,6 +321,14 @@ namespace Serialization
         return h._rawMemorySize + h._internalPointerCount * sizeof(NascentBlockSerializer::InternalPointer) + sizeof(Header);
     }
 
+    bool            Block_IsRelocatable(const void* block)
+    {
+            //  With no entries in the internal pointer table, the block
+            //  is valid at any address, and doesn't need Block_Initialize()
+        const Header& h = *(const Header*)block;
+        return h._internalPointerCount == 0;
+    }
+
     std::unique_ptr<uint8[]>  Block_Duplicate(const void* block)
     {
         size_t size = Block_GetSize(block);
@@ -26,7 +26,29 @@ namespace Serialization
     public:
         struct SpecialBuffer
         {
-            enum Enum { Unknown, VertexBuffer, IndexBuffer, String, Vector, UniquePtr };
+            enum Enum 
+            { 
+                Unknown, VertexBuffer, IndexBuffer, String, Vector, UniquePtr,
+                RelativePtr, RelativeArray, RelativeString
+            };
+        };
+
+            //
+            //      In "Relocatable" mode, pointers are written as the position
+            //      independent types from RelativePtr.h:
+            //          raw pointers & std::unique_ptr    -> RelativePtr
+            //          std::vector & DynamicArray        -> RelativeArray
+            //          std::string                       -> RelativeString
+            //      The offsets are resolved in AsMemoryBlock(), so they don't
+            //      appear in the internal pointer table. A block with no other
+            //      pointers needs no Block_Initialize(), and can be used in place
+            //      (eg, from a read-only memory mapped file). The runtime types 
+            //      must use the matching relative types, of course.
+            //
+        struct Flags
+        {
+            enum Enum { Relocatable = 1<<0 };
+            typedef unsigned BitField;
         };
         
         template<typename Type> void    SerializeSubBlock(const Type* type);
@@ -56,8 +78,9 @@ namespace Serialization
             void    SerializeRaw    ( Type      type );
 
         std::unique_ptr<uint8[]>      AsMemoryBlock();
+        Flags::BitField               GetFlags() const { return _flags; }
 
-        NascentBlockSerializer();
+        NascentBlockSerializer(Flags::BitField flags = 0);
         ~NascentBlockSerializer();
 
         class InternalPointer
@@ -76,6 +99,9 @@ namespace Serialization
         std::vector<uint8>              _memory;
         std::vector<uint8>              _trailingSubBlocks;
         std::vector<InternalPointer>    _internalPointers;
+        Flags::BitField                 _flags;
+
+        SpecialBuffer::Enum AsStoredType(SpecialBuffer::Enum specialBuffer) const;
 
         virtual void PushBackPointer(size_t value);
         virtual void PushBackRaw(const void* data, size_t size);
@@ -87,6 +113,7 @@ namespace Serialization
     void            Block_Initialize(void* block, const void* base=nullptr);
     const void*     Block_GetFirstObject(const void* blockStart);
     size_t          Block_GetSize(const void* block);
+    bool            Block_IsRelocatable(const void* block);
     std::unique_ptr<uint8[]>     Block_Duplicate(const void* block);
 
         ////////////////////////////////////////////////////
@@ -109,7 +136,7 @@ namespace Serialization
     template<typename Type>
         void    NascentBlockSerializer::SerializeSubBlock(const Type* begin, const Type* end, SpecialBuffer::Enum specialBuffer)
     {
-        NascentBlockSerializer temporaryBlock;
+        NascentBlockSerializer temporaryBlock(_flags);
         for (auto i=begin; i!=end; ++i) {
             Serialize(temporaryBlock, *i);
         }
@@ -120,7 +147,7 @@ namespace Serialization
     template<typename Type>
         void    NascentBlockSerializer::SerializeSubBlock(const Type* type)
     {
-        NascentBlockSerializer temporaryBlock;
+        NascentBlockSerializer temporaryBlock(_flags);
         Serialize(temporaryBlock, type);
         SerializeSubBlock(temporaryBlock, SpecialBuffer::Unknown);
     }
@@ -140,8 +167,13 @@ namespace Serialization
     template<typename Type, typename Deletor>
         void    NascentBlockSerializer::SerializeValue  ( const DynamicArray<Type, Deletor>& value )
     {
-        SerializeSubBlock(value.begin(), value.end(), SpecialBuffer::UniquePtr);
-        SerializeValue(value.size());
+        if (_flags & Flags::Relocatable) {
+                // (RelativeArray holds the size itself)
+            SerializeSubBlock(value.begin(), value.end(), SpecialBuffer::RelativeArray);
+        } else {
+            SerializeSubBlock(value.begin(), value.end(), SpecialBuffer::UniquePtr);
+            SerializeValue(value.size());
+        }
     }
         
     template<typename Type, typename Deletor>
@@ -14,10 +14,15 @@ namespace Serialization { namespace ChunkFile
 {
     using Assets::Exceptions::FormatError;
 
-    std::vector<ChunkHeader> LoadChunkTable(BasicFile& file)
+    std::vector<ChunkHeader> LoadChunkTable(BasicFile& file, uint32& hashFamily)
     {
+            //  Version 0 headers are the same as version 1, except that they end just
+            //  before _hashFamily. So read that part first, and then the rest if it's there.
+        const size_t version0HeaderSize = offsetof(ChunkFileHeader, _hashFamily);
+
         ChunkFileHeader fileHeader;
-        if (file.Read(&fileHeader, sizeof(ChunkFileHeader), 1) != 1) {
+        XlZeroMemory(fileHeader);
+        if (file.Read(&fileHeader, version0HeaderSize, 1) != 1) {
             throw FormatError("Incomplete file header");
         }
 
@@ -25,10 +30,18 @@ namespace Serialization { namespace ChunkFile
             throw FormatError("Unrecognised format");
         }
 
-        if (fileHeader._fileVersionNumber != ChunkFileVersion) {
+        if (fileHeader._fileVersionNumber == 0) {
+            fileHeader._hashFamily = HASH_FAMILY_MURMUR;
+        } else if (fileHeader._fileVersionNumber == ChunkFileVersion) {
+            if (file.Read(&fileHeader._hashFamily, sizeof(ChunkFileHeader) - version0HeaderSize, 1) != 1) {
+                throw FormatError("Incomplete file header");
+            }
+        } else {
             throw FormatError("Bad chunk file format");
         }
 
+        hashFamily = fileHeader._hashFamily;
+
         std::vector<ChunkHeader> result;
         result.resize(fileHeader._chunkCount);
         auto readCount = file.Read(AsPointer(result.begin()), sizeof(ChunkHeader), fileHeader._chunkCount);
@@ -39,6 +52,16 @@ namespace Serialization { namespace ChunkFile
         return result;
     }
 
+    std::vector<ChunkHeader> LoadChunkTable(BasicFile& file)
+    {
+        uint32 hashFamily = 0;
+        auto result = LoadChunkTable(file, hashFamily);
+        if (hashFamily != HashFamily_Active) {
+            throw FormatError("Chunk file was built with a different hash function");
+        }
+        return result;
+    }
+
     Serialization::ChunkFile::ChunkHeader FindChunk(
         const char filename[],
         std::vector<Serialization::ChunkFile::ChunkHeader>& hdrs,
@@ -79,6 +102,58 @@ namespace Serialization { namespace ChunkFile
         return std::move(rawMemoryBlock);
     }
 
+    MappedChunk MapChunk(
+            const char filename[],
+            Serialization::ChunkFile::TypeIdentifier chunkType,
+            unsigned expectedVersion)
+    {
+        ChunkHeader scaffoldChunk;
+        {
+            BasicFile file(filename, "rb");
+            auto chunks = Serialization::ChunkFile::LoadChunkTable(file);
+            scaffoldChunk = FindChunk(filename, chunks, chunkType, expectedVersion);
+        }
+
+        auto mappedFile = std::make_unique<MemoryMappedFile>(filename, 0, MemoryMappedFile::Access::Read);
+        if (!mappedFile->IsValid()) {
+            throw FormatError("Could not map chunk file: %s", filename);
+        }
+
+        if ((uint64(scaffoldChunk._fileOffset) + uint64(scaffoldChunk._size)) > mappedFile->GetSize()) {
+            throw FormatError("Chunk extends beyond the end of the file: %s", filename);
+        }
+
+        return MappedChunk(std::move(mappedFile), scaffoldChunk._fileOffset, scaffoldChunk._size);
+    }
+
+    MappedChunk::MappedChunk(std::unique_ptr<MemoryMappedFile>&& file, size_t offset, size_t size)
+    : _file(std::move(file))
+    , _size(size)
+    {
+        _data = PtrAdd(_file->GetData(), offset);
+    }
+
+    MappedChunk::MappedChunk(MappedChunk&& moveFrom)
+    : _file(std::move(moveFrom._file))
+    , _data(moveFrom._data)
+    , _size(moveFrom._size)
+    {
+        moveFrom._data = nullptr;
+        moveFrom._size = 0;
+    }
+
+    MappedChunk& MappedChunk::operator=(MappedChunk&& moveFrom)
+    {
+        _file = std::move(moveFrom._file);
+        _data = moveFrom._data;
+        _size = moveFrom._size;
+        moveFrom._data = nullptr;
+        moveFrom._size = 0;
+        return *this;
+    }
+
+    MappedChunk::~MappedChunk() {}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
     SimpleChunkFileWriter::SimpleChunkFileWriter(
@@ -96,10 +171,11 @@ namespace Serialization { namespace ChunkFile
         ChunkFileHeader fileHeader;
         XlZeroMemory(fileHeader);
         fileHeader._magic = MagicHeader;
-        fileHeader._fileVersionNumber = 0;
+        fileHeader._fileVersionNumber = ChunkFileVersion;
         XlCopyString(fileHeader._buildVersion, dimof(fileHeader._buildVersion), buildVersionString);
         XlCopyString(fileHeader._buildDate, dimof(fileHeader._buildDate), buildDateString);
         fileHeader._chunkCount = chunkCount;
+        fileHeader._hashFamily = HashFamily_Active;
 
         Write(&fileHeader, sizeof(fileHeader), 1);
         for (unsigned c=0; c<chunkCount; ++c) {
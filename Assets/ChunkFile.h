@@ -8,6 +8,7 @@
 
 #include "../Utility/Streams/FileUtils.h"
 #include "../Utility/StringUtils.h"
+#include "../Utility/MemoryUtils.h"
 #include "../Core/Types.h"
 #include <algorithm>
 #include <vector>
@@ -50,8 +51,14 @@ namespace Serialization { namespace ChunkFile
     };
 
     static const unsigned MagicHeader = uint32('X') | (uint32('L') << 8) | (uint32('E') << 16) | (uint32('~') << 24);
-    static const unsigned ChunkFileVersion = 0;
-
+    static const unsigned ChunkFileVersion = 1;
+
+        //  version 0 -- original layout, without _hashFamily (always HASH_FAMILY_MURMUR)
+        //  version 1 -- added _hashFamily
+        //  Chunk files are often full of hash values (chunk contents, and ids in
+        //  archive caches). The _hashFamily member records the Hash64/Hash32
+        //  implementation that built them (see HashFamily_Active), so files built with a
+        //  different hash can be rejected or upgraded, rather than silently failing to match.
     class ChunkFileHeader
     {
     public:
@@ -60,10 +67,18 @@ namespace Serialization { namespace ChunkFile
         char        _buildVersion[64];
         char        _buildDate[64];
         unsigned    _chunkCount;
+        uint32      _hashFamily;
     };
 
+        //  Reads the chunk table, and rejects files built with a different hash family.
+        //  Use this for compiled intermediates (which depend on hash values).
     std::vector<ChunkHeader> LoadChunkTable(Utility::BasicFile& file);
 
+        //  Reads the chunk table from a file built with any hash family, and returns that
+        //  family in "hashFamily". The caller must either not depend on hash values from
+        //  the file, or rebuild them when the family is not HashFamily_Active.
+    std::vector<ChunkHeader> LoadChunkTable(Utility::BasicFile& file, uint32& hashFamily);
+
     ChunkHeader FindChunk(
         const char filename[], std::vector<ChunkHeader>& hdrs,
         TypeIdentifier chunkType, unsigned expectedVersion);
@@ -71,6 +86,33 @@ namespace Serialization { namespace ChunkFile
     std::unique_ptr<uint8[]> RawChunkAsMemoryBlock(
         const char filename[], TypeIdentifier chunkType, unsigned expectedVersion);
 
+        /// <summary>A chunk that is used in place, from a read-only memory mapped file</summary>
+        /// Intended for blocks built with NascentBlockSerializer::Flags::Relocatable,
+        /// which don't need Block_Initialize(). The data is valid for the lifetime
+        /// of this object, and must not be written to.
+    class MappedChunk
+    {
+    public:
+        const void*     GetData() const     { return _data; }
+        size_t          GetSize() const     { return _size; }
+
+        MappedChunk(std::unique_ptr<Utility::MemoryMappedFile>&& file, size_t offset, size_t size);
+        MappedChunk(MappedChunk&& moveFrom);
+        MappedChunk& operator=(MappedChunk&& moveFrom);
+        ~MappedChunk();
+
+    private:
+        std::unique_ptr<Utility::MemoryMappedFile> _file;
+        const void* _data;
+        size_t _size;
+
+        MappedChunk(const MappedChunk&);
+        MappedChunk& operator=(const MappedChunk&);
+    };
+
+    MappedChunk MapChunk(
+        const char filename[], TypeIdentifier chunkType, unsigned expectedVersion);
+
     class SimpleChunkFileWriter : public Utility::BasicFile
     {
     public:
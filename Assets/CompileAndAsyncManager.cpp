@@ -9,6 +9,7 @@
 #include "../ConsoleRig/Log.h"
 #include "../Utility/StringUtils.h"
 #include "../Utility/PtrUtils.h"
+#include "../Utility/Profiling/CPUProfilerRegistry.h"
 
 namespace Assets
 {
@@ -34,6 +35,7 @@ namespace Assets
     public:
         std::vector<std::unique_ptr<IAssetSet>> _sets;
         unsigned _boundThreadId;
+        Threading::Mutex _lock;
     };
 
     void AssetSetManager::Add(std::unique_ptr<IAssetSet>&& set)
@@ -43,6 +45,7 @@ namespace Assets
 
     void AssetSetManager::Clear()
     {
+        ScopedLock(_pimpl->_lock);
         for (auto i=_pimpl->_sets.begin(); i!=_pimpl->_sets.end(); ++i) {
             (*i)->Clear();
         }
@@ -50,12 +53,22 @@ namespace Assets
 
     void AssetSetManager::LogReport()
     {
+        ScopedLock(_pimpl->_lock);
         for (auto i=_pimpl->_sets.begin(); i!=_pimpl->_sets.end(); ++i) {
             (*i)->LogReport();
         }
     }
 
+    void AssetSetManager::OnFrameBarrier()
+    {
+        ScopedLock(_pimpl->_lock);
+        for (auto i=_pimpl->_sets.begin(); i!=_pimpl->_sets.end(); ++i) {
+            (*i)->OnFrameBarrier();
+        }
+    }
+
     unsigned AssetSetManager::BoundThreadId() { return _pimpl->_boundThreadId; }
+    Threading::Mutex& AssetSetManager::GetLock() { return _pimpl->_lock; }
 
     AssetSetManager::AssetSetManager()
     {
@@ -71,6 +84,10 @@ namespace Assets
 
     void CompileAndAsyncManager::Update()
     {
+            //  Shader compiles run on the D3DX thread pump's own threads, which we
+            //  can't register. So the pump update and the polling processes are
+            //  recorded on the calling thread instead.
+        ThreadProfileEvent profileEvent("CompileAndAsyncManager::Update", CPUProfilerRegistry::GetInstance().GetThreadProfiler());
         if (_threadPump) {
             _threadPump->Update();
         }
@@ -8,6 +8,7 @@
 
 #include "../Core/Prefix.h"
 #include "../Core/Types.h"
+#include "../Utility/Threading/Mutex.h"
 #include <memory>
 #include <functional>
 #include <vector>
@@ -49,16 +50,19 @@ namespace Assets
     public:
         virtual void Clear() = 0;
         virtual void LogReport() = 0;
+        virtual void OnFrameBarrier() = 0;
         virtual ~IAssetSet();
     };
 
     class AssetSetManager
     {
     public:
-        void Add(std::unique_ptr<IAssetSet>&& set);
+        void Add(std::unique_ptr<IAssetSet>&& set);     ///< caller must hold GetLock()
         void Clear();
         void LogReport();
+        void OnFrameBarrier();      ///< call once per frame; destroys assets retired a few frames ago
         unsigned BoundThreadId();
+        Threading::Mutex& GetLock();
 
         AssetSetManager();
         ~AssetSetManager();
@@ -0,0 +1,278 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../Utility/Threading/ThreadingUtils.h"
+#include "../Utility/Threading/Mutex.h"
+#include "../Core/Types.h"
+#include "../Core/Exceptions.h"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <utility>
+
+namespace Assets { namespace Internal
+{
+    /// <summary>Thread safe hash table of assets, used by AssetSet</summary>
+    /// Assets are split into shards based on the top bits of the hash value.
+    /// Each shard is an open addressing table of entry pointers that can be
+    /// searched without taking any locks. Locks are only taken when adding a
+    /// new entry (or growing the table).
+    ///
+    /// Each entry also has a small state machine, so that only a single thread
+    /// will ever construct an asset for a given hash. Other threads that request
+    /// the same asset while it is being constructed will wait for that construction
+    /// to complete.
+    ///
+    /// Entries are never removed (except by Clear()). Tables that are replaced while
+    /// growing are kept until Clear(). Assets that are replaced during a dependency
+    /// refresh are retired, and destroyed by OnFrameBarrier() once RetireFrameDelay
+    /// frames have passed. So a reference returned from FindOrCreate() remains valid
+    /// even if another thread refreshes the asset, as long as it isn't held across
+    /// that many frames.
+    /// Clear() must not be called while other threads are accessing the table.
+    template<typename AssetType>
+        class ConcurrentAssetTable
+    {
+    public:
+        template<typename CreateFn, typename RefreshFn, typename OnFirstCreateFn>
+            AssetType& FindOrCreate(
+                uint64 hash, CreateFn&& create,
+                RefreshFn&& needsRefresh, OnFirstCreateFn&& onFirstCreate);
+
+        std::vector<uint64> GetHashes() const;
+        void Clear();
+        void OnFrameBarrier();
+
+        static const unsigned RetireFrameDelay = 4;
+
+        ConcurrentAssetTable();
+        ~ConcurrentAssetTable();
+    protected:
+        struct State { enum Enum { Empty, Constructing, Ready }; };
+
+        class Entry
+        {
+        public:
+            uint64                          _hash;
+            AssetType* volatile             _asset;
+            Interlocked::Value volatile     _state;
+            bool                            _hasBeenConstructed;     // (only touched by the thread that holds the "Constructing" state)
+
+            Entry(uint64 hash) : _hash(hash), _asset(nullptr), _state(State::Empty), _hasBeenConstructed(false) {}
+            ~Entry() { delete _asset; }
+        };
+
+        class Table
+        {
+        public:
+            unsigned            _mask;
+            std::vector<Entry*> _slots;     // only written with Interlocked::ExchangePointer, while the shard is locked
+
+            Table(unsigned capacity) : _mask(capacity-1), _slots(capacity, nullptr) {}
+        };
+
+        class Shard
+        {
+        public:
+            Table* volatile                             _table;
+            Threading::Mutex                            _lock;
+            std::vector<std::unique_ptr<Entry>>         _entries;
+            std::vector<std::unique_ptr<Table>>         _tables;            // current table is the last one; earlier ones are retired
+            std::vector<std::pair<unsigned, std::unique_ptr<AssetType>>> _retiredAssets;     // (frame it was retired in, asset)
+
+            Shard() : _table(nullptr) {}
+        };
+
+        static const unsigned ShardCountBits = 6;
+        static const unsigned ShardCount = 1<<ShardCountBits;
+        static const unsigned InitialTableCapacity = 16;
+        Shard _shards[ShardCount];
+        Interlocked::Value volatile _currentFrame;
+
+        static Shard& GetShard(Shard shards[], uint64 hash)     { return shards[unsigned(hash >> (64-ShardCountBits))]; }
+        static Entry* Find(const Shard& shard, uint64 hash);
+        static Entry* Insert(Shard& shard, uint64 hash);
+        static void Retire(Shard& shard, AssetType* asset, unsigned frame);
+    };
+
+    template<typename AssetType>
+        auto ConcurrentAssetTable<AssetType>::Find(const Shard& shard, uint64 hash) -> Entry*
+    {
+            // lock-free search; the table pointer and the slots are only ever replaced atomically
+        auto* table = (const Table*)Interlocked::LoadPointer((void*volatile const*)&shard._table);
+        if (!table) { return nullptr; }
+
+        for (unsigned c=0;; ++c) {
+            auto* entry = (Entry*)Interlocked::LoadPointer((void*volatile const*)&table->_slots[(unsigned(hash) + c) & table->_mask]);
+            if (!entry) { return nullptr; }
+            if (entry->_hash == hash) { return entry; }
+        }
+    }
+
+    template<typename AssetType>
+        auto ConcurrentAssetTable<AssetType>::Insert(Shard& shard, uint64 hash) -> Entry*
+    {
+            // (shard must be locked by the caller)
+        auto* table = shard._table;
+        if (!table || ((shard._entries.size()+1)*4) > (table->_slots.size()*3)) {
+                //  Build a larger table, and publish it. The old table must stay alive,
+                //  because other threads may still be searching through it.
+            auto newTable = std::make_unique<Table>(table ? unsigned(table->_slots.size()*2) : InitialTableCapacity);
+            for (auto i=shard._entries.cbegin(); i!=shard._entries.cend(); ++i) {
+                unsigned slot = unsigned((*i)->_hash) & newTable->_mask;
+                while (newTable->_slots[slot]) { slot = (slot+1) & newTable->_mask; }
+                newTable->_slots[slot] = i->get();
+            }
+            table = newTable.get();
+            shard._tables.push_back(std::move(newTable));
+            Interlocked::ExchangePointer((void*volatile*)&shard._table, table);
+        }
+
+        auto newEntry = std::make_unique<Entry>(hash);
+        unsigned slot = unsigned(hash) & table->_mask;
+        while (table->_slots[slot]) { slot = (slot+1) & table->_mask; }
+        auto* result = newEntry.get();
+        shard._entries.push_back(std::move(newEntry));
+        Interlocked::ExchangePointer((void*volatile*)&table->_slots[slot], result);
+        return result;
+    }
+
+    template<typename AssetType>
+        void ConcurrentAssetTable<AssetType>::Retire(Shard& shard, AssetType* asset, unsigned frame)
+    {
+        if (!asset) { return; }
+        ScopedLock(shard._lock);
+        shard._retiredAssets.push_back(std::make_pair(frame, std::unique_ptr<AssetType>(asset)));
+    }
+
+    template<typename AssetType>
+        template<typename CreateFn, typename RefreshFn, typename OnFirstCreateFn>
+            AssetType& ConcurrentAssetTable<AssetType>::FindOrCreate(
+                uint64 hash, CreateFn&& create,
+                RefreshFn&& needsRefresh, OnFirstCreateFn&& onFirstCreate)
+    {
+        auto& shard = GetShard(_shards, hash);
+        for (;;) {
+            auto* entry = Find(shard, hash);
+            if (!entry) {
+                ScopedLock(shard._lock);
+                entry = Find(shard, hash);
+                if (!entry) {
+                    entry = Insert(shard, hash);
+                }
+            }
+
+                //  Fast path -- asset already exists and doesn't need to be rebuilt.
+                //  Otherwise we must take ownership of the "Constructing" state before
+                //  building the asset.
+            auto state = Interlocked::Load(&entry->_state);
+            if (state == State::Ready) {
+                auto* asset = entry->_asset;
+                if (!needsRefresh(asset)) {
+                    return *asset;
+                }
+                if (Interlocked::CompareExchange(&entry->_state, State::Constructing, State::Ready) != State::Ready) {
+                    continue;
+                }
+            } else if (state == State::Empty) {
+                if (Interlocked::CompareExchange(&entry->_state, State::Constructing, State::Empty) != State::Empty) {
+                    continue;
+                }
+            } else {
+                    // another thread is constructing this asset; wait for it to finish
+                Threading::YieldTimeSlice();
+                continue;
+            }
+
+                //  We now own this entry. Note that when refreshing, the old asset is retired
+                //  before the new one is constructed. If construction throws, we're left with
+                //  an empty entry, and the next request will attempt to construct it again.
+            auto* oldAsset = (AssetType*)Interlocked::ExchangePointer((void*volatile*)&entry->_asset, nullptr);
+            Retire(shard, oldAsset, unsigned(Interlocked::Load(&_currentFrame)));
+
+            std::unique_ptr<AssetType> newAsset;
+            TRY {
+                newAsset = create();
+            } CATCH (...) {
+                Interlocked::Exchange(&entry->_state, State::Empty);
+                RETHROW;
+            } CATCH_END
+
+            if (!entry->_hasBeenConstructed) {
+                entry->_hasBeenConstructed = true;
+                onFirstCreate();
+            }
+
+            auto* result = newAsset.release();
+            Interlocked::ExchangePointer((void*volatile*)&entry->_asset, result);
+            Interlocked::Exchange(&entry->_state, State::Ready);
+            return *result;
+        }
+    }
+
+    template<typename AssetType>
+        std::vector<uint64> ConcurrentAssetTable<AssetType>::GetHashes() const
+    {
+        std::vector<uint64> result;
+        for (unsigned s=0; s<ShardCount; ++s) {
+            auto& shard = const_cast<Shard&>(_shards[s]);
+            ScopedLock(shard._lock);
+            for (auto i=shard._entries.cbegin(); i!=shard._entries.cend(); ++i) {
+                if (Interlocked::Load(&(*i)->_state) == State::Ready) {
+                    result.push_back((*i)->_hash);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return std::move(result);
+    }
+
+    template<typename AssetType>
+        void ConcurrentAssetTable<AssetType>::Clear()
+    {
+        for (unsigned s=0; s<ShardCount; ++s) {
+            auto& shard = _shards[s];
+            ScopedLock(shard._lock);
+            Interlocked::ExchangePointer((void*volatile*)&shard._table, nullptr);
+            shard._entries.clear();
+            shard._tables.clear();
+            shard._retiredAssets.clear();
+        }
+    }
+
+    template<typename AssetType>
+        void ConcurrentAssetTable<AssetType>::OnFrameBarrier()
+    {
+            //  Destroy the assets that were retired at least RetireFrameDelay frames ago.
+            //  The destructors run after the shard lock is released, because destroying
+            //  an asset might request other assets from this table.
+        auto frame = unsigned(Interlocked::Increment(&_currentFrame)+1);
+        std::vector<std::unique_ptr<AssetType>> expired;
+        for (unsigned s=0; s<ShardCount; ++s) {
+            auto& shard = _shards[s];
+            {
+                ScopedLock(shard._lock);
+                auto& retired = shard._retiredAssets;
+                auto i = std::partition(retired.begin(), retired.end(),
+                    [frame](const std::pair<unsigned, std::unique_ptr<AssetType>>& r) { return (frame - r.first) < RetireFrameDelay; });
+                for (auto e=i; e!=retired.end(); ++e) {
+                    expired.push_back(std::move(e->second));
+                }
+                retired.erase(i, retired.end());
+            }
+            expired.clear();
+        }
+    }
+
+    template<typename AssetType>
+        ConcurrentAssetTable<AssetType>::ConcurrentAssetTable() : _currentFrame(0) {}
+
+    template<typename AssetType>
+        ConcurrentAssetTable<AssetType>::~ConcurrentAssetTable() {}
+}}
+
@@ -0,0 +1,98 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../Core/Types.h"
+#include "../Utility/PtrUtils.h"
+#include <assert.h>
+
+namespace Serialization
+{
+        //
+        //  Position independent pointer types for serialized blocks.
+        //
+        //  Each stores the distance from its own address to the data it refers to,
+        //  so a block built only from these (and plain values) is valid at any
+        //  address. It can be used straight out of a read-only memory mapped file,
+        //  without Block_Initialize() and without a copy. See
+        //  NascentBlockSerializer::Flags::Relocatable.
+        //
+        //  The offsets are only meaningful where the serializer put them, so
+        //  these types can't be copied. Always access them by reference into the
+        //  block.
+        //
+
+    /// <summary>Self-relative pointer to a single object (or an array with a separately stored count)</summary>
+    template<typename Type>
+        class RelativePtr
+    {
+    public:
+        Type*           get()                   { return _offset ? (Type*)PtrAdd(this, ptrdiff_t(_offset)) : nullptr; }
+        const Type*     get() const             { return _offset ? (const Type*)PtrAdd(this, ptrdiff_t(_offset)) : nullptr; }
+        Type*           operator->()            { return get(); }
+        const Type*     operator->() const      { return get(); }
+        Type&           operator*()             { assert(_offset); return *get(); }
+        const Type&     operator*() const       { assert(_offset); return *get(); }
+        Type&           operator[](size_t index)        { return get()[index]; }
+        const Type&     operator[](size_t index) const  { return get()[index]; }
+        bool            IsNull() const          { return _offset == 0; }
+
+        RelativePtr() : _offset(0) {}
+    private:
+        int64   _offset;
+
+        RelativePtr(const RelativePtr&);
+        RelativePtr& operator=(const RelativePtr&);
+    };
+
+    /// <summary>Self-relative array; replaces std::vector and DynamicArray in relocatable blocks</summary>
+    template<typename Type>
+        class RelativeArray
+    {
+    public:
+        typedef const Type* const_iterator;
+        typedef Type*       iterator;
+
+        Type*           begin()                 { return (Type*)PtrAdd(this, ptrdiff_t(_offset)); }
+        Type*           end()                   { return (Type*)PtrAdd(this, ptrdiff_t(_offset + _byteCount)); }
+        const Type*     begin() const           { return (const Type*)PtrAdd(this, ptrdiff_t(_offset)); }
+        const Type*     end() const             { return (const Type*)PtrAdd(this, ptrdiff_t(_offset + _byteCount)); }
+        const Type*     cbegin() const          { return begin(); }
+        const Type*     cend() const            { return end(); }
+        size_t          size() const            { return size_t(_byteCount / sizeof(Type)); }
+        bool            empty() const           { return _byteCount == 0; }
+        Type&           operator[](size_t index)        { assert(index < size()); return begin()[index]; }
+        const Type&     operator[](size_t index) const  { assert(index < size()); return begin()[index]; }
+
+        RelativeArray() : _offset(0), _byteCount(0) {}
+    private:
+        int64   _offset;
+        uint64  _byteCount;
+
+        RelativeArray(const RelativeArray&);
+        RelativeArray& operator=(const RelativeArray&);
+    };
+
+    /// <summary>Self-relative, null terminated string; replaces std::string in relocatable blocks</summary>
+    class RelativeString
+    {
+    public:
+        const char*     c_str() const           { return _offset ? (const char*)PtrAdd(this, ptrdiff_t(_offset)) : ""; }
+        const char*     begin() const           { return c_str(); }
+        const char*     end() const             { return c_str() + _length; }
+        size_t          size() const            { return size_t(_length); }
+        bool            empty() const           { return _length == 0; }
+
+        RelativeString() : _offset(0), _length(0) {}
+    private:
+        int64   _offset;
+        uint64  _length;
+
+        RelativeString(const RelativeString&);
+        RelativeString& operator=(const RelativeString&);
+    };
+}
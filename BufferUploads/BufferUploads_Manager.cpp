@@ -11,6 +11,7 @@
 #include "DataPacket.h"
 #include "../ConsoleRig/Log.h"
 #include "../Utility/Threading/ThreadingUtils.h"
+#include "../Utility/Profiling/CPUProfilerRegistry.h"
 #include "../Utility/MemoryUtils.h"
 #include "../Utility/PtrUtils.h"
 #include "../Utility/BitUtils.h"
@@ -42,111 +43,6 @@ namespace BufferUploads
 
         ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-    template<typename T>
-    struct DeleteAligned
-    {
-        void operator()(T* ptr) { XlMemAlignFree(ptr); }
-    };
-
-    class FileDataSource : public RawDataPacket
-    {
-    public:
-        virtual void*                           GetData             (unsigned mipIndex, unsigned arrayIndex);
-        virtual size_t                          GetDataSize         (unsigned mipIndex, unsigned arrayIndex) const;
-        virtual std::pair<unsigned,unsigned>    GetRowAndSlicePitch (unsigned mipIndex, unsigned arrayIndex) const;
-
-        FileDataSource(const void* fileHandle, size_t offset, size_t dataSize);
-        virtual ~FileDataSource();
-
-    protected:
-        std::unique_ptr<byte[], DeleteAligned<byte>>        _pkt;
-        HANDLE      _fileHandle;
-        OVERLAPPED  _overlappedStatus;
-        size_t      _dataSize;
-    };
-
-    void*                     FileDataSource::GetData             (unsigned mipIndex, unsigned arrayIndex)
-    {
-        if (mipIndex == 0) {
-            while (!HasOverlappedIoCompleted(&_overlappedStatus)) {
-                ::Threading::YieldTimeSlice();
-            }
-
-            return _pkt.get();
-        }
-        return nullptr;
-    }
-
-    size_t                          FileDataSource::GetDataSize         (unsigned mipIndex, unsigned arrayIndex) const
-    {
-        return _dataSize;
-    }
-
-    std::pair<unsigned,unsigned>    FileDataSource::GetRowAndSlicePitch (unsigned mipIndex, unsigned arrayIndex) const
-    {
-            // hack -- hard coded values for terrain upload
-        if (_dataSize == 8192) {
-            int pixelWidth = 128;
-            return std::make_pair(pixelWidth * 64 / 8 / 4, unsigned(_dataSize));
-        } else if (_dataSize == 2312) { 
-            return std::make_pair(34*2, unsigned(_dataSize));
-        } else if (_dataSize == 4356) { 
-            return std::make_pair(33*4, unsigned(_dataSize));
-        } else {
-            return std::make_pair(33*2, unsigned(_dataSize));
-        }
-    }
-
-    FileDataSource::FileDataSource(const void* fileHandle, size_t offset, size_t dataSize)
-    {
-        assert(dataSize);
-        assert(fileHandle != INVALID_HANDLE_VALUE);
-
-            //  duplicate the file handle so we get our own reference count on this
-            //  file object.
-        HANDLE duplicatedFileHandle;
-        ::DuplicateHandle(
-            GetCurrentProcess(), (HANDLE)fileHandle, GetCurrentProcess(),
-            &duplicatedFileHandle, 0, FALSE, DUPLICATE_SAME_ACCESS);
-
-            // start the read operation immediately (it will happen asynchronously)
-            //
-            //      Simple asynchronous io to start with... Just start the io here (from the
-            //      queuing thread), and add a stall when we attempt to read the data.
-            //      
-            //      We'll be reading into a temporary buffer, and then copying that into
-            //      the staging texture. That's a little bit redundant. Ideally we'd allocate
-            //      the staging texture first, and then copy into that from here.
-        std::unique_ptr<byte[], DeleteAligned<byte>> pkt((byte*)XlMemAlign(dataSize, 16));
-        XlSetMemory(&_overlappedStatus, 0, sizeof(_overlappedStatus));
-        _overlappedStatus.Offset = (DWORD)offset;
-        _overlappedStatus.OffsetHigh = (DWORD)(uint64(offset)>>32);
-        // SetFilePointer(duplicatedFileHandle, offset, 0, FILE_BEGIN);
-        auto result = ReadFile(
-            duplicatedFileHandle, pkt.get(), (DWORD)dataSize, 
-            nullptr, &_overlappedStatus);
-        auto lastError = GetLastError();
-        (void)result; (void)lastError;
-
-        _pkt = std::move(pkt);
-        _fileHandle = duplicatedFileHandle;
-        _dataSize = dataSize;
-    }
-
-    FileDataSource::~FileDataSource()
-    {
-        if (_fileHandle && _fileHandle!=INVALID_HANDLE_VALUE) {
-            CloseHandle(_fileHandle);
-        }
-    }
-
-    intrusive_ptr<RawDataPacket> CreateFileDataSource(const void* fileHandle, size_t offset, size_t dataSize)
-    {
-        return make_intrusive<FileDataSource>(fileHandle, offset, dataSize);
-    }
-    
-        ///////////////////////////////////////////////////////////////////////////////////////////////////
-
     static BufferDesc AsStagingDesc(const BufferDesc& desc)
     {
         BufferDesc result = desc;
@@ -172,9 +68,9 @@ namespace BufferUploads
     template<typename Entry, int EntryCount>
         struct LockFreeQueue {
             #if defined(D3D_BUFFER_UPLOAD_USE_WAITABLE_QUEUES)
-                typedef LockFree::FixedSizeQueue_Waitable< Entry, EntryCount >  ResolvedType;
+                typedef LockFree::MPMCQueue_Waitable< Entry, EntryCount >       ResolvedType;
             #else
-                typedef LockFree::FixedSizeQueue< Entry, EntryCount >           ResolvedType;
+                typedef LockFree::MPMCQueue< Entry, EntryCount >                ResolvedType;
             #endif
         };
 
@@ -261,8 +157,8 @@ namespace BufferUploads
         #endif
 
         #if defined(OPTIMISED_ALLOCATE_TRANSACTION)
-            SimpleSpanningHeap _transactionsHeap;
-            SimpleSpanningHeap _transactionsHeap_LongTerm;
+            SpanningHeap<uint32> _transactionsHeap;
+            SpanningHeap<uint32> _transactionsHeap_LongTerm;
         #endif
 
         Threading::Mutex        _transactionsLock;
@@ -1080,7 +976,7 @@ namespace BufferUploads
             }
             (*offsetWriteIterator) = offset;
             queuedBytesAdjustment[AsUploadDataType(transaction->_desc)] -= Interlocked::Value(size);
-            offset += MarkerHeap<uint16>::AlignSize(size);
+            offset += MarkerHeap<uint32>::AlignSize(size);
         }
 
         for (unsigned c=0; c<dimof(queuedBytesAdjustment); ++c) {
@@ -1248,7 +1144,7 @@ namespace BufferUploads
             for (;;) {
                 unsigned thisSize = 0;
                 if (batchingI!=batchOperation._batchedSteps.end()) {
-                    thisSize = MarkerHeap<uint16>::AlignSize(PlatformInterface::ByteCount(batchingI->_creationDesc));
+                    thisSize = MarkerHeap<uint32>::AlignSize(PlatformInterface::ByteCount(batchingI->_creationDesc));
                 }
                 if (batchingI == batchOperation._batchedSteps.end() || (currentBatchSize+thisSize) > maxSingleBatch) {
                     if (batchingI == batchingStart) {
@@ -1460,7 +1356,7 @@ namespace BufferUploads
 
                     completed = true;
                     _batchPreparation_Main._batchedSteps.push_back(resourceCreateStep);
-                    _batchPreparation_Main._batchedAllocationSize += MarkerHeap<uint16>::AlignSize(objectSize);
+                    _batchPreparation_Main._batchedAllocationSize += MarkerHeap<uint32>::AlignSize(objectSize);
                 }
 
                 if (completed) {
@@ -1772,7 +1668,7 @@ namespace BufferUploads
 
                 if (!nothingFoundInQueues && !atLeastOneRealAction) {
                     LogAlwaysWarningF("Warning -- suspected allocation failure; sleeping");
-                    Sleep(5);
+                    Threading::Sleep(5);
                 }
             }
 
@@ -2083,7 +1979,24 @@ namespace BufferUploads
             LogAlwaysWarningF("Push upload step to (%i)", _framePriority_WritingQueueSet);
         }
         Interlocked::Increment(&transaction._referenceCount);
-        GetQueueSet(transaction._creationOptions)._uploadSteps.push_overflow(step);
+
+            //  If the packet is still being filled asynchronously (eg, by a file read), the
+            //  step gets queued by the packet when its data arrives, rather than here. That
+            //  way the background thread never stalls waiting for io. The reference we've
+            //  just taken keeps the transaction alive in the meantime.
+            //  Frame priority steps are never deferred. They must land in the queue set that's
+            //  being written right now, because that's the set the frame barrier will drain.
+            //  By the time the data arrives, _framePriority_WritingQueueSet may have flipped.
+            //  So for those, we accept a stall on the background thread instead.
+        auto& queueSet = GetQueueSet(transaction._creationOptions);
+        bool deferred = false;
+        if (!(transaction._creationOptions & TransactionOptions::FramePriority) && step._rawData) {
+            deferred = step._rawData->DeferUntilReady(
+                [&queueSet, step]() { queueSet._uploadSteps.push_overflow(step); });
+        }
+        if (!deferred) {
+            queueSet._uploadSteps.push_overflow(step);
+        }
     }
 
     unsigned AssemblyLine::FlipWritingQueueSet()
@@ -2347,6 +2260,7 @@ namespace BufferUploads
         }
 
         // CryThreadSetName(-1, "BufferUploads");
+        auto& threadProfiler = CPUProfilerRegistry::GetInstance().GetThreadProfiler("BufferUploads");
         while (!_shutdownBackgroundThread && _backgroundStepMask) {
 
             if (_handlingLostDevice) {
@@ -2365,6 +2279,7 @@ namespace BufferUploads
             }
 
             if (!_shutdownBackgroundThread) {
+                ThreadProfileEvent profileEvent("BufferUploads::Process", threadProfiler);
                 _assemblyLine->Process(_backgroundStepMask, *_backgroundContext);
             }
             if (!_shutdownBackgroundThread) {
@@ -6,6 +6,11 @@
 
 #include "DataPacket.h"
 #include "PlatformInterface.h"
+#include "../ConsoleRig/Log.h"
+#include "../Utility/Streams/AsyncFileReader.h"
+#include "../Utility/Threading/Mutex.h"
+#include "../Utility/Threading/ThreadingUtils.h"
+#include "../Utility/PtrUtils.h"
 
 namespace BufferUploads
 {
@@ -56,18 +61,16 @@ namespace BufferUploads
     static unsigned    RoundBCDim(unsigned input)
     {
         uint32 part = input%BlockCompDim;
-        auto result = input + part?(BlockCompDim-part):0;
+        auto result = input + (part?(BlockCompDim-part):0);
         assert(!(result%BlockCompDim));
         return result;
     }
 
-    intrusive_ptr<BasicRawDataPacket> CreateEmptyPacket(const BufferDesc& desc)
+    static std::pair<unsigned,unsigned> CalculateRowAndSlicePitch(const BufferDesc& desc)
     {
-            // Create an empty packet of the appropriate size for the given desc
-            // Linear buffers are simple, but textures need a little more detail...
         if (desc._type == BufferDesc::Type::LinearBuffer) {
             auto size = PlatformInterface::ByteCount(desc);
-            return make_intrusive<BasicRawDataPacket>(size, nullptr, std::make_pair(size, size));
+            return std::make_pair(size, size);
         } else if (desc._type == BufferDesc::Type::Texture) {
                 //  currently not supporting textures with multiple mip-maps
                 //  or multiple array slices
@@ -95,11 +98,153 @@ namespace BufferUploads
                     (NativeFormat::Enum)desc._textureDesc._nativePixelFormat);
             }
 
-            return make_intrusive<BasicRawDataPacket>(slicePitch, nullptr, std::make_pair(rowPitch, slicePitch));
+            return std::make_pair(rowPitch, slicePitch);
         }
 
+        return std::make_pair(0u, 0u);
+    }
+
+    intrusive_ptr<BasicRawDataPacket> CreateEmptyPacket(const BufferDesc& desc)
+    {
+            // Create an empty packet of the appropriate size for the given desc
+            // Linear buffers are simple, but textures need a little more detail...
+        if (desc._type != BufferDesc::Type::LinearBuffer && desc._type != BufferDesc::Type::Texture) {
+            return nullptr;
+        }
+
+        auto pitches = CalculateRowAndSlicePitch(desc);
+        return make_intrusive<BasicRawDataPacket>(pitches.second, nullptr, pitches);
+    }
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    class FileDataSource : public RawDataPacket
+    {
+    public:
+        virtual void*                           GetData             (unsigned mipIndex, unsigned arrayIndex);
+        virtual size_t                          GetDataSize         (unsigned mipIndex, unsigned arrayIndex) const;
+        virtual std::pair<unsigned,unsigned>    GetRowAndSlicePitch (unsigned mipIndex, unsigned arrayIndex) const;
+        virtual bool                            DeferUntilReady     (std::function<void()>&& onReady);
+
+        void BeginRead(AsyncFileReader& reader, size_t offset);
+
+        FileDataSource(const void* fileHandle, size_t dataSize, std::pair<unsigned,unsigned> rowAndSlicePitch);
+        virtual ~FileDataSource();
+
+    protected:
+        std::unique_ptr<uint8, AlignedDeletor>  _data;
+        const void*                     _fileHandle;
+        size_t                          _dataSize;
+        std::pair<unsigned,unsigned>    _rowAndSlicePitch;
+
+        Threading::Mutex                _readLock;
+        bool                            _readComplete;
+        std::function<void()>           _onReady;
+
+        void OnReadComplete(size_t bytesRead);
+    };
+
+    void*                           FileDataSource::GetData             (unsigned mipIndex, unsigned arrayIndex)
+    {
+        if (mipIndex == 0) {
+                //  Normally the upload step is deferred until the read has completed,
+                //  so we shouldn't have to wait here. But clients can still call
+                //  GetData() directly...
+            for (;;) {
+                {
+                    ScopedLock(_readLock);
+                    if (_readComplete) break;
+                }
+                Threading::YieldTimeSlice();
+            }
+
+            return _data.get();
+        }
         return nullptr;
     }
 
-}
+    size_t                          FileDataSource::GetDataSize         (unsigned mipIndex, unsigned arrayIndex) const
+    {
+        return _dataSize;
+    }
 
+    std::pair<unsigned,unsigned>    FileDataSource::GetRowAndSlicePitch (unsigned mipIndex, unsigned arrayIndex) const
+    {
+        return _rowAndSlicePitch;
+    }
+
+    bool                            FileDataSource::DeferUntilReady     (std::function<void()>&& onReady)
+    {
+        ScopedLock(_readLock);
+        if (_readComplete) {
+            return false;
+        }
+        assert(!_onReady);  // only a single upload step can wait on a packet at a time
+        _onReady = std::move(onReady);
+        return true;
+    }
+
+    void FileDataSource::OnReadComplete(size_t bytesRead)
+    {
+        if (bytesRead < _dataSize) {
+            LogWarningF("Short read in FileDataSource (%u of %u bytes)", unsigned(bytesRead), unsigned(_dataSize));
+            XlSetMemory(PtrAdd(_data.get(), bytesRead), 0, _dataSize - bytesRead);
+        }
+
+        std::function<void()> onReady;
+        {
+            ScopedLock(_readLock);
+            _readComplete = true;
+            onReady = std::move(_onReady);
+            _onReady = nullptr;
+        }
+        if (onReady) {
+            onReady();
+        }
+    }
+
+    void FileDataSource::BeginRead(AsyncFileReader& reader, size_t offset)
+    {
+            //  The read holds a reference on the packet, so the destination buffer
+            //  (and the duplicated file handle) survive until the read has completed,
+            //  even if every client reference is released before then.
+            //
+            //  We'll be reading into a temporary buffer, and then copying that into
+            //  the staging texture. That's a little bit redundant. Ideally we'd allocate
+            //  the staging texture first, and then copy into that from here.
+        intrusive_ptr<FileDataSource> keepAlive(this);
+        AsyncFileReader::Request request;
+        request._fileHandle = _fileHandle;
+        request._offset = offset;
+        request._destination = _data.get();
+        request._size = _dataSize;
+        request._onCompletion = [keepAlive](size_t bytesRead) { keepAlive->OnReadComplete(bytesRead); };
+        reader.Submit(std::move(request));
+    }
+
+    FileDataSource::FileDataSource(const void* fileHandle, size_t dataSize, std::pair<unsigned,unsigned> rowAndSlicePitch)
+    : _dataSize(dataSize), _rowAndSlicePitch(rowAndSlicePitch), _readComplete(false)
+    {
+        assert(dataSize);
+
+            //  duplicate the file handle so we get our own reference count on this
+            //  file object.
+        _fileHandle = AsyncFileReader::DuplicateFileHandle(fileHandle);
+        _data.reset((uint8*)XlMemAlign(dataSize, 16));
+    }
+
+    FileDataSource::~FileDataSource()
+    {
+        AsyncFileReader::CloseFileHandle(_fileHandle);
+    }
+
+    intrusive_ptr<RawDataPacket> CreateFileDataSource(
+        AsyncFileReader& reader, const void* fileHandle, size_t offset, size_t dataSize,
+        const BufferDesc& desc)
+    {
+        auto result = make_intrusive<FileDataSource>(fileHandle, dataSize, CalculateRowAndSlicePitch(desc));
+        result->BeginRead(reader, offset);
+        return std::move(result);
+    }
+
+}
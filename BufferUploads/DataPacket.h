@@ -9,6 +9,8 @@
 #include "IBufferUploads.h"
 #include "../Utility/MemoryUtils.h"
 
+namespace Utility { class AsyncFileReader; }
+
 namespace BufferUploads
 {
     class BasicRawDataPacket : public RawDataPacket
@@ -36,7 +38,11 @@ namespace BufferUploads
     buffer_upload_dll_export intrusive_ptr<BasicRawDataPacket> CreateEmptyPacket(
         const BufferDesc& desc);
 
+        //  Starts reading "dataSize" bytes from the given file offset immediately. The 
+        //  packet defers its upload step until the read has completed (so the upload 
+        //  thread never stalls on io). Row and slice pitch are calculated from "desc".
     buffer_upload_dll_export intrusive_ptr<RawDataPacket> CreateFileDataSource(
-        const void* fileHandle, size_t offset, size_t dataSize);
+        AsyncFileReader& reader, const void* fileHandle, size_t offset, size_t dataSize,
+        const BufferDesc& desc);
 
 }
\ No newline at end of file
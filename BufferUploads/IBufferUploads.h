@@ -16,6 +16,7 @@
 #include "IBufferUploads_Forward.h"
 #include <vector>
 #include <memory>
+#include <functional>
 #include <assert.h>
 
 #if OUTPUT_DLL
@@ -243,6 +244,16 @@ namespace BufferUploads
         virtual void*                           GetData             (unsigned mipIndex=0, unsigned arrayIndex=0) = 0;
         virtual size_t                          GetDataSize         (unsigned mipIndex=0, unsigned arrayIndex=0) const = 0;
         virtual std::pair<unsigned,unsigned>    GetRowAndSlicePitch (unsigned mipIndex=0, unsigned arrayIndex=0) const = 0;
+
+            //
+            //      Packets that are filled asynchronously (eg, by a file read) can
+            //      hold back the upload until the data has arrived. If the data
+            //      isn't ready yet, DeferUntilReady() should keep "onReady" and call 
+            //      it (from any thread) when the data is ready, and return true.
+            //      If the data is already available, it should return false without
+            //      calling "onReady".
+            //
+        virtual bool                            DeferUntilReady     (std::function<void()>&& onReady) { return false; }
     };
 
         /////////////////////////////////////////////////
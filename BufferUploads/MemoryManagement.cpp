@@ -26,42 +26,39 @@ namespace BufferUploads
         #define DEBUG_ONLY(x)       
     #endif
 
-    std::pair<signed,signed> ReferenceCountingLayer::AddRef(unsigned start, unsigned size, const char name[])
+    void ReferenceCountingLayer::AddRef_Internal(
+        std::vector<Entry>& entries, Marker internalStart, Marker internalEnd, const char name[],
+        signed& refMin, signed& refMax)
     {
-        ScopedLock(_lock);
-        Marker internalStart = ToInternalSize(start);
-        Marker internalSize = ToInternalSize(AlignSize(size));
-
-        if (_entries.empty()) {
+        if (entries.empty()) {
             Entry newBlock;
             newBlock._start = internalStart;
-            newBlock._end = internalStart+internalSize;
+            newBlock._end = internalEnd;
             newBlock._refCount = 1;
             DEBUG_ONLY(newBlock._name = name);
-            _entries.insert(_entries.end(), newBlock);
-            return std::make_pair(newBlock._refCount, newBlock._refCount);
+            entries.insert(entries.end(), newBlock);
+            refMin = std::min(refMin, 1); refMax = std::max(refMax, 1);
+            return;
         }
 
-        std::vector<Entry>::iterator i = std::lower_bound(_entries.begin(), _entries.end(), internalStart, CompareStart());
-        if (i != _entries.begin() && ((i-1)->_end > internalStart)) {
+        std::vector<Entry>::iterator i = std::lower_bound(entries.begin(), entries.end(), internalStart, CompareStart());
+        if (i != entries.begin() && ((i-1)->_end > internalStart)) {
             --i;
         }
 
         Marker currentStart = internalStart;
-        Marker internalEnd = internalStart+internalSize;
-        signed refMin = INT_MAX, refMax = INT_MIN;
         for (;;++i) {
-            if (i >= _entries.end() || currentStart < i->_start) {
+            if (i >= entries.end() || currentStart < i->_start) {
                     //      this this is past the end of any other blocks -- add new a block
                 Entry newBlock;
                 newBlock._start = currentStart;
-                newBlock._end = std::min(internalEnd, Marker((i<_entries.end())?i->_start:INT_MAX));
+                newBlock._end = std::min(internalEnd, Marker((i<entries.end())?i->_start:INT_MAX));
                 newBlock._refCount = 1;
                 DEBUG_ONLY(newBlock._name = name);
                 assert(newBlock._start < newBlock._end);
                 assert(newBlock._end != 0xbaad);
-                bool end = i >= _entries.end() || internalEnd <= i->_start;
-                i = _entries.insert(i, newBlock)+1;
+                bool end = i >= entries.end() || internalEnd <= i->_start;
+                i = entries.insert(i, newBlock)+1;
                 refMin = std::min(refMin, 1); refMax = std::max(refMax,1);
                 if (end) {
                     break;  // it's the end
@@ -88,13 +85,15 @@ namespace BufferUploads
                     // assert(0);
                     Entry newBlock;
                     newBlock._start = i->_start;
+                    newBlock._continuation = i->_continuation;
+                    i->_continuation = false;
                     newBlock._end = internalEnd;
                     DEBUG_ONLY(newBlock._name = name);
                     signed newRefCount = newBlock._refCount = i->_refCount+1;
                     i->_start = internalEnd;
                     assert(newBlock._start < newBlock._end && i->_start < i->_end);
                     assert(i->_end != 0xbaad && newBlock._end != 0xbaad);
-                    _entries.insert(i, newBlock);
+                    entries.insert(i, newBlock);
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
                     break;  // it's the end
                 }
@@ -105,6 +104,8 @@ namespace BufferUploads
                     assert(0);
                     Entry newBlock[2];
                     newBlock[0]._start = i->_start;
+                    newBlock[0]._continuation = i->_continuation;
+                    i->_continuation = false;
                     newBlock[0]._end = currentStart;
                     newBlock[0]._refCount = i->_refCount;
                     DEBUG_ONLY(newBlock[0]._name = i->_name);
@@ -115,7 +116,7 @@ namespace BufferUploads
                     i->_start = internalEnd;
                     assert(newBlock[0]._start < newBlock[0]._end && newBlock[1]._start < newBlock[1]._end&& i->_start < i->_end);
                     assert(i->_end != 0xbaad && newBlock[0]._end != 0xbaad && newBlock[1]._end != 0xbaad);
-                    _entries.insert(i, newBlock, &newBlock[2]);
+                    entries.insert(i, newBlock, &newBlock[2]);
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
                     break;
                 } else {
@@ -123,6 +124,8 @@ namespace BufferUploads
                     Marker iEnd = i->_end;
                     Entry newBlock;
                     newBlock._start = i->_start;
+                    newBlock._continuation = i->_continuation;
+                    i->_continuation = false;
                     newBlock._end = currentStart;
                     newBlock._refCount = i->_refCount;
                     DEBUG_ONLY(newBlock._name.swap(i->_name));
@@ -131,7 +134,7 @@ namespace BufferUploads
                     signed newRefCount = ++i->_refCount;
                     assert(newBlock._start < newBlock._end && i->_start < i->_end);
                     assert(i->_end != 0xbaad && newBlock._end != 0xbaad);
-                    i = _entries.insert(i, newBlock)+1;
+                    i = entries.insert(i, newBlock)+1;
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
 
                     if (internalEnd == iEnd) {
@@ -143,98 +146,30 @@ namespace BufferUploads
                 }
             }
         }
-
-        return std::make_pair(refMin, refMax);
-    }
-
-    size_t ReferenceCountingLayer::Validate()
-    {
-        size_t result = 0;
-        for (std::vector<Entry>::iterator i=_entries.begin(); i<_entries.end(); ++i) {
-            assert(i->_start < i->_end);
-            if ((i+1)<_entries.end()) {
-                assert(i->_end <= (i+1)->_start);
-            }
-            assert(i->_start <= 0x800 && i->_end <= 0x800);
-            result += i->_refCount*size_t(i->_end-i->_start);
-        }
-        return result;
-    }
-
-    unsigned ReferenceCountingLayer::CalculatedReferencedSpace() const
-    {
-        ScopedLock(_lock);
-        unsigned result = 0;
-        for (std::vector<Entry>::const_iterator i=_entries.begin(); i<_entries.end(); ++i) {
-            result += ToExternalSize(i->_end-i->_start);
-        }
-        return result;
     }
 
-    void ReferenceCountingLayer::PerformDefrag(const std::vector<DefragStep>& defrag)
+    void ReferenceCountingLayer::Release_Internal(
+        std::vector<Entry>& entries, Marker internalStart, Marker internalEnd, 
+        signed& refMin, signed& refMax)
     {
-        ScopedLock(_lock);
-        std::vector<Entry>::iterator entryIterator = _entries.begin();
-        for (   std::vector<DefragStep>::const_iterator s=defrag.begin(); 
-                s!=defrag.end() && entryIterator!=_entries.end();) {
-            unsigned entryStart  = ToExternalSize(entryIterator->_start);
-            unsigned entryEnd    = ToExternalSize(entryIterator->_end);
-            if (s->_sourceEnd <= entryStart) {
-                ++s;
-                continue;
-            }
-
-            if (s->_sourceStart >= entryEnd) {
-                //      This deallocate iterator doesn't have an adjustment
-                ++entryIterator;
-                continue;
-            }
-
-                //
-                //      We shouldn't have any blocks that are stretched between multiple 
-                //      steps. If we've got a match it must match the entire deallocation block
-                //
-            assert(entryStart >= s->_sourceStart && entryStart < s->_sourceEnd);
-            assert(entryEnd > s->_sourceStart && entryEnd <= s->_sourceEnd);
-
-            signed offset = s->_destination - signed(s->_sourceStart);
-            entryIterator->_start    = ToInternalSize(entryStart+offset);
-            entryIterator->_end      = ToInternalSize(entryEnd+offset);
-            ++entryIterator;
+        if (entries.empty()) {
+            return;
         }
 
-            //  The defrag process may have modified the order of the entries (in the heap space)
-            //  We need to resort by start
-        std::sort(_entries.begin(), _entries.end(), CompareStart());
-    }
-
-    std::pair<signed,signed> ReferenceCountingLayer::Release(unsigned start, unsigned size)
-    {
-        ScopedLock(_lock);
-
-        Marker internalStart = ToInternalSize(start);
-        Marker internalSize = ToInternalSize(AlignSize(size));
-
-        if (_entries.empty()) {
-            return std::make_pair(INT_MIN, INT_MIN);
-        }
-
-        std::vector<Entry>::iterator i = std::lower_bound(_entries.begin(), _entries.end(), internalStart, CompareStart());
-        if (i != _entries.begin() && ((i-1)->_end > internalStart)) {
+        std::vector<Entry>::iterator i = std::lower_bound(entries.begin(), entries.end(), internalStart, CompareStart());
+        if (i != entries.begin() && ((i-1)->_end > internalStart)) {
             --i;
         }
 
         Marker currentStart = internalStart;
-        Marker internalEnd = internalStart+internalSize;
-        signed refMin = INT_MAX, refMax = INT_MIN;
         for (;;) {
-            if (i >= _entries.end() || currentStart < i->_start) {
-                if (i >= _entries.end() || internalEnd <= i->_start) {
+            if (i >= entries.end() || currentStart < i->_start) {
+                if (i >= entries.end() || internalEnd <= i->_start) {
                     break;
                 }
                 currentStart = i->_start;
             }
-            assert(i>=_entries.begin() && i<_entries.end());
+            assert(i>=entries.begin() && i<entries.end());
 
             #if defined(XL_DEBUG)
                 if (i->_start == currentStart) {
@@ -251,7 +186,7 @@ namespace BufferUploads
                     currentStart = i->_end;
                     Marker iEnd = i->_end;
                     if (!newRefCount) {
-                        i = _entries.erase(i);
+                        i = entries.erase(i);
                     }
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
                     if (internalEnd == iEnd) {
@@ -265,16 +200,19 @@ namespace BufferUploads
                     signed newRefCount = i->_refCount-1;
                     if (newRefCount == 0) {
                         i->_start = internalEnd;
+                        i->_continuation = false;
                     } else {
                         Entry newBlock;
                         newBlock._start = currentStart;
                         newBlock._end = internalEnd;
                         newBlock._refCount = newRefCount;
+                        newBlock._continuation = i->_continuation;
+                        i->_continuation = false;
                         DEBUG_ONLY(newBlock._name = i->_name);
                         i->_start = internalEnd;
                         assert(newBlock._start < newBlock._end && i->_start < i->_end);
                         assert(i->_end != 0xbaad && newBlock._end != 0xbaad);
-                        i = _entries.insert(i, newBlock);
+                        i = entries.insert(i, newBlock);
                     }
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
                     break;  // it's the end
@@ -285,18 +223,22 @@ namespace BufferUploads
                     if (newRefCount==0) {
                         Entry newBlock;
                         newBlock._start = i->_start;
+                        newBlock._continuation = i->_continuation;
+                        i->_continuation = false;
                         newBlock._end = currentStart;
                         newBlock._refCount = i->_refCount;
                         DEBUG_ONLY(newBlock._name = i->_name);
                         i->_start = internalEnd;
                         assert(newBlock._start < newBlock._end && i->_start < i->_end);
                         assert(i->_end != 0xbaad && newBlock._end != 0xbaad);
-                        i = _entries.insert(i, newBlock);
+                        i = entries.insert(i, newBlock);
                     } else {
                             //  This is a block that falls entirely within the old block. We need to create a new block, splitting the old one if necessary
                             // we need do split the end part of the old block off too, and then insert 2 blocks
                         Entry newBlock[2];
                         newBlock[0]._start = i->_start;
+                        newBlock[0]._continuation = i->_continuation;
+                        i->_continuation = false;
                         newBlock[0]._end = currentStart;
                         newBlock[0]._refCount = i->_refCount;
                         DEBUG_ONLY(newBlock[0]._name = i->_name);
@@ -307,9 +249,9 @@ namespace BufferUploads
                         i->_start = internalEnd;
                         assert(newBlock[0]._start < newBlock[0]._end && newBlock[1]._start < newBlock[1]._end && i->_start < i->_end);
                         assert(i->_end != 0xbaad && newBlock[0]._end != 0xbaad && newBlock[1]._end != 0xbaad);
-                        size_t offset = std::distance(_entries.begin(),i);
-                        _entries.insert(i, newBlock, &newBlock[2]);
-                        i = _entries.begin()+offset+2;
+                        size_t offset = std::distance(entries.begin(),i);
+                        entries.insert(i, newBlock, &newBlock[2]);
+                        i = entries.begin()+offset+2;
                     }
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
                     break;
@@ -321,15 +263,17 @@ namespace BufferUploads
                     } else {
                         Entry newBlock;
                         newBlock._start = i->_start;
+                        newBlock._continuation = i->_continuation;
+                        i->_continuation = false;
                         newBlock._end = currentStart;
                         newBlock._refCount = i->_refCount;
                         DEBUG_ONLY(newBlock._name = i->_name);
                         i->_start = currentStart;
                         i->_refCount = newRefCount;
-                        assert(i>=_entries.begin() && i<_entries.end());
+                        assert(i>=entries.begin() && i<entries.end());
                         assert(newBlock._start < newBlock._end && i->_start < i->_end);
                         assert(i->_end != 0xbaad && newBlock._end != 0xbaad);
-                        i = _entries.insert(i, newBlock)+1;
+                        i = entries.insert(i, newBlock)+1;
                     }
                     refMin = std::min(refMin, newRefCount); refMax = std::max(refMax, newRefCount);
 
@@ -344,27 +288,368 @@ namespace BufferUploads
 
             ++i;
         }
+    }
+
+    class ReferenceCountingLayer::ShardLock
+    {
+    public:
+            //  Locks the shards in [beginShard, endShard). Shards are always locked in 
+            //  increasing order, so overlapping ranges can't deadlock
+        ShardLock(const ReferenceCountingLayer& layer, unsigned beginShard, unsigned endShard)
+        : _layer(&layer), _beginShard(beginShard), _endShard(endShard)
+        {
+            for (unsigned c=_beginShard; c<_endShard; ++c) {
+                _layer->_shards[c]._lock.lock();
+            }
+        }
+
+        ~ShardLock()
+        {
+            for (unsigned c=_endShard; c>_beginShard; --c) {
+                _layer->_shards[c-1]._lock.unlock();
+            }
+        }
+    private:
+        const ReferenceCountingLayer* _layer;
+        unsigned _beginShard, _endShard;
+
+        ShardLock(const ShardLock&);
+        ShardLock& operator=(const ShardLock&);
+    };
+
+    auto ReferenceCountingLayer::EntryStartingAt(unsigned granule) const -> Entry*
+    {
+        auto& entries = _shards[granule / ShardGranules]._entries;
+        auto i = std::lower_bound(entries.begin(), entries.end(), Marker(granule), CompareStart());
+        if (i != entries.end() && i->_start == granule) {
+            return &*i;
+        }
+        return nullptr;
+    }
+
+    bool ReferenceCountingLayer::IsContinuous(unsigned boundary) const
+    {
+            //  Returns true if the shard boundary is inside of an entry, or if there is
+            //  no entry on either side of it
+        assert(boundary && !(boundary % ShardGranules));
+        const auto& left = _shards[boundary / ShardGranules - 1]._entries;
+        bool leftEndsHere = !left.empty() && left[left.size()-1]._end == boundary;
+        auto* right = EntryStartingAt(boundary);
+        if (!right) {
+            return !leftEndsHere;
+        }
+        return leftEndsHere && right->_continuation;
+    }
+
+    void ReferenceCountingLayer::SetContinuation(unsigned boundary, bool continuation)
+    {
+        if (!boundary || boundary >= _granuleCount) {
+            return;
+        }
+        auto* right = EntryStartingAt(boundary);
+        if (right) {
+            const auto& left = _shards[boundary / ShardGranules - 1]._entries;
+            right->_continuation = continuation && !left.empty() && left[left.size()-1]._end == boundary;
+        }
+    }
+
+    std::pair<signed,signed> ReferenceCountingLayer::AddRef(unsigned start, unsigned size, const char name[])
+    {
+        unsigned internalStart = ToInternalSize(start);
+        unsigned internalEnd = internalStart + ToInternalSize(AlignSize(size));
+        assert(internalStart < internalEnd && internalEnd <= _granuleCount);
+
+            //  We lock the shards touched by the range, plus the shard starting at 
+            //  internalEnd (if there is one), because we might split the entry there
+        unsigned firstShard = internalStart / ShardGranules;
+        ShardLock lock(*this, firstShard, std::min(internalEnd / ShardGranules + 1, _shardCount));
+
+            //  Shard boundaries within the range will end up inside of an entry if they
+            //  were inside of an entry before, or if they were unreferenced (in which
+            //  case the new entry will cover both sides)
+        uint64 continuous = 0;
+        for (unsigned b=firstShard+1; b*ShardGranules<internalEnd; ++b) {
+            if (IsContinuous(b*ShardGranules)) {
+                continuous |= 1ull << uint64(b);
+            }
+        }
+
+        signed refMin = INT_MAX, refMax = INT_MIN;
+        for (unsigned c=firstShard; c*ShardGranules<internalEnd; ++c) {
+            AddRef_Internal(
+                _shards[c]._entries, 
+                Marker(std::max(internalStart, c*ShardGranules)), Marker(std::min(internalEnd, (c+1)*ShardGranules)),
+                name, refMin, refMax);
+        }
+
+        for (unsigned b=firstShard+1; b*ShardGranules<internalEnd; ++b) {
+            SetContinuation(b*ShardGranules, (continuous & (1ull << uint64(b))) != 0);
+        }
+        if (!(internalStart % ShardGranules)) { SetContinuation(internalStart, false); }
+        if (!(internalEnd % ShardGranules)) { SetContinuation(internalEnd, false); }
 
         return std::make_pair(refMin, refMax);
     }
 
+    std::pair<signed,signed> ReferenceCountingLayer::Release(unsigned start, unsigned size)
+    {
+        unsigned internalStart = ToInternalSize(start);
+        unsigned internalEnd = internalStart + ToInternalSize(AlignSize(size));
+        assert(internalStart < internalEnd && internalEnd <= _granuleCount);
+
+        unsigned firstShard = internalStart / ShardGranules;
+        ShardLock lock(*this, firstShard, std::min(internalEnd / ShardGranules + 1, _shardCount));
+
+            //  Releasing never joins or separates entries within the range, but
+            //  Release_Internal can replace the entries at the shard boundaries
+        uint64 continuous = 0;
+        for (unsigned b=firstShard+1; b*ShardGranules<internalEnd; ++b) {
+            auto* entry = EntryStartingAt(b*ShardGranules);
+            if (entry && entry->_continuation) {
+                continuous |= 1ull << uint64(b);
+            }
+        }
+
+        signed refMin = INT_MAX, refMax = INT_MIN;
+        for (unsigned c=firstShard; c*ShardGranules<internalEnd; ++c) {
+            Release_Internal(
+                _shards[c]._entries, 
+                Marker(std::max(internalStart, c*ShardGranules)), Marker(std::min(internalEnd, (c+1)*ShardGranules)),
+                refMin, refMax);
+        }
+
+        for (unsigned b=firstShard+1; b*ShardGranules<internalEnd; ++b) {
+            SetContinuation(b*ShardGranules, (continuous & (1ull << uint64(b))) != 0);
+        }
+        if (!(internalStart % ShardGranules)) { SetContinuation(internalStart, false); }
+        if (!(internalEnd % ShardGranules)) { SetContinuation(internalEnd, false); }
+
+        if (refMin == INT_MAX) {
+            return std::make_pair(INT_MIN, INT_MIN);    // nothing in this range was referenced
+        }
+        return std::make_pair(refMin, refMax);
+    }
+
+    size_t ReferenceCountingLayer::Validate()
+    {
+        size_t result = 0;
+        for (unsigned s=0; s<_shardCount; ++s) {
+            ScopedLock(_shards[s]._lock);
+            const auto& entries = _shards[s]._entries;
+            for (std::vector<Entry>::const_iterator i=entries.begin(); i<entries.end(); ++i) {
+                assert(i->_start < i->_end);
+                if ((i+1)<entries.end()) {
+                    assert(i->_end <= (i+1)->_start);
+                }
+                assert(i->_start >= s*ShardGranules && i->_end <= (s+1)*ShardGranules);
+                assert(!i->_continuation || (i->_start == s*ShardGranules && !_shards[s-1]._entries.empty() && _shards[s-1]._entries.back()._end == i->_start));
+                result += i->_refCount*size_t(i->_end-i->_start);
+            }
+        }
+        return result;
+    }
+
+    unsigned ReferenceCountingLayer::CalculatedReferencedSpace() const
+    {
+        unsigned result = 0;
+        for (unsigned s=0; s<_shardCount; ++s) {
+            ScopedLock(_shards[s]._lock);
+            const auto& entries = _shards[s]._entries;
+            for (std::vector<Entry>::const_iterator i=entries.begin(); i<entries.end(); ++i) {
+                result += ToExternalSize(i->_end-i->_start);
+            }
+        }
+        return result;
+    }
+
+    auto ReferenceCountingLayer::BuildLogicalEntries() const -> std::vector<Entry>
+    {
+            //  Join together entries that were split by shard boundaries.
+            //  (the caller must hold the locks on all shards)
+        std::vector<Entry> result;
+        for (unsigned s=0; s<_shardCount; ++s) {
+            const auto& entries = _shards[s]._entries;
+            for (std::vector<Entry>::const_iterator i=entries.begin(); i<entries.end(); ++i) {
+                if (i->_continuation && !result.empty() && result[result.size()-1]._end == i->_start) {
+                    result[result.size()-1]._end = i->_end;
+                } else {
+                    result.push_back(*i);
+                    result[result.size()-1]._continuation = false;
+                }
+            }
+        }
+        return result;
+    }
+
+    unsigned ReferenceCountingLayer::GetEntryCount() const
+    {
+        ShardLock lock(*this, 0, _shardCount);
+        unsigned result = 0;
+        for (unsigned s=0; s<_shardCount; ++s) {
+            const auto& entries = _shards[s]._entries;
+            for (std::vector<Entry>::const_iterator i=entries.begin(); i<entries.end(); ++i) {
+                if (!i->_continuation) {
+                    ++result;
+                }
+            }
+        }
+        return result;
+    }
+
+    auto ReferenceCountingLayer::FindLogicalEntry(unsigned index, unsigned& logicalEnd) const -> const Entry*
+    {
+            //  Find the first piece of the given logical entry, and follow it through 
+            //  any shard boundaries to find where it ends.
+            //  (the caller must hold the locks on all shards)
+        for (unsigned s=0; s<_shardCount; ++s) {
+            const auto& entries = _shards[s]._entries;
+            for (std::vector<Entry>::const_iterator i=entries.begin(); i<entries.end(); ++i) {
+                if (i->_continuation || index--) {
+                    continue;
+                }
+
+                logicalEnd = i->_end;
+                while (!(logicalEnd % ShardGranules) && logicalEnd < _granuleCount) {
+                    auto* next = EntryStartingAt(logicalEnd);
+                    if (!next || !next->_continuation) {
+                        break;
+                    }
+                    logicalEnd = next->_end;
+                }
+                return &*i;
+            }
+        }
+        return nullptr;
+    }
+
+    std::pair<unsigned,unsigned> ReferenceCountingLayer::GetEntry(unsigned index) const
+    {
+        ShardLock lock(*this, 0, _shardCount);
+        unsigned logicalEnd = 0;
+        auto* entry = FindLogicalEntry(index, logicalEnd);
+        assert(entry);
+        return std::make_pair(ToExternalSize(entry->_start), ToExternalSize(logicalEnd-entry->_start));
+    }
+
+    #if defined(XL_DEBUG)
+        std::string ReferenceCountingLayer::GetEntryName(unsigned index) const
+        {
+            ShardLock lock(*this, 0, _shardCount);
+            unsigned logicalEnd = 0;
+            auto* entry = FindLogicalEntry(index, logicalEnd);
+            assert(entry);
+            return entry->_name;
+        }
+    #endif
+
+    void ReferenceCountingLayer::PerformDefrag(const std::vector<DefragStep>& defrag)
+    {
+        ShardLock lock(*this, 0, _shardCount);
+        auto entries = BuildLogicalEntries();
+
+        std::vector<Entry>::iterator entryIterator = entries.begin();
+        for (   std::vector<DefragStep>::const_iterator s=defrag.begin(); 
+                s!=defrag.end() && entryIterator!=entries.end();) {
+            unsigned entryStart  = ToExternalSize(entryIterator->_start);
+            unsigned entryEnd    = ToExternalSize(entryIterator->_end);
+            if (s->_sourceEnd <= entryStart) {
+                ++s;
+                continue;
+            }
+
+            if (s->_sourceStart >= entryEnd) {
+                //      This deallocate iterator doesn't have an adjustment
+                ++entryIterator;
+                continue;
+            }
+
+                //
+                //      We shouldn't have any blocks that are stretched between multiple 
+                //      steps. If we've got a match it must match the entire deallocation block
+                //
+            assert(entryStart >= s->_sourceStart && entryStart < s->_sourceEnd);
+            assert(entryEnd > s->_sourceStart && entryEnd <= s->_sourceEnd);
+
+            signed offset = s->_destination - signed(s->_sourceStart);
+            entryIterator->_start    = ToInternalSize(entryStart+offset);
+            entryIterator->_end      = ToInternalSize(entryEnd+offset);
+            ++entryIterator;
+        }
+
+            //  The defrag process may have modified the order of the entries (in the heap space)
+            //  We need to resort by start, and then split them up between the shards again
+        std::sort(entries.begin(), entries.end(), CompareStart());
+        for (unsigned s=0; s<_shardCount; ++s) {
+            _shards[s]._entries.clear();
+        }
+        for (auto i=entries.begin(); i!=entries.end(); ++i) {
+            unsigned pieceStart = i->_start;
+            while (pieceStart < i->_end) {
+                unsigned shard = pieceStart / ShardGranules;
+                Entry piece = *i;
+                piece._start = Marker(pieceStart);
+                piece._end = Marker(std::min(unsigned(i->_end), (shard+1)*ShardGranules));
+                piece._continuation = pieceStart != i->_start;
+                _shards[shard]._entries.push_back(piece);
+                pieceStart = piece._end;
+            }
+        }
+    }
+
     bool        ReferenceCountingLayer::ValidateBlock(unsigned start, unsigned size) const
     {
-        ScopedLock(_lock);
-        Marker internalStart = ToInternalSize(start);
-        Marker internalEnd = internalStart+ToInternalSize(AlignSize(size));
-        std::vector<Entry>::const_iterator i = std::lower_bound(_entries.begin(), _entries.end(), internalStart, CompareStart());
-        return (i != _entries.end() && i->_start == internalStart && i->_end == internalEnd);
+        unsigned internalStart = ToInternalSize(start);
+        unsigned internalEnd = internalStart+ToInternalSize(AlignSize(size));
+        if (internalEnd > _granuleCount || internalStart >= internalEnd) {
+            return false;
+        }
+
+        ShardLock lock(*this, internalStart / ShardGranules, std::min(internalEnd / ShardGranules + 1, _shardCount));
+        auto* entry = EntryStartingAt(internalStart);
+        if (!entry || entry->_continuation) {
+            return false;
+        }
+
+            // follow the entry through any shard boundaries
+        unsigned entryEnd = entry->_end;
+        while (entryEnd < internalEnd && !(entryEnd % ShardGranules)) {
+            auto* next = EntryStartingAt(entryEnd);
+            if (!next || !next->_continuation) {
+                break;
+            }
+            entryEnd = next->_end;
+        }
+        if (entryEnd != internalEnd) {
+            return false;
+        }
+        if (!(entryEnd % ShardGranules) && entryEnd < _granuleCount) {
+            auto* next = EntryStartingAt(entryEnd);
+            if (next && next->_continuation) {
+                return false;
+            }
+        }
+        return true;
     }
 
     ReferenceCountingLayer::ReferenceCountingLayer(size_t size)
     {
-        _entries.reserve(64);
+        _granuleCount = ToInternalSize(AlignSize(unsigned(size)));
+        _shardCount = (_granuleCount + ShardGranules - 1) / ShardGranules;
+        _shards.reset(new Shard[_shardCount]);
     }
 
     ReferenceCountingLayer::ReferenceCountingLayer(const ReferenceCountingLayer& cloneFrom)
-    : _entries(cloneFrom._entries)
-    {}
+    {
+        _granuleCount = cloneFrom._granuleCount;
+        _shardCount = cloneFrom._shardCount;
+        _shards.reset(new Shard[_shardCount]);
+        ShardLock lock(cloneFrom, 0, _shardCount);
+        for (unsigned s=0; s<_shardCount; ++s) {
+            _shards[s]._entries = cloneFrom._shards[s]._entries;
+        }
+    }
+
+    ReferenceCountingLayer::~ReferenceCountingLayer() {}
 
     #if 0 // defined(XL_DEBUG)
         struct HeapTest_Allocation 
@@ -406,11 +691,16 @@ namespace BufferUploads
 
                     SimpleSpanningHeap dupe = heap;
                     dupe.PerformDefrag(dupe.CalculateDefragSteps());
+
+                    auto flattened = heap.Flatten();
+                    SimpleSpanningHeap unflattened(flattened.first.get(), flattened.second);
+                    assert(unflattened.CalculateHash() == heap.CalculateHash());
                 }
 
                 for (std::vector<std::pair<unsigned,unsigned>>::iterator i=allocations.begin(); i!=allocations.end(); ++i) {
                     heap.Deallocate(i->first, i->second);
                 }
+                assert(heap.IsEmpty() && heap.GetStatistics()._freeBlockCount == 1);
 
                     //      ...Defrag test...
                 for (unsigned c=0; c<100; ++c) {
@@ -10,12 +10,22 @@
 #include "../Utility/Threading/Mutex.h"
 #include "../Utility/StringUtils.h"
 #include "../Utility/HeapUtils.h"
+#include <memory>
 
 namespace BufferUploads
 {
             //////   R E F E R E N C E   C O U N T I N G   L A Y E R   //////
 
-    class ReferenceCountingLayer : public MarkerHeap<uint16>
+    /// <summary>Tracks reference counts for sub-ranges of a batched resource heap</summary>
+    /// The heap is divided into fixed size shards (of ShardGranules 16 byte units), each
+    /// with its own lock and its own sorted list of entries. AddRef() and Release() only
+    /// lock the shards their range touches, so threads working on different parts of the
+    /// heap don't contend.
+    ///
+    /// Entries are clipped at shard boundaries. An entry that starts on a shard boundary
+    /// can be flagged as a continuation of the entry that ends there, so that queries like
+    /// GetEntry() and ValidateBlock() see the same entries as they would with a single list.
+    class ReferenceCountingLayer : public MarkerHeap<uint32>
     {
     public:
         std::pair<signed,signed> AddRef(unsigned start, unsigned size, const char name[] = NULL);
@@ -23,10 +33,10 @@ namespace BufferUploads
 
         size_t      Validate();
         unsigned    CalculatedReferencedSpace() const;
-        unsigned    GetEntryCount() const                               { return (unsigned)_entries.size(); }
-        std::pair<unsigned,unsigned> GetEntry(unsigned index) const     { const Entry& entry = _entries[index]; return std::make_pair(ToExternalSize(entry._start), ToExternalSize(entry._end-entry._start)); }
+        unsigned    GetEntryCount() const;
+        std::pair<unsigned,unsigned> GetEntry(unsigned index) const;
         #if defined(XL_DEBUG)
-            std::string      GetEntryName(unsigned index) const         { const Entry& entry = _entries[index]; return entry._name; }
+            std::string      GetEntryName(unsigned index) const;
         #endif
         bool        ValidateBlock(unsigned start, unsigned size) const;
 
@@ -34,20 +44,32 @@ namespace BufferUploads
 
         ReferenceCountingLayer(size_t size);
         ReferenceCountingLayer(const ReferenceCountingLayer& cloneFrom);
+        ~ReferenceCountingLayer();
     protected:
 
-        typedef uint16 Marker;
+        typedef uint32 Marker;
         class Entry
         {
         public:
             Marker _start, _end;    // _end is stl style -- one past the end of the allocation
             signed _refCount;
+            bool _continuation;     // (only for entries starting on a shard boundary) continues the entry ending at that boundary
             #if defined(XL_DEBUG)
                 std::string _name;
             #endif
+            Entry() : _start(0), _end(0), _refCount(0), _continuation(false) {}
         };
-        std::vector<Entry> _entries;
-        mutable Threading::Mutex _lock;
+
+        static const unsigned ShardGranules = 1024;
+        class Shard
+        {
+        public:
+            std::vector<Entry>          _entries;
+            mutable Threading::Mutex    _lock;
+        };
+        std::unique_ptr<Shard[]>    _shards;
+        unsigned                    _shardCount;
+        unsigned                    _granuleCount;
 
         struct CompareStart
         {
@@ -55,6 +77,19 @@ namespace BufferUploads
             bool operator()(Marker value, const Entry&rhs)      { return value < rhs._start; }
             bool operator()(const Entry&lhs, const Entry&rhs)   { return lhs._start < rhs._start; }
         };
+
+        class ShardLock;
+
+        static void AddRef_Internal(std::vector<Entry>& entries, Marker internalStart, Marker internalEnd, const char name[], signed& refMin, signed& refMax);
+        static void Release_Internal(std::vector<Entry>& entries, Marker internalStart, Marker internalEnd, signed& refMin, signed& refMax);
+
+        Entry*          EntryStartingAt(unsigned granule) const;
+        bool            IsContinuous(unsigned boundary) const;
+        void            SetContinuation(unsigned boundary, bool continuation);
+        const Entry*    FindLogicalEntry(unsigned index, unsigned& logicalEnd) const;
+        std::vector<Entry> BuildLogicalEntries() const;
+
+        ReferenceCountingLayer& operator=(const ReferenceCountingLayer&);
     };
 
 }
@@ -0,0 +1,358 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "../../Core/Prefix.h"
+#include "../../RenderCore/Metal/Metal.h"
+
+#if GFXAPI_ACTIVE == GFXAPI_NULL
+
+    #include "../PlatformInterface.h"
+    #include "../../RenderCore/Metal/Format.h"
+    #include "../../Utility/PtrUtils.h"
+    #include "../../Utility/MemoryUtils.h"
+    #include "../../Utility/HeapUtils.h"
+
+        //
+        //      Platform interface for the null device.
+        //
+        //      Resources are blocks of host memory, and every device operation
+        //      is a memcpy performed at the point it's issued. Subresources are
+        //      laid out in D3D order (all mips of array slice 0, then all mips of
+        //      slice 1, ...) with tightly packed rows, matching ByteCount().
+        //
+        //      GPU events are triggered after the simulated latency set on the
+        //      immediate context (see RenderCore::IDeviceNull).
+        //
+
+    namespace BufferUploads { namespace PlatformInterface
+    {
+        class NullResource : public Underlying::Resource
+        {
+        public:
+            BufferDesc      _desc;
+
+            NullResource(const BufferDesc& desc);
+            ~NullResource();
+        };
+
+            ///////////////////////////////////////
+
+        static Interlocked::Value       s_resourceBytes = 0;
+        static Interlocked::Value       s_peakResourceBytes = 0;
+        static Interlocked::Value       s_stagingBytes = 0;
+        static Interlocked::Value       s_peakStagingBytes = 0;
+
+        static void UpdatePeak(Interlocked::Value volatile* peak, Interlocked::Value newValue)
+        {
+            for (;;) {
+                auto oldPeak = Interlocked::Load(peak);
+                if (newValue <= oldPeak || Interlocked::CompareExchange(peak, newValue, oldPeak) == oldPeak) {
+                    break;
+                }
+            }
+        }
+
+        static bool IsStaging(const BufferDesc& desc) { return !!(desc._allocationRules & AllocationRules::Staging); }
+
+        NullResource::NullResource(const BufferDesc& desc)
+        : Underlying::Resource(std::max(ByteCount(desc), 1u))
+        , _desc(desc)
+        {
+            const auto size = Interlocked::Value(GetDataSize());
+            UpdatePeak(&s_peakResourceBytes, Interlocked::Add(&s_resourceBytes, size) + size);
+            if (IsStaging(desc)) {
+                UpdatePeak(&s_peakStagingBytes, Interlocked::Add(&s_stagingBytes, size) + size);
+            }
+        }
+
+        NullResource::~NullResource()
+        {
+            const auto size = Interlocked::Value(GetDataSize());
+            Interlocked::Add(&s_resourceBytes, -size);
+            if (IsStaging(_desc)) {
+                Interlocked::Add(&s_stagingBytes, -size);
+            }
+        }
+
+        HostMemoryMetrics   GetHostMemoryMetrics()
+        {
+            HostMemoryMetrics result;
+            result._resourceBytes       = Interlocked::Load(&s_resourceBytes);
+            result._peakResourceBytes   = Interlocked::Load(&s_peakResourceBytes);
+            result._stagingBytes        = Interlocked::Load(&s_stagingBytes);
+            result._peakStagingBytes    = Interlocked::Load(&s_peakStagingBytes);
+            return result;
+        }
+
+        static NullResource&        AsNullResource(const Underlying::Resource& resource)
+        {
+            return *const_cast<NullResource*>(checked_cast<const NullResource*>(&resource));
+        }
+
+            ///////////////////////////////////////
+
+        static bool IsDXTCompressed(unsigned format) { return GetCompressionType(NativeFormat::Enum(format)) == FormatCompressionType::BlockCompression; }
+
+        struct SubResource
+        {
+            unsigned _offset, _size;
+            unsigned _rowPitch, _rowCount;
+            unsigned _bytesPerElement, _pixelsPerElement;
+        };
+
+        static SubResource  CalculateSubResource(const BufferDesc& desc, unsigned lodLevel, unsigned arrayIndex)
+        {
+            SubResource result;
+            if (desc._type != BufferDesc::Type::Texture) {
+                result._offset = 0;
+                result._size = result._rowPitch = desc._linearBufferDesc._sizeInBytes;
+                result._rowCount = 1;
+                result._bytesPerElement = result._pixelsPerElement = 1;
+                return result;
+            }
+
+                //  (matches the layout assumed by ByteCount(const TextureDesc&))
+            const auto& tDesc = desc._textureDesc;
+            const unsigned bitsPerPixel = BitsPerPixel(NativeFormat::Enum(tDesc._nativePixelFormat));
+            const bool dxt = IsDXTCompressed(tDesc._nativePixelFormat);
+            const unsigned mipMin = dxt?4:1;
+            auto mipSize = [&](unsigned m) { return std::max(mipMin, tDesc._width>>m) * std::max(mipMin, tDesc._height>>m) * bitsPerPixel / 8; };
+
+            unsigned sliceSize = 0;
+            for (unsigned m=0; m<tDesc._mipCount; ++m) { sliceSize += mipSize(m); }
+
+            result._offset = arrayIndex * sliceSize;
+            for (unsigned m=0; m<lodLevel; ++m) { result._offset += mipSize(m); }
+            result._size = mipSize(lodLevel);
+
+            const unsigned width = std::max(mipMin, tDesc._width>>lodLevel);
+            const unsigned height = std::max(mipMin, tDesc._height>>lodLevel);
+            if (dxt) {
+                result._pixelsPerElement = 4;
+                result._bytesPerElement = bitsPerPixel * 16 / 8;
+                result._rowCount = height / 4;
+            } else {
+                result._pixelsPerElement = 1;
+                result._bytesPerElement = bitsPerPixel / 8;
+                result._rowCount = height;
+            }
+            result._rowPitch = (width / result._pixelsPerElement) * result._bytesPerElement;
+            return result;
+        }
+
+        static void CopyRows(   void* destination, unsigned destinationRowPitch,
+                                const void* source, unsigned sourceRowPitch,
+                                unsigned rowBytes, unsigned rowCount)
+        {
+            if (destinationRowPitch == rowBytes && sourceRowPitch == rowBytes) {
+                XlCopyMemory(destination, source, rowBytes * rowCount);
+                return;
+            }
+            for (unsigned r=0; r<rowCount; ++r) {
+                XlCopyMemory(destination, source, rowBytes);
+                destination = PtrAdd(destination, destinationRowPitch);
+                source = PtrAdd(source, sourceRowPitch);
+            }
+        }
+
+            ///////////////////////////////////////
+
+        intrusive_ptr<Underlying::Resource> CreateResource(ObjectFactory&, const BufferDesc& desc, RawDataPacket* initialisationData)
+        {
+            intrusive_ptr<NullResource> result(new NullResource(desc), false);
+            if (initialisationData) {
+                if (desc._type == BufferDesc::Type::Texture) {
+                    const unsigned arrayCount = std::max(unsigned(desc._textureDesc._arrayCount), 1u);
+                    for (unsigned a=0; a<arrayCount; ++a) {
+                        for (unsigned m=0; m<desc._textureDesc._mipCount; ++m) {
+                            const void* data = initialisationData->GetData(m, a);
+                            if (!data) continue;
+                            auto sub = CalculateSubResource(desc, m, a);
+                            auto sourcePitch = initialisationData->GetRowAndSlicePitch(m, a).first;
+                            if (!sourcePitch) sourcePitch = sub._rowPitch;
+                            CopyRows(   PtrAdd(result->GetData(), sub._offset), sub._rowPitch,
+                                        data, sourcePitch, std::min(sub._rowPitch, sourcePitch),
+                                        std::min(sub._rowCount, unsigned(initialisationData->GetDataSize(m, a) / sourcePitch)));
+                        }
+                    }
+                } else if (initialisationData->GetData()) {
+                    XlCopyMemory(result->GetData(), initialisationData->GetData(), std::min(initialisationData->GetDataSize(), result->GetDataSize()));
+                }
+            }
+            return intrusive_ptr<Underlying::Resource>(result.get());
+        }
+
+        BufferDesc ExtractDesc(const Underlying::Resource& resource)
+        {
+            return AsNullResource(resource)._desc;
+        }
+
+            ///////////////////////////////////////
+
+        void UnderlyingDeviceContext::PushToResource(   const Underlying::Resource& resource, const BufferDesc& desc,
+                                                        unsigned resourceOffsetValue, const void* data, size_t dataSize,
+                                                        std::pair<unsigned,unsigned> rowAndSlicePitch,
+                                                        const Box2D& box, unsigned lodLevel, unsigned arrayIndex)
+        {
+            if (!data) {
+                return;
+            }
+
+            auto& res = AsNullResource(resource);
+            switch (desc._type) {
+            case BufferDesc::Type::Texture:
+                {
+                    auto sub = CalculateSubResource(res._desc, lodLevel, arrayIndex);
+                    void* destination = PtrAdd(res.GetData(), sub._offset);
+                    if (box == Box2D()) {
+                        const unsigned sourcePitch = rowAndSlicePitch.first ? rowAndSlicePitch.first : sub._rowPitch;
+                        CopyRows(   destination, sub._rowPitch, data, sourcePitch,
+                                    std::min(sub._rowPitch, sourcePitch),
+                                    std::min(sub._rowCount, unsigned(dataSize / sourcePitch)));
+                    } else {
+                            // "data" points to the top left of the box (as with UpdateSubresource)
+                        const unsigned left     = box._left / sub._pixelsPerElement;
+                        const unsigned top      = box._top / sub._pixelsPerElement;
+                        const unsigned right    = (box._right + sub._pixelsPerElement - 1) / sub._pixelsPerElement;
+                        const unsigned bottom   = (box._bottom + sub._pixelsPerElement - 1) / sub._pixelsPerElement;
+                        assert(right * sub._bytesPerElement <= sub._rowPitch && bottom <= sub._rowCount);
+                        CopyRows(   PtrAdd(destination, top * sub._rowPitch + left * sub._bytesPerElement), sub._rowPitch,
+                                    data, rowAndSlicePitch.first,
+                                    (right-left) * sub._bytesPerElement, bottom-top);
+                    }
+                }
+                break;
+
+            case BufferDesc::Type::LinearBuffer:
+                {
+                    assert(box == Box2D());
+                    assert((resourceOffsetValue + dataSize) <= res.GetDataSize());
+                    XlCopyMemory(PtrAdd(res.GetData(), resourceOffsetValue), data, dataSize);
+                }
+                break;
+            }
+        }
+
+        void UnderlyingDeviceContext::PushToStagingResource(    const Underlying::Resource& resource, const BufferDesc& desc,
+                                                                unsigned resourceOffsetValue, const void* data, size_t dataSize,
+                                                                std::pair<unsigned,unsigned> rowAndSlicePitch,
+                                                                const Box2D& box, unsigned lodLevel, unsigned arrayIndex)
+        {
+            assert(box == Box2D());
+            auto& res = AsNullResource(resource);
+            switch (desc._type) {
+            case BufferDesc::Type::Texture:
+                {
+                    auto sub = CalculateSubResource(res._desc, lodLevel, arrayIndex);
+                    CopyMipLevel(
+                        PtrAdd(res.GetData(), sub._offset), sub._size, data, dataSize,
+                        CalculateMipMapDesc(desc._textureDesc, lodLevel), sub._rowPitch);
+                }
+                break;
+
+            case BufferDesc::Type::LinearBuffer:
+                {
+                    assert((resourceOffsetValue + dataSize) <= res.GetDataSize());
+                    XlCopyMemory(PtrAdd(res.GetData(), resourceOffsetValue), data, dataSize);
+                }
+                break;
+            }
+        }
+
+        void UnderlyingDeviceContext::UpdateFinalResourceFromStaging(const Underlying::Resource& finalResource, const Underlying::Resource& staging, const BufferDesc& destinationDesc, unsigned lodLevelMin, unsigned lodLevelMax, unsigned stagingLODOffset)
+        {
+            if ((lodLevelMin == ~unsigned(0x0) || lodLevelMax == ~unsigned(0x0)) && destinationDesc._type == BufferDesc::Type::Texture && !stagingLODOffset) {
+                ResourceCopy(finalResource, staging);
+            } else {
+                auto& dst = AsNullResource(finalResource);
+                auto& src = AsNullResource(staging);
+                for (unsigned a=0; a<std::max(unsigned(destinationDesc._textureDesc._arrayCount), 1u); ++a) {
+                    for (unsigned c=lodLevelMin; c<=lodLevelMax; ++c) {
+                        auto dstSub = CalculateSubResource(dst._desc, c, a);
+                        auto srcSub = CalculateSubResource(src._desc, c-stagingLODOffset, a);
+                        XlCopyMemory(   PtrAdd(dst.GetData(), dstSub._offset), PtrAdd(src.GetData(), srcSub._offset),
+                                        std::min(dstSub._size, srcSub._size));
+                    }
+                }
+            }
+        }
+
+        void UnderlyingDeviceContext::ResourceCopy_DefragSteps(const Underlying::Resource& destination, const Underlying::Resource& source, const std::vector<DefragStep>& steps)
+        {
+            auto& dst = AsNullResource(destination);
+            auto& src = AsNullResource(source);
+            for (auto i=steps.begin(); i!=steps.end(); ++i) {
+                assert(i->_sourceEnd > i->_sourceStart);
+                assert(i->_sourceEnd <= src.GetDataSize() && (i->_destination + i->_sourceEnd - i->_sourceStart) <= dst.GetDataSize());
+                XlCopyMemory(   PtrAdd(dst.GetData(), i->_destination), PtrAdd(src.GetData(), i->_sourceStart),
+                                i->_sourceEnd - i->_sourceStart);
+            }
+        }
+
+        void UnderlyingDeviceContext::ResourceCopy(const Underlying::Resource& destination, const Underlying::Resource& source)
+        {
+            auto& dst = AsNullResource(destination);
+            auto& src = AsNullResource(source);
+            XlCopyMemory(dst.GetData(), src.GetData(), std::min(dst.GetDataSize(), src.GetDataSize()));
+        }
+
+        intrusive_ptr<RenderCore::Metal::CommandList> UnderlyingDeviceContext::ResolveCommandList()
+        {
+            return _context->ResolveCommandList();
+        }
+
+        void                        UnderlyingDeviceContext::BeginCommandList()
+        {
+            _context->BeginCommandList();
+        }
+
+        UnderlyingDeviceContext::MappedBuffer UnderlyingDeviceContext::Map(const Underlying::Resource& resource, MapType::Enum mapType, unsigned lodLevel, unsigned arrayIndex)
+        {
+            auto& res = AsNullResource(resource);
+            auto sub = CalculateSubResource(res._desc, lodLevel, arrayIndex);
+            return MappedBuffer(*this, resource, 0, PtrAdd(res.GetData(), sub._offset), sub._rowPitch, sub._size);
+        }
+
+        UnderlyingDeviceContext::MappedBuffer UnderlyingDeviceContext::MapPartial(const Underlying::Resource& resource, MapType::Enum mapType, unsigned offset, unsigned size, unsigned lodLevel, unsigned arrayIndex)
+        {
+            auto& res = AsNullResource(resource);
+            auto sub = CalculateSubResource(res._desc, lodLevel, arrayIndex);
+            assert((offset + size) <= sub._size);
+            return MappedBuffer(*this, resource, 0, PtrAdd(res.GetData(), sub._offset + offset), sub._rowPitch, sub._size);
+        }
+
+        void UnderlyingDeviceContext::Unmap(const Underlying::Resource&, unsigned)
+        {
+                // (resources are always in host memory, so there's nothing to do)
+        }
+
+        UnderlyingDeviceContext::UnderlyingDeviceContext(RenderCore::IDevice* device, DeviceContext* context)
+        : _device(device)
+        , _context(context ? intrusive_ptr<DeviceContext>(context) : DeviceContext::GetImmediateContext(device))
+        {
+        }
+
+            ///////////////////////////////////////
+
+        void    Query_End(DeviceContext* context, Underlying::Query* query)
+        {
+            query->_retireTime = QueryPerformanceCounter() + context->GetSimulatedLatency();
+        }
+
+        bool    Query_IsEventTriggered(DeviceContext* context, Underlying::Query* query)
+        {
+            return QueryPerformanceCounter() >= query->_retireTime;
+        }
+
+        intrusive_ptr<Underlying::Query> Query_CreateEvent(ObjectFactory&)
+        {
+            return intrusive_ptr<Underlying::Query>(new Underlying::Query, false);
+        }
+
+    }}
+
+#endif
+
@@ -7,6 +7,7 @@
 #include "PlatformInterface.h"
 #include "../RenderCore/Metal/Format.h"
 #include "../Utility/StringFormat.h"
+#include "../Utility/MemoryUtils.h"
 #include "../Utility/TimeUtils.h"
 #include <assert.h>
 
@@ -96,7 +97,7 @@ namespace BufferUploads { namespace PlatformInterface
                 rows = mipMapDesc._height;
             }
 
-            rows = std::min(rows, sourceDataSize/sourceRowPitch);
+            rows = (unsigned)std::min(size_t(rows), sourceDataSize/sourceRowPitch);
             for (unsigned j = 0; j < rows; j++) {
                 assert((size_t(destination) + sourceRowPitch - size_t(originalDest)) <= destinationDataSize);
                 XlCopyMemoryAlign16(destination, sourceData, sourceRowPitch);
@@ -108,7 +109,7 @@ namespace BufferUploads { namespace PlatformInterface
                 // Copy data to/from video texture
             int nPitch = TextureDataSize(mipMapDesc._width, 1, 1, 1, (NativeFormat::Enum)mipMapDesc._nativePixelFormat);
             assert(sourceDataSize % nPitch == 0); (void)nPitch;
-            assert(size_t(destination) + sourceDataSize <= destinationDataSize);
+            assert(sourceDataSize <= destinationDataSize);
             XlCopyMemoryAlign16((uint8*)destination, sourceData, sourceDataSize);
         }
     }
@@ -197,7 +198,7 @@ namespace BufferUploads { namespace PlatformInterface
         moveFrom._rowPitch = moveFrom._slicePitch = 0;
     }
 
-    const UnderlyingDeviceContext::MappedBuffer& UnderlyingDeviceContext::MappedBuffer::operator=(UnderlyingDeviceContext::MappedBuffer&& moveFrom)
+    const UnderlyingDeviceContext::MappedBuffer& UnderlyingDeviceContext::MappedBuffer::operator=(UnderlyingDeviceContext::MappedBuffer&& moveFrom) never_throws
     {
         if (_sourceContext && _data) {
             _sourceContext->Unmap(*_resource.get(), _subResourceIndex);
@@ -237,6 +238,10 @@ namespace BufferUploads { namespace PlatformInterface
         intrusive_ptr<ID3D::Query> Query_CreateEvent(ObjectFactory& factory);
         bool    Query_IsEventTriggered(ID3D::DeviceContext* context, ID3D::Query* query);
         void    Query_End(ID3D::DeviceContext* context, ID3D::Query* query);
+    #elif GFXAPI_ACTIVE == GFXAPI_NULL
+        intrusive_ptr<Underlying::Query> Query_CreateEvent(ObjectFactory& factory);
+        bool    Query_IsEventTriggered(DeviceContext* context, Underlying::Query* query);
+        void    Query_End(DeviceContext* context, Underlying::Query* query);
     #endif
 
     static const GPUEventStack::EventID EventID_Temporary    = ~GPUEventStack::EventID(0x1);
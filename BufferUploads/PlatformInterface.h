@@ -43,6 +43,19 @@ namespace BufferUploads { namespace PlatformInterface
     void            Resource_RecalculateVideoMemoryHeadroom();
     void            Resource_ScheduleVideoMemoryHeadroomCalculation();
 
+    #if GFXAPI_ACTIVE == GFXAPI_NULL
+            /// <summary>Host memory used by null device resources</summary>
+            /// The null device keeps every resource in host memory. These counters
+            /// track how much is allocated (and the peak), so the upload pipeline
+            /// can be profiled without a GPU.
+        struct HostMemoryMetrics
+        {
+            size_t _resourceBytes, _peakResourceBytes;
+            size_t _stagingBytes, _peakStagingBytes;
+        };
+        HostMemoryMetrics   GetHostMemoryMetrics();
+    #endif
+
         /////////////////////////////////////////////////////////////////////
 
     class UnderlyingDeviceContext
@@ -184,6 +197,21 @@ namespace BufferUploads { namespace PlatformInterface
         static const bool ContextBasedMultithreading = true;
         static const bool CanDoPartialMaps = false;
         static const bool NonVolatileResourcesTakeSystemMemory = false;
+    #elif GFXAPI_ACTIVE == GFXAPI_NULL
+            //  (mirror DX11, so the null device exercises the same paths as our main platform.
+            //  Define NULLGFX_STAGING_TEXTURE_UPLOAD to send texture updates through staging resources)
+        static const bool SupportsResourceInitialisation = true;
+        #if defined(NULLGFX_STAGING_TEXTURE_UPLOAD)
+            static const bool RequiresStagingTextureUpload = true;
+        #else
+            static const bool RequiresStagingTextureUpload = false;
+        #endif
+        static const bool RequiresStagingResourceReadBack = true;
+        static const bool CanDoNooverwriteMapInBackground = false;
+        static const bool UseMapBasedDefrag = false;
+        static const bool ContextBasedMultithreading = true;
+        static const bool CanDoPartialMaps = false;
+        static const bool NonVolatileResourcesTakeSystemMemory = false;
     #else
         #error Unsupported platform!
     #endif
@@ -145,7 +145,7 @@ namespace BufferUploads
             ~HeapedResource();
 
             intrusive_ptr<ResourceLocator> _heapResource;
-            SimpleSpanningHeap  _heap;
+            SpanningHeap<uint32>  _heap;
             ReferenceCountingLayer _refCounts;
             unsigned _size;
             unsigned _defragCount;
@@ -162,7 +162,7 @@ namespace BufferUploads
             void                Tick(ThreadContext& context, Underlying::Resource* sourceResource);
             bool                IsCompleted(IManager::EventListID processedEventList, ThreadContext& context);
 
-            void                SetSteps(const SimpleSpanningHeap& sourceHeap, const std::vector<DefragStep>& steps);
+            void                SetSteps(const SpanningHeap<uint32>& sourceHeap, const std::vector<DefragStep>& steps);
             void                ReleaseSteps();
             const std::vector<DefragStep>&  GetSteps() { return _steps; }
 
@@ -298,7 +298,7 @@ namespace RenderCore { namespace ColladaConversion
         return false;
 	}
 
-    static const auto DefaultDiffuseTextureBindingHash = Hash64("DiffuseTexture");
+    static const auto DefaultDiffuseTextureBindingHash = ConstExprHash64("DiffuseTexture");
 
     static void AddBoundTexture( 
         const COLLADAFW::Effect* effect, unsigned commonEffectIndex,
@@ -424,7 +424,7 @@ namespace RenderCore { namespace ColladaConversion
                 if (i != _matSettingsFile._materials.end() && i->first == hashName) {
                     matSettings = i->second;
                 } else {
-                    static const auto defHash = Hash64("*");
+                    static const auto defHash = ConstExprHash64("*");
                     i = LowerBound(_matSettingsFile._materials, defHash);
                     if (i != _matSettingsFile._materials.end() && i->first == defHash) {
                         matSettings = i->second;
@@ -1286,7 +1286,7 @@ namespace RenderCore { namespace ColladaConversion
         size_t size = Serialization::Block_GetSize(block.get());
 
         Serialization::ChunkFile::ChunkHeader scaffoldChunk(
-            RenderCore::Assets::ChunkType_ModelScaffold, 0, _name.c_str(), size);
+            RenderCore::Assets::ChunkType_ModelScaffold, RenderCore::Assets::ModelScaffoldVersion, _name.c_str(), size);
         Serialization::ChunkFile::ChunkHeader largeBlockChunk(
             RenderCore::Assets::ChunkType_ModelScaffoldLargeBlocks, 0, _name.c_str(), largeResourcesBlock.size());
 
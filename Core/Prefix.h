@@ -19,10 +19,18 @@
 		#define thread_local    __declspec(thread)
 	#endif
 
+    #if _MSC_VER >= 1910
+        #define CONSTEXPR14_SUPPORTED       // (relaxed constexpr functions, with loops & local variables)
+    #endif
+
 #elif COMPILER_ACTIVE == COMPILER_TYPE_GCC
 
     #define never_throws    noexcept
-    #define force_inline    __attribute__(( always_inline ))
+    #define force_inline    inline __attribute__(( always_inline ))
+
+    #if __cplusplus >= 201402L
+        #define CONSTEXPR14_SUPPORTED
+    #endif
 
     #if PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID 
             // no dll export/import on android?
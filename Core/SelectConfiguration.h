@@ -87,6 +87,7 @@
 #define PLATFORMOS_WINDOWS      1
 #define PLATFORMOS_ANDROID      2
 #define PLATFORMOS_OSX          3
+#define PLATFORMOS_LINUX        4
 
 #if defined(__ANDROID__)
 
@@ -98,6 +99,11 @@
     #define PLATFORMOS_ACTIVE   PLATFORMOS_WINDOWS
     #define PLATFORMOS_TARGET   PLATFORMOS_WINDOWS
 
+#elif defined(__linux__)
+
+    #define PLATFORMOS_ACTIVE   PLATFORMOS_LINUX
+    #define PLATFORMOS_TARGET   PLATFORMOS_LINUX
+
 #else
 
     #pragma error("Cannot determine platform OS. Platform unsupported!")
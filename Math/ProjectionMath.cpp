@@ -10,6 +10,7 @@
 #include "ProjectionMath.h"
 #include "../Core/Prefix.h"
 #include <assert.h>
+#include <algorithm>
 #include <intrin.h>
 
 namespace Math
@@ -387,6 +388,213 @@ namespace Math
         return TestAABB_SSE(localToProjection, mins, maxs);
     }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    static void ExtractFrustumPlanes(Float4 planes[6], const float row0[], const float row1[], const float row2[], const float row3[])
+    {
+            //  Each plane is a combination of the rows of the localToProjection matrix.
+            //  These match the clip space tests in TestAABB_Basic:
+            //      x >= -w, x <= w, y >= -w, y <= w, z >= 0, z <= w
+        for (unsigned c=0; c<4; ++c) {
+            planes[0][c] = row3[c] + row0[c];
+            planes[1][c] = row3[c] - row0[c];
+            planes[2][c] = row3[c] + row1[c];
+            planes[3][c] = row3[c] - row1[c];
+            planes[4][c] = row2[c];
+            planes[5][c] = row3[c] - row2[c];
+        }
+    }
+
+    FrustumPlanes::FrustumPlanes(const Float4x4& localToProjection)
+    {
+        float rows[4][4];
+        for (unsigned r=0; r<4; ++r)
+            for (unsigned c=0; c<4; ++c)
+                rows[r][c] = localToProjection(r, c);
+        ExtractFrustumPlanes(_planes, rows[0], rows[1], rows[2], rows[3]);
+    }
+
+    FrustumPlanes::FrustumPlanes(const float localToProjection[])
+    {
+        ExtractFrustumPlanes(
+            _planes, 
+            localToProjection, localToProjection+4, 
+            localToProjection+8, localToProjection+12);
+    }
+
+    static AABBIntersection::Enum TestAABB_Planes(
+        const FrustumPlanes& frustum,
+        const Float3& mins, const Float3& maxs)
+    {
+            //  For each plane, find the distance to the corner furthest along
+            //  the plane normal (and the corner furthest in the opposite direction).
+            //  If the furthest corner is outside of any plane, all 8 corners are outside
+            //  of that plane (so the box is culled). If the nearest corner is outside
+            //  of any plane, the box straddles the boundary
+        bool culled = false, boundary = false;
+        for (unsigned p=0; p<6; ++p) {
+            const auto& plane = frustum._planes[p];
+            float maxDist = plane[3], minDist = plane[3];
+            for (unsigned c=0; c<3; ++c) {
+                float a = plane[c] * mins[c], b = plane[c] * maxs[c];
+                maxDist += std::max(a, b);
+                minDist += std::min(a, b);
+            }
+            culled |= maxDist < 0.f;
+            boundary |= minDist < 0.f;
+        }
+        if (culled) return AABBIntersection::Culled;
+        if (boundary) return AABBIntersection::Boundary;
+        return AABBIntersection::Within;
+    }
+
+    static inline const std::pair<Float3, Float3>& GetBox(
+        const std::pair<Float3, Float3>* boxes, size_t boxStride,
+        const unsigned indices[], size_t index)
+    {
+        auto i = indices ? indices[index] : index;
+        return *(const std::pair<Float3, Float3>*)(size_t(boxes) + i * boxStride);
+    }
+
+    static void TestAABBs_SSE(
+        AABBIntersection::Enum results[],
+        const FrustumPlanes& frustum,
+        const std::pair<Float3, Float3>* boxes, size_t boxStride,
+        const unsigned indices[], size_t count)
+    {
+            //  Test 4 boxes at a time. The boxes are transposed into
+            //  structure-of-arrays form, so each lane of each register
+            //  holds a value from a different box. Then the plane tests
+            //  are the same as TestAABB_Planes.
+        __m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+        for (unsigned p=0; p<6; ++p) {
+            planeX[p] = _mm_set1_ps(frustum._planes[p][0]);
+            planeY[p] = _mm_set1_ps(frustum._planes[p][1]);
+            planeZ[p] = _mm_set1_ps(frustum._planes[p][2]);
+            planeD[p] = _mm_set1_ps(frustum._planes[p][3]);
+        }
+        const auto zero = _mm_setzero_ps();
+
+        for (size_t c=0; c<count; c+=4) {
+            const auto& b0 = GetBox(boxes, boxStride, indices, c+0);
+            const auto& b1 = GetBox(boxes, boxStride, indices, c+1);
+            const auto& b2 = GetBox(boxes, boxStride, indices, c+2);
+            const auto& b3 = GetBox(boxes, boxStride, indices, c+3);
+
+                // (note; using WZYX order)
+            auto minX = _mm_set_ps(b3.first[0],  b2.first[0],  b1.first[0],  b0.first[0]);
+            auto minY = _mm_set_ps(b3.first[1],  b2.first[1],  b1.first[1],  b0.first[1]);
+            auto minZ = _mm_set_ps(b3.first[2],  b2.first[2],  b1.first[2],  b0.first[2]);
+            auto maxX = _mm_set_ps(b3.second[0], b2.second[0], b1.second[0], b0.second[0]);
+            auto maxY = _mm_set_ps(b3.second[1], b2.second[1], b1.second[1], b0.second[1]);
+            auto maxZ = _mm_set_ps(b3.second[2], b2.second[2], b1.second[2], b0.second[2]);
+
+            auto culled = _mm_setzero_ps();
+            auto boundary = _mm_setzero_ps();
+            for (unsigned p=0; p<6; ++p) {
+                auto ax = _mm_mul_ps(planeX[p], minX), bx = _mm_mul_ps(planeX[p], maxX);
+                auto ay = _mm_mul_ps(planeY[p], minY), by = _mm_mul_ps(planeY[p], maxY);
+                auto az = _mm_mul_ps(planeZ[p], minZ), bz = _mm_mul_ps(planeZ[p], maxZ);
+
+                auto maxDist = _mm_add_ps(_mm_add_ps(planeD[p], _mm_max_ps(ax, bx)), _mm_add_ps(_mm_max_ps(ay, by), _mm_max_ps(az, bz)));
+                auto minDist = _mm_add_ps(_mm_add_ps(planeD[p], _mm_min_ps(ax, bx)), _mm_add_ps(_mm_min_ps(ay, by), _mm_min_ps(az, bz)));
+
+                culled = _mm_or_ps(culled, _mm_cmplt_ps(maxDist, zero));
+                boundary = _mm_or_ps(boundary, _mm_cmplt_ps(minDist, zero));
+            }
+
+            int culledMask = _mm_movemask_ps(culled);
+            int boundaryMask = _mm_movemask_ps(boundary);
+            for (unsigned q=0; q<4; ++q) {
+                results[c+q] = 
+                      (culledMask & (1<<q))     ? AABBIntersection::Culled
+                    : (boundaryMask & (1<<q))   ? AABBIntersection::Boundary
+                    :                             AABBIntersection::Within;
+            }
+        }
+    }
+
+    #if defined(__AVX__)
+        static void TestAABBs_AVX(
+            AABBIntersection::Enum results[],
+            const FrustumPlanes& frustum,
+            const std::pair<Float3, Float3>* boxes, size_t boxStride,
+            const unsigned indices[], size_t count)
+        {
+                //  Same as TestAABBs_SSE, but 8 boxes at a time
+            const auto zero = _mm256_setzero_ps();
+            for (size_t c=0; c<count; c+=8) {
+                __declspec(align(32)) float mins[3][8], maxs[3][8];
+                for (unsigned q=0; q<8; ++q) {
+                    const auto& b = GetBox(boxes, boxStride, indices, c+q);
+                    mins[0][q] = b.first[0]; mins[1][q] = b.first[1]; mins[2][q] = b.first[2];
+                    maxs[0][q] = b.second[0]; maxs[1][q] = b.second[1]; maxs[2][q] = b.second[2];
+                }
+                auto minX = _mm256_load_ps(mins[0]), minY = _mm256_load_ps(mins[1]), minZ = _mm256_load_ps(mins[2]);
+                auto maxX = _mm256_load_ps(maxs[0]), maxY = _mm256_load_ps(maxs[1]), maxZ = _mm256_load_ps(maxs[2]);
+
+                auto culled = _mm256_setzero_ps();
+                auto boundary = _mm256_setzero_ps();
+                for (unsigned p=0; p<6; ++p) {
+                    const auto& plane = frustum._planes[p];
+                    auto px = _mm256_set1_ps(plane[0]), py = _mm256_set1_ps(plane[1]), pz = _mm256_set1_ps(plane[2]);
+                    auto ax = _mm256_mul_ps(px, minX), bx = _mm256_mul_ps(px, maxX);
+                    auto ay = _mm256_mul_ps(py, minY), by = _mm256_mul_ps(py, maxY);
+                    auto az = _mm256_mul_ps(pz, minZ), bz = _mm256_mul_ps(pz, maxZ);
+                    auto d = _mm256_set1_ps(plane[3]);
+
+                    auto maxDist = _mm256_add_ps(_mm256_add_ps(d, _mm256_max_ps(ax, bx)), _mm256_add_ps(_mm256_max_ps(ay, by), _mm256_max_ps(az, bz)));
+                    auto minDist = _mm256_add_ps(_mm256_add_ps(d, _mm256_min_ps(ax, bx)), _mm256_add_ps(_mm256_min_ps(ay, by), _mm256_min_ps(az, bz)));
+
+                    culled = _mm256_or_ps(culled, _mm256_cmp_ps(maxDist, zero, _CMP_LT_OQ));
+                    boundary = _mm256_or_ps(boundary, _mm256_cmp_ps(minDist, zero, _CMP_LT_OQ));
+                }
+
+                int culledMask = _mm256_movemask_ps(culled);
+                int boundaryMask = _mm256_movemask_ps(boundary);
+                for (unsigned q=0; q<8; ++q) {
+                    results[c+q] = 
+                          (culledMask & (1<<q))     ? AABBIntersection::Culled
+                        : (boundaryMask & (1<<q))   ? AABBIntersection::Boundary
+                        :                             AABBIntersection::Within;
+                }
+            }
+        }
+    #endif
+
+    void TestAABBs(
+        AABBIntersection::Enum results[],
+        const FrustumPlanes& frustum,
+        const std::pair<Float3, Float3>* boxes, size_t boxStride,
+        const unsigned indices[], size_t count)
+    {
+            //  Use the wide kernel for as many boxes as we can, and then finish
+            //  with the scalar version
+        size_t packetCount = 0;
+        #if defined(__AVX__)
+            packetCount = count & ~size_t(7);
+            TestAABBs_AVX(results, frustum, boxes, boxStride, indices, packetCount);
+        #endif
+
+        {
+            auto sseCount = (count - packetCount) & ~size_t(3);
+            if (indices) {
+                TestAABBs_SSE(results + packetCount, frustum, boxes, boxStride, indices + packetCount, sseCount);
+            } else {
+                TestAABBs_SSE(
+                    results + packetCount, frustum, 
+                    (const std::pair<Float3, Float3>*)(size_t(boxes) + packetCount * boxStride), boxStride, 
+                    nullptr, sseCount);
+            }
+            packetCount += sseCount;
+        }
+
+        for (size_t c=packetCount; c<count; ++c) {
+            const auto& box = GetBox(boxes, boxStride, indices, c);
+            results[c] = TestAABB_Planes(frustum, box.first, box.second);
+        }
+    }
+
     Float4 ExtractMinimalProjection(const Float4x4& projectionMatrix)
     {
         return Float4(projectionMatrix(0,0), projectionMatrix(1,1), projectionMatrix(2,2), projectionMatrix(2,3));
@@ -8,6 +8,7 @@
 
 #include "Vector.h"
 #include "Matrix.h"
+#include <utility>
 
 namespace Math
 {
@@ -43,6 +44,33 @@ namespace Math
             == AABBIntersection::Culled;
     }
 
+        /// <summary>Clipping planes of a frustum, for testing many bounding boxes</summary>
+        /// Extract the planes once (for example, once per placement cell) and then use
+        /// TestAABBs() to test many boxes against them. Each plane is stored as (nx, ny, nz, d)
+        /// in the space of the input boxes, with points inside the frustum giving positive
+        /// distances.
+    class FrustumPlanes
+    {
+    public:
+        Float4 _planes[6];
+
+        explicit FrustumPlanes(const Float4x4& localToProjection);
+        explicit FrustumPlanes(const float localToProjection[]);
+    };
+
+        /// <summary>Test many bounding boxes against a frustum</summary>
+        /// Tests 4 boxes at a time with SSE (or 8 with AVX, when enabled at compile time).
+        /// The boxes are read from "boxes" with the given stride in bytes. If "indices" is
+        /// not null, "results[c]" is the result for the box at "indices[c]"; otherwise boxes
+        /// are read in order.
+        /// This gives the same results as TestAABB(), except for boxes that are very close 
+        /// to one of the clipping planes (where the two methods can round differently)
+    void TestAABBs(
+        AABBIntersection::Enum results[],
+        const FrustumPlanes& frustum,
+        const std::pair<Float3, Float3>* boxes, size_t boxStride,
+        const unsigned indices[], size_t count);
+
     Float4 ExtractMinimalProjection(const Float4x4& projectionMatrix);
 }
 
@@ -16,13 +16,13 @@ namespace PlatformRig { namespace Overlays
 {
     static float AsMilliseconds(uint64 profilerTime)
     {
-        static float freqMult = 1000.f / GetPerformanceCounterFrequency();
+        static float freqMult = 1000.f / HierarchicalCPUProfiler::GetTimestampFrequency();
         return float(profilerTime) * freqMult;
     }
 
     static uint64 MillisecondsAsTimerValue(float milliseconds)
     {
-        static float converter = GetPerformanceCounterFrequency() / 1000.f;
+        static float converter = HierarchicalCPUProfiler::GetTimestampFrequency() / 1000.f;
         return uint64(milliseconds * converter);
     }
 
@@ -13,11 +13,13 @@
 
 #include "../RenderCore/Techniques/ResourceBox.h"
 #include "../RenderCore/Techniques/CommonResources.h"
+#include "../Assets/CompileAndAsyncManager.h"
 
 #include "../Utility/TimeUtils.h"
 #include "../Utility/IntrusivePtr.h"
 #include "../Utility/StringFormat.h"
 #include "../Utility/Profiling/CPUProfiler.h"
+#include "../Utility/Profiling/CPUProfilerRegistry.h"
 
 #include "../ConsoleRig/Log.h"
 #include "../ConsoleRig/Console.h"
@@ -77,6 +79,7 @@ namespace PlatformRig
         uint64      _timerFrequency;
         std::shared_ptr<FrameRigDisplay> _display;
         HierarchicalCPUProfiler* _profiler;
+        ThreadProfiler* _threadProfiler;
 
         Pimpl() 
         : _prevFrameStartTime(0) 
@@ -84,6 +87,7 @@ namespace PlatformRig
         , _frameRenderCount(0)
         , _frameLimiter(0)
         , _profiler(nullptr)
+        , _threadProfiler(nullptr)
         {
             _timerToSeconds = 1.0f / float(_timerFrequency);
         }
@@ -122,7 +126,11 @@ namespace PlatformRig
         RenderCore::Metal::GPUProfiler::Profiler* gpuProfiler,
         const FrameRenderFunction& renderFunction) -> FrameResult
     {
+            //  Collect the events every thread recorded during the previous frame
+        CPUProfilerRegistry::GetInstance().EndFrame();
+
         CPUProfileEvent_Conditional pEvnt("FrameRig::ExecuteFrame", _pimpl->_profiler);
+        ThreadProfileEvent threadEvnt("FrameRig::ExecuteFrame", *_pimpl->_threadProfiler);
 
         assert(context && device && presChain);
 
@@ -177,9 +185,15 @@ namespace PlatformRig
 
         {
             CPUProfileEvent_Conditional pEvnt("Present", _pimpl->_profiler);
+            ThreadProfileEvent threadEvnt("Present", *_pimpl->_threadProfiler);
             presChain->Present();
         }
 
+            //  Assets replaced by a dependency refresh are kept alive for a few frames
+            //  (in case some other thread is still using them). Let the asset sets know
+            //  that another frame has passed.
+        ::Assets::CompileAndAsyncManager::GetInstance().GetAssetSets().OnFrameBarrier();
+
         if (gpuProfiler) {
             RenderCore::Metal::GPUProfiler::Frame_End(*context, gpuProfiler);
         }
@@ -213,6 +227,7 @@ namespace PlatformRig
     {
         _pimpl = std::make_unique<Pimpl>();
         _pimpl->_profiler = profiler;
+        _pimpl->_threadProfiler = &CPUProfilerRegistry::GetInstance().GetThreadProfiler("Main");
 
         if (debugSystem) {
             _pimpl->_display = std::make_shared<FrameRigDisplay>(debugSystem, _pimpl->_prevFrameAllocationCount, _pimpl->_frameRate);
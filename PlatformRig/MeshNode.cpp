@@ -71,6 +71,31 @@ namespace PlatformRig { namespace Network
             _time = time;
         }
 
+        void    StateBundleUpdateBatch::SerializeBody(XlNetSerializer& ser)
+        {
+            ser.Value("Count", _count);
+            ser.Value("Size", _size);
+            _size = std::min(dimof(_buffer), size_t(_size));
+            if (ser.IsWriting()) {
+                ser.WriteBinaryArray("Data", (const char*)_buffer, (int)_size);
+            } else {
+                ser.ReadBinaryArray("Data", (char*)_buffer, (int)_size);
+            }
+        }
+
+        bool    StateBundleUpdateBatch::Append(const RecordHeader& header, const void* encodedData)
+        {
+            auto recordSize = sizeof(RecordHeader) + header._encodedSize;
+            if ((_size + recordSize) > dimof(_buffer)) {
+                return false;
+            }
+            XlCopyMemory(&_buffer[_size], &header, sizeof(RecordHeader));
+            XlCopyMemory(&_buffer[_size + sizeof(RecordHeader)], encodedData, header._encodedSize);
+            _size += recordSize;
+            ++_count;
+            return true;
+        }
+
         void    StateBundleDestroy::SerializeBody(XlNetSerializer& ser)
         {
             ser.Value("Bundle", _stateBundle);
@@ -164,6 +189,42 @@ namespace PlatformRig { namespace Network
         return true;
     }
 
+    static bool OnStateBundleUpdateBatch(ContactSession* session, const ContactPacket::StateBundleUpdateBatch& packet)
+    {
+        typedef ContactPacket::StateBundleUpdateBatch Batch;
+        auto& world = StatePropagation::StateWorld::GetInstance();
+        auto authority = session->GetRemoteMeshNodeId();
+
+        size_t offset = 0;
+        for (size_t c=0; c<packet._count; ++c) {
+            if ((offset + sizeof(Batch::RecordHeader)) > packet._size) {
+                LogWarningF("Truncated state bundle update batch");
+                return false;
+            }
+
+            Batch::RecordHeader header;
+            XlCopyMemory(&header, &packet._buffer[offset], sizeof(header));
+            offset += sizeof(header);
+            if ((offset + header._encodedSize) > packet._size) {
+                LogWarningF("Truncated state bundle update batch");
+                return false;
+            }
+
+            const void* data = &packet._buffer[offset];
+            if (header._encoding == Batch::Encoding::Delta) {
+                world.ReceiveBundleDelta(
+                    header._stateBundle, data, header._encodedSize, header._size, 
+                    header._type, authority, header._time, header._baseTime);
+            } else {
+                world.ReceiveBundle(
+                    header._stateBundle, data, header._size, header._type, 
+                    authority, header._time);
+            }
+            offset += header._encodedSize;
+        }
+        return true;
+    }
+
     static bool OnStateBundleDestroy(ContactSession* session, const ContactPacket::StateBundleDestroy& packet)
     {
         StatePropagation::StateWorld::GetInstance().DestroyBundle(
@@ -213,6 +274,7 @@ namespace PlatformRig { namespace Network
         impl.Register(&OnRequestSubscribe);
         impl.Register(&OnSubscriptionSuggestions);
         impl.Register(&OnMoveObserver);
+        impl.Register(&OnStateBundleUpdateBatch);
     }
 
     void        ContactSession::SetRemoteMeshNodeId(MeshNodeId newId)
@@ -52,6 +52,8 @@ namespace PlatformRig { namespace Network
 
                 MoveObserver,
 
+                StateBundleUpdateBatch,
+
                 Max
             };
         }
@@ -87,6 +89,38 @@ namespace PlatformRig { namespace Network
             uint8               _buffer[2048];
         };
 
+            /// <summary>Updates for many state bundles, sent to a single destination</summary>
+            /// Each record is a RecordHeader, followed by "_encodedSize" bytes of data.
+            /// The data is either the full state of the bundle, or a delta against the
+            /// version with time "_baseTime" (see StatePropagation::DeltaEncode)
+        class StateBundleUpdateBatch : public BasicPacket<  ContactPacket::Type::StateBundleUpdateBatch, 
+                                                            ContactPacket::Type::Enum>
+        {
+        public:
+            struct Encoding { enum Enum { Full, Delta }; };
+
+            class RecordHeader
+            {
+            public:
+                StateBundleId       _stateBundle;
+                StateBundleType     _type;
+                NetworkTime         _time;
+                NetworkTime         _baseTime;
+                uint32              _size;
+                uint32              _encodedSize;
+                uint32              _encoding;      // Encoding::Enum
+            };
+
+            void    SerializeBody(XlNetSerializer& ser);
+            void    Init()          { _count = 0; _size = 0; }
+            bool    Append(const RecordHeader& header, const void* encodedData);
+            bool    IsEmpty() const { return _count == 0; }
+
+            size_t              _count;
+            size_t              _size;
+            uint8               _buffer[4096];
+        };
+
         class StateBundleDestroy : public BasicPacket<ContactPacket::Type::StateBundleDestroy, ContactPacket::Type::Enum>
         {
         public:
@@ -1325,8 +1325,8 @@ namespace Tools
         const ShaderResourceView* resources[] = { &srv };
         const ConstantBuffer* cnsts[] = { &reciprocalViewportDimensions };
         BoundUniforms boundLayout(shaderProgram);
-        boundLayout.BindConstantBuffer(Hash64("ReciprocalViewportDimensions"), 0, 1);
-        boundLayout.BindShaderResource(Hash64("DiffuseTexture"), 0, 1);
+        boundLayout.BindConstantBuffer(ConstExprHash64("ReciprocalViewportDimensions"), 0, 1);
+        boundLayout.BindShaderResource(ConstExprHash64("DiffuseTexture"), 0, 1);
         boundLayout.Apply(*context, UniformsStream(), UniformsStream(nullptr, cnsts, dimof(cnsts), resources, dimof(resources)));
 
         context->Bind(BlendState(BlendOp::Add, Blend::SrcAlpha, Blend::InvSrcAlpha));
@@ -7,6 +7,11 @@
 #include "StatePropagation.h"
 #include "../ConsoleRig/Log.h"
 #include "../Utility/PtrUtils.h"
+#include "../Utility/IteratorUtils.h"
+#include "../Math/Math.h"
+#include "../Utility/MemoryUtils.h"
+#include "../Utility/TimeUtils.h"
+#include <algorithm>
 
 namespace PlatformRig
 {
@@ -40,6 +45,16 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         return _active;
     }
 
+    bool    VisibilityObject::VisibleToObserver(const Float3& observerPosition, VisibilityArea observerArea, float interestRadius) const
+    {
+        if (!_active) return false;
+        if (interestRadius >= FLT_MAX) return true;
+
+        float dx = std::max(0.f, std::max(_transpondPosition.first[0] - observerPosition[0], observerPosition[0] - _transpondPosition.second[0]));
+        float dy = std::max(0.f, std::max(_transpondPosition.first[1] - observerPosition[1], observerPosition[1] - _transpondPosition.second[1]));
+        return (dx*dx + dy*dy) <= (interestRadius*interestRadius);
+    }
+
         ////////////////////////////////////////////////////////////////////////
 
     bool    SubscriptionList::HasSubscriber(MeshNodeId meshNode) const
@@ -67,6 +82,129 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
         ////////////////////////////////////////////////////////////////////////
 
+    static bool WriteVarInt(uint8 dst[], size_t dstCapacity, size_t& pos, size_t value)
+    {
+        do {
+            if (pos >= dstCapacity) return false;
+            uint8 b = uint8(value & 0x7f);
+            value >>= 7;
+            dst[pos++] = b | (value ? 0x80 : 0);
+        } while (value);
+        return true;
+    }
+
+    static bool ReadVarInt(const uint8 src[], size_t srcSize, size_t& pos, size_t& value)
+    {
+        value = 0;
+        for (unsigned shift=0; shift<64; shift+=7) {
+            if (pos >= srcSize) return false;
+            uint8 b = src[pos++];
+            value |= size_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool    DeltaEncode(
+        void* dst, size_t dstCapacity, size_t& encodedSize,
+        const void* data, const void* baseline, size_t size)
+    {
+            //  The encoded form is a series of tokens, each with:
+            //      <varint: unchanged byte count> <varint: changed byte count> <changed bytes XOR baseline>
+            //  Any bytes after the last token are unchanged.
+        auto* out = (uint8*)dst;
+        auto* a = (const uint8*)data;
+        auto* b = (const uint8*)baseline;
+        size_t o = 0, i = 0;
+        while (i < size) {
+            auto unchangedStart = i;
+            while (i < size && a[i] == b[i]) ++i;
+            auto unchangedCount = i - unchangedStart;
+
+                //  Short runs of unchanged bytes are included in the changed run, because
+                //  starting a new token costs at least 2 bytes
+            auto changedStart = i;
+            while (i < size) {
+                if (a[i] != b[i]) { ++i; continue; }
+                size_t gap = 0;
+                while ((i+gap) < size && a[i+gap] == b[i+gap] && gap < 3) ++gap;
+                if (gap >= 3 || (i+gap) == size) break;
+                i += gap;
+            }
+            auto changedCount = i - changedStart;
+            if (!changedCount) break;       // (only unchanged bytes remaining)
+
+            if (!WriteVarInt(out, dstCapacity, o, unchangedCount)) return false;
+            if (!WriteVarInt(out, dstCapacity, o, changedCount)) return false;
+            if ((o + changedCount) > dstCapacity) return false;
+            for (size_t c=0; c<changedCount; ++c) {
+                out[o+c] = a[changedStart+c] ^ b[changedStart+c];
+            }
+            o += changedCount;
+        }
+        encodedSize = o;
+        return true;
+    }
+
+    bool    DeltaDecode(
+        void* dst, const void* baseline, size_t size,
+        const void* encoded, size_t encodedSize)
+    {
+        auto* out = (uint8*)dst;
+        auto* in = (const uint8*)encoded;
+        if (dst != baseline) {
+            XlCopyMemory(dst, baseline, size);
+        }
+
+        size_t pos = 0, i = 0;
+        while (i < encodedSize) {
+            size_t unchangedCount, changedCount;
+            if (!ReadVarInt(in, encodedSize, i, unchangedCount)) return false;
+            if (!ReadVarInt(in, encodedSize, i, changedCount)) return false;
+            if (unchangedCount > (size - pos)) return false;
+            pos += unchangedCount;
+            if (changedCount > (size - pos) || changedCount > (encodedSize - i)) return false;
+            for (size_t c=0; c<changedCount; ++c) {
+                out[pos+c] ^= in[i+c];
+            }
+            pos += changedCount;
+            i += changedCount;
+        }
+        return true;
+    }
+
+    bool    DeltaBaseline::Encode(
+        std::vector<uint8>& encoded, NetworkTime& baseTime,
+        const void* data, size_t size, NetworkTime time,
+        unsigned snapshotInterval)
+    {
+        bool useDelta = _valid && size > 0 && _data.size() == size && _deltasSinceSnapshot < snapshotInterval;
+        if (useDelta) {
+                // (the delta is only useful if it's smaller than the full data)
+            encoded.resize(size);
+            size_t encodedSize = 0;
+            useDelta = DeltaEncode(
+                AsPointer(encoded.begin()), size-1, encodedSize,
+                data, AsPointer(_data.cbegin()), size);
+            if (useDelta) {
+                encoded.resize(encodedSize);
+                baseTime = _time;
+            }
+        }
+
+        _data.assign((const uint8*)data, PtrAdd((const uint8*)data, size));
+        _time = time;
+        _valid = true;
+        _deltasSinceSnapshot = useDelta ? (_deltasSinceSnapshot+1) : 0;
+        return useDelta;
+    }
+
+    DeltaBaseline::DeltaBaseline()
+    : _time(0), _deltasSinceSnapshot(0), _valid(false)
+    {}
+
+        ////////////////////////////////////////////////////////////////////////
+
     StateBundle::Data::Data(    Threading::ReadWriteMutex& mutex, 
                                 const void* data, size_t size, NetworkTime time)
     :       _lock(mutex, false), _data(data)
@@ -125,6 +263,9 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
     void            StateBundle::UpdateVisibility(const VisibilityObject& visibility)
     {
         _visibilityObject = visibility;
+        if (_broadcaster) {
+            _broadcaster->OnVisibilityChange(*this);
+        }
     }
 
     void            StateBundle::UpdateBroadcaster(IStatePacketBroadcaster* broadcaster)
@@ -157,6 +298,203 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
         ////////////////////////////////////////////////////////////////////////
 
+    static uint64 CellKey(int x, int y) { return (uint64(uint32(x)) << 32ull) | uint64(uint32(y)); }
+
+    static int CellCoord(float value, float cellSize)
+    {
+            // clamp, so that very large boxes don't overflow
+        float f = XlFloor(value / cellSize);
+        return int(std::max(-float(1<<30), std::min(float(1<<30), f)));
+    }
+
+    void    InterestGrid::AddToCells(unsigned objectIndex)
+    {
+        auto& obj = _objects[objectIndex];
+        if (obj._large) {
+            _largeObjects.push_back(objectIndex);
+            return;
+        }
+
+        for (int y=obj._cellMin[1]; y<=obj._cellMax[1]; ++y)
+            for (int x=obj._cellMin[0]; x<=obj._cellMax[0]; ++x) {
+                auto key = CellKey(x, y);
+                auto i = LowerBound(_cells, key);
+                if (i == _cells.end() || i->first != key) {
+                    i = _cells.insert(i, std::make_pair(key, std::vector<unsigned>()));
+                }
+                i->second.push_back(objectIndex);
+            }
+    }
+
+    void    InterestGrid::RemoveFromCells(unsigned objectIndex)
+    {
+        auto& obj = _objects[objectIndex];
+        if (obj._large) {
+            auto i = std::find(_largeObjects.begin(), _largeObjects.end(), objectIndex);
+            assert(i != _largeObjects.end());
+            *i = _largeObjects.back();
+            _largeObjects.pop_back();
+            return;
+        }
+
+        for (int y=obj._cellMin[1]; y<=obj._cellMax[1]; ++y)
+            for (int x=obj._cellMin[0]; x<=obj._cellMax[0]; ++x) {
+                auto key = CellKey(x, y);
+                auto i = LowerBound(_cells, key);
+                assert(i != _cells.end() && i->first == key);
+                auto& list = i->second;
+                auto o = std::find(list.begin(), list.end(), objectIndex);
+                assert(o != list.end());
+                *o = list.back();
+                list.pop_back();
+                    // (empty cells are kept, because objects tend to move back into them)
+            }
+    }
+
+    void    InterestGrid::Update(StateBundle& bundle)
+    {
+        auto& visibility = bundle.GetVisibility();
+        if (!visibility.IsActive()) {
+            Remove(bundle.GetId());
+            return;
+        }
+
+        auto& box = visibility.GetTranspondPosition();
+        Float2 mins(box.first[0], box.first[1]), maxs(box.second[0], box.second[1]);
+        int cellMin[2] = { CellCoord(mins[0], _cellSize), CellCoord(mins[1], _cellSize) };
+        int cellMax[2] = { CellCoord(maxs[0], _cellSize), CellCoord(maxs[1], _cellSize) };
+        bool large = (int64(cellMax[0]) - int64(cellMin[0]) + 1) * (int64(cellMax[1]) - int64(cellMin[1]) + 1) > int64(MaxCellsPerObject);
+
+        auto l = LowerBound(_objectLookup, bundle.GetId());
+        if (l != _objectLookup.end() && l->first == bundle.GetId()) {
+            auto& obj = _objects[l->second];
+            obj._bundle = &bundle;
+            obj._mins = mins; obj._maxs = maxs;
+
+                //  Most updates are small movements that don't change the cells
+                //  that the object is in. In that case, we don't need to touch the cells.
+            if (    obj._large == large
+                &&  (large || (    obj._cellMin[0] == cellMin[0] && obj._cellMin[1] == cellMin[1]
+                                && obj._cellMax[0] == cellMax[0] && obj._cellMax[1] == cellMax[1]))) {
+                return;
+            }
+
+            RemoveFromCells(l->second);
+            obj._cellMin[0] = cellMin[0]; obj._cellMin[1] = cellMin[1];
+            obj._cellMax[0] = cellMax[0]; obj._cellMax[1] = cellMax[1];
+            obj._large = large;
+            AddToCells(l->second);
+            return;
+        }
+
+        Object newObject;
+        newObject._bundle = &bundle;
+        newObject._mins = mins; newObject._maxs = maxs;
+        newObject._cellMin[0] = cellMin[0]; newObject._cellMin[1] = cellMin[1];
+        newObject._cellMax[0] = cellMax[0]; newObject._cellMax[1] = cellMax[1];
+        newObject._large = large;
+        newObject._queryStamp = 0;
+
+        unsigned objectIndex;
+        if (!_freeObjects.empty()) {
+            objectIndex = _freeObjects.back();
+            _freeObjects.pop_back();
+            _objects[objectIndex] = newObject;
+        } else {
+            objectIndex = unsigned(_objects.size());
+            _objects.push_back(newObject);
+        }
+        _objectLookup.insert(l, std::make_pair(bundle.GetId(), objectIndex));
+        AddToCells(objectIndex);
+    }
+
+    void    InterestGrid::Remove(StateBundleId bundle)
+    {
+        auto l = LowerBound(_objectLookup, bundle);
+        if (l == _objectLookup.end() || l->first != bundle) return;
+
+        RemoveFromCells(l->second);
+        _objects[l->second]._bundle = nullptr;
+        _freeObjects.push_back(l->second);
+        _objectLookup.erase(l);
+    }
+
+    bool    InterestGrid::Overlaps(const Object& obj, const Float3& observerPosition, float interestRadius) const
+    {
+        return  (obj._mins[0] - interestRadius) <= observerPosition[0] && observerPosition[0] <= (obj._maxs[0] + interestRadius)
+            &&  (obj._mins[1] - interestRadius) <= observerPosition[1] && observerPosition[1] <= (obj._maxs[1] + interestRadius);
+    }
+
+    void    InterestGrid::FindBundles(
+        std::vector<StateBundle*>& result, 
+        const Float3& observerPosition, float interestRadius) const
+    {
+            //  An infinite radius means every object is visible. Just return everything
+        if (interestRadius >= FLT_MAX) {
+            for (auto i=_objectLookup.cbegin(); i!=_objectLookup.cend(); ++i) {
+                result.push_back(_objects[i->second]._bundle);
+            }
+            return;
+        }
+
+            //  Objects can be in more than one cell, so we use a stamp to make sure
+            //  each object is only returned once
+        auto stamp = ++_queryStamp;
+        if (stamp == 0) {
+            for (auto i=_objects.begin(); i!=_objects.end(); ++i) { i->_queryStamp = 0; }
+            stamp = _queryStamp = 1;
+        }
+
+        for (auto i=_largeObjects.cbegin(); i!=_largeObjects.cend(); ++i) {
+            auto& obj = _objects[*i];
+            if (Overlaps(obj, observerPosition, interestRadius)) {
+                obj._queryStamp = stamp;
+                result.push_back(obj._bundle);
+            }
+        }
+
+        int queryMin[2] = { CellCoord(observerPosition[0] - interestRadius, _cellSize), CellCoord(observerPosition[1] - interestRadius, _cellSize) };
+        int queryMax[2] = { CellCoord(observerPosition[0] + interestRadius, _cellSize), CellCoord(observerPosition[1] + interestRadius, _cellSize) };
+        auto queryCellCount = (int64(queryMax[0]) - int64(queryMin[0]) + 1) * (int64(queryMax[1]) - int64(queryMin[1]) + 1);
+
+        auto testCell = [&](const std::vector<unsigned>& cell)
+        {
+            for (auto o=cell.cbegin(); o!=cell.cend(); ++o) {
+                auto& obj = _objects[*o];
+                if (obj._queryStamp != stamp && Overlaps(obj, observerPosition, interestRadius)) {
+                    obj._queryStamp = stamp;
+                    result.push_back(obj._bundle);
+                }
+            }
+        };
+
+        if (queryCellCount > int64(_cells.size())) {
+                // large query; it's quicker to just walk through the occupied cells
+            for (auto c=_cells.cbegin(); c!=_cells.cend(); ++c) {
+                testCell(c->second);
+            }
+        } else {
+            for (int y=queryMin[1]; y<=queryMax[1]; ++y)
+                for (int x=queryMin[0]; x<=queryMax[0]; ++x) {
+                    auto key = CellKey(x, y);
+                    auto i = LowerBound(_cells, key);
+                    if (i != _cells.end() && i->first == key) {
+                        testCell(i->second);
+                    }
+                }
+        }
+    }
+
+    InterestGrid::InterestGrid(float cellSize)
+    : _cellSize(cellSize), _queryStamp(0)
+    {
+        assert(cellSize > 0.f);
+    }
+
+    InterestGrid::~InterestGrid() {}
+
+        ////////////////////////////////////////////////////////////////////////
+
     std::shared_ptr<StateBundle>        StateWorld::CreateAuthoritativePacket(size_t size, StateBundleType type)
     {
         StateBundleId packetId = GenerateGuid64();
@@ -174,15 +512,19 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
             //
             //      Find all packets that are visible to the given observer,
-            //      but don't yet have that observer as a subscriber
+            //      but don't yet have that observer as a subscriber.
+            //      The interest grid gives us a short list of nearby packets
             //
-        for (auto i=_authoriativePackets.begin(); i!=_authoriativePackets.end(); ++i) {
-            const bool visible = i->second->GetVisibility().VisibleToObserver(observerPosition, observerArea);
-            if (visible && !i->second->GetSubscriptionList().HasSubscriber(observer)) {
-                result.push_back(i->first);
+        std::vector<StateBundle*> candidates;
+        _interestGrid.FindBundles(candidates, observerPosition, _interestRadius);
+        for (auto i=candidates.cbegin(); i!=candidates.cend(); ++i) {
+            const bool visible = (*i)->GetVisibility().VisibleToObserver(observerPosition, observerArea, _interestRadius);
+            if (visible && !(*i)->GetSubscriptionList().HasSubscriber(observer)) {
+                result.push_back((*i)->GetId());
             }
         }
 
+        std::sort(result.begin(), result.end());
         return result;
     }
 
@@ -198,8 +540,18 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
                 // (do we need to send recent events to the new subscriber, also?)
             i->second->GetSubscriptionList().AddSubscriber(meshNode);
-            auto data = i->second->LockData();
-            OnUpdate(statePacket, meshNode, data.Get(), data.GetSize(), i->second->GetType(), data.GetTime());
+
+                //  When using delta compression, the next batched update will be a delta
+                //  against the baseline. So the new subscriber must start with the baseline
+                //  (rather than the most recent data)
+            auto b = _baselines.find(statePacket);
+            if (_deltaCompression && b != _baselines.end() && b->second.IsValid()) {
+                auto& baseline = b->second;
+                OnUpdate(statePacket, meshNode, AsPointer(baseline.GetData().cbegin()), baseline.GetData().size(), i->second->GetType(), baseline.GetTime());
+            } else {
+                auto data = i->second->LockData();
+                OnUpdate(statePacket, meshNode, data.Get(), data.GetSize(), i->second->GetType(), data.GetTime());
+            }
 
         } else {
             LogWarningF("Attempting to subscribe to a state packet that doesn't exist in our authoritative packet list!");
@@ -236,6 +588,15 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
             //
             //      Note -- not thread safe!
             //
+        if (_deltaCompression) {
+                // (sent later, in FlushPendingUpdates)
+            auto i = std::lower_bound(_pendingUpdates.begin(), _pendingUpdates.end(), packet);
+            if (i == _pendingUpdates.end() || *i != packet) {
+                _pendingUpdates.insert(i, packet);
+            }
+            return;
+        }
+
         for (auto i=subscription.GetSubscribers().cbegin(); i!=subscription.GetSubscribers().cend(); ++i) {
                 //  probably we should cache the XlConnection object, rather than finding
                 //  it every time!
@@ -260,6 +621,69 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         SendPacket(singleDestination, &out);
     }
 
+    void    StateWorld::FlushPendingUpdates()
+    {
+        if (_pendingUpdates.empty()) return;
+
+        typedef ContactPacket::StateBundleUpdateBatch Batch;
+        std::vector<std::pair<MeshNodeId, std::unique_ptr<Batch>>> batches;
+
+        for (auto p=_pendingUpdates.cbegin(); p!=_pendingUpdates.cend(); ++p) {
+            auto i = _authoriativePackets.find(*p);
+            if (i == _authoriativePackets.end()) continue;
+            auto& bundle = *i->second;
+
+                //  Note that we must update the baseline even if there are no subscribers
+                //  currently. New subscribers will receive the baseline when they subscribe.
+            auto data = bundle.LockData();
+                //  (zero the whole header, including padding, because it is copied
+                //  into the packet byte-for-byte)
+            Batch::RecordHeader header;
+            XlZeroMemory(header);
+            header._stateBundle = *p;
+            header._type = bundle.GetType();
+            header._time = data.GetTime();
+            header._baseTime = 0;
+            header._size = uint32(data.GetSize());
+            bool isDelta = _baselines[*p].Encode(
+                _encodeBuffer, header._baseTime, 
+                data.Get(), data.GetSize(), data.GetTime(), _snapshotInterval);
+            header._encoding = isDelta ? Batch::Encoding::Delta : Batch::Encoding::Full;
+            header._encodedSize = isDelta ? uint32(_encodeBuffer.size()) : header._size;
+            const void* payload = isDelta ? (const void*)AsPointer(_encodeBuffer.cbegin()) : data.Get();
+
+            auto& subscribers = bundle.GetSubscriptionList().GetSubscribers();
+            for (auto s=subscribers.cbegin(); s!=subscribers.cend(); ++s) {
+                auto b = LowerBound(batches, *s);
+                if (b == batches.end() || b->first != *s) {
+                    auto newBatch = std::make_unique<Batch>();
+                    newBatch->Init();
+                    b = batches.insert(b, std::make_pair(*s, std::move(newBatch)));
+                }
+
+                if (b->second->Append(header, payload)) continue;
+
+                    //  This batch is full. Send it, and start a new one. If the record
+                    //  doesn't fit even in an empty batch, send the full data on its own.
+                if (!b->second->IsEmpty()) {
+                    SendPacket(*s, b->second.get());
+                    b->second->Init();
+                }
+                if (!b->second->Append(header, payload)) {
+                    OnUpdate(*p, *s, data.Get(), data.GetSize(), header._type, header._time);
+                }
+            }
+        }
+
+        for (auto b=batches.cbegin(); b!=batches.cend(); ++b) {
+            if (!b->second->IsEmpty()) {
+                SendPacket(b->first, b->second.get());
+            }
+        }
+
+        _pendingUpdates.clear();
+    }
+
     void    StateWorld::OnDestroy(StateBundleId packet, const SubscriptionList& subscription)
     {
         for (auto i=subscription.GetSubscribers().cbegin(); i!=subscription.GetSubscribers().cend(); ++i) {
@@ -278,6 +702,30 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         }
     }
 
+    void    StateWorld::OnVisibilityChange(StateBundle& bundle)
+    {
+            // only authoritative bundles are suggested to observers
+        auto i = _authoriativePackets.find(bundle.GetId());
+        if (i != _authoriativePackets.end() && i->second.get() == &bundle) {
+            _interestGrid.Update(bundle);
+        }
+    }
+
+    void    StateWorld::SetInterestRadius(float radius)
+    {
+        _interestRadius = radius;
+    }
+
+    void    StateWorld::SetDeltaCompression(bool enable, unsigned snapshotInterval)
+    {
+        if (!enable) {
+            FlushPendingUpdates();
+            _baselines.clear();
+        }
+        _deltaCompression = enable;
+        _snapshotInterval = snapshotInterval;
+    }
+
     MeshNodeId  StateWorld::LocalMeshNode() const   { return _localMeshNode; }
     MeshNodeId  StateWorld::GetTimeNow() const      { return LocalMeshNode::GetInstance().GetNetworkTime(); }
 
@@ -310,6 +758,37 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         }
     }
 
+    void    StateWorld::ReceiveBundleDelta(StateBundleId id, const void* encoded, size_t encodedSize, 
+                                           size_t size, StateBundleType type, 
+                                           MeshNodeId authority, NetworkTime updateTime, NetworkTime baseTime)
+    {
+            //
+            //      We can only apply the delta if we have exactly the version it
+            //      was encoded against. Otherwise we must wait for the next full snapshot
+            //
+        auto i = _nonAuthoriativePackets.find(id);
+        if (i == _nonAuthoriativePackets.end()) {
+            LogWarningF("Received a state bundle delta for an unknown bundle. Waiting for the next snapshot");
+            return;
+        }
+
+        _decodeBuffer.resize(size);
+        {
+            auto data = i->second->LockData();
+            if (data.GetTime() != baseTime || data.GetSize() != size) {
+                LogWarningF("State bundle delta doesn't match the current version of the bundle. Waiting for the next snapshot");
+                return;
+            }
+            if (!DeltaDecode(AsPointer(_decodeBuffer.begin()), data.Get(), size, encoded, encodedSize)) {
+                LogWarningF("Invalid state bundle delta");
+                return;
+            }
+        }
+
+        i->second->UpdateAuthority(authority);
+        i->second->UpdateData(AsPointer(_decodeBuffer.cbegin()), size, updateTime);
+    }
+
     void    StateWorld::DestroyBundle   (StateBundleId bundle, MeshNodeId authority)
     {
         auto i = _nonAuthoriativePackets.find(bundle);
@@ -325,6 +804,8 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
     void    StateWorld::Update()
     {
+        FlushPendingUpdates();
+
         const unsigned countdownStart = 60;
 
         static unsigned subscriptionCountdown = countdownStart;
@@ -334,11 +815,11 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
                 //      Make list of subscription suggestions for each observer
                 //
             for (auto i=_observers.begin(); i!=_observers.end(); ++i) {
-                auto suggestions = FindSubscriptionSuggestions(Float3(0.f, 0.f, 0.f), 0, *i);
+                auto suggestions = FindSubscriptionSuggestions(i->_position, i->_area, i->_id);
                 if (!suggestions.empty()) {
                     ContactPacket::SubscriptionSuggestions out;
                     out.Init(AsPointer(suggestions.begin()), suggestions.size());
-                    SendPacket(*i, &out);
+                    SendPacket(i->_id, &out);
                 }
             }
 
@@ -366,17 +847,26 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
             _localObserverPosition  = position;
             _localObserverArea      = observerArea;
         } else {
-            auto i=std::lower_bound(_observers.begin(), _observers.end(), observer);
-            if (i==_observers.end() || *i != observer) {
-                _observers.insert(i, observer);
+            auto i=std::lower_bound(_observers.begin(), _observers.end(), observer,
+                [](const Observer& lhs, MeshNodeId rhs) { return lhs._id < rhs; });
+            if (i==_observers.end() || i->_id != observer) {
+                Observer newObserver;
+                newObserver._id = observer;
+                i = _observers.insert(i, newObserver);
             }
+            i->_position = position;
+            i->_area = observerArea;
         }
     }
 
     StateWorld*  StateWorld::_instance = nullptr;
 
     StateWorld::StateWorld(MeshNodeId localMeshNode)
-    : _localMeshNode(localMeshNode)
+    : _interestGrid(64.f)
+    , _interestRadius(FLT_MAX)
+    , _localMeshNode(localMeshNode)
+    , _deltaCompression(false)
+    , _snapshotInterval(60)
     {
         assert(!_instance);
         _instance = this;
@@ -390,6 +880,67 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         _instance = nullptr;
     }
 
+        ////////////////////////////////////////////////////////////////////////
+
+    void    LoopbackBroadcaster::OnUpdate(  StateBundleId packet, const SubscriptionList& subscription, 
+                                            const void* data, size_t size, StateBundleType packetType, 
+                                            NetworkTime time)
+    {
+        auto& mirror = _mirrors[packet];
+
+        NetworkTime baseTime = 0;
+        auto encodeStart = GetPerformanceCounter();
+        bool isDelta = mirror._baseline.Encode(_encoded, baseTime, data, size, time, _snapshotInterval);
+        auto encodeEnd = GetPerformanceCounter();
+
+        bool success = true;
+        if (isDelta) {
+            success = mirror._time == baseTime && mirror._data.size() == size
+                && DeltaDecode(AsPointer(mirror._data.begin()), AsPointer(mirror._data.cbegin()), size, AsPointer(_encoded.cbegin()), _encoded.size());
+        } else {
+            mirror._data.assign((const uint8*)data, PtrAdd((const uint8*)data, size));
+        }
+        mirror._time = time;
+        auto decodeEnd = GetPerformanceCounter();
+
+        if (!success || mirror._data.size() != size || !std::equal(mirror._data.cbegin(), mirror._data.cend(), (const uint8*)data)) {
+            ++_metrics._mismatchCount;
+        }
+
+        ++_metrics._updateCount;
+        if (isDelta) { ++_metrics._deltaCount; } else { ++_metrics._snapshotCount; }
+        _metrics._rawBytes += size;
+        _metrics._encodedBytes += isDelta ? _encoded.size() : size;
+        _metrics._encodeTime += encodeEnd - encodeStart;
+        _metrics._decodeTime += decodeEnd - encodeEnd;
+    }
+
+    void    LoopbackBroadcaster::OnDestroy(StateBundleId packet, const SubscriptionList& subscription)
+    {
+        _mirrors.erase(packet);
+    }
+
+    void    LoopbackBroadcaster::OnEvent(StateBundleId packet, const SubscriptionList& subscription, const char eventString[]) {}
+    void    LoopbackBroadcaster::OnVisibilityChange(StateBundle& bundle) {}
+    MeshNodeId  LoopbackBroadcaster::LocalMeshNode() const { return _localMeshNode; }
+
+        //  Time is simulated; it just advances by one for every update. This
+        //  makes results repeatable.
+    NetworkTime LoopbackBroadcaster::GetTimeNow() const { return ++_time; }
+
+    void    LoopbackBroadcaster::ResetMetrics()
+    {
+        XlZeroMemory(_metrics);
+    }
+
+    LoopbackBroadcaster::LoopbackBroadcaster(MeshNodeId localMeshNode, unsigned snapshotInterval)
+    : _localMeshNode(localMeshNode), _snapshotInterval(snapshotInterval), _time(0)
+    {
+        XlZeroMemory(_metrics);
+    }
+
+    LoopbackBroadcaster::~LoopbackBroadcaster() {}
+
 }}}
 
 
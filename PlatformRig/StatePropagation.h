@@ -12,6 +12,7 @@
 #include "../Math/Vector.h"
 #include "../Core/Types.h"
 #include <map>
+#include <vector>
 
 namespace PlatformRig { namespace Network { namespace StatePropagation
 {
@@ -22,6 +23,15 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
     public:
         bool    VisibleToObserver(const Float3& observerPosition, VisibilityArea observerArea) const;
 
+            /// <summary>Visibility test with an interest radius</summary>
+            /// Visible if the observer is within "interestRadius" of the transpond
+            /// box (on the XY plane)
+        bool    VisibleToObserver(const Float3& observerPosition, VisibilityArea observerArea, float interestRadius) const;
+
+        bool                                IsActive() const                { return _active; }
+        const std::pair<Float3, Float3>&    GetTranspondPosition() const    { return _transpondPosition; }
+        VisibilityArea                      GetTranspondArea() const        { return _transpondVisibilityArea; }
+
         VisibilityObject();
         VisibilityObject(const std::pair<Float3, Float3>& position, VisibilityArea area);
     private:
@@ -46,6 +56,52 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
         ////////////////////////////////////////////////////////////////////////
 
+    /// <summary>Encode "data" as a difference from "baseline"</summary>
+    /// The encoding is the XOR of the two buffers, with runs of unchanged bytes
+    /// removed. So bundles where only a few fields have changed encode to only
+    /// a few bytes. Returns false if the result won't fit within "dstCapacity".
+    bool    DeltaEncode(
+        void* dst, size_t dstCapacity, size_t& encodedSize,
+        const void* data, const void* baseline, size_t size);
+
+    /// <summary>Reverses DeltaEncode</summary>
+    /// "dst" and "baseline" may be the same buffer. Returns false if the encoded
+    /// data is invalid.
+    bool    DeltaDecode(
+        void* dst, const void* baseline, size_t size,
+        const void* encoded, size_t encodedSize);
+
+    /// <summary>The last version of a state bundle that was sent to subscribers</summary>
+    class DeltaBaseline
+    {
+    public:
+            /// <summary>Encode new data for sending, and make it the new baseline</summary>
+            /// Returns true if "encoded" was filled with a delta against the old baseline
+            /// (whose time is written to "baseTime"). Returns false when the full data should
+            /// be sent instead; that happens when there's no baseline, when the size has
+            /// changed, when the delta is no smaller than the data, or when "snapshotInterval"
+            /// deltas have been sent since the last full snapshot.
+        bool    Encode(
+            std::vector<uint8>& encoded, NetworkTime& baseTime,
+            const void* data, size_t size, NetworkTime time,
+            unsigned snapshotInterval);
+
+        bool                        IsValid() const     { return _valid; }
+        const std::vector<uint8>&   GetData() const     { return _data; }
+        NetworkTime                 GetTime() const     { return _time; }
+
+        DeltaBaseline();
+    private:
+        std::vector<uint8>  _data;
+        NetworkTime         _time;
+        unsigned            _deltasSinceSnapshot;
+        bool                _valid;
+    };
+
+        ////////////////////////////////////////////////////////////////////////
+
+    class StateBundle;
+
     class IStatePacketBroadcaster
     {
     public:
@@ -55,6 +111,7 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         virtual void            OnDestroy(  StateBundleId packet, const SubscriptionList& subscription) = 0;
         virtual void            OnEvent(    StateBundleId packet, const SubscriptionList& subscription, 
                                             const char eventString[]) = 0;
+        virtual void            OnVisibilityChange(StateBundle& bundle) = 0;
         virtual MeshNodeId      LocalMeshNode() const = 0;
         virtual NetworkTime     GetTimeNow() const = 0;
     };
@@ -127,6 +184,55 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
         ////////////////////////////////////////////////////////////////////////
 
+    /// <summary>Uniform grid of state bundles, for finding the bundles near an observer</summary>
+    /// Bundles are placed in every grid cell that their transpond box overlaps (on
+    /// the XY plane). Bundles that cover too many cells are kept in a separate list
+    /// that is checked by every query. Inactive bundles are not in the grid.
+    ///
+    /// Update() should be called whenever the visibility of a bundle changes; it only
+    /// touches the grid cells that have changed.
+    class InterestGrid
+    {
+    public:
+        void    Update(StateBundle& bundle);
+        void    Remove(StateBundleId bundle);
+
+            /// <summary>Find all bundles that might be visible from the given position</summary>
+            /// This is conservative; callers should still use VisibilityObject::VisibleToObserver
+            /// on the result. Results are appended to "result" in an arbitrary order.
+        void    FindBundles(
+            std::vector<StateBundle*>& result, 
+            const Float3& observerPosition, float interestRadius) const;
+
+        InterestGrid(float cellSize);
+        ~InterestGrid();
+    private:
+        class Object
+        {
+        public:
+            StateBundle*    _bundle;
+            Float2          _mins, _maxs;
+            int             _cellMin[2], _cellMax[2];
+            bool            _large;
+            mutable unsigned _queryStamp;
+        };
+        std::vector<Object>                                     _objects;
+        std::vector<unsigned>                                   _freeObjects;
+        std::vector<std::pair<StateBundleId, unsigned>>         _objectLookup;
+        std::vector<std::pair<uint64, std::vector<unsigned>>>   _cells;
+        std::vector<unsigned>                                   _largeObjects;
+        float                                                   _cellSize;
+        mutable unsigned                                        _queryStamp;
+
+        static const unsigned MaxCellsPerObject = 16;
+
+        void    AddToCells(unsigned objectIndex);
+        void    RemoveFromCells(unsigned objectIndex);
+        bool    Overlaps(const Object& obj, const Float3& observerPosition, float interestRadius) const;
+    };
+
+        ////////////////////////////////////////////////////////////////////////
+
     class StateWorld : IStatePacketBroadcaster
     {
     public:
@@ -144,6 +250,23 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
 
         std::shared_ptr<StateBundle>    CreateAuthoritativePacket(size_t size, StateBundleType type);
 
+            /// <summary>Set the distance at which bundles become visible to observers</summary>
+            /// By default the radius is infinite, so that every active bundle is visible
+            /// to every observer.
+        void    SetInterestRadius(float radius);
+
+            /// <summary>Enable delta compressed, batched updates</summary>
+            /// When enabled, updates to authoritative bundles aren't sent immediately.
+            /// Instead they are sent during Update(), with all of the changed bundles for
+            /// each destination in a single StateBundleUpdateBatch packet. Each bundle is
+            /// sent as a delta against the version that was sent previously, with a full
+            /// snapshot every "snapshotInterval" updates.
+        void    SetDeltaCompression(bool enable, unsigned snapshotInterval = 60);
+
+        void    ReceiveBundleDelta(StateBundleId id, const void* encoded, size_t encodedSize, 
+                                   size_t size, StateBundleType type, 
+                                   MeshNodeId authority, NetworkTime updateTime, NetworkTime baseTime);
+
         static StateWorld&              GetInstance() { return *_instance; }
 
         StateWorld(MeshNodeId localMeshNode);
@@ -153,8 +276,24 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         std::map<StateBundleId, std::shared_ptr<StateBundle>>       _authoriativePackets;
         std::map<StateBundleId, std::shared_ptr<StateBundle>>       _nonAuthoriativePackets;
 
-        std::vector<MeshNodeId>     _observers;
+        class Observer
+        {
+        public:
+            MeshNodeId      _id;
+            Float3          _position;
+            VisibilityArea  _area;
+        };
+        std::vector<Observer>       _observers;         // (sorted by id)
+        InterestGrid                _interestGrid;      // (authoritative bundles only)
+        float                       _interestRadius;
         MeshNodeId                  _localMeshNode;
+
+        bool                                    _deltaCompression;
+        unsigned                                _snapshotInterval;
+        std::map<StateBundleId, DeltaBaseline>  _baselines;
+        std::vector<StateBundleId>              _pendingUpdates;    // (sorted)
+        std::vector<uint8>                      _encodeBuffer;
+        std::vector<uint8>                      _decodeBuffer;
         Float3                      _localObserverPosition;
         VisibilityArea              _localObserverArea;
 
@@ -167,17 +306,70 @@ namespace PlatformRig { namespace Network { namespace StatePropagation
         void            OnDestroy(  StateBundleId packet, const SubscriptionList& subscription);
         void            OnEvent(    StateBundleId packet, const SubscriptionList& subscription,
                                     const char eventString[]);
+        void            OnVisibilityChange(StateBundle& bundle);
         MeshNodeId      LocalMeshNode() const;
         NetworkTime     GetTimeNow() const;
 
         std::vector<StateBundleId>      FindSubscriptionSuggestions(
             const Float3& observerPosition, VisibilityArea observerArea, MeshNodeId observer);
 
+        void            FlushPendingUpdates();
+
         static StateWorld*          _instance;
     };
 
         ////////////////////////////////////////////////////////////////////////
 
+    /// <summary>In-process broadcaster, for measuring delta compression</summary>
+    /// Every update is encoded in the same way as StateWorld does with delta compression
+    /// enabled, and then immediately decoded into a local copy of the bundle (which is 
+    /// checked against the original). Nothing is sent over the network. Use this with
+    /// StateBundle::UpdateBroadcaster() to measure the compression ratio and encode/decode
+    /// throughput for real bundle data.
+    class LoopbackBroadcaster : public IStatePacketBroadcaster
+    {
+    public:
+        class Metrics
+        {
+        public:
+            uint64      _updateCount, _deltaCount, _snapshotCount;
+            uint64      _rawBytes, _encodedBytes;
+            uint64      _encodeTime, _decodeTime;       // (in performance counter ticks)
+            unsigned    _mismatchCount;
+        };
+        const Metrics&  GetMetrics() const      { return _metrics; }
+        void            ResetMetrics();
+
+        void            OnUpdate(   StateBundleId packet, const SubscriptionList& subscription, 
+                                    const void* data, size_t size, StateBundleType packetType, 
+                                    NetworkTime time);
+        void            OnDestroy(  StateBundleId packet, const SubscriptionList& subscription);
+        void            OnEvent(    StateBundleId packet, const SubscriptionList& subscription, 
+                                    const char eventString[]);
+        void            OnVisibilityChange(StateBundle& bundle);
+        MeshNodeId      LocalMeshNode() const;
+        NetworkTime     GetTimeNow() const;
+
+        LoopbackBroadcaster(MeshNodeId localMeshNode, unsigned snapshotInterval = 60);
+        ~LoopbackBroadcaster();
+    private:
+        class Mirror
+        {
+        public:
+            DeltaBaseline       _baseline;      // (sender side)
+            std::vector<uint8>  _data;          // (receiver side)
+            NetworkTime         _time;
+        };
+        std::map<StateBundleId, Mirror>     _mirrors;
+        std::vector<uint8>                  _encoded;
+        Metrics                             _metrics;
+        MeshNodeId                          _localMeshNode;
+        unsigned                            _snapshotInterval;
+        mutable NetworkTime                 _time;
+    };
+
+        ////////////////////////////////////////////////////////////////////////
+
 }}}
 
 
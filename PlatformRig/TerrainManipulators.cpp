@@ -182,9 +182,9 @@ namespace Tools
 
             BoundUniforms boundLayout(shaderProgram);
             RenderCore::Techniques::TechniqueContext::BindGlobalUniforms(boundLayout);
-            boundLayout.BindConstantBuffer(Hash64("CircleHighlightParameters"), 0, 1);
-            boundLayout.BindShaderResource(Hash64("DepthTexture"), 0, 1);
-            boundLayout.BindShaderResource(Hash64("HighlightResource"), 1, 1);
+            boundLayout.BindConstantBuffer(ConstExprHash64("CircleHighlightParameters"), 0, 1);
+            boundLayout.BindShaderResource(ConstExprHash64("DepthTexture"), 0, 1);
+            boundLayout.BindShaderResource(ConstExprHash64("HighlightResource"), 1, 1);
 
             context->Bind(shaderProgram);
             boundLayout.Apply(*context, 
@@ -558,9 +558,9 @@ namespace Tools
 
                 BoundUniforms boundLayout(shaderProgram);
                 RenderCore::Techniques::TechniqueContext::BindGlobalUniforms(boundLayout);
-                boundLayout.BindConstantBuffer(Hash64("RectangleHighlightParameters"), 0, 1);
-                boundLayout.BindShaderResource(Hash64("DepthTexture"), 0, 1);
-                boundLayout.BindShaderResource(Hash64("HighlightResource"), 1, 1);
+                boundLayout.BindConstantBuffer(ConstExprHash64("RectangleHighlightParameters"), 0, 1);
+                boundLayout.BindShaderResource(ConstExprHash64("DepthTexture"), 0, 1);
+                boundLayout.BindShaderResource(ConstExprHash64("HighlightResource"), 1, 1);
 
                 context->Bind(shaderProgram);
                 boundLayout.Apply(*context, 
@@ -54,11 +54,30 @@ namespace RenderCore { namespace Assets
             float       _beginTime, _endTime;
         };
 
+            /// <param name="curveKeyHints">Optional array of "curvesCount" key hints (see
+            /// RawAnimationCurve::Calculate). Keep this array with the animation state from frame
+            /// to frame to make key lookups constant time during normal playback.</param>
         TransformationParameterSet  BuildTransformationParameterSet(
                 const AnimationState&           animState,
                 const TransformationMachine&    transformationMachine,
                 const AnimationSetBinding&      binding,
                 const RawAnimationCurve*        curves,
+                size_t                          curvesCount,
+                unsigned*                       curveKeyHints = nullptr) const;
+
+            /// <summary>Build the parameter sets for many instances at once</summary>
+            /// Equivalent to calling BuildTransformationParameterSet() for each animation state,
+            /// but each curve is evaluated for all instances playing the same animation together
+            /// (see RawAnimationCurve::CalculateBatch). "curveKeyHints" is optional; if provided,
+            /// it is an array of "instanceCount" arrays of "curvesCount" key hints.
+        void                    BuildTransformationParameterSets(
+                TransformationParameterSet      results[],
+                const AnimationState            animStates[],
+                unsigned*                       curveKeyHints[],
+                unsigned                        instanceCount,
+                const TransformationMachine&    transformationMachine,
+                const AnimationSetBinding&      binding,
+                const RawAnimationCurve*        curves,
                 size_t                          curvesCount) const;
 
         const AnimationDriver&  GetAnimationDriver(size_t index) const;
@@ -21,6 +21,8 @@
 #include "../Metal/InputLayout.h"
 #include "../Metal/Format.h"
 #include <stdarg.h>
+#include <vector>
+#include <algorithm>
 
 #include "../Techniques/ResourceBox.h"
 #include "../Techniques/Techniques.h"
@@ -96,6 +98,345 @@ namespace RenderCore { namespace Assets
         buffer[std::min(std::max(0,identLevel), signed(bufferSize-1))] = '\0';
     }
 
+    static bool IsAffine(const Float4x4& transform)
+    {
+        return transform(3,0) == 0.f && transform(3,1) == 0.f && transform(3,2) == 0.f && transform(3,3) == 1.f;
+    }
+
+    static Float4x4 CombineAffine(const Float4x4& firstTransform, const Float4x4& secondTransform)
+    {
+            //  Same as Combine(firstTransform, secondTransform), but assumes both inputs have
+            //  a bottom row of (0,0,0,1) -- so we only need to calculate the top 3 rows.
+        Float4x4 result;
+        for (unsigned r=0; r<3; ++r) {
+            for (unsigned c=0; c<4; ++c) {
+                result(r,c) = 
+                      secondTransform(r,0) * firstTransform(0,c)
+                    + secondTransform(r,1) * firstTransform(1,c)
+                    + secondTransform(r,2) * firstTransform(2,c);
+            }
+            result(r,3) += secondTransform(r,3);
+        }
+        result(3,0) = result(3,1) = result(3,2) = 0.f; result(3,3) = 1.f;
+        return result;
+    }
+
+    CompiledTransformationMachine::CompiledTransformationMachine(const uint32* commandStreamBegin, const uint32* commandStreamEnd)
+    {
+            //
+            //      Simulate the stack as we go through the command stream. Each stack
+            //      depth is given a working slot. But a newly pushed transform doesn't 
+            //      get its own value until something modifies it; until then it just
+            //      refers to the slot of its parent (or identity, for the root).
+            //
+        struct StackEntry { uint32 _slot; uint32 _valueSlot; };
+        StackEntry stack[MaxWorkingSlots];
+        unsigned depth = 0;
+        stack[0]._slot = 0;
+        stack[0]._valueSlot = IdentitySlot;
+        _workingSlotCount = 1;
+        _isAffine = true;
+
+        auto addStatic = [this, &stack, &depth](const Float4x4& transform)
+        {
+            auto& top = stack[depth];
+            if (!_operations.empty()) {
+                auto& lastOp = _operations[_operations.size()-1];
+                if (    lastOp._type == TransformStackCommand::TransformFloat4x4_Static
+                    &&  lastOp._dst == top._slot && top._valueSlot == top._slot) {
+                        // fold into the previous static transform
+                    auto& existing = _staticTransforms[lastOp._operand];
+                    existing = Combine(transform, existing);
+                    return;
+                }
+            }
+            Operation op = { TransformStackCommand::TransformFloat4x4_Static, top._slot, top._valueSlot, uint32(_staticTransforms.size()) };
+            _operations.push_back(op);
+            _staticTransforms.push_back(transform);
+            top._valueSlot = top._slot;
+        };
+
+        auto addParameterOp = [this, &stack, &depth](uint32 type, uint32 parameterIndex)
+        {
+            auto& top = stack[depth];
+            Operation op = { type, top._slot, top._valueSlot, parameterIndex };
+            _operations.push_back(op);
+            top._valueSlot = top._slot;
+        };
+
+        for (auto i=commandStreamBegin; i!=commandStreamEnd;) {
+            auto commandIndex = *i++;
+            switch (commandIndex) {
+            case TransformStackCommand::PushLocalToWorld:
+                if ((depth+1) >= MaxWorkingSlots) {
+                    ThrowException(::Exceptions::BasicLabel("Exceeded maximum stack depth in CompiledTransformationMachine"));
+                }
+                stack[depth+1]._slot = depth+1;
+                stack[depth+1]._valueSlot = stack[depth]._valueSlot;
+                ++depth;
+                _workingSlotCount = std::max(_workingSlotCount, depth+1);
+                break;
+
+            case TransformStackCommand::PopLocalToWorld:
+                {
+                    auto popCount = *i++;
+                    if (depth < popCount) {
+                        ThrowException(::Exceptions::BasicLabel("Stack underflow in CompiledTransformationMachine"));
+                    }
+                    depth -= popCount;
+                }
+                break;
+
+            case TransformStackCommand::TransformFloat4x4_Static:
+                addStatic(*reinterpret_cast<const Float4x4*>(AsPointer(i)));
+                i += 16;
+                break;
+
+            case TransformStackCommand::Translate_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(AsFloat3(reinterpret_cast<const float*>(AsPointer(i))), transform);
+                    addStatic(transform);
+                    i += 3;
+                }
+                break;
+
+            case TransformStackCommand::RotateX_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(RotationX(Deg2Rad(*reinterpret_cast<const float*>(AsPointer(i)))), transform);
+                    addStatic(transform);
+                    i++;
+                }
+                break;
+
+            case TransformStackCommand::RotateY_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(RotationY(Deg2Rad(*reinterpret_cast<const float*>(AsPointer(i)))), transform);
+                    addStatic(transform);
+                    i++;
+                }
+                break;
+
+            case TransformStackCommand::RotateZ_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(RotationZ(Deg2Rad(*reinterpret_cast<const float*>(AsPointer(i)))), transform);
+                    addStatic(transform);
+                    i++;
+                }
+                break;
+
+            case TransformStackCommand::Rotate_Static:
+                addStatic(Combine(
+                    MakeRotationMatrix(AsFloat3(reinterpret_cast<const float*>(AsPointer(i))), Deg2Rad(*reinterpret_cast<const float*>(AsPointer(i+3)))),
+                    Identity<Float4x4>()));
+                i += 4;
+                break;
+
+            case TransformStackCommand::UniformScale_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(UniformScale(*reinterpret_cast<const float*>(AsPointer(i))), transform);
+                    addStatic(transform);
+                    i++;
+                }
+                break;
+
+            case TransformStackCommand::ArbitraryScale_Static:
+                {
+                    auto transform = Identity<Float4x4>();
+                    Combine_InPlace(ArbitraryScale(AsFloat3(reinterpret_cast<const float*>(AsPointer(i)))), transform);
+                    addStatic(transform);
+                    i += 3;
+                }
+                break;
+
+            case TransformStackCommand::TransformFloat4x4_Parameter:
+                _isAffine = false;      // (we can't know if the parameter will be affine)
+                addParameterOp(commandIndex, *i++);
+                break;
+
+            case TransformStackCommand::Translate_Parameter:
+            case TransformStackCommand::RotateX_Parameter:
+            case TransformStackCommand::RotateY_Parameter:
+            case TransformStackCommand::RotateZ_Parameter:
+            case TransformStackCommand::Rotate_Parameter:
+            case TransformStackCommand::UniformScale_Parameter:
+            case TransformStackCommand::ArbitraryScale_Parameter:
+                addParameterOp(commandIndex, *i++);
+                break;
+
+            case TransformStackCommand::WriteOutputMatrix:
+                {
+                    Operation op = { TransformStackCommand::WriteOutputMatrix, 0, stack[depth]._valueSlot, *i++ };
+                    _operations.push_back(op);
+                }
+                break;
+            }
+        }
+
+        for (auto i=_staticTransforms.cbegin(); i!=_staticTransforms.cend(); ++i) {
+            _isAffine &= IsAffine(*i);
+        }
+    }
+
+    static const Float4x4 s_identityTransform = Identity<Float4x4>();
+
+    bool CompiledTransformationMachine::ExecuteOperation(
+        const Operation&                    op,
+        Float4x4                            working[],
+        size_t                              workingStride,
+        Float4x4                            result[],
+        size_t                              resultCount,
+        const TransformationParameterSet*   parameterSet) const
+    {
+            //  Apply a single operation to the working transforms of one instance.
+            //  Working slot "n" is at working[n*workingStride], so the same code
+            //  works for GenerateOutputTransforms() (stride 1) and for the batched
+            //  version (where the slots of all instances are interleaved)
+        const auto& src = (op._src == IdentitySlot) ? s_identityTransform : working[op._src*workingStride];
+
+        if (op._type == TransformStackCommand::WriteOutputMatrix) {
+            if (op._operand >= resultCount) return false;
+            result[op._operand] = src;
+            return true;
+        }
+
+        auto& dst = working[op._dst*workingStride];
+        if (op._type == TransformStackCommand::TransformFloat4x4_Static) {
+            const auto& transform = _staticTransforms[op._operand];
+            if (op._src == IdentitySlot) {
+                dst = transform;
+            } else if (_isAffine) {
+                dst = CombineAffine(transform, src);
+            } else {
+                dst = Combine(transform, src);
+            }
+            return true;
+        }
+
+            // (all of the remaining operations are parameter operations that modify dst in-place)
+        if (&dst != &src) { dst = src; }
+        if (!parameterSet) return false;
+
+        auto parameterIndex = op._operand;
+        switch (op._type) {
+        case TransformStackCommand::TransformFloat4x4_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat4x4ParametersCount()) return false;
+            dst = Combine(parameterSet->GetFloat4x4Parameters()[parameterIndex], dst);
+            break;
+
+        case TransformStackCommand::Translate_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat3ParametersCount()) return false;
+            Combine_InPlace(parameterSet->GetFloat3Parameters()[parameterIndex], dst);
+            break;
+
+        case TransformStackCommand::RotateX_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat1ParametersCount()) return false;
+            Combine_InPlace(RotationX(Deg2Rad(parameterSet->GetFloat1Parameters()[parameterIndex])), dst);
+            break;
+
+        case TransformStackCommand::RotateY_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat1ParametersCount()) return false;
+            Combine_InPlace(RotationY(Deg2Rad(parameterSet->GetFloat1Parameters()[parameterIndex])), dst);
+            break;
+
+        case TransformStackCommand::RotateZ_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat1ParametersCount()) return false;
+            Combine_InPlace(RotationZ(Deg2Rad(parameterSet->GetFloat1Parameters()[parameterIndex])), dst);
+            break;
+
+        case TransformStackCommand::Rotate_Parameter:
+            {
+                if (parameterIndex >= parameterSet->GetFloat4ParametersCount()) return false;
+                const auto& p = parameterSet->GetFloat4Parameters()[parameterIndex];
+                dst = Combine(MakeRotationMatrix(Truncate(p), Deg2Rad(p[3])), dst);
+            }
+            break;
+
+        case TransformStackCommand::UniformScale_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat1ParametersCount()) return false;
+            Combine_InPlace(UniformScale(parameterSet->GetFloat1Parameters()[parameterIndex]), dst);
+            break;
+
+        case TransformStackCommand::ArbitraryScale_Parameter:
+            if (parameterIndex >= parameterSet->GetFloat3ParametersCount()) return false;
+            Combine_InPlace(ArbitraryScale(parameterSet->GetFloat3Parameters()[parameterIndex]), dst);
+            break;
+        }
+        return true;
+    }
+
+    static void LogBadOperation(uint32 type, uint32 operand)
+    {
+        if (type == TransformStackCommand::WriteOutputMatrix) {
+            LogWarning << "Warning -- bad output matrix index (" << operand << ")";
+        } else {
+            LogWarning << "Warning -- bad parameter index for transformation command (" << type << ", " << operand << ")";
+        }
+    }
+
+    void CompiledTransformationMachine::GenerateOutputTransforms(
+        Float4x4                            result[],
+        size_t                              resultCount,
+        const TransformationParameterSet*   parameterSet) const
+    {
+        Float4x4 working[MaxWorkingSlots]; // (fairly large space on the stack)
+        for (auto i=_operations.cbegin(); i!=_operations.cend(); ++i) {
+            if (!ExecuteOperation(*i, working, 1, result, resultCount, parameterSet)) {
+                LogBadOperation(i->_type, i->_operand);
+            }
+        }
+    }
+
+    void CompiledTransformationMachine::GenerateOutputTransformsBatch(
+        Float4x4*                           result[],
+        size_t                              resultCount,
+        const TransformationParameterSet    parameterSets[],
+        unsigned                            instanceCount) const
+    {
+        if (!instanceCount) return;
+
+            //  The working slots are stored as [slot][instance], so each operation
+            //  touches a contiguous run of "instanceCount" matrices.
+        std::vector<Float4x4> working(std::max(_workingSlotCount, 1u) * instanceCount);
+        for (auto i=_operations.cbegin(); i!=_operations.cend(); ++i) {
+            bool good = true;
+            for (unsigned c=0; c<instanceCount; ++c) {
+                good &= ExecuteOperation(*i, &working[c], instanceCount, result[c], resultCount, &parameterSets[c]);
+            }
+            if (!good) {
+                LogBadOperation(i->_type, i->_operand);
+            }
+        }
+    }
+
+    CompiledTransformationMachine::CompiledTransformationMachine()
+    {
+        _workingSlotCount = 0;
+        _isAffine = true;
+    }
+
+    CompiledTransformationMachine::CompiledTransformationMachine(CompiledTransformationMachine&& moveFrom)
+    : _operations(std::move(moveFrom._operations))
+    , _staticTransforms(std::move(moveFrom._staticTransforms))
+    , _workingSlotCount(moveFrom._workingSlotCount)
+    , _isAffine(moveFrom._isAffine)
+    {}
+
+    CompiledTransformationMachine& CompiledTransformationMachine::operator=(CompiledTransformationMachine&& moveFrom)
+    {
+        _operations = std::move(moveFrom._operations);
+        _staticTransforms = std::move(moveFrom._staticTransforms);
+        _workingSlotCount = moveFrom._workingSlotCount;
+        _isAffine = moveFrom._isAffine;
+        return *this;
+    }
+
+    CompiledTransformationMachine::~CompiledTransformationMachine() {}
+
     void TraceTransformationMachine(
             Utility::OutputStream&      outputStream,
             const uint32*               commandStreamBegin,
@@ -175,5 +175,8 @@ namespace RenderCore { namespace Assets
     static const uint64 ChunkType_ModelScaffoldLargeBlocks = ConstHash64<'Mode', 'lSca', 'fold', 'Larg'>::Value;
     static const uint64 ChunkType_AnimationSet = ConstHash64<'Anim', 'Set'>::Value;
     static const uint64 ChunkType_Skeleton = ConstHash64<'Skel', 'eton'>::Value;
+
+        //  version 1 -- ParameterBox hash values changed to the order independent scheme
+    static const unsigned ModelScaffoldVersion = 1;
 }}
 
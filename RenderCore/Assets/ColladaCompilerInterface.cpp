@@ -58,10 +58,11 @@ namespace RenderCore { namespace Assets
 
         XlZeroMemory(header);
         header._magic = MagicHeader;
-        header._fileVersionNumber = 0;
+        header._fileVersionNumber = ChunkFileVersion;
         XlCopyString(header._buildVersion, dimof(header._buildVersion), versionInfo.first);
         XlCopyString(header._buildDate, dimof(header._buildDate), versionInfo.second);
         header._chunkCount = chunks.second;
+        header._hashFamily = HashFamily_Active;
             
         BasicFile outputFile(destinationFilename, "wb");
         outputFile.Write(&header, sizeof(header), 1);
@@ -32,6 +32,8 @@
 #include "../../Utility/PtrUtils.h"
 #include "../../Utility/Streams/FileUtils.h"
 #include "../../Utility/IteratorUtils.h"
+#include "../../Utility/MemoryUtils.h"
+#include "../../Utility/Threading/ThreadingUtils.h"
 #include "../../Math/Transformations.h"
 #include "../../ConsoleRig/Console.h"
 
@@ -208,8 +210,8 @@ namespace RenderCore { namespace Assets
             return result;
         }
 
-        static const auto DefaultNormalsTextureBindingHash = Hash64("NormalsTexture");
-        static const auto DefaultParametersTextureBindingHash = Hash64("ParametersTexture");
+        static const auto DefaultNormalsTextureBindingHash = ConstExprHash64("NormalsTexture");
+        static const auto DefaultParametersTextureBindingHash = ConstExprHash64("ParametersTexture");
 
         static std::vector<std::pair<unsigned, SubMatResources>> BuildMaterialResources(
             const ModelScaffold& scaffold, SharedStateSet& sharedStateSet, unsigned levelOfDetail,
@@ -402,6 +404,51 @@ namespace RenderCore { namespace Assets
         return vertexElementCount;
     }
 
+        //  Renderer sort ids must fit in 16 bits of the draw call sort key (see
+        //  MakeDrawCallSortKey), so they are recycled when a renderer is destroyed.
+        //  That way the id range is bounded by the number of live renderers, rather
+        //  than the number ever created.
+        //  The allocated ids are tracked in a bit field of plain integers, so there's
+        //  no static construction or destruction order to worry about (renderers may
+        //  be destroyed very late during shutdown).
+    static Interlocked::Value s_rendererSortIdBits[0x10000/32];
+
+    static unsigned AllocateRendererSortId()
+    {
+        for (unsigned w=0; w<dimof(s_rendererSortIdBits); ++w) {
+            for (;;) {
+                auto oldBits = uint32(Interlocked::Load(&s_rendererSortIdBits[w]));
+                if (oldBits == 0xffffffff) break;
+                unsigned bit = 0;
+                while (oldBits & (1u<<bit)) ++bit;
+                auto newBits = oldBits | (1u<<bit);
+                if (uint32(Interlocked::CompareExchange(&s_rendererSortIdBits[w], Interlocked::Value(newBits), Interlocked::Value(oldBits))) == oldBits) {
+                    return w*32+bit;
+                }
+            }
+        }
+
+            //  More than 65536 live renderers. Sharing an id only affects the sorting
+            //  (not correctness), so fall back to an id that is never released (it
+            //  will be masked to 0xffff in the sort key).
+        assert(0);
+        return ~0u;
+    }
+
+    static void ReleaseRendererSortId(unsigned sortId)
+    {
+        if (sortId == ~0u) return;
+        auto& word = s_rendererSortIdBits[sortId/32];
+        auto mask = 1u<<(sortId%32);
+        for (;;) {
+            auto oldBits = uint32(Interlocked::Load(&word));
+            assert(oldBits & mask);
+            if (uint32(Interlocked::CompareExchange(&word, Interlocked::Value(oldBits & ~mask), Interlocked::Value(oldBits))) == oldBits) {
+                break;
+            }
+        }
+    }
+
     ModelRenderer::ModelRenderer(
         const ModelScaffold& scaffold, SharedStateSet& sharedStateSet, 
         const ::Assets::DirectorySearchRules* searchRules, unsigned levelOfDetail)
@@ -605,6 +652,16 @@ namespace RenderCore { namespace Assets
 
             ////////////////////////////////////////////////////////////////////////
 
+            //  Find the mesh for each draw call now, so that Prepare() doesn't have to search for it
+        std::vector<unsigned> drawCallMeshIndices;
+        drawCallMeshIndices.reserve(drawCalls.size());
+        for (auto d=drawCalls.cbegin(); d!=drawCalls.cend(); ++d) {
+            auto geoId = cmdStream.GetGeoCall(d->first)._geoId;
+            auto mesh = FindIf(meshes, [=](const Pimpl::Mesh& mesh) { return mesh._id == geoId; });
+            assert(mesh != meshes.end());
+            drawCallMeshIndices.push_back(unsigned(std::distance(meshes.begin(), mesh)));
+        }
+
         auto pimpl = std::make_unique<Pimpl>();
 
         pimpl->_vertexBuffer = std::move(vb);
@@ -614,6 +671,7 @@ namespace RenderCore { namespace Assets
         pimpl->_skinnedBindings = std::move(skinnedBindings);
 
         pimpl->_drawCalls = std::move(drawCalls);
+        pimpl->_drawCallMeshIndices = std::move(drawCallMeshIndices);
         pimpl->_drawCallRes = std::move(drawCallRes);
         pimpl->_skinnedDrawCalls = std::move(skinnedDrawCalls);
 
@@ -623,6 +681,7 @@ namespace RenderCore { namespace Assets
 
         pimpl->_scaffold = &scaffold;
         pimpl->_levelOfDetail = levelOfDetail;
+        pimpl->_sortId = AllocateRendererSortId();
         
         #if defined(_DEBUG)
             pimpl->_vbSize = nascentVB.size();
@@ -636,7 +695,11 @@ namespace RenderCore { namespace Assets
     }
 
     ModelRenderer::~ModelRenderer()
-    {}
+    {
+        if (_pimpl) {
+            ReleaseRendererSortId(_pimpl->_sortId);
+        }
+    }
 
     
 
@@ -1000,84 +1063,172 @@ namespace RenderCore { namespace Assets
     class ModelRenderer::SortedModelDrawCalls::Entry
     {
     public:
-        unsigned        _shaderVariationHash;
-
-        ModelRenderer*  _renderer;
-        unsigned        _drawCallIndex;
-        Float4x4        _meshToWorld;
+        const ModelRenderer*    _renderer;
+        unsigned                _drawCallIndex;
+        unsigned                _shaderVariationHash;
 
         unsigned        _indexCount, _firstIndex, _firstVertex;
         Topology        _topology;
         
-        ModelRenderer::Pimpl::Mesh* _mesh;
+        const ModelRenderer::Pimpl::Mesh* _mesh;
     };
 
+        //  The sort key packs the draw call ordering into a single integer:
+        //      bits 32-63: shader variation hash
+        //      bits 16-31: renderer sort id
+        //      bits 10-15: mesh index (within the renderer)
+        //      bits 0-9:   draw call index (within the renderer)
+        //  Models with more meshes or draw calls than that are still valid. Their
+        //  indices are masked to fit the fields, so different draw calls from the
+        //  same renderer and shader variation can end up with the same key.
+        //  Those draw calls are then left in submission order (the sort is stable),
+        //  and may be interleaved with draw calls from other meshes of the same
+        //  renderer. That costs redundant state changes, but still renders correctly,
+        //  because RenderPrepared() checks for state changes on every draw call.
+    class ModelRenderer::SortedModelDrawCalls::SortKey
+    {
+    public:
+        uint64      _key;
+        unsigned    _entryIndex;
+    };
+
+    static uint64 MakeDrawCallSortKey(
+        unsigned shaderVariationHash, unsigned rendererSortId, 
+        unsigned meshIndex, unsigned drawCallIndex)
+    {
+        return (uint64(shaderVariationHash) << 32ull)
+            | (uint64(rendererSortId & 0xffff) << 16ull)
+            | uint64((meshIndex & 0x3f) << 10)
+            | uint64(drawCallIndex & 0x3ff);
+    }
+
+        //  Stable LSD radix sort on the 64 bit keys, using 8 bit digits. Passes
+        //  where every key shares the same digit are skipped (common for the renderer
+        //  and mesh fields). The result ends up in "keys" ("scratch" is clobbered)
+    static void RadixSortDrawCalls(
+        std::vector<ModelRenderer::SortedModelDrawCalls::SortKey>& keys,
+        std::vector<ModelRenderer::SortedModelDrawCalls::SortKey>& scratch)
+    {
+        const size_t count = keys.size();
+        if (count < 2) return;
+        scratch.resize(count);
+
+        const unsigned digitCount = 8;
+        unsigned histograms[digitCount][256];
+        XlZeroMemory(histograms);
+        for (size_t c=0; c<count; ++c) {
+            auto key = keys[c]._key;
+            for (unsigned d=0; d<digitCount; ++d)
+                ++histograms[d][unsigned(key >> (d*8)) & 0xff];
+        }
+
+        auto* src = AsPointer(keys.begin());
+        auto* dst = AsPointer(scratch.begin());
+        for (unsigned d=0; d<digitCount; ++d) {
+            auto* histogram = histograms[d];
+            auto firstDigit = unsigned(src[0]._key >> (d*8)) & 0xff;
+            if (histogram[firstDigit] == count) continue;
+
+            unsigned offset = 0;
+            for (unsigned b=0; b<256; ++b) {
+                auto t = histogram[b];
+                histogram[b] = offset;
+                offset += t;
+            }
+
+            for (size_t c=0; c<count; ++c) {
+                auto digit = unsigned(src[c]._key >> (d*8)) & 0xff;
+                dst[histogram[digit]++] = src[c];
+            }
+            std::swap(src, dst);
+        }
+
+        if (src != AsPointer(keys.begin()))
+            keys.swap(scratch);
+    }
+
     void ModelRenderer::SortedModelDrawCalls::Reset() 
     {
         _entries.erase(_entries.begin(), _entries.end());
+        _meshToWorlds.erase(_meshToWorlds.begin(), _meshToWorlds.end());
+        _sortKeys.erase(_sortKeys.begin(), _sortKeys.end());
     }
 
     ModelRenderer::SortedModelDrawCalls::SortedModelDrawCalls() 
     {
         _entries.reserve(10*1000);
+        _meshToWorlds.reserve(10*1000);
+        _sortKeys.reserve(10*1000);
     }
 
     ModelRenderer::SortedModelDrawCalls::~SortedModelDrawCalls() {}
 
-    bool CompareDrawCall(const ModelRenderer::SortedModelDrawCalls::Entry& lhs, const ModelRenderer::SortedModelDrawCalls::Entry& rhs)
+    void ModelRenderer::SortedModelDrawCalls::Merge(SortedModelDrawCalls& source)
     {
-        if (lhs._shaderVariationHash == rhs._shaderVariationHash) {
-            if (lhs._renderer == rhs._renderer) {
-                if (lhs._mesh == rhs._mesh) {
-                    return lhs._drawCallIndex < rhs._drawCallIndex;
-                }
-                return lhs._mesh < rhs._mesh;
-            }
-            return lhs._renderer < rhs._renderer;
+        auto baseIndex = unsigned(_entries.size());
+        _entries.insert(_entries.end(), source._entries.cbegin(), source._entries.cend());
+        _meshToWorlds.insert(_meshToWorlds.end(), source._meshToWorlds.cbegin(), source._meshToWorlds.cend());
+
+        _sortKeys.reserve(_sortKeys.size() + source._sortKeys.size());
+        for (auto i=source._sortKeys.cbegin(); i!=source._sortKeys.cend(); ++i) {
+            SortKey key = *i;
+            key._entryIndex += baseIndex;
+            _sortKeys.push_back(key);
         }
-        return lhs._shaderVariationHash < rhs._shaderVariationHash; 
+
+        source.Reset();
     }
 
     void    ModelRenderer::Prepare(
         SortedModelDrawCalls& dest, 
         const SharedStateSet& sharedStateSet, 
         const Float4x4& modelToWorld,
-        const MeshToModel* transforms)
+        const MeshToModel* transforms) const
     {
             //  After culling; submit all of the draw-calls in this mesh to a list to be sorted
             //  Note -- only unskinned geometry supported currently. In theory, we might be able
             //          to do the same with skinned geometry (at least, when not using the "prepare" step
-        unsigned drawCallIndex = 0;
-        for (auto md=_pimpl->_drawCalls.cbegin(); md!=_pimpl->_drawCalls.cend(); ++md, ++drawCallIndex) {
+            //
+            //  This only reads from the renderer, so it's safe to prepare the same renderer
+            //  from multiple threads at the same time (so long as each thread has its own "dest")
+        auto& cmdStream = _pimpl->_scaffold->CommandStream();
+        auto drawCallCount = unsigned(_pimpl->_drawCalls.size());
+        for (unsigned drawCallIndex=0; drawCallIndex<drawCallCount; ++drawCallIndex) {
+            const auto& md = _pimpl->_drawCalls[drawCallIndex];
             const auto& drawCallRes = _pimpl->_drawCallRes[drawCallIndex];
-            const auto& d = md->second;
+            const auto& d = md.second;
+            auto meshIndex = _pimpl->_drawCallMeshIndices[drawCallIndex];
+            auto& mesh = _pimpl->_meshes[meshIndex];
 
             auto geoParamIndex = drawCallRes._geoParamBox;
             auto matParamIndex = drawCallRes._materialParamBox;
             auto shaderNameIndex = drawCallRes._shaderName;
-
-            auto& cmdStream = _pimpl->_scaffold->CommandStream();
-            auto& geoCall = cmdStream.GetGeoCall(md->first);
-            auto mesh = FindIf(_pimpl->_meshes, [=](const Pimpl::Mesh& mesh) { return mesh._id == geoCall._geoId; });
-            assert(mesh != _pimpl->_meshes.end());
-
-            unsigned techniqueInterface = mesh->_techniqueInterface;
+            unsigned techniqueInterface = mesh._techniqueInterface;
 
             SortedModelDrawCalls::Entry entry;
             entry._drawCallIndex = drawCallIndex;
             entry._renderer = this;
-            if (transforms) {
-                entry._meshToWorld = Combine(transforms->GetMeshToModel(geoCall._transformMarker), modelToWorld);
-            } else {
-                entry._meshToWorld = modelToWorld;
-            }
             entry._shaderVariationHash = techniqueInterface ^ (geoParamIndex << 12) ^ (matParamIndex << 15) ^ (shaderNameIndex << 24);  // simple hash of these indices. Note that collisions might be possible
             entry._indexCount = d._indexCount;
             entry._firstIndex = d._firstIndex;
             entry._firstVertex = d._firstVertex;
             entry._topology = d._topology;
-            entry._mesh = AsPointer(mesh);
+            entry._mesh = &mesh;
+
+            SortedModelDrawCalls::SortKey sortKey;
+            sortKey._key = MakeDrawCallSortKey(
+                entry._shaderVariationHash, _pimpl->_sortId, 
+                meshIndex, drawCallIndex);
+            sortKey._entryIndex = unsigned(dest._entries.size());
+
             dest._entries.push_back(entry);
+            dest._sortKeys.push_back(sortKey);
+            if (transforms) {
+                auto& geoCall = cmdStream.GetGeoCall(md.first);
+                dest._meshToWorlds.push_back(Combine(transforms->GetMeshToModel(geoCall._transformMarker), modelToWorld));
+            } else {
+                dest._meshToWorlds.push_back(modelToWorld);
+            }
         }
     }
 
@@ -1094,7 +1245,7 @@ namespace RenderCore { namespace Assets
         Metal::ConstantBuffer& localTransformBuffer = Techniques::CommonResources()._localTransformBuffer;
         const Metal::ConstantBuffer* pkts[] = { &localTransformBuffer, nullptr };
 
-        std::sort(drawCalls._entries.begin(), drawCalls._entries.end(), CompareDrawCall);
+        RadixSortDrawCalls(drawCalls._sortKeys, drawCalls._sortScratch);
 
         const ModelRenderer::Pimpl::Mesh* currentMesh = nullptr;
         RenderCore::Metal::BoundUniforms* boundUniforms = nullptr;
@@ -1102,7 +1253,8 @@ namespace RenderCore { namespace Assets
         unsigned currentTextureSet = ~unsigned(0x0);
         unsigned currentConstantBufferIndex = ~unsigned(0x0);
 
-        for (auto d=drawCalls._entries.cbegin(); d!=drawCalls._entries.cend(); ++d) {
+        for (auto k=drawCalls._sortKeys.cbegin(); k!=drawCalls._sortKeys.cend(); ++k) {
+            auto* d = &drawCalls._entries[k->_entryIndex];
             auto& renderer = *d->_renderer;
             const auto& drawCallRes = renderer._pimpl->_drawCallRes[d->_drawCallIndex];
 
@@ -1133,7 +1285,7 @@ namespace RenderCore { namespace Assets
                 HRESULT hresult = context._context->GetUnderlying()->Map(
                     localTransformBuffer.GetUnderlying(), 0, D3D11_MAP_WRITE_DISCARD, 0, &result);
                 assert(SUCCEEDED(hresult) && result.pData); (void)hresult;
-                CopyTransform(((Techniques::LocalTransformConstants*)result.pData)->_localToWorld, d->_meshToWorld);
+                CopyTransform(((Techniques::LocalTransformConstants*)result.pData)->_localToWorld, drawCalls._meshToWorlds[k->_entryIndex]);
                 context._context->GetUnderlying()->Unmap(localTransformBuffer.GetUnderlying(), 0);
             }
             
@@ -1383,7 +1535,7 @@ namespace RenderCore { namespace Assets
             throw ::Assets::Exceptions::FormatError("Missing model scaffold chunks: %s", filename);
         }
 
-        if (scaffoldChunk._chunkVersion != 0) {
+        if (scaffoldChunk._chunkVersion != ModelScaffoldVersion) {
             throw ::Assets::Exceptions::FormatError("Incorrect file version: %s", filename);
         }
 
@@ -148,16 +148,30 @@ namespace RenderCore { namespace Assets
         {
         public:
             class Entry;
-            std::vector<Entry> _entries;
+            class SortKey;
+            std::vector<Entry>      _entries;       ///< draw call state, in the order it was prepared
+            std::vector<Float4x4>   _meshToWorlds;  ///< transform for each entry in _entries (kept out of the sorted data)
+            std::vector<SortKey>    _sortKeys;      ///< packed sort key + entry index for each entry
+            std::vector<SortKey>    _sortScratch;
             SortedModelDrawCalls();
             ~SortedModelDrawCalls();
             void Reset();
+
+                /// <summary>Moves all of the draw calls in "source" into this list</summary>
+                /// Use this to combine lists that were filled by Prepare() on
+                /// different threads, before calling RenderPrepared(). "source" is reset.
+            void Merge(SortedModelDrawCalls& source);
         };
+
+            /// <summary>Adds the draw calls for this model to a list, to be sorted and rendered later</summary>
+            /// Prepare() doesn't modify the renderer, so different threads can prepare
+            /// at the same time, so long as each thread writes to its own SortedModelDrawCalls.
+            /// Use SortedModelDrawCalls::Merge() to combine the results before RenderPrepared().
         void Prepare(
             SortedModelDrawCalls& dest, 
             const SharedStateSet& sharedStateSet, 
             const Float4x4& modelToWorld,
-            const MeshToModel*  transforms = nullptr);
+            const MeshToModel*  transforms = nullptr) const;
         static void RenderPrepared(
             const Context&          context,
             SortedModelDrawCalls&   drawCalls);
@@ -170,6 +184,7 @@ namespace RenderCore { namespace Assets
             Metal::VertexBuffer         _skinningBuffer;
             AnimationState              _animState;
             std::vector<unsigned>       _vbOffsets;
+            std::vector<unsigned>       _curveKeyHints;     ///< per-curve key cursors (see RawAnimationCurve::Calculate)
 
             PreparedAnimation();
             PreparedAnimation(PreparedAnimation&&);
@@ -315,6 +330,14 @@ namespace RenderCore { namespace Assets
     public:
         void PrepareAnimation(  Metal::DeviceContext* context, 
                                 ModelRenderer::PreparedAnimation& state) const;
+
+            /// <summary>Prepare the animation for many instances of this model at once</summary>
+            /// Produces the same results as calling PrepareAnimation() for each state, but
+            /// the animation curves are evaluated for all instances together, and each
+            /// operation of the compiled skeleton is applied to every instance in turn.
+            /// Prefer this when many characters share the same skeleton and animation set.
+        void PrepareAnimationBatch( Metal::DeviceContext* context, 
+                                    ModelRenderer::PreparedAnimation* states[], unsigned stateCount) const;
         const SkeletonBinding& GetSkeletonBinding() const;
         unsigned GetSkeletonOutputCount() const;
 
@@ -196,6 +196,11 @@ namespace RenderCore { namespace Assets
                                             DebugIterator*  debugIterator,
                                             const void*     iteratorUserData) const;
 
+            /// <summary>Compile the command stream into a flat list of operations</summary>
+            /// The compiled form is faster to evaluate, but must be stored separately from
+            /// the transformation machine itself. See CompiledTransformationMachine.
+        CompiledTransformationMachine Compile() const;
+
         class InputInterface
         {
         public:
@@ -353,10 +358,12 @@ namespace RenderCore { namespace Assets
         ///////////////////////////////////////////////////////////////////////////////
         typedef std::pair<unsigned, DrawCallDesc> MeshAndDrawCall;
         std::vector<MeshAndDrawCall>    _drawCalls;
+        std::vector<unsigned>           _drawCallMeshIndices;   ///< index into _meshes for each entry in _drawCalls
         std::vector<MeshAndDrawCall>    _skinnedDrawCalls;
 
         const ModelScaffold*  _scaffold;
         unsigned        _levelOfDetail;
+        unsigned        _sortId;        ///< small id used to group draw calls from this renderer in SortedModelDrawCalls
 
         ///////////////////////////////////////////////////////////////////////////////
         #if defined(_DEBUG)
@@ -366,7 +373,7 @@ namespace RenderCore { namespace Assets
         #endif
 
         ///////////////////////////////////////////////////////////////////////////////
-        Pimpl() : _scaffold(nullptr), _levelOfDetail(~unsigned(0x0)) {}
+        Pimpl() : _scaffold(nullptr), _levelOfDetail(~unsigned(0x0)), _sortId(0) {}
         ~Pimpl() {}
 
         Metal::BoundUniforms* BeginVariation(
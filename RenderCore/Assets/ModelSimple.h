@@ -236,6 +236,7 @@ namespace RenderCore { namespace Assets { namespace Simple
             SortedModelDrawCalls();
             ~SortedModelDrawCalls();
             void Reset();
+            void Merge(SortedModelDrawCalls& source);
         };
         void    Prepare(SortedModelDrawCalls& dest, const SharedStateSet& sharedStateSet, const Float4x4& modelToWorld);
         static void RenderPrepared(
@@ -186,6 +186,12 @@ namespace RenderCore { namespace Assets { namespace Simple
         _entries.erase(_entries.begin(), _entries.end());
     }
 
+    void ModelRenderer::SortedModelDrawCalls::Merge(SortedModelDrawCalls& source)
+    {
+        _entries.insert(_entries.end(), source._entries.cbegin(), source._entries.cend());
+        source.Reset();
+    }
+
     ModelRenderer::SortedModelDrawCalls::SortedModelDrawCalls() 
     {
         _entries.reserve(10*1000);
@@ -336,7 +342,7 @@ namespace RenderCore { namespace Assets { namespace Simple
     }
 
     static std::string InvalidShaderName = "invalid";
-    static const uint64 BindNormals = Hash64("NormalsTexture");
+    static const uint64 BindNormals = ConstExprHash64("NormalsTexture");
                                 
     ModelRenderer::ModelRenderer(
         ModelScaffold& scaffold, MaterialScaffold& material, 
@@ -7,9 +7,11 @@
 #define _SCL_SECURE_NO_WARNINGS
 
 #include "RawAnimationCurve.h"
+#include "../../Math/Math.h"
 #include "../../Math/Matrix.h"
 #include "../../Math/Interpolation.h"
 #include "../../Core/Exceptions.h"
+#include <algorithm>
 
 namespace RenderCore { namespace Assets
 {
@@ -24,27 +26,62 @@ namespace RenderCore { namespace Assets
         return (input - A) / (B-A);
     }
 
+    unsigned    RawAnimationCurve::FindKey(float inputTime, unsigned keyHint) const never_throws
+    {
+            //  Find the key "c", such that _timeMarkers[c] <= inputTime < _timeMarkers[c+1]
+            //  The caller must have already clamped inputTime to the range of the curve.
+            //  First check the hint key (and the one after it), because normal playback
+            //  moves forward through the curve in small steps.
+        assert(_keyCount >= 2);
+            //  (compare against _keyCount-1 and _keyCount-2, rather than adding to
+            //  keyHint, so that any hint value is safe -- even ~0u)
+        if (keyHint < (_keyCount-1) && _timeMarkers[keyHint] <= inputTime) {
+            if (inputTime < _timeMarkers[keyHint+1]) {
+                return keyHint;
+            }
+            if (keyHint < (_keyCount-2) && inputTime < _timeMarkers[keyHint+2]) {
+                return keyHint+1;
+            }
+        }
+
+        auto* i = std::upper_bound(&_timeMarkers[1], &_timeMarkers[_keyCount-1], inputTime);
+        return unsigned(i - &_timeMarkers[1]);
+    }
+
     template<typename OutType>
         OutType        RawAnimationCurve::Calculate(float inputTime) const never_throws
+    {
+        unsigned keyHint = 0;
+        return Calculate<OutType>(inputTime, keyHint);
+    }
+
+    template<typename OutType>
+        OutType        RawAnimationCurve::Calculate(float inputTime, unsigned& keyHint) const never_throws
     {
         assert(_positionFormat == ExpectedFormat<OutType>());
 
             // note -- clamping at start and end positions of the curve
-        if (inputTime < _timeMarkers[0])
+        if (inputTime < _timeMarkers[0]) {
+            keyHint = 0;
             return *(OutType*)_parameterData.get();
+        }
 
-        if (_interpolationType == Linear) {
+        if (inputTime >= _timeMarkers[_keyCount-1]) {
+            keyHint = unsigned(_keyCount-1);
+            return *(OutType*)PtrAdd(_parameterData.get(), (_keyCount-1) * _elementSize );
+        }
 
-            for (unsigned c=0; c<(_keyCount-1); ++c) {
-                if (inputTime < _timeMarkers[c+1]) {
-                    assert(_timeMarkers[c+1] > _timeMarkers[c]);
-                    float alpha = LerpParameter(_timeMarkers[c], _timeMarkers[c+1], inputTime);
+        unsigned c = FindKey(inputTime, keyHint);
+        keyHint = c;
+        assert(c < (_keyCount-1));
+        assert(_timeMarkers[c+1] > _timeMarkers[c]);
 
-                    const OutType& P0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize);
-                    const OutType& P1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize);
-                    return SphericalInterpolate(P0, P1, alpha);
-                }
-            }
+        if (_interpolationType == Linear) {
+
+            float alpha = LerpParameter(_timeMarkers[c], _timeMarkers[c+1], inputTime);
+            const OutType& P0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize);
+            const OutType& P1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize);
+            return SphericalInterpolate(P0, P1, alpha);
 
         } else if (_interpolationType == Bezier || _interpolationType == Hermite) {
 
@@ -56,20 +93,15 @@ namespace RenderCore { namespace Assets
 
             if (_interpolationType == Bezier) {
 
-                for (unsigned c=0; c<(_keyCount-1); ++c) {
-                    if (inputTime < _timeMarkers[c+1]) {
-                        assert(_timeMarkers[c+1] > _timeMarkers[c]);
-                        float alpha = LerpParameter(_timeMarkers[c], _timeMarkers[c+1], inputTime);
+                float alpha = LerpParameter(_timeMarkers[c], _timeMarkers[c+1], inputTime);
 
-                        const OutType& P0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize);
-                        const OutType& P1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize);
+                const OutType& P0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize);
+                const OutType& P1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize);
 
-                        const OutType& C0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize + outTangentOffset);
-                        const OutType& C1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize + inTangentOffset);
+                const OutType& C0 = *(const OutType*)PtrAdd(_parameterData.get(), c * _elementSize + outTangentOffset);
+                const OutType& C1 = *(const OutType*)PtrAdd(_parameterData.get(), (c+1) * _elementSize + inTangentOffset);
 
-                        return SphericalBezierInterpolate(P0, C0, C1, P1, alpha);
-                    }
-                }
+                return SphericalBezierInterpolate(P0, C0, C1, P1, alpha);
 
             } else {
                 assert(0);      // hermite version not implemented (though we could just convert on load in)
@@ -80,6 +112,151 @@ namespace RenderCore { namespace Assets
         return *(OutType*)PtrAdd(_parameterData.get(), (_keyCount-1) * _elementSize );
     }
 
+    #if COMPILER_ACTIVE == COMPILER_TYPE_MSVC
+
+            //  SIMD versions for the linearly interpolated types. Each works on 4 instances
+            //  per iteration, with the data arranged as SoA lanes (ie, one register holds 
+            //  the same component for all 4 instances).
+            //  Note that these must match the order of operations in LinearInterpolate,
+            //  so that we get the same result as the non-batched path. Float4x4 isn't here,
+            //  because SphericalInterpolate decomposes it, rather than just lerping.
+        static __m128 LinearInterpolateLanes(__m128 p0, __m128 p1, __m128 alpha)
+        {
+            return _mm_add_ps(_mm_mul_ps(_mm_sub_ps(p1, p0), alpha), p0);
+        }
+
+        static void LinearInterpolateBatch(
+            float results[], const float* const p0s[], const float* const p1s[], 
+            const float alphas[], unsigned count)
+        {
+            unsigned c=0;
+            for (; (c+4)<=count; c+=4) {
+                auto p0 = _mm_set_ps(*p0s[c+3], *p0s[c+2], *p0s[c+1], *p0s[c+0]);
+                auto p1 = _mm_set_ps(*p1s[c+3], *p1s[c+2], *p1s[c+1], *p1s[c+0]);
+                auto alpha = _mm_loadu_ps(&alphas[c]);
+                _mm_storeu_ps(&results[c], LinearInterpolateLanes(p0, p1, alpha));
+            }
+            for (; c<count; ++c) {
+                results[c] = LinearInterpolate(*p0s[c], *p1s[c], alphas[c]);
+            }
+        }
+
+        static void LinearInterpolateBatch(
+            Float3 results[], const Float3* const p0s[], const Float3* const p1s[], 
+            const float alphas[], unsigned count)
+        {
+            unsigned c=0;
+            for (; (c+4)<=count; c+=4) {
+                auto alpha = _mm_loadu_ps(&alphas[c]);
+                float lanes[3][4];
+                for (unsigned e=0; e<3; ++e) {
+                    auto p0 = _mm_set_ps((*p0s[c+3])[e], (*p0s[c+2])[e], (*p0s[c+1])[e], (*p0s[c+0])[e]);
+                    auto p1 = _mm_set_ps((*p1s[c+3])[e], (*p1s[c+2])[e], (*p1s[c+1])[e], (*p1s[c+0])[e]);
+                    _mm_storeu_ps(lanes[e], LinearInterpolateLanes(p0, p1, alpha));
+                }
+                for (unsigned i=0; i<4; ++i) {
+                    results[c+i] = Float3(lanes[0][i], lanes[1][i], lanes[2][i]);
+                }
+            }
+            for (; c<count; ++c) {
+                results[c] = LinearInterpolate(*p0s[c], *p1s[c], alphas[c]);
+            }
+        }
+
+        static void LinearInterpolateBatch(
+            Float4 results[], const Float4* const p0s[], const Float4* const p1s[], 
+            const float alphas[], unsigned count)
+        {
+            unsigned c=0;
+            for (; (c+4)<=count; c+=4) {
+                    //  Load one instance per register, and transpose into component lanes
+                auto a0 = _mm_loadu_ps(&(*p0s[c+0])[0]), a1 = _mm_loadu_ps(&(*p0s[c+1])[0]);
+                auto a2 = _mm_loadu_ps(&(*p0s[c+2])[0]), a3 = _mm_loadu_ps(&(*p0s[c+3])[0]);
+                auto b0 = _mm_loadu_ps(&(*p1s[c+0])[0]), b1 = _mm_loadu_ps(&(*p1s[c+1])[0]);
+                auto b2 = _mm_loadu_ps(&(*p1s[c+2])[0]), b3 = _mm_loadu_ps(&(*p1s[c+3])[0]);
+                _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+                _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+                auto alpha = _mm_loadu_ps(&alphas[c]);
+                auto r0 = LinearInterpolateLanes(a0, b0, alpha);
+                auto r1 = LinearInterpolateLanes(a1, b1, alpha);
+                auto r2 = LinearInterpolateLanes(a2, b2, alpha);
+                auto r3 = LinearInterpolateLanes(a3, b3, alpha);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                _mm_storeu_ps(&results[c+0][0], r0);
+                _mm_storeu_ps(&results[c+1][0], r1);
+                _mm_storeu_ps(&results[c+2][0], r2);
+                _mm_storeu_ps(&results[c+3][0], r3);
+            }
+            for (; c<count; ++c) {
+                results[c] = LinearInterpolate(*p0s[c], *p1s[c], alphas[c]);
+            }
+        }
+
+    #endif
+
+    template<typename OutType>
+        static void LinearInterpolateBatch(
+            OutType results[], const OutType* const p0s[], const OutType* const p1s[], 
+            const float alphas[], unsigned count)
+        {
+            for (unsigned c=0; c<count; ++c) {
+                    // (clamped instances must get the key value exactly, matching Calculate())
+                results[c] = (p0s[c] != p1s[c]) ? SphericalInterpolate(*p0s[c], *p1s[c], alphas[c]) : *p0s[c];
+            }
+        }
+
+    template<typename OutType>
+        void        RawAnimationCurve::CalculateBatch(
+            OutType results[], const float inputTimes[], 
+            unsigned keyHints[], unsigned count) const never_throws
+    {
+        assert(_positionFormat == ExpectedFormat<OutType>());
+        if (_interpolationType != Linear) {
+            for (unsigned c=0; c<count; ++c) {
+                results[c] = Calculate<OutType>(inputTimes[c], keyHints[c]);
+            }
+            return;
+        }
+
+            //  First resolve the keys for every instance (this is the part with 
+            //  branches and unpredictable memory access). Then we can interpolate
+            //  in a tight loop. Instances outside of the range of the curve are 
+            //  clamped by interpolating between the same key twice.
+        const unsigned batchSize = 64;
+        const OutType* p0s[batchSize];
+        const OutType* p1s[batchSize];
+        float alphas[batchSize];
+
+        const auto* firstKey = (const OutType*)_parameterData.get();
+        const auto* lastKey = (const OutType*)PtrAdd(_parameterData.get(), (_keyCount-1) * _elementSize);
+        for (unsigned b=0; b<count; b+=batchSize) {
+            unsigned batchCount = std::min(count-b, batchSize);
+            for (unsigned c=0; c<batchCount; ++c) {
+                float inputTime = inputTimes[b+c];
+                unsigned& keyHint = keyHints[b+c];
+                if (inputTime < _timeMarkers[0]) {
+                    keyHint = 0;
+                    p0s[c] = p1s[c] = firstKey;
+                    alphas[c] = 0.f;
+                } else if (inputTime >= _timeMarkers[_keyCount-1]) {
+                    keyHint = unsigned(_keyCount-1);
+                    p0s[c] = p1s[c] = lastKey;
+                    alphas[c] = 0.f;
+                } else {
+                    unsigned k = FindKey(inputTime, keyHint);
+                    keyHint = k;
+                    p0s[c] = (const OutType*)PtrAdd(_parameterData.get(), k * _elementSize);
+                    p1s[c] = (const OutType*)PtrAdd(_parameterData.get(), (k+1) * _elementSize);
+                    alphas[c] = LerpParameter(_timeMarkers[k], _timeMarkers[k+1], inputTime);
+                }
+            }
+
+            LinearInterpolateBatch(&results[b], p0s, p1s, alphas, batchCount);
+        }
+    }
+
     float       RawAnimationCurve::StartTime() const
     {
         if (!_keyCount) {
@@ -100,6 +277,14 @@ namespace RenderCore { namespace Assets
     template Float3     RawAnimationCurve::Calculate(float inputTime) const never_throws;
     template Float4     RawAnimationCurve::Calculate(float inputTime) const never_throws;
     template Float4x4   RawAnimationCurve::Calculate(float inputTime) const never_throws;
+    template float      RawAnimationCurve::Calculate(float inputTime, unsigned& keyHint) const never_throws;
+    template Float3     RawAnimationCurve::Calculate(float inputTime, unsigned& keyHint) const never_throws;
+    template Float4     RawAnimationCurve::Calculate(float inputTime, unsigned& keyHint) const never_throws;
+    template Float4x4   RawAnimationCurve::Calculate(float inputTime, unsigned& keyHint) const never_throws;
+    template void       RawAnimationCurve::CalculateBatch(float results[], const float inputTimes[], unsigned keyHints[], unsigned count) const never_throws;
+    template void       RawAnimationCurve::CalculateBatch(Float3 results[], const float inputTimes[], unsigned keyHints[], unsigned count) const never_throws;
+    template void       RawAnimationCurve::CalculateBatch(Float4 results[], const float inputTimes[], unsigned keyHints[], unsigned count) const never_throws;
+    template void       RawAnimationCurve::CalculateBatch(Float4x4 results[], const float inputTimes[], unsigned keyHints[], unsigned count) const never_throws;
 
     void        RawAnimationCurve::Serialize(Serialization::NascentBlockSerializer& outputSerializer) const
     {
@@ -37,6 +37,25 @@ namespace RenderCore { namespace Assets
         template<typename OutType>
             OutType        Calculate(float inputTime) const never_throws;
 
+            /// <summary>Calculate, using a key hint from a previous evaluation</summary>
+            /// The key hint is the index of the key found by the last evaluation of this
+            /// curve. When playback advances monotonically, the next key is normally the same
+            /// key (or the one after) -- so this becomes a constant time lookup. Otherwise it
+            /// falls back to a binary search. Initialize the hint to 0 (or any value) before
+            /// the first evaluation; it is updated on return.
+        template<typename OutType>
+            OutType        Calculate(float inputTime, unsigned& keyHint) const never_throws;
+
+            /// <summary>Evaluate this curve for many instances at once</summary>
+            /// Results are written in structure-of-arrays form (ie, "results[c]" is the value
+            /// for "inputTimes[c]"). Key lookups are done for all instances first, and the
+            /// interpolation is done afterwards in a tight loop (using SIMD where possible).
+            /// "keyHints" is an array of "count" hints, as per Calculate().
+        template<typename OutType>
+            void        CalculateBatch(
+                OutType results[], const float inputTimes[], 
+                unsigned keyHints[], unsigned count) const never_throws;
+
     protected:
         size_t                          _keyCount;
         std::unique_ptr<float[], Serialization::BlockSerializerDeleter<float[]>>    _timeMarkers;
@@ -50,6 +69,8 @@ namespace RenderCore { namespace Assets
 
         template<typename OutType>
             static Metal::NativeFormat::Enum   ExpectedFormat();
+
+        unsigned    FindKey(float inputTime, unsigned keyHint) const never_throws;
     };
 
 }}
@@ -15,6 +15,7 @@
 #include "../Techniques/ResourceBox.h"
 #include "../../Utility/Streams/FileUtils.h"
 #include "../../Utility/ParameterBox.h"
+#include "../../Utility/FlatHashMap.h"
 #include <vector>
 
 namespace RenderCore { namespace Assets
@@ -25,6 +26,7 @@ namespace RenderCore { namespace Assets
         std::vector<std::string>                        _shaderNames;
         std::vector<Techniques::TechniqueInterface>     _techniqueInterfaces;
         std::vector<ParameterBox>                       _parameterBoxes;
+        FlatHashMap<unsigned>                           _parameterBoxLookup;
         std::vector<uint64>                             _techniqueInterfaceHashes;
         std::vector<std::pair<uint64, RenderStateSet>>  _renderStateSets;
 
@@ -66,8 +68,8 @@ namespace RenderCore { namespace Assets
             Techniques::TechniqueInterface techniqueInterface(
                 Metal::InputLayout(vertexElements, count));
 
-            static const auto HashLocalTransform = Hash64("LocalTransform");
-            static const auto HashBasicMaterial = Hash64("BasicMaterialConstants");
+            static const auto HashLocalTransform = ConstExprHash64("LocalTransform");
+            static const auto HashBasicMaterial = ConstExprHash64("BasicMaterialConstants");
             techniqueInterface.BindConstantBuffer(HashLocalTransform, 0, 1);
             techniqueInterface.BindConstantBuffer(HashBasicMaterial, 1, 1);
             Techniques::TechniqueContext::BindGlobalUniforms(techniqueInterface);
@@ -102,18 +104,33 @@ namespace RenderCore { namespace Assets
         auto& paramBoxes = _pimpl->_parameterBoxes;
         auto boxHash = box.GetHash();
         auto namesHash = box.GetParameterNamesHash();
-        auto p = std::find_if(
-            paramBoxes.cbegin(), paramBoxes.cend(), 
-            [=](const ParameterBox& box) 
-            { 
-                return box.GetHash() == boxHash && box.GetParameterNamesHash() == namesHash; 
-            });
-        if (p == paramBoxes.cend()) {
-            paramBoxes.push_back(box);
-            return paramBoxes.size()-1;
-        } else {
-            return std::distance(paramBoxes.cbegin(), p);
+
+            //  The lookup is keyed on a combination of both hashes. Different boxes
+            //  can (rarely) combine to the same key, so we must check both hashes on
+            //  a hit, and fall back to a linear search if they don't match
+        auto key = boxHash ^ ((namesHash << 21ull) | (namesHash >> 43ull));
+        auto* existing = _pimpl->_parameterBoxLookup.Find(key);
+        if (existing) {
+            const auto& e = paramBoxes[*existing];
+            if (e.GetHash() == boxHash && e.GetParameterNamesHash() == namesHash) {
+                return *existing;
+            }
+
+            auto p = std::find_if(
+                paramBoxes.cbegin(), paramBoxes.cend(), 
+                [=](const ParameterBox& box) 
+                { 
+                    return box.GetHash() == boxHash && box.GetParameterNamesHash() == namesHash; 
+                });
+            if (p != paramBoxes.cend()) {
+                return unsigned(std::distance(paramBoxes.cbegin(), p));
+            }
         }
+
+        paramBoxes.push_back(box);
+        auto result = unsigned(paramBoxes.size()-1);
+        _pimpl->_parameterBoxLookup.Insert(key, result);
+        return result;
     }
 
     unsigned SharedStateSet::InsertRenderStateSet(const RenderStateSet& states)
@@ -133,7 +133,7 @@ namespace RenderCore { namespace Assets
         _vbByteCode = &::Assets::GetAsset<CompiledShaderByteCode>     (hasNormals ? skinningVertexShaderSourcePN4 : skinningVertexShaderSourceP4);
 
         BoundUniforms boundUniforms(*_vbByteCode);
-        const auto jointTransformsHash = Hash64("JointTransforms");
+        const auto jointTransformsHash = ConstExprHash64("JointTransforms");
         if (desc._bindingType == BindingType::cbuffer) {
             boundUniforms.BindConstantBuffer(jointTransformsHash, 0, 1);
         } else {
@@ -270,6 +270,11 @@ namespace RenderCore { namespace Assets
             output, outputCount, parameterSet, debugIterator, iteratorUserData);
     }
 
+    CompiledTransformationMachine TransformationMachine::Compile() const
+    {
+        return CompiledTransformationMachine(_commandStream, _commandStream + _commandStreamSize);
+    }
+
     TransformationMachine::TransformationMachine()
     {
         _commandStream = nullptr;
@@ -702,7 +707,8 @@ namespace RenderCore { namespace Assets
     : _finalMatrices(std::move(moveFrom._finalMatrices))
     , _skinningBuffer(std::move(moveFrom._skinningBuffer))
     , _vbOffsets(std::move(moveFrom._vbOffsets))
-    , _animState(moveFrom._animState) {}
+    , _animState(moveFrom._animState)
+    , _curveKeyHints(std::move(moveFrom._curveKeyHints)) {}
 
     ModelRenderer::PreparedAnimation& ModelRenderer::PreparedAnimation::operator=(PreparedAnimation&& moveFrom)
     {
@@ -710,6 +716,7 @@ namespace RenderCore { namespace Assets
         _skinningBuffer = std::move(moveFrom._skinningBuffer);
         _vbOffsets = std::move(moveFrom._vbOffsets);
         _animState = moveFrom._animState;
+        _curveKeyHints = std::move(moveFrom._curveKeyHints);
         return *this;
     }
 
@@ -722,12 +729,45 @@ namespace RenderCore { namespace Assets
         bool operator()(uint64 lhs, const AnimationSet::Animation& rhs) const { return lhs < rhs._name; }
     };
 
+    static void ApplyConstantDriver(
+        TransformationParameterSet& dst,
+        const TransformationMachine::InputInterface::Parameter& p,
+        const AnimationSet::ConstantDriver& driver, const void* data)
+    {
+            //  (shared by BuildTransformationParameterSet and BuildTransformationParameterSets,
+            //  so the single and batched paths treat constant drivers the same way)
+        if (driver._samplerType == TransformationParameterSet::Type::Float4x4) {
+            assert(p._type == TransformationParameterSet::Type::Float4x4);
+            dst.GetFloat4x4Parameters()[p._index] = *(const Float4x4*)data;
+        } else if (driver._samplerType == TransformationParameterSet::Type::Float4) {
+            if (p._type == TransformationParameterSet::Type::Float4) {
+                dst.GetFloat4Parameters()[p._index] = *(const Float4*)data;
+            } else if (p._type == TransformationParameterSet::Type::Float3) {
+                dst.GetFloat3Parameters()[p._index] = Truncate(*(const Float4*)data);
+            }
+        } else if (driver._samplerType == TransformationParameterSet::Type::Float3) {
+            assert(p._type == TransformationParameterSet::Type::Float3);
+            dst.GetFloat3Parameters()[p._index] = *(const Float3*)data;
+        } else if (driver._samplerType == TransformationParameterSet::Type::Float1) {
+            if (p._type == TransformationParameterSet::Type::Float1) {
+                dst.GetFloat1Parameters()[p._index] = *(const float*)data;
+            } else if (p._type == TransformationParameterSet::Type::Float3) {
+                assert(driver._samplerOffset < 3);
+                dst.GetFloat3Parameters()[p._index][driver._samplerOffset] = *(const float*)data;
+            } else if (p._type == TransformationParameterSet::Type::Float4) {
+                assert(driver._samplerOffset < 4);
+                dst.GetFloat4Parameters()[p._index][driver._samplerOffset] = *(const float*)data;
+            }
+        }
+    }
+
     TransformationParameterSet      AnimationSet::BuildTransformationParameterSet(
         const AnimationState&           animState__,
         const TransformationMachine&    transformationMachine,
         const AnimationSetBinding&      binding,
         const RawAnimationCurve*        curves,
-        size_t                          curvesCount) const
+        size_t                          curvesCount,
+        unsigned*                       curveKeyHints) const
     {
         TransformationParameterSet result(transformationMachine.GetDefaultParameters());
         float* float1s      = result.GetFloat1Parameters();
@@ -764,39 +804,42 @@ namespace RenderCore { namespace Assets
             const TransformationMachine::InputInterface::Parameter& p 
                 = inputInterface._parameters[transInputIndex];
 
+            unsigned tempKeyHint = 0;
+            unsigned& keyHint = (curveKeyHints && driver._curveId < curvesCount) ? curveKeyHints[driver._curveId] : tempKeyHint;
+
             if (driver._samplerType == TransformationParameterSet::Type::Float4x4) {
                 if (driver._curveId < curvesCount) {
                     const RawAnimationCurve& curve = curves[driver._curveId];
                     assert(p._type == TransformationParameterSet::Type::Float4x4);
                     // assert(i->_index < float4x4s.size());
-                    float4x4s[p._index] = curve.Calculate<Float4x4>(animState._time);
+                    float4x4s[p._index] = curve.Calculate<Float4x4>(animState._time, keyHint);
                 }
             } else if (driver._samplerType == TransformationParameterSet::Type::Float4) {
                 if (driver._curveId < curvesCount) {
                     const RawAnimationCurve& curve = curves[driver._curveId];
                     if (p._type == TransformationParameterSet::Type::Float4) {
-                        float4s[p._index] = curve.Calculate<Float4>(animState._time);
+                        float4s[p._index] = curve.Calculate<Float4>(animState._time, keyHint);
                     } else if (p._type == TransformationParameterSet::Type::Float3) {
-                        float3s[p._index] = Truncate(curve.Calculate<Float4>(animState._time));
+                        float3s[p._index] = Truncate(curve.Calculate<Float4>(animState._time, keyHint));
                     } else {
                         assert(p._type == TransformationParameterSet::Type::Float1);
-                        float1s[p._index] = curve.Calculate<Float4>(animState._time)[0];
+                        float1s[p._index] = curve.Calculate<Float4>(animState._time, keyHint)[0];
                     }
                 }
             } else if (driver._samplerType == TransformationParameterSet::Type::Float3) {
                 if (driver._curveId < curvesCount) {
                     const RawAnimationCurve& curve = curves[driver._curveId];
                     if (p._type == TransformationParameterSet::Type::Float3) {
-                        float3s[p._index] = curve.Calculate<Float3>(animState._time);
+                        float3s[p._index] = curve.Calculate<Float3>(animState._time, keyHint);
                     } else {
                         assert(p._type == TransformationParameterSet::Type::Float1);
-                        float1s[p._index] = curve.Calculate<Float3>(animState._time)[0];
+                        float1s[p._index] = curve.Calculate<Float3>(animState._time, keyHint)[0];
                     }
                 }
             } else if (driver._samplerType == TransformationParameterSet::Type::Float1) {
                 if (driver._curveId < curvesCount) {
                     const RawAnimationCurve& curve = curves[driver._curveId];
-                    float result = curve.Calculate<float>(animState._time);
+                    float result = curve.Calculate<float>(animState._time, keyHint);
                     if (p._type == TransformationParameterSet::Type::Float1) {
                         float1s[p._index] = result;
                     } else if (p._type == TransformationParameterSet::Type::Float3) {
@@ -821,33 +864,192 @@ namespace RenderCore { namespace Assets
             const TransformationMachine::InputInterface::Parameter& p 
                 = inputInterface._parameters[transInputIndex];
 
-            const void* data    = PtrAdd(_constantData, driver._dataOffset);
-            if (driver._samplerType == TransformationParameterSet::Type::Float4x4) {
-                assert(p._type == TransformationParameterSet::Type::Float4x4);
-                float4x4s[p._index] = *(const Float4x4*)data;
-            } else if (driver._samplerType == TransformationParameterSet::Type::Float4) {
-                if (p._type == TransformationParameterSet::Type::Float4) {
-                    float4s[p._index] = *(const Float4*)data;
-                } else if (p._type == TransformationParameterSet::Type::Float3) {
-                    float3s[p._index] = Truncate(*(const Float4*)data);
-                }
-            } else if (driver._samplerType == TransformationParameterSet::Type::Float3) {
-                assert(p._type == TransformationParameterSet::Type::Float3);
-                float3s[p._index] = *(Float3*)data;
-            } else if (driver._samplerType == TransformationParameterSet::Type::Float1) {
-                if (p._type == TransformationParameterSet::Type::Float1) {
-                    float1s[p._index] = *(float*)data;
-                } else if (p._type == TransformationParameterSet::Type::Float3) {
-                    assert(driver._samplerOffset < 3);
-                    float3s[p._index][driver._samplerOffset] = *(const float*)data;
-                } else if (p._type == TransformationParameterSet::Type::Float4) {
-                    assert(driver._samplerOffset < 4);
-                    float4s[p._index][driver._samplerOffset] = *(const float*)data;
+            ApplyConstantDriver(result, p, driver, PtrAdd(_constantData, driver._dataOffset));
+        }
+
+        return result;
+    }
+
+    static void ScatterDriverOutput(
+        TransformationParameterSet& dst, 
+        const TransformationMachine::InputInterface::Parameter& p,
+        unsigned samplerOffset, const Float4x4& value)
+    {
+        assert(p._type == TransformationParameterSet::Type::Float4x4);
+        dst.GetFloat4x4Parameters()[p._index] = value;
+    }
+
+    static void ScatterDriverOutput(
+        TransformationParameterSet& dst, 
+        const TransformationMachine::InputInterface::Parameter& p,
+        unsigned samplerOffset, const Float4& value)
+    {
+        if (p._type == TransformationParameterSet::Type::Float4) {
+            dst.GetFloat4Parameters()[p._index] = value;
+        } else if (p._type == TransformationParameterSet::Type::Float3) {
+            dst.GetFloat3Parameters()[p._index] = Truncate(value);
+        } else {
+            assert(p._type == TransformationParameterSet::Type::Float1);
+            dst.GetFloat1Parameters()[p._index] = value[0];
+        }
+    }
+
+    static void ScatterDriverOutput(
+        TransformationParameterSet& dst, 
+        const TransformationMachine::InputInterface::Parameter& p,
+        unsigned samplerOffset, const Float3& value)
+    {
+        if (p._type == TransformationParameterSet::Type::Float3) {
+            dst.GetFloat3Parameters()[p._index] = value;
+        } else {
+            assert(p._type == TransformationParameterSet::Type::Float1);
+            dst.GetFloat1Parameters()[p._index] = value[0];
+        }
+    }
+
+    static void ScatterDriverOutput(
+        TransformationParameterSet& dst, 
+        const TransformationMachine::InputInterface::Parameter& p,
+        unsigned samplerOffset, const float& value)
+    {
+        if (p._type == TransformationParameterSet::Type::Float1) {
+            dst.GetFloat1Parameters()[p._index] = value;
+        } else if (p._type == TransformationParameterSet::Type::Float3) {
+            assert(samplerOffset < 3);
+            dst.GetFloat3Parameters()[p._index][samplerOffset] = value;
+        } else if (p._type == TransformationParameterSet::Type::Float4) {
+            assert(samplerOffset < 4);
+            dst.GetFloat4Parameters()[p._index][samplerOffset] = value;
+        }
+    }
+
+    template<typename Type>
+        static void EvaluateDriverBatch(
+            TransformationParameterSet results[], const unsigned instances[], unsigned instanceCount,
+            const RawAnimationCurve& curve, unsigned curveId,
+            const float times[], unsigned* curveKeyHints[],
+            const TransformationMachine::InputInterface::Parameter& p, unsigned samplerOffset)
+        {
+                //  Gather the key hints, evaluate the curve for every instance in 
+                //  one go, and then scatter the results into the parameter sets.
+                //  The caller limits instanceCount, so fixed size arrays are fine here
+            const unsigned maxInstances = 64;
+            assert(instanceCount <= maxInstances);
+            unsigned keyHints[maxInstances];
+            Type values[maxInstances];
+
+            for (unsigned c=0; c<instanceCount; ++c) {
+                keyHints[c] = curveKeyHints ? curveKeyHints[instances[c]][curveId] : 0;
+            }
+
+            curve.CalculateBatch<Type>(values, times, keyHints, instanceCount);
+
+            for (unsigned c=0; c<instanceCount; ++c) {
+                ScatterDriverOutput(results[instances[c]], p, samplerOffset, values[c]);
+                if (curveKeyHints) {
+                    curveKeyHints[instances[c]][curveId] = keyHints[c];
                 }
             }
         }
 
-        return result;
+    void AnimationSet::BuildTransformationParameterSets(
+        TransformationParameterSet      results[],
+        const AnimationState            animStates[],
+        unsigned*                       curveKeyHints[],
+        unsigned                        instanceCount,
+        const TransformationMachine&    transformationMachine,
+        const AnimationSetBinding&      binding,
+        const RawAnimationCurve*        curves,
+        size_t                          curvesCount) const
+    {
+        for (unsigned c=0; c<instanceCount; ++c) {
+            results[c] = transformationMachine.GetDefaultParameters();
+        }
+
+            //  Group the instances by the animation they are playing. Within each group,
+            //  we walk through the drivers once, and evaluate each driver for all of the
+            //  instances in the group (structure-of-arrays style). 
+        std::vector<unsigned> sortedInstances(instanceCount);
+        for (unsigned c=0; c<instanceCount; ++c) { sortedInstances[c] = c; }
+        std::stable_sort(sortedInstances.begin(), sortedInstances.end(),
+            [animStates](unsigned lhs, unsigned rhs) { return animStates[lhs]._animation < animStates[rhs]._animation; });
+
+        const auto& inputInterface = transformationMachine.GetInputInterface();
+        const unsigned maxGroupSize = 64;
+
+        for (auto groupStart=sortedInstances.cbegin(); groupStart!=sortedInstances.cend();) {
+            auto animation = animStates[*groupStart]._animation;
+            auto groupEnd = groupStart+1;
+            while (    groupEnd!=sortedInstances.cend() && (groupEnd-groupStart) < maxGroupSize
+                    && animStates[*groupEnd]._animation == animation) { ++groupEnd; }
+
+            const unsigned* instances = AsPointer(groupStart);
+            unsigned groupSize = unsigned(groupEnd-groupStart);
+
+            size_t driverStart = 0, driverEnd = GetAnimationDriverCount();
+            size_t constantDriverStartIndex = 0, constantDriverEndIndex = _constantDriverCount;
+            float beginTime = 0.f;
+            if (animation!=0x0) {
+                auto end = &_animations[_animationCount];
+                auto i = std::lower_bound(_animations, end, animation, CompareAnimationName());
+                if (i!=end && i->_name == animation) {
+                    driverStart = i->_beginDriver;
+                    driverEnd = i->_endDriver;
+                    constantDriverStartIndex = i->_beginConstantDriver;
+                    constantDriverEndIndex = i->_endConstantDriver;
+                    beginTime = i->_beginTime;
+                }
+            }
+
+            float times[maxGroupSize];
+            for (unsigned c=0; c<groupSize; ++c) {
+                times[c] = animStates[instances[c]]._time + beginTime;
+            }
+
+            for (size_t c=driverStart; c<driverEnd; ++c) {
+                const AnimationDriver& driver = _animationDrivers[c];
+                unsigned transInputIndex = binding._animDriverToMachineParameter[driver._parameterIndex];
+                if (transInputIndex == ~unsigned(0x0) || driver._curveId >= curvesCount) {
+                    continue;   // (unbound output)
+                }
+
+                assert(transInputIndex < inputInterface._parameterCount);
+                const auto& p = inputInterface._parameters[transInputIndex];
+                const auto& curve = curves[driver._curveId];
+
+                switch (driver._samplerType) {
+                case TransformationParameterSet::Type::Float4x4:
+                    EvaluateDriverBatch<Float4x4>(results, instances, groupSize, curve, driver._curveId, times, curveKeyHints, p, driver._samplerOffset);
+                    break;
+                case TransformationParameterSet::Type::Float4:
+                    EvaluateDriverBatch<Float4>(results, instances, groupSize, curve, driver._curveId, times, curveKeyHints, p, driver._samplerOffset);
+                    break;
+                case TransformationParameterSet::Type::Float3:
+                    EvaluateDriverBatch<Float3>(results, instances, groupSize, curve, driver._curveId, times, curveKeyHints, p, driver._samplerOffset);
+                    break;
+                case TransformationParameterSet::Type::Float1:
+                    EvaluateDriverBatch<float>(results, instances, groupSize, curve, driver._curveId, times, curveKeyHints, p, driver._samplerOffset);
+                    break;
+                }
+            }
+
+            for (size_t c=constantDriverStartIndex; c<constantDriverEndIndex; ++c) {
+                const ConstantDriver& driver = _constantDrivers[c];
+                unsigned transInputIndex = binding._animDriverToMachineParameter[driver._parameterIndex];
+                if (transInputIndex == ~unsigned(0x0)) {
+                    continue;   // (unbound output)
+                }
+
+                assert(transInputIndex < inputInterface._parameterCount);
+                const auto& p = inputInterface._parameters[transInputIndex];
+                const void* data = PtrAdd(_constantData, driver._dataOffset);
+                for (unsigned q=0; q<groupSize; ++q) {
+                    ApplyConstantDriver(results[instances[q]], p, driver, data);
+                }
+            }
+
+            groupStart = groupEnd;
+        }
     }
 
     AnimationSet::Animation AnimationSet::FindAnimation(uint64 animation) const
@@ -893,6 +1095,7 @@ namespace RenderCore { namespace Assets
         std::unique_ptr<SkeletonBinding> _skeletonBinding;
         AnimationSetScaffold* _animationSetScaffold;
         SkeletonScaffold* _skeletonScaffold;
+        CompiledTransformationMachine _compiledSkeleton;
     };
 
     void SkinPrepareMachine::PrepareAnimation(   
@@ -905,15 +1108,56 @@ namespace RenderCore { namespace Assets
         auto finalMatCount = skeleton.GetOutputMatrixCount();
         state._finalMatrices = std::make_unique<Float4x4[]>(finalMatCount);
         if (!Tweakable("AnimBasePose", false)) {
+            state._curveKeyHints.resize(animSet._curvesCount, 0);
             auto params = animSet._animationSet.BuildTransformationParameterSet(
                 state._animState, 
                 skeleton, *_pimpl->_animationSetBinding, 
+                animSet._curves, animSet._curvesCount,
+                AsPointer(state._curveKeyHints.begin()));
+
+            _pimpl->_compiledSkeleton.GenerateOutputTransforms(state._finalMatrices.get(), finalMatCount, &params);
+        } else {
+            _pimpl->_compiledSkeleton.GenerateOutputTransforms(state._finalMatrices.get(), finalMatCount, &skeleton.GetDefaultParameters());
+        }
+    }
+
+    void SkinPrepareMachine::PrepareAnimationBatch(
+            Metal::DeviceContext* context, 
+            ModelRenderer::PreparedAnimation* states[], unsigned stateCount) const
+    {
+        if (!stateCount) return;
+
+        auto& skeleton = _pimpl->_skeletonScaffold->GetTransformationMachine();
+        auto& animSet = _pimpl->_animationSetScaffold->ImmutableData();
+
+        auto finalMatCount = skeleton.GetOutputMatrixCount();
+        std::vector<Float4x4*> outputs(stateCount);
+        for (unsigned c=0; c<stateCount; ++c) {
+            states[c]->_finalMatrices = std::make_unique<Float4x4[]>(finalMatCount);
+            outputs[c] = states[c]->_finalMatrices.get();
+        }
+
+        if (!Tweakable("AnimBasePose", false)) {
+            std::vector<AnimationState> animStates(stateCount);
+            std::vector<unsigned*> keyHints(stateCount);
+            for (unsigned c=0; c<stateCount; ++c) {
+                states[c]->_curveKeyHints.resize(animSet._curvesCount, 0);
+                animStates[c] = states[c]->_animState;
+                keyHints[c] = AsPointer(states[c]->_curveKeyHints.begin());
+            }
+
+            std::vector<TransformationParameterSet> params(stateCount);
+            animSet._animationSet.BuildTransformationParameterSets(
+                AsPointer(params.begin()), AsPointer(animStates.cbegin()), AsPointer(keyHints.begin()), stateCount,
+                skeleton, *_pimpl->_animationSetBinding, 
                 animSet._curves, animSet._curvesCount);
 
-            
-            skeleton.GenerateOutputTransforms(state._finalMatrices.get(), finalMatCount, &params);
+            _pimpl->_compiledSkeleton.GenerateOutputTransformsBatch(
+                AsPointer(outputs.begin()), finalMatCount, AsPointer(params.cbegin()), stateCount);
         } else {
-            skeleton.GenerateOutputTransforms(state._finalMatrices.get(), finalMatCount, &skeleton.GetDefaultParameters());
+            for (unsigned c=0; c<stateCount; ++c) {
+                _pimpl->_compiledSkeleton.GenerateOutputTransforms(outputs[c], finalMatCount, &skeleton.GetDefaultParameters());
+            }
         }
     }
 
@@ -938,6 +1182,28 @@ namespace RenderCore { namespace Assets
             skinScaffold.CommandStream().GetInputInterface());
         pimpl->_animationSetScaffold = &animationScaffold;
         pimpl->_skeletonScaffold = &skeletonScaffold;
+
+        auto& transMachine = skeletonScaffold.GetTransformationMachine();
+        pimpl->_compiledSkeleton = transMachine.Compile();
+
+        #if defined(_DEBUG)
+                //  Check that the compiled skeleton matches the interpreted 
+                //  version (at least for the default parameters)
+            {
+                auto outputCount = transMachine.GetOutputMatrixCount();
+                auto interpreted = std::make_unique<Float4x4[]>(outputCount);
+                auto compiled = std::make_unique<Float4x4[]>(outputCount);
+                transMachine.GenerateOutputTransforms(interpreted.get(), outputCount, &transMachine.GetDefaultParameters());
+                pimpl->_compiledSkeleton.GenerateOutputTransforms(compiled.get(), outputCount, &transMachine.GetDefaultParameters());
+                for (unsigned c=0; c<outputCount; ++c) {
+                    if (!Equivalent(interpreted[c], compiled[c], 1e-3f)) {
+                        LogWarning << "Compiled transformation machine doesn't match interpreted version for output matrix (" << c << ")";
+                        break;
+                    }
+                }
+            }
+        #endif
+
         _pimpl = std::move(pimpl);
     }
 
@@ -1052,7 +1318,7 @@ namespace RenderCore { namespace Assets
         context->Bind(shaderProgram);
 
         BoundUniforms boundLayout(shaderProgram);
-        static const auto HashLocalTransform = Hash64("LocalTransform");
+        static const auto HashLocalTransform = ConstExprHash64("LocalTransform");
         boundLayout.BindConstantBuffer( HashLocalTransform, 0, 1, Assets::LocalTransform_Elements, Assets::LocalTransform_ElementsCount);
         Techniques::TechniqueContext::BindGlobalUniforms(boundLayout);
         boundLayout.Apply(*context, 
@@ -113,7 +113,10 @@ namespace RenderCore { namespace Assets
             // Load the chunks. We should have 2 chunks:
             //  . cell scaffold
             //  . height map data
-        auto chunks = Serialization::ChunkFile::LoadChunkTable(file);
+            //  (terrain cells don't contain hash values, so files built with any
+            //  hash family are fine)
+        uint32 hashFamily = 0;
+        auto chunks = Serialization::ChunkFile::LoadChunkTable(file, hashFamily);
 
         Serialization::ChunkFile::ChunkHeader scaffoldChunk;
         Serialization::ChunkFile::ChunkHeader heightDataChunk;
@@ -213,7 +216,10 @@ namespace RenderCore { namespace Assets
             // Load the chunks. We should have 2 chunks:
             //  . cell scaffold
             //  . coverage data
-        auto chunks = Serialization::ChunkFile::LoadChunkTable(file);
+            //  (terrain cells don't contain hash values, so files built with any
+            //  hash family are fine)
+        uint32 hashFamily = 0;
+        auto chunks = Serialization::ChunkFile::LoadChunkTable(file, hashFamily);
 
         Serialization::ChunkFile::ChunkHeader scaffoldChunk;
         Serialization::ChunkFile::ChunkHeader coverageDataChunk;
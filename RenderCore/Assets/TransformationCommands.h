@@ -326,6 +326,74 @@ namespace RenderCore { namespace Assets
         }
     }
 
+        /// <summary>Transformation command stream, compiled into a flat list of operations</summary>
+        /// The command stream for a skeleton never changes after it has been loaded. So
+        /// we can do a little bit of work up front to make evaluating it cheaper:
+        ///     <list>
+        ///         <item>push and pop commands are resolved into fixed working slots, so
+        ///                 no transforms are copied when pushing</item>
+        ///         <item>runs of static transforms are folded into a single matrix</item>
+        ///         <item>when every transform in the stream is affine, static transforms are 
+        ///                 combined as 3x4 matrices</item>
+        ///     </list>
+        /// The result should match GenerateOutputTransformsFree() to within floating point
+        /// tolerance (folding static transforms changes the order of some operations).
+        /// There is no debug iterator support; use GenerateOutputTransformsFree() for that.
+    class CompiledTransformationMachine
+    {
+    public:
+        void    GenerateOutputTransforms(
+            Float4x4                            result[],
+            size_t                              resultCount,
+            const TransformationParameterSet*   parameterSet) const;
+
+            /// <summary>Run the compiled program for many instances at once</summary>
+            /// Each operation is applied to every instance before moving onto the next,
+            /// using the same per-operation code as GenerateOutputTransforms(). So the
+            /// results are identical to calling GenerateOutputTransforms() for each
+            /// parameter set in turn.
+            /// "result" is an array of "instanceCount" output arrays, each with space for
+            /// "resultCount" matrices.
+        void    GenerateOutputTransformsBatch(
+            Float4x4*                           result[],
+            size_t                              resultCount,
+            const TransformationParameterSet    parameterSets[],
+            unsigned                            instanceCount) const;
+
+        bool    IsAffine() const                { return _isAffine; }
+        size_t  GetOperationCount() const       { return _operations.size(); }
+
+        CompiledTransformationMachine(const uint32* commandStreamBegin, const uint32* commandStreamEnd);
+        CompiledTransformationMachine();
+        CompiledTransformationMachine(CompiledTransformationMachine&& moveFrom);
+        CompiledTransformationMachine& operator=(CompiledTransformationMachine&& moveFrom);
+        ~CompiledTransformationMachine();
+
+        static const unsigned MaxWorkingSlots = 64;
+    protected:
+        struct Operation
+        {
+            uint32  _type;          // TransformStackCommand::Enum (only transform types & WriteOutputMatrix)
+            uint32  _dst;           // working slot written
+            uint32  _src;           // working slot read (or IdentitySlot)
+            uint32  _operand;       // index into _staticTransforms, parameter index or output matrix index
+        };
+        static const uint32 IdentitySlot = ~uint32(0);
+
+        bool    ExecuteOperation(
+            const Operation&                    op,
+            Float4x4                            working[],
+            size_t                              workingStride,
+            Float4x4                            result[],
+            size_t                              resultCount,
+            const TransformationParameterSet*   parameterSet) const;
+
+        std::vector<Operation>  _operations;
+        std::vector<Float4x4>   _staticTransforms;
+        unsigned                _workingSlotCount;
+        bool                    _isAffine;
+    };
+
     void TraceTransformationMachine(
             Utility::OutputStream&      outputStream,
             const uint32*               commandStreamBegin,
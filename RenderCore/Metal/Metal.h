@@ -11,8 +11,18 @@
 #define GFXAPI_DX11         1
 #define GFXAPI_DX9          2
 #define GFXAPI_OPENGLES     3
+#define GFXAPI_NULL         4
 
-#if PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
+    //
+    //      GFXAPI_NULL is a headless device that keeps all resources in
+    //      host memory. Select it with SELECT_NULLGFX (or build for a
+    //      platform with no GPU backend) to run the BufferUploads pipeline
+    //      without a GPU.
+    //
+#if defined(SELECT_NULLGFX)
+    #define GFXAPI_ACTIVE   GFXAPI_NULL
+
+#elif PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
 
     #if defined(SELECT_OPENGL)
         #define GFXAPI_ACTIVE   GFXAPI_OPENGLES
@@ -22,9 +32,14 @@
 
 #elif PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID
     #define GFXAPI_ACTIVE   GFXAPI_OPENGLES
+#elif PLATFORMOS_ACTIVE == PLATFORMOS_LINUX
+    #define GFXAPI_ACTIVE   GFXAPI_NULL
 #endif
 
-#if PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
+#if defined(SELECT_NULLGFX)
+    #define GFXAPI_TARGET   GFXAPI_NULL
+
+#elif PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
     
     #if defined(SELECT_OPENGL)
         #define GFXAPI_TARGET   GFXAPI_OPENGLES
@@ -34,6 +49,8 @@
 
 #elif PLATFORMOS_TARGET == PLATFORMOS_ANDROID
     #define GFXAPI_TARGET   GFXAPI_OPENGLES
+#elif PLATFORMOS_TARGET == PLATFORMOS_LINUX
+    #define GFXAPI_TARGET   GFXAPI_NULL
 #endif
 
 // #define _PSTE(X,Y) X##Y
@@ -47,6 +64,13 @@
         namespace Metal_DX11 {}
         namespace Metal = Metal_DX11;
     }
+#elif GFXAPI_ACTIVE == GFXAPI_NULL
+    #define METAL_HEADER(X) _STRIZE(../Null/Metal/X)
+
+    namespace RenderCore {
+        namespace Metal_Null {}
+        namespace Metal = Metal_Null;
+    }
 #else
     #define METAL_HEADER(X) _STRIZE(../OpenGLES/Metal/X)
 
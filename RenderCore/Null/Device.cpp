@@ -0,0 +1,118 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "../Metal/Metal.h"
+
+#if GFXAPI_ACTIVE == GFXAPI_NULL
+
+#include "Device.h"
+#include "Metal/DeviceContext.h"
+#include "../../Utility/PtrUtils.h"
+#include "../../Utility/TimeUtils.h"
+
+namespace RenderCore
+{
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    Device::Device()
+    {
+        _immediateContext = moveptr(new Metal_Null::DeviceContext(true, 0));
+    }
+
+    Device::~Device()
+    {
+    }
+
+    std::unique_ptr<IPresentationChain>   Device::CreatePresentationChain(const void* platformValue, unsigned width, unsigned height)
+    {
+        return std::make_unique<PresentationChain>(width, height);
+    }
+
+    void    Device::BeginFrame(IPresentationChain* presentationChain)
+    {
+    }
+
+    extern char VersionString[];
+    extern char BuildDateString[];
+        
+    std::pair<const char*, const char*> Device::GetVersionInformation()
+    {
+        return std::make_pair(VersionString, BuildDateString);
+    }
+
+    void* Device::QueryInterface(const GUID& guid)
+    {
+        return nullptr;
+    }
+
+    #if !FLEX_USE_VTABLE_Device && !DOXYGEN
+        namespace Detail
+        {
+            void* Ignore_Device::QueryInterface(const GUID& guid)
+            {
+                return nullptr;
+            }
+        }
+    #endif
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    void* DeviceNull::QueryInterface(const GUID& guid)
+    {
+            // (like the OpenGLES device, we don't have uuids for non-windows
+            //  interfaces, so the guid is ignored)
+        return (IDeviceNull*)this;
+    }
+
+    intrusive_ptr<Metal_Null::DeviceContext>   DeviceNull::CreateDeferredContext()
+    {
+        return moveptr(new Metal_Null::DeviceContext(false, _immediateContext->GetSimulatedLatency()));
+    }
+
+    intrusive_ptr<Metal_Null::DeviceContext>   DeviceNull::GetImmediateContext()
+    {
+        return _immediateContext;
+    }
+
+    void    DeviceNull::SetSimulatedGPULatency(unsigned microseconds)
+    {
+        auto ticks = int64(microseconds) * int64(GetPerformanceCounterFrequency()) / 1000000ll;
+        _immediateContext->SetSimulatedLatency(ticks);
+    }
+
+    DeviceNull::DeviceNull() {}
+    DeviceNull::~DeviceNull() {}
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    PresentationChain::PresentationChain(unsigned width, unsigned height)
+    {
+        _desc._dimensions = Int2(width, height);
+    }
+
+    PresentationChain::~PresentationChain() {}
+
+    void                    PresentationChain::Present() {}
+
+    void                    PresentationChain::Resize(unsigned newWidth, unsigned newHeight)
+    {
+        _desc._dimensions = Int2(newWidth, newHeight);
+    }
+
+    PresentationChainDesc   PresentationChain::GetDesc() const
+    {
+        return _desc;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    render_dll_export std::unique_ptr<IDevice>    CreateDevice()
+    {
+        return std::make_unique<DeviceNull>();
+    }
+}
+
+#endif
@@ -0,0 +1,66 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#define FLEX_CONTEXT_Device             FLEX_CONTEXT_CONCRETE
+#define FLEX_CONTEXT_DeviceNull         FLEX_CONTEXT_CONCRETE
+#define FLEX_CONTEXT_PresentationChain  FLEX_CONTEXT_CONCRETE
+
+#include "../IDevice.h"
+#include "IDeviceNull.h"
+#include "../../Utility/Mixins.h"
+#include "../../Utility/IntrusivePtr.h"
+
+namespace RenderCore
+{
+////////////////////////////////////////////////////////////////////////////////
+
+    class PresentationChain : public Base_PresentationChain
+    {
+    public:
+        void                    Present() /*override*/;
+        void                    Resize(unsigned newWidth, unsigned newHeight) /*override*/;
+        PresentationChainDesc   GetDesc() const;
+
+        PresentationChain(unsigned width, unsigned height);
+        ~PresentationChain();
+    private:
+        PresentationChainDesc   _desc;
+    };
+
+////////////////////////////////////////////////////////////////////////////////
+
+    class Device : public Base_Device, noncopyable
+    {
+    public:
+        std::unique_ptr<IPresentationChain>     CreatePresentationChain(const void* platformValue, unsigned width, unsigned height) /*override*/;
+        virtual void*                           QueryInterface(const GUID& guid);
+        void                                    BeginFrame(IPresentationChain* presentationChain);
+
+        std::pair<const char*, const char*>     GetVersionInformation();
+
+        Device();
+        ~Device();
+
+    protected:
+        intrusive_ptr<Metal_Null::DeviceContext>   _immediateContext;
+    };
+
+    class DeviceNull : public Device, public Base_DeviceNull
+    {
+    public:
+        intrusive_ptr<Metal_Null::DeviceContext>   CreateDeferredContext();
+        intrusive_ptr<Metal_Null::DeviceContext>   GetImmediateContext();
+        void                                        SetSimulatedGPULatency(unsigned microseconds);
+        virtual void*                               QueryInterface(const GUID& guid);
+
+        DeviceNull();
+        ~DeviceNull();
+    };
+
+////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,53 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../IDevice.h"
+#include "../../Utility/IntrusivePtr.h"
+
+#define FLEX_USE_VTABLE_DeviceNull FLEX_USE_VTABLE_Device
+
+namespace RenderCore
+{
+    namespace Metal_Null { class DeviceContext; }
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+#define FLEX_INTERFACE DeviceNull
+/*-----------------*/ #include "../FlexBegin.h" /*-----------------*/
+    
+        /// <summary>IDevice extension for the null device</summary>
+        /// The null device has no GPU. Resources are kept in host memory and
+        /// GPU events are triggered after a simulated latency. It's intended for
+        /// running and profiling systems like BufferUploads in headless builds.
+        ///
+        /// Use IDevice::QueryInterface for query for this type from a
+        /// plain IDevice.
+        class ICLASSNAME(DeviceNull)
+        {
+        public:
+            IMETHOD intrusive_ptr<Metal_Null::DeviceContext>   CreateDeferredContext() IPURE;
+            IMETHOD intrusive_ptr<Metal_Null::DeviceContext>   GetImmediateContext()   IPURE;
+
+            /// <summary>Sets the simulated latency for GPU events</summary>
+            /// Event queries ended on the immediate context will be triggered
+            /// this many microseconds later.
+            IMETHOD void                                        SetSimulatedGPULatency(unsigned microseconds) IPURE;
+            IDESTRUCTOR
+        };
+
+        #if !defined(FLEX_CONTEXT_DeviceNull)
+            #define FLEX_CONTEXT_DeviceNull     FLEX_CONTEXT_INTERFACE
+        #endif
+
+        #if defined(DOXYGEN)
+            typedef IDeviceNull Base_DeviceNull;
+        #endif
+
+/*-----------------*/ #include "../FlexEnd.h" /*-----------------*/
+
+}
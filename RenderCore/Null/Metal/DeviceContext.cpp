@@ -0,0 +1,83 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "../../Metal/Metal.h"
+
+#if GFXAPI_ACTIVE == GFXAPI_NULL
+
+#include "DeviceContext.h"
+#include "../IDeviceNull.h"
+
+namespace RenderCore { namespace Metal_Null
+{
+    DeviceContext::DeviceContext(bool isImmediate, int64 simulatedLatency)
+    : _simulatedLatency(simulatedLatency)
+    , _isImmediate(isImmediate)
+    {
+    }
+
+    DeviceContext::~DeviceContext()
+    {
+    }
+
+    void                            DeviceContext::BeginCommandList()
+    {
+    }
+
+    intrusive_ptr<CommandList>      DeviceContext::ResolveCommandList()
+    {
+            //  all work has already been performed when it was issued; so
+            //  there's nothing to record in a command list
+        return intrusive_ptr<CommandList>();
+    }
+
+    void                            DeviceContext::CommitCommandList(CommandList& commandList)
+    {
+    }
+
+    intrusive_ptr<DeviceContext>    DeviceContext::GetImmediateContext(IDevice* device)
+    {
+        if (device) {
+            IDeviceNull* nullDevice = 
+                (IDeviceNull*)device->QueryInterface(*(GUID*)nullptr);
+            if (nullDevice) {
+                return nullDevice->GetImmediateContext();
+            }
+        }
+        return intrusive_ptr<DeviceContext>();
+    }
+
+    intrusive_ptr<DeviceContext>    DeviceContext::CreateDeferredContext(IDevice* device)
+    {
+        if (device) {
+            IDeviceNull* nullDevice = 
+                (IDeviceNull*)device->QueryInterface(*(GUID*)nullptr);
+            if (nullDevice) {
+                return nullDevice->CreateDeferredContext();
+            }
+        }
+        return intrusive_ptr<DeviceContext>();
+    }
+
+    ObjectFactory::ObjectFactory() {}
+    ObjectFactory::ObjectFactory(IDevice* device) {}
+    ObjectFactory::ObjectFactory(const Underlying::Resource& resource) {}
+
+    namespace Underlying
+    {
+        Resource::Resource(size_t dataSize)
+        : _data(new uint8[dataSize])
+        , _dataSize(dataSize)
+        {
+        }
+
+        Resource::~Resource()
+        {
+        }
+    }
+}}
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "Resource.h"
+#include "Types.h"
+#include "Format.h"
+#include "../../IDevice_Forward.h"
+#include "../../../Utility/Threading/ThreadingUtils.h"
+#include "../../../Utility/IntrusivePtr.h"
+
+namespace RenderCore { class Device; class DeviceNull; }
+
+namespace RenderCore { namespace Metal_Null
+{
+    class CommandList : public RefCountedObject
+    {
+    public:
+    };
+
+        ///
+        /// <summary>Device context for the null device</summary>
+        ///
+        /// There is no command buffer behind this context; all work is done
+        /// on the CPU at the point it is issued. Command lists are just empty
+        /// markers, so the ordering logic in clients still runs normally.
+        ///
+        /// The context can simulate GPU latency for event queries: a query
+        /// ended on this context won't be triggered until the given number of
+        /// performance counter ticks have passed.
+        ///
+    class DeviceContext : public RefCountedObject
+    {
+    public:
+        void                            BeginCommandList();
+        intrusive_ptr<CommandList>      ResolveCommandList();
+        void                            CommitCommandList(CommandList& commandList);
+        bool                            IsImmediate() const                 { return _isImmediate; }
+
+        static intrusive_ptr<DeviceContext> GetImmediateContext(IDevice* device);
+        static intrusive_ptr<DeviceContext> CreateDeferredContext(IDevice* device);
+
+        void                            SetSimulatedLatency(int64 ticks)    { _simulatedLatency = ticks; }
+        int64                           GetSimulatedLatency() const         { return _simulatedLatency; }
+
+        DeviceContext*                  GetUnderlying()                     { return this; }
+
+        ~DeviceContext();
+    private:
+        int64       _simulatedLatency;
+        bool        _isImmediate;
+
+        DeviceContext(bool isImmediate, int64 simulatedLatency);
+
+        friend class RenderCore::Device;
+        friend class RenderCore::DeviceNull;
+    };
+
+    class ObjectFactory
+    {
+    public:
+        ObjectFactory();
+        ObjectFactory(IDevice* device);
+        ObjectFactory(const Underlying::Resource& resource);
+    };
+}}
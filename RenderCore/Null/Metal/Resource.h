@@ -0,0 +1,42 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../../../Utility/Threading/ThreadingUtils.h"
+#include "../../../Utility/IntrusivePtr.h"
+#include "../../../Core/Types.h"
+#include <memory>
+
+namespace RenderCore { namespace Metal_Null
+{
+    namespace Underlying
+    {
+            ///
+            /// <summary>Host memory resource for the null device</summary>
+            ///
+            /// The null device has no GPU memory; every resource is just a
+            /// block of host memory. Platform layers (eg, BufferUploads) derive
+            /// from this type to attach their own description of the contents.
+            ///
+        class Resource : public RefCountedObject
+        {
+        public:
+            void*           GetData()           { return _data.get(); }
+            const void*     GetData() const     { return _data.get(); }
+            size_t          GetDataSize() const { return _dataSize; }
+
+            Resource(size_t dataSize);
+            virtual ~Resource();
+        private:
+            std::unique_ptr<uint8[]>    _data;
+            size_t                      _dataSize;
+
+            Resource(const Resource&);
+            Resource& operator=(const Resource&);
+        };
+    }
+}}
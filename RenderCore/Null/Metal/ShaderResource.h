@@ -0,0 +1,25 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "Resource.h"
+
+namespace RenderCore { namespace Metal_Null
+{
+    class ShaderResourceView
+    {
+    public:
+        typedef Underlying::Resource*   UnderlyingResource;
+        typedef Underlying::Resource*   UnderlyingType;
+        Underlying::Resource*           GetUnderlying() const { return _resource.get(); }
+
+        ShaderResourceView() {}
+        explicit ShaderResourceView(Underlying::Resource* resource) : _resource(resource) {}
+    private:
+        intrusive_ptr<Underlying::Resource>   _resource;
+    };
+}}
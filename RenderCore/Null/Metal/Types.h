@@ -0,0 +1,30 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../../../Utility/Threading/ThreadingUtils.h"
+#include "../../../Utility/IntrusivePtr.h"
+#include "../../../Core/Types.h"
+
+namespace RenderCore { namespace Metal_Null
+{
+    namespace Underlying
+    {
+            /// <summary>Simulated GPU event query</summary>
+            /// There is no GPU to signal the event, so the query records the time
+            /// (in performance counter ticks) at which it should be considered
+            /// triggered. See DeviceContext::SetSimulatedLatency()
+        class Query : public RefCountedObject
+        {
+        public:
+            int64       _retireTime;
+            Query() : _retireTime(0) {}
+        };
+    }
+
+    typedef intrusive_ptr<Underlying::Query>    UnderlyingQuery;
+}}
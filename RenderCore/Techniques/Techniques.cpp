@@ -162,10 +162,10 @@ namespace RenderCore { namespace Techniques
         }
         
         uint64 globalHashWithInterface = inputHash ^ techniqueInterface.GetHashValue();
-        auto i = std::lower_bound(_globalToResolved.begin(), _globalToResolved.end(), globalHashWithInterface, CompareFirst<uint64, ResolvedShader>());
-        if (i!=_globalToResolved.cend() && i->first == globalHashWithInterface) {
-            if (i->second._shaderProgram && (i->second._shaderProgram->GetDependencyValidation().GetValidationIndex()!=0)) {
-                ResolveAndBind(i->second, globalState, techniqueInterface);
+        auto* i = _globalToResolved.Find(globalHashWithInterface);
+        if (i) {
+            if (i->_shaderProgram && (i->_shaderProgram->GetDependencyValidation().GetValidationIndex()!=0)) {
+                ResolveAndBind(*i, globalState, techniqueInterface);
             }
 
             #if defined(CHECK_TECHNIQUE_HASH_CONFLICTS)
@@ -173,16 +173,16 @@ namespace RenderCore { namespace Techniques
                 assert(ti!=_globalToResolvedTest.cend() && ti->first == globalHashWithInterface);
                 TestHashConflict(globalState, ti->second);
             #endif
-            return i->second;
+            return *i;
         }
 
         uint64 filteredHashValue = _baseParameters.CalculateFilteredHash(inputHash, globalState);
         uint64 filteredHashWithInterface = filteredHashValue ^ techniqueInterface.GetHashValue();
-        auto i2 = std::lower_bound(_filteredToResolved.begin(), _filteredToResolved.end(), filteredHashWithInterface, CompareFirst<uint64, ResolvedShader>());
-        if (i2!=_filteredToResolved.cend() && i2->first == filteredHashWithInterface) {
-            _globalToResolved.insert(i, std::make_pair(globalHashWithInterface, i2->second));
-            if (i2->second._shaderProgram && (i2->second._shaderProgram->GetDependencyValidation().GetValidationIndex()!=0)) {
-                ResolveAndBind(i2->second, globalState, techniqueInterface);
+        auto* i2 = _filteredToResolved.Find(filteredHashWithInterface);
+        if (i2) {
+            _globalToResolved.Insert(globalHashWithInterface, *i2);
+            if (i2->_shaderProgram && (i2->_shaderProgram->GetDependencyValidation().GetValidationIndex()!=0)) {
+                ResolveAndBind(*i2, globalState, techniqueInterface);
             }
 
             #if defined(CHECK_TECHNIQUE_HASH_CONFLICTS)
@@ -193,14 +193,14 @@ namespace RenderCore { namespace Techniques
                 assert(lti!=_localToResolvedTest.cend() && lti->first == filteredHashWithInterface);
                 TestHashConflict(globalState, lti->second);
             #endif
-            return i2->second;
+            return *i2;
         }
 
         ResolvedShader newResolvedShader;
         newResolvedShader._variationHash = filteredHashValue;
         ResolveAndBind(newResolvedShader, globalState, techniqueInterface);
-        _filteredToResolved.insert(i2, std::make_pair(filteredHashWithInterface, newResolvedShader));
-        _globalToResolved.insert(i, std::make_pair(globalHashWithInterface, newResolvedShader));
+        _filteredToResolved.Insert(filteredHashWithInterface, newResolvedShader);
+        _globalToResolved.Insert(globalHashWithInterface, newResolvedShader);
 
         #if defined(CHECK_TECHNIQUE_HASH_CONFLICTS)
             auto gti = std::lower_bound(_globalToResolvedTest.begin(), _globalToResolvedTest.end(), globalHashWithInterface, CompareFirst<uint64, HashConflictTest>());
@@ -212,6 +212,42 @@ namespace RenderCore { namespace Techniques
         return newResolvedShader;
     }
     
+    ResolvedShader      Technique::FindVariation(   const ParameterBox* globalState[ShaderParameters::Source::Max],
+                                                    ShaderParameters::Source::Enum perDrawSource,
+                                                    const SmallParameterBox& perDrawState,
+                                                    const TechniqueInterface& techniqueInterface)
+    {
+            //  SmallParameterBox produces the same hashes as ParameterBox, so we can
+            //  check _globalToResolved directly. Only when we need to filter, resolve or
+            //  rebind do we expand the per draw state into a full ParameterBox and
+            //  fall back to the normal path.
+        #if !defined(CHECK_TECHNIQUE_HASH_CONFLICTS)
+            uint64 inputHash = 0;
+            for (unsigned c=0; c<ShaderParameters::Source::Max; ++c) {
+                if (c == unsigned(perDrawSource)) {
+                    inputHash ^= perDrawState.GetParameterNamesHash();
+                    inputHash ^= perDrawState.GetHash() << (c*6);
+                } else {
+                    inputHash ^= globalState[c]->GetParameterNamesHash();
+                    inputHash ^= globalState[c]->GetHash() << (c*6);
+                }
+            }
+
+            auto* i = _globalToResolved.Find(inputHash ^ techniqueInterface.GetHashValue());
+            if (i && !(i->_shaderProgram && (i->_shaderProgram->GetDependencyValidation().GetValidationIndex()!=0))) {
+                return *i;
+            }
+        #endif
+
+        ParameterBox expandedState;
+        expandedState.MergeIn(perDrawState);
+        const ParameterBox* state[ShaderParameters::Source::Max];
+        for (unsigned c=0; c<ShaderParameters::Source::Max; ++c) {
+            state[c] = (c == unsigned(perDrawSource)) ? &expandedState : globalState[c];
+        }
+        return FindVariation(state, techniqueInterface);
+    }
+    
     void        Technique::ResolveAndBind(  ResolvedShader& resolvedShader, 
                                             const ParameterBox* globalState[ShaderParameters::Source::Max],
                                             const TechniqueInterface& techniqueInterface)
@@ -525,6 +561,18 @@ namespace RenderCore { namespace Techniques
         return _technique[techniqueIndex].FindVariation(globalState, techniqueInterface);
     }
 
+    ResolvedShader      ShaderType::FindVariation(  int techniqueIndex, 
+                                                    const ParameterBox* globalState[ShaderParameters::Source::Max],
+                                                    ShaderParameters::Source::Enum perDrawSource, 
+                                                    const SmallParameterBox& perDrawState,
+                                                    const TechniqueInterface& techniqueInterface)
+    {
+        if (techniqueIndex >= int(_technique.size()) || !_technique[techniqueIndex].IsValid()) {
+            return ResolvedShader();
+        }
+        return _technique[techniqueIndex].FindVariation(globalState, perDrawSource, perDrawState, techniqueInterface);
+    }
+
     ShaderType::ShaderType(const char resourceName[])
     {
         Data data;
@@ -601,11 +649,11 @@ namespace RenderCore { namespace Techniques
     {
             //  We need to specify the order of resources as they appear in 
             //  _globalUniformsStream
-        static auto HashGlobalTransform         = Hash64("GlobalTransform");
-        static auto HashGlobalState             = Hash64("GlobalState");
-        static auto HashFogSettings             = Hash64("FogSettings");
-        static auto HashShadowProjection        = Hash64("ArbitraryShadowProjection");
-        static auto HashOrthoShadowProjection   = Hash64("OrthogonalShadowProjection");
+        static auto HashGlobalTransform         = ConstExprHash64("GlobalTransform");
+        static auto HashGlobalState             = ConstExprHash64("GlobalState");
+        static auto HashFogSettings             = ConstExprHash64("FogSettings");
+        static auto HashShadowProjection        = ConstExprHash64("ArbitraryShadowProjection");
+        static auto HashOrthoShadowProjection   = ConstExprHash64("OrthogonalShadowProjection");
         binding.BindConstantBuffer(HashGlobalTransform, 0, 0);
         binding.BindConstantBuffer(HashGlobalState, 1, 0);
         binding.BindConstantBuffer(HashFogSettings, 2, 0);
@@ -617,11 +665,11 @@ namespace RenderCore { namespace Techniques
     {
             //  We need to specify the order of resources as they appear in 
             //  _globalUniformsStream
-        static auto HashGlobalTransform         = Hash64("GlobalTransform");
-        static auto HashGlobalState             = Hash64("GlobalState");
-        static auto HashFogSettings             = Hash64("FogSettings");
-        static auto HashShadowProjection        = Hash64("ShadowProjection");
-        static auto HashOrthoShadowProjection   = Hash64("OrthogonalShadowProjection");
+        static auto HashGlobalTransform         = ConstExprHash64("GlobalTransform");
+        static auto HashGlobalState             = ConstExprHash64("GlobalState");
+        static auto HashFogSettings             = ConstExprHash64("FogSettings");
+        static auto HashShadowProjection        = ConstExprHash64("ShadowProjection");
+        static auto HashOrthoShadowProjection   = ConstExprHash64("OrthogonalShadowProjection");
         binding.BindConstantBuffer(HashGlobalTransform, 0, 0);
         binding.BindConstantBuffer(HashGlobalState, 1, 0);
         binding.BindConstantBuffer(HashFogSettings, 2, 0);
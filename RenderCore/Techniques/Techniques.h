@@ -9,6 +9,7 @@
 #include "../Metal/Forward.h"
 #include "../Metal/InputLayout.h"        // required for _materialConstantsLayout in ResolvedShader
 #include "../../Utility/ParameterBox.h"
+#include "../../Utility/FlatHashMap.h"
 #include "../../Core/Prefix.h"
 #include "../../Core/Types.h"
 #include <string>
@@ -112,6 +113,10 @@ namespace RenderCore { namespace Techniques
     public:
         ResolvedShader      FindVariation(  const ParameterBox* globalState[ShaderParameters::Source::Max], 
                                             const TechniqueInterface& techniqueInterface);
+        ResolvedShader      FindVariation(  const ParameterBox* globalState[ShaderParameters::Source::Max], 
+                                            ShaderParameters::Source::Enum perDrawSource,
+                                            const SmallParameterBox& perDrawState,
+                                            const TechniqueInterface& techniqueInterface);
         bool                IsValid() const { return !_vertexShaderName.empty(); }
 
         Technique(Data& source, ::Assets::DirectorySearchRules* searchRules = nullptr, std::vector<const ::Assets::DependencyValidation*>* inherited = nullptr);
@@ -120,8 +125,8 @@ namespace RenderCore { namespace Techniques
     protected:
         std::string         _name;
         ShaderParameters    _baseParameters;
-        std::vector<std::pair<uint64, ResolvedShader>>  _filteredToResolved;
-        std::vector<std::pair<uint64, ResolvedShader>>  _globalToResolved;
+        FlatHashMap<ResolvedShader> _filteredToResolved;
+        FlatHashMap<ResolvedShader> _globalToResolved;
         std::string         _vertexShaderName;
         std::string         _pixelShaderName;
         std::string         _geometryShaderName;
@@ -161,6 +166,14 @@ namespace RenderCore { namespace Techniques
     {
     public:
         ResolvedShader      FindVariation(int techniqueIndex, const ParameterBox* globalState[ShaderParameters::Source::Max], const TechniqueInterface& techniqueInterface);
+
+            /// <summary>Find a variation, with one of the state boxes built on the stack</summary>
+            /// The entry globalState[perDrawSource] is ignored, and perDrawState is used instead.
+            /// When the variation has been seen before, this doesn't build a full ParameterBox
+            /// for perDrawState; so it's suited to per draw call material and geometry selectors.
+        ResolvedShader      FindVariation(  int techniqueIndex, const ParameterBox* globalState[ShaderParameters::Source::Max], 
+                                            ShaderParameters::Source::Enum perDrawSource, const SmallParameterBox& perDrawState,
+                                            const TechniqueInterface& techniqueInterface);
         const ::Assets::DependencyValidation&         GetDependencyValidation() const     { return *_validationCallback; }
 
         ShaderType(const char resourceName[]);
@@ -537,7 +537,7 @@ namespace RenderOverlays
             BoundInputLayout boundInputLayout(inputLayout, *_shaderProgram);
             BoundUniforms boundUniforms(*_shaderProgram);
             boundUniforms.BindConstantBuffer(
-                Hash64("ReciprocalViewportDimensions"), 0, 1,
+                ConstExprHash64("ReciprocalViewportDimensions"), 0, 1,
                 ReciprocalViewportDimensions_Elements, dimof(ReciprocalViewportDimensions_Elements));
             RenderCore::Techniques::TechniqueContext::BindGlobalUniforms(boundUniforms);
 
@@ -57,10 +57,10 @@ namespace Overlays
 
         _uniforms = BoundUniforms(*_shader);
         Techniques::TechniqueContext::BindGlobalUniforms(_uniforms);
-        _uniforms.BindConstantBuffer(Hash64("ArbitraryShadowProjection"), 0, 1);
-        _uniforms.BindConstantBuffer(Hash64("OrthogonalShadowProjection"), 1, 1);
-        _uniforms.BindConstantBuffer(Hash64("ScreenToShadowProjection"), 2, 1);
-        _uniforms.BindShaderResource(Hash64("DepthTexture"), 0, 1);
+        _uniforms.BindConstantBuffer(ConstExprHash64("ArbitraryShadowProjection"), 0, 1);
+        _uniforms.BindConstantBuffer(ConstExprHash64("OrthogonalShadowProjection"), 1, 1);
+        _uniforms.BindConstantBuffer(ConstExprHash64("ScreenToShadowProjection"), 2, 1);
+        _uniforms.BindShaderResource(ConstExprHash64("DepthTexture"), 0, 1);
         
         _depVal = std::make_shared<Assets::DependencyValidation>();
         ::Assets::RegisterAssetDependency(_depVal, &_shader->GetDependencyValidation());
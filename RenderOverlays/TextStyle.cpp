@@ -217,7 +217,7 @@ TextStyleResources::TextStyleResources(const Desc& desc)
     };
 
     BoundUniforms boundUniforms(shaderProgram);
-    boundUniforms.BindConstantBuffer(Hash64("ReciprocalViewportDimensions"), 0, 1, elements, dimof(elements));
+    boundUniforms.BindConstantBuffer(ConstExprHash64("ReciprocalViewportDimensions"), 0, 1, elements, dimof(elements));
 
     auto validationCallback = std::make_shared<Assets::DependencyValidation>();
     Assets::RegisterAssetDependency(validationCallback, &shaderProgram.GetDependencyValidation());
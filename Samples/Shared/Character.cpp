@@ -196,7 +196,7 @@ namespace Sample
         #if defined(ENABLE_XLNET)
             auto& stateWorld = Network::StatePropagation::StateWorld::GetInstance();
             auto stateBundle = stateWorld.CreateAuthoritativePacket(
-                sizeof(StateBundleContents), Hash64("PlayerCharacter"));
+                sizeof(StateBundleContents), ConstExprHash64("PlayerCharacter"));
 
             // Combine_InPlace(Float3(2048.f, 2048.f, 100.f), _localToWorld);
             Combine_InPlace(Float3(512.f, 512.f, 250.f), _localToWorld);
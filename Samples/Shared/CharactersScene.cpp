@@ -229,18 +229,47 @@ namespace Sample
             //      Separate state preparation from rendering, so we can profile
             //      them both separately
             //  
+            //  Characters that share the same model can have their skeletons
+            //  evaluated together in a single batch. So look for runs of state bins
+            //  with the same model.
+        std::vector<RenderCore::Assets::ModelRenderer::PreparedAnimation*> batch;
         auto si = _pimpl->_preallocatedState.begin();
-        for (auto i=_pimpl->_stateCache.begin(); i!=_pimpl->_stateCache.end(); ++i, ++si) {
+        for (auto i=_pimpl->_stateCache.begin(); i!=_pimpl->_stateCache.end();) {
+            auto batchEnd = i+1;
+            while (batchEnd!=_pimpl->_stateCache.end() && batchEnd->_model == i->_model) { ++batchEnd; }
+
+            batch.clear();
+            auto batchStateStart = si;
+            for (auto i2=i; i2!=batchEnd; ++i2, ++si) {
+                si->_animState = RenderCore::Assets::AnimationState(i2->_time, i2->_animation);
+                batch.push_back(&*si);
+            }
+
+                // 2 prepare steps
+                //      * first, we need to generate the transform matrices
+                //      * second, we generate the animated vertex positions
+                //  If the batch fails (eg, because of a pending or invalid resource), fall back
+                //  to generating the transforms one character at a time, so that one bad
+                //  character doesn't stop the others from animating.
+            const auto& model = *i->_model;
+            bool batchPrepared = false;
             TRY {
-                const auto& model = *i->_model;
-                    // 2 prepare steps
-                    //      * first, we need to generate the transform matrices
-                    //      * second, we generate the animated vertex positions
-                si->_animState = RenderCore::Assets::AnimationState(i->_time, i->_animation);
-                model.GetPrepareMachine().PrepareAnimation(context, *si);
-                model.GetRenderer().PrepareAnimation(context, *si, model.GetPrepareMachine().GetSkeletonBinding());
+                model.GetPrepareMachine().PrepareAnimationBatch(context, AsPointer(batch.begin()), unsigned(batch.size()));
+                batchPrepared = true;
             } CATCH(const std::exception&) {
             } CATCH_END
+
+            for (auto s=batchStateStart; s!=si; ++s) {
+                TRY {
+                    if (!batchPrepared) {
+                        model.GetPrepareMachine().PrepareAnimation(context, *s);
+                    }
+                    model.GetRenderer().PrepareAnimation(context, *s, model.GetPrepareMachine().GetSkeletonBinding());
+                } CATCH(const std::exception&) {
+                } CATCH_END
+            }
+
+            i = batchEnd;
         }
 
         GPUProfiler::TriggerEvent(*context, g_gpuProfiler.get(), "PrepareAnimation", GPUProfiler::End);
@@ -107,19 +107,21 @@ namespace SceneEngine
     {
         TRY {
             ParameterBox materialParameters;
-            ParameterBox geoParameters;
+            SmallParameterBox geoParameters;
             geoParameters.SetParameter("GEO_HAS_NORMAL", 1);
             const ParameterBox* state[] = {
-                &geoParameters, &parserContext.GetTechniqueContext()._globalEnvironmentState,
+                nullptr, &parserContext.GetTechniqueContext()._globalEnvironmentState,
                 &parserContext.GetTechniqueContext()._runtimeState, &materialParameters
             };
 
             Techniques::TechniqueInterface techniqueInterface(Metal::GlobalInputLayouts::PN);
             Techniques::TechniqueContext::BindGlobalUniforms(techniqueInterface);
-            techniqueInterface.BindConstantBuffer(Hash64("LocalTransform"), 0, 1);
+            techniqueInterface.BindConstantBuffer(ConstExprHash64("LocalTransform"), 0, 1);
 
             auto& shaderType = ::Assets::GetAssetDep<Techniques::ShaderType>("game/xleres/cloudvolume.txt");
-            auto variation = shaderType.FindVariation(techniqueIndex, state, techniqueInterface);
+            auto variation = shaderType.FindVariation(
+                techniqueIndex, state, Techniques::ShaderParameters::Source::Geometry,
+                geoParameters, techniqueInterface);
             if (variation._shaderProgram != nullptr) {
                 context->Bind(*variation._shaderProgram);
                 if (variation._boundLayout) {
@@ -313,10 +315,10 @@ namespace SceneEngine
             // context->Bind(inputLayout);
 
             ParameterBox materialParameters;
-            ParameterBox geoParameters;
+            SmallParameterBox geoParameters;
             geoParameters.SetParameter("GEO_HAS_NORMAL", 1);
             const ParameterBox* state[] = {
-                &geoParameters, &parserContext.GetTechniqueContext()._globalEnvironmentState,
+                nullptr, &parserContext.GetTechniqueContext()._globalEnvironmentState,
                 &parserContext.GetTechniqueContext()._runtimeState, &materialParameters
             };
 
@@ -324,7 +326,9 @@ namespace SceneEngine
             Techniques::TechniqueContext::BindGlobalUniforms(techniqueInterface);
 
             auto& shaderType = ::Assets::GetAssetDep<Techniques::ShaderType>("game/xleres/illum.txt");
-            auto variation = shaderType.FindVariation(techniqueIndex, state, techniqueInterface);
+            auto variation = shaderType.FindVariation(
+                techniqueIndex, state, Techniques::ShaderParameters::Source::Geometry,
+                geoParameters, techniqueInterface);
             if (variation._shaderProgram != nullptr) {
                 context->Bind(*variation._shaderProgram);
                 if (variation._boundLayout) {
@@ -250,11 +250,11 @@ namespace SceneEngine
 
         for (unsigned c=0; c<dimof(bu); ++c) {
             Techniques::TechniqueContext::BindGlobalUniforms(*bu[c]);
-            bu[c]->BindConstantBuffer(Hash64("ArbitraryShadowProjection"), 0, 1);
-            bu[c]->BindConstantBuffer(Hash64("LightBuffer"), 1, 1);
-            bu[c]->BindConstantBuffer(Hash64("ShadowParameters"), 2, 1);
-            bu[c]->BindConstantBuffer(Hash64("ScreenToShadowProjection"), 3, 1);
-            bu[c]->BindConstantBuffer(Hash64("OrthogonalShadowProjection"), 4, 1);
+            bu[c]->BindConstantBuffer(ConstExprHash64("ArbitraryShadowProjection"), 0, 1);
+            bu[c]->BindConstantBuffer(ConstExprHash64("LightBuffer"), 1, 1);
+            bu[c]->BindConstantBuffer(ConstExprHash64("ShadowParameters"), 2, 1);
+            bu[c]->BindConstantBuffer(ConstExprHash64("ScreenToShadowProjection"), 3, 1);
+            bu[c]->BindConstantBuffer(ConstExprHash64("OrthogonalShadowProjection"), 4, 1);
         }
 
         _validationCallback = std::make_shared<::Assets::DependencyValidation>();
@@ -301,7 +301,7 @@ namespace SceneEngine
             definesTable);
 
         auto ambientLightUniforms = std::make_unique<Metal::BoundUniforms>(std::ref(*ambientLight));
-        ambientLightUniforms->BindConstantBuffer(Hash64("AmbientLightBuffer"), 0, 1);
+        ambientLightUniforms->BindConstantBuffer(ConstExprHash64("AmbientLightBuffer"), 0, 1);
 
         auto validationCallback = std::make_shared<::Assets::DependencyValidation>();
         ::Assets::RegisterAssetDependency(validationCallback, &ambientLight->GetDependencyValidation());
@@ -630,8 +630,8 @@ namespace SceneEngine
 
         BoundUniforms setupUniforms(Assets::GetAssetDep<Metal::CompiledShaderByteCode>("game/xleres/Ocean/FFT.csh:Setup:cs_*", "DO_INVERSE=0"));
         Techniques::TechniqueContext::BindGlobalUniforms(setupUniforms);
-        setupUniforms.BindConstantBuffer(Hash64("OceanRenderingConstants"), 0, 1);
-        setupUniforms.BindConstantBuffer(Hash64("OceanMaterialSettings"), 1, 1);
+        setupUniforms.BindConstantBuffer(ConstExprHash64("OceanRenderingConstants"), 0, 1);
+        setupUniforms.BindConstantBuffer(ConstExprHash64("OceanMaterialSettings"), 1, 1);
         setupUniforms.Apply(*context, 
             parserContext.GetGlobalUniformsStream(),
             UniformsStream(nullptr, cbs, dimof(cbs)));
@@ -670,8 +670,8 @@ namespace SceneEngine
         if (!fftBuffer._normalsTextureUAV.empty()) {
             BoundUniforms buildNormalsUniforms(Assets::GetAssetDep<Metal::CompiledShaderByteCode>(fftBuffer._useDerivativesMapForNormals ? "game/xleres/Ocean/OceanNormals.csh:BuildDerivatives:cs_*" : "game/xleres/Ocean/OceanNormals.csh:BuildNormals:cs_*"));
             Techniques::TechniqueContext::BindGlobalUniforms(buildNormalsUniforms);
-            buildNormalsUniforms.BindConstantBuffer(Hash64("OceanRenderingConstants"), 0, 1);
-            buildNormalsUniforms.BindConstantBuffer(Hash64("OceanMaterialSettings"), 1, 1);
+            buildNormalsUniforms.BindConstantBuffer(ConstExprHash64("OceanRenderingConstants"), 0, 1);
+            buildNormalsUniforms.BindConstantBuffer(ConstExprHash64("OceanMaterialSettings"), 1, 1);
             buildNormalsUniforms.Apply(*context, 
                 parserContext.GetGlobalUniformsStream(),
                 UniformsStream(nullptr, cbs, dimof(cbs)));
@@ -1061,28 +1061,27 @@ namespace SceneEngine
         ConstantBuffer oceanGridConstants(&gridConstants, sizeof(gridConstants));
         ConstantBuffer oceanLightingConstants(&oceanLightingSettings, sizeof(OceanLightingSettings));
 
-        static auto HashMaterialConstants           = Hash64("OceanMaterialSettings");
-        static auto HashGridConstants               = Hash64("GridConstants");
-        static auto HashRenderingConstants          = Hash64("OceanRenderingConstants");
-        static auto HashLightingConstants           = Hash64("OceanLightingSettings");
-        static auto HashDynamicReflectionTexture    = Hash64("DynamicReflectionTexture");
-        static auto HashSurfaceSpecularity          = Hash64("SurfaceSpecularity");
+        static auto HashMaterialConstants           = ConstExprHash64("OceanMaterialSettings");
+        static auto HashGridConstants               = ConstExprHash64("GridConstants");
+        static auto HashRenderingConstants          = ConstExprHash64("OceanRenderingConstants");
+        static auto HashLightingConstants           = ConstExprHash64("OceanLightingSettings");
+        static auto HashDynamicReflectionTexture    = ConstExprHash64("DynamicReflectionTexture");
+        static auto HashSurfaceSpecularity          = ConstExprHash64("SurfaceSpecularity");
         const bool useWireframeRender               = Tweakable("OceanRenderWireframe", false);
         if (!useWireframeRender) {
 
             auto& shaderType = Assets::GetAssetDep<Techniques::ShaderType>("game/xleres/ocean/oceanmaterial.txt");
 
-            ParameterBox materialParameters;
+            SmallParameterBox materialParameters;
             materialParameters.SetParameter("MAT_USE_DERIVATIVES_MAP", unsigned(fftBuffer._useDerivativesMapForNormals));
             materialParameters.SetParameter("MAT_USE_SHALLOW_WATER", shallowWater && unsigned(shallowWater->_simulatingGridsCount!=0));
             materialParameters.SetParameter("MAT_DO_REFRACTION", refractionsBox!=nullptr);
             materialParameters.SetParameter("MAT_SKY_PROJECTION", skyProjectionType);
             materialParameters.SetParameter("MAT_DYNAMIC_REFLECTION", int(doDynamicReflection));
             materialParameters.SetParameter("SHALLOW_WATER_TILE_DIMENSION", shallowWater?int(shallowWater->_gridDimension):0);
-            ParameterBox dummyBox;
             const ParameterBox* state[] = {
                 &MaterialState_Blank, &parserContext.GetTechniqueContext()._globalEnvironmentState,
-                &parserContext.GetTechniqueContext()._runtimeState, &materialParameters
+                &parserContext.GetTechniqueContext()._runtimeState, nullptr
             };
             
             Techniques::TechniqueInterface techniqueInterface;
@@ -1094,7 +1093,9 @@ namespace SceneEngine
             techniqueInterface.BindShaderResource(HashDynamicReflectionTexture, 0, 1);
             techniqueInterface.BindShaderResource(HashSurfaceSpecularity, 1, 1);
 
-            auto variation = shaderType.FindVariation(techniqueIndex, state, techniqueInterface);
+            auto variation = shaderType.FindVariation(
+                techniqueIndex, state, Techniques::ShaderParameters::Source::Material,
+                materialParameters, techniqueInterface);
             if (variation._shaderProgram != nullptr) {
                 context->Bind(*variation._shaderProgram);
                 if (variation._boundLayout) {
@@ -44,6 +44,8 @@
 #include "../Utility/Streams/FileUtils.h"
 #include "../Utility/Streams/DataSerialize.h"
 #include "../Utility/Streams/PathUtils.h"
+#include "../Utility/Threading/JobSystem.h"
+#include "../Utility/Threading/ThreadingUtils.h"
 #include "../Core/Types.h"
 
 #include <random>
@@ -234,6 +236,26 @@ namespace SceneEngine
         }
     }
 
+    static void RehashStringTable(std::vector<uint8>& filenamesBuffer)
+    {
+            //  Each entry is a uint64 hash of the string, followed by the null terminated string
+        if (filenamesBuffer.empty()) return;
+        auto* i = AsPointer(filenamesBuffer.begin());
+        auto* end = i + filenamesBuffer.size();
+        while (i != end) {
+            if (size_t(end - i) < sizeof(uint64)) {
+                assert(0);
+                break;  // not enough room for a full hash code. Seems like the string table is corrupted
+            }
+            auto* hash = (uint64*)i;
+            i += sizeof(uint64);
+            auto* stringStart = i;
+            while (i != end && *i) { ++i; }
+            *hash = Hash64(stringStart, i);
+            if (i != end) { ++i; }      // (skip the null character)
+        }
+    }
+
     Placements::Placements(const ResChar filename[])
     {
             //
@@ -252,7 +274,8 @@ namespace SceneEngine
 
         TRY {
             BasicFile file(filename, "rb");
-            auto chunks = LoadChunkTable(file);
+            uint32 hashFamily = 0;
+            auto chunks = LoadChunkTable(file, hashFamily);
             auto i = std::find_if(
                 chunks.begin(), chunks.end(), 
                 [](const ChunkHeader& hdr) { return hdr._type == ChunkType_Placements; });
@@ -272,6 +295,14 @@ namespace SceneEngine
             filenamesBuffer.resize(hdr._filenamesBufferSize);
             file.Read(AsPointer(objects.begin()), sizeof(ObjectReference), hdr._objectRefCount);
             file.Read(AsPointer(filenamesBuffer.begin()), 1, hdr._filenamesBufferSize);
+
+                //  The string table stores a hash with each filename. If the file was
+                //  built with a different hash function (eg, files saved before the hash
+                //  family was recorded), we must rebuild them. The upgraded hashes are
+                //  written back the next time the placements are saved.
+            if (hashFamily != HashFamily_Active) {
+                RehashStringTable(filenamesBuffer);
+            }
         } CATCH (const Utility::Exceptions::IOException&) { // catch file errors
         } CATCH_END
 
@@ -323,7 +354,25 @@ namespace SceneEngine
             const PlacementCell& cell,
             const uint64* filterStart = nullptr, const uint64* filterEnd = nullptr);
 
+            //  Render many cells at once. Culling for all of the cells is done
+            //  in parallel first, and then the visible objects are prepared for
+            //  rendering (in cell order)
+        void Render(
+            RenderCore::Metal::DeviceContext* context,
+            LightingParserContext& parserContext, 
+            const PlacementCell* cellsBegin, const PlacementCell* cellsEnd);
+
         typedef ModelRenderer::SortedModelDrawCalls PreparedState;
+
+            //  A visible object that is waiting for ModelRenderer::Prepare() to be
+            //  called. The renderer is resolved on the main thread (because it may
+            //  need to be created), and then Prepare() is called in parallel during EndRender()
+        class PendingObject
+        {
+        public:
+            ModelRenderer*  _renderer;
+            Float4x4        _localToWorld;
+        };
         
         auto GetCachedModel(const ResChar filename[]) -> const ModelScaffold&;
         auto GetCachedPlacements(uint64 hash, const ResChar filename[]) -> const Placements&;
@@ -345,6 +394,8 @@ namespace SceneEngine
             LRUCache<ModelRenderer>             _modelRenderers;
             RenderCore::Assets::SharedStateSet  _sharedStates;
             PreparedState                       _preparedRenders;
+            std::vector<PendingObject>          _pendingObjects;
+            std::vector<std::unique_ptr<PreparedState>> _prepareBuckets;     // (one per prepare job; reused every frame)
 
             Cache()
             : _modelScaffolds(2000)
@@ -387,6 +438,7 @@ namespace SceneEngine
         std::vector<std::pair<uint64, CellRenderInfo>> _cellOverrides;
         std::vector<std::pair<uint64, CellRenderInfo>> _cells;
         std::unique_ptr<Cache> _cache;
+        std::shared_ptr<JobSystem> _jobSystem;
 
         std::shared_ptr<RenderCore::Assets::IModelFormat> _modelFormat;
 
@@ -396,6 +448,31 @@ namespace SceneEngine
             const CellRenderInfo& renderInfo,
             const Float3x4& cellToWorld,
             const uint64* filterStart, const uint64* filterEnd);
+
+        void RenderObjects(
+            LightingParserContext& parserContext, 
+            const CellRenderInfo& renderInfo,
+            const Float3x4& cellToWorld,
+            const unsigned visibleObjs[], size_t visibleObjCount,
+            const uint64* filterStart, const uint64* filterEnd);
+
+        const CellRenderInfo& GetRenderInfo(const PlacementCell& cell);
+        const CellRenderInfo* FindRenderInfo(uint64 filenameHash) const;
+
+            //  Cull many cells against many views, across the shared job system.
+            //  "results" must have (cellCount * viewCount) elements; the visible objects
+            //  for cell "c" in view "v" are written to results[c*viewCount+v] (in sorted 
+            //  order). Cells without a quad tree are culled on the calling thread.
+        void CullCells(
+            const CellRenderInfo* const cells[], const Float3x4 cellToWorlds[], size_t cellCount,
+            const Float4x4 worldToClips[], unsigned viewCount,
+            std::vector<unsigned> results[]);
+
+            //  Calls ModelRenderer::Prepare() for every pending object, across the shared
+            //  job system. Each job writes to its own bucket, and the buckets are merged into
+            //  _cache->_preparedRenders in job order (so the result doesn't depend on
+            //  thread timing)
+        void PrepareObjects();
     };
 
     class PlacementsManager::Pimpl
@@ -410,6 +487,7 @@ namespace SceneEngine
     void PlacementsRenderer::BeginRender(RenderCore::Metal::DeviceContext* devContext)
     {
         _cache->_preparedRenders.Reset();
+        _cache->_pendingObjects.clear();
         _cache->_sharedStates.CaptureState(devContext);
     }
 
@@ -420,6 +498,8 @@ namespace SceneEngine
     {
         TRY 
         {
+            PrepareObjects();
+
             #if MODEL_FORMAT == MODEL_FORMAT_RUNTIME
                 ModelRenderer::RenderPrepared(
                     ModelRenderer::Context(context, parserContext, techniqueIndex, _cache->_sharedStates),
@@ -541,42 +621,179 @@ namespace SceneEngine
             return;
         }
 
+        TRY 
+        {
+            Render(context, parserContext, GetRenderInfo(cell), cell._cellToWorld, filterStart, filterEnd);
+        } 
+        CATCH(const ::Assets::Exceptions::InvalidResource& e) { parserContext.Process(e); }
+        CATCH(const ::Assets::Exceptions::PendingResource& e) { parserContext.Process(e); }
+        CATCH (...) {} 
+        CATCH_END
+    }
+
+    auto PlacementsRenderer::GetRenderInfo(const PlacementCell& cell) -> const CellRenderInfo&
+    {
             //  We need to look in the "_cellOverride" list first.
             //  The overridden cells are actually designed for tools. When authoring 
             //  placements, we need a way to render them before they are flushed to disk.
-        TRY 
-        {
-            auto i = LowerBound(_cellOverrides, cell._filenameHash);
-            if (i != _cellOverrides.end() && i->first == cell._filenameHash) {
-                Render(context, parserContext, i->second, cell._cellToWorld, filterStart, filterEnd);
-            } else {
-                auto i2 = LowerBound(_cells, cell._filenameHash);
-                if (i2 == _cells.end() || i2->first != cell._filenameHash) {
-                    CellRenderInfo newRenderInfo;
-                    newRenderInfo._placements = &::Assets::GetAssetDep<Placements>(cell._filename);
-                    i2 = _cells.insert(i2, std::make_pair(cell._filenameHash, std::move(newRenderInfo)));
+        auto i = LowerBound(_cellOverrides, cell._filenameHash);
+        if (i != _cellOverrides.end() && i->first == cell._filenameHash) {
+            return i->second;
+        }
+
+        auto i2 = LowerBound(_cells, cell._filenameHash);
+        if (i2 == _cells.end() || i2->first != cell._filenameHash) {
+            CellRenderInfo newRenderInfo;
+            newRenderInfo._placements = &::Assets::GetAssetDep<Placements>(cell._filename);
+            i2 = _cells.insert(i2, std::make_pair(cell._filenameHash, std::move(newRenderInfo)));
+        } else {
+                // check if we need to reload placements
+            if (i2->second._placements->GetDependencyValidation().GetValidationIndex() != 0) {
+                i2->second._placements = &::Assets::GetAssetDep<Placements>(cell._filename);
+                i2->second._quadTree.reset();
+            }
+        }
+
+        if (!i2->second._quadTree) {
+            i2->second._quadTree = std::make_unique<PlacementsQuadTree>(
+                &i2->second._placements->GetObjectReferences()->_cellSpaceBoundary,
+                sizeof(Placements::ObjectReference), 
+                i2->second._placements->GetObjectReferenceCount());
+        }
+
+        return i2->second;
+    }
+
+    auto PlacementsRenderer::FindRenderInfo(uint64 filenameHash) const -> const CellRenderInfo*
+    {
+            //  Lookup only; never loads or inserts. Same search order as GetRenderInfo()
+        auto i = LowerBound(_cellOverrides, filenameHash);
+        if (i != _cellOverrides.end() && i->first == filenameHash) {
+            return &i->second;
+        }
+
+        auto i2 = LowerBound(_cells, filenameHash);
+        if (i2 != _cells.end() && i2->first == filenameHash) {
+            return &i2->second;
+        }
+        return nullptr;
+    }
+
+    void PlacementsRenderer::Render(
+        RenderCore::Metal::DeviceContext* context,
+        LightingParserContext& parserContext, 
+        const PlacementCell* cellsBegin, const PlacementCell* cellsEnd)
+    {
+            //  First, find the cells that are visible, and make sure that
+            //  they are loaded. This must happen on this thread, because it
+            //  can modify the lists of cells.
+            //  GetRenderInfo() can insert into "_cells" (which is a sorted vector),
+            //  so we can't hold onto the references it returns while loading.
+            //  Only once every visible cell is loaded do we collect pointers.
+        std::vector<const PlacementCell*> visibleCells;
+        visibleCells.reserve(cellsEnd - cellsBegin);
+
+        const auto& worldToProjection = parserContext.GetProjectionDesc()._worldToProjection;
+        for (auto c=cellsBegin; c!=cellsEnd; ++c) {
+            if (CullAABB_Aligned(AsFloatArray(worldToProjection), c->_aabbMin, c->_aabbMax)) {
+                continue;
+            }
+
+            TRY {
+                GetRenderInfo(*c);
+                visibleCells.push_back(c);
+            }
+            CATCH(const ::Assets::Exceptions::InvalidResource& e) { parserContext.Process(e); }
+            CATCH(const ::Assets::Exceptions::PendingResource& e) { parserContext.Process(e); }
+            CATCH (...) {} 
+            CATCH_END
+        }
+
+        std::vector<const CellRenderInfo*> renderInfos;
+        std::vector<Float3x4> cellToWorlds;
+        renderInfos.reserve(visibleCells.size());
+        cellToWorlds.reserve(visibleCells.size());
+        for (auto c=visibleCells.cbegin(); c!=visibleCells.cend(); ++c) {
+            auto* renderInfo = FindRenderInfo((*c)->_filenameHash);
+            assert(renderInfo);
+            renderInfos.push_back(renderInfo);
+            cellToWorlds.push_back((*c)->_cellToWorld);
+        }
+
+            //  Now do the culling for all cells in parallel, and then
+            //  prepare the visible objects serially (in a consistent order)
+        std::vector<std::vector<unsigned>> visibleObjects(renderInfos.size());
+        CullCells(
+            AsPointer(renderInfos.cbegin()), AsPointer(cellToWorlds.cbegin()), renderInfos.size(),
+            &worldToProjection, 1, AsPointer(visibleObjects.begin()));
+
+        for (size_t c=0; c<renderInfos.size(); ++c) {
+            TRY {
+                RenderObjects(
+                    parserContext, *renderInfos[c], cellToWorlds[c],
+                    AsPointer(visibleObjects[c].cbegin()), visibleObjects[c].size(),
+                    nullptr, nullptr);
+            }
+            CATCH(const ::Assets::Exceptions::InvalidResource& e) { parserContext.Process(e); }
+            CATCH(const ::Assets::Exceptions::PendingResource& e) { parserContext.Process(e); }
+            CATCH (...) {} 
+            CATCH_END
+        }
+    }
+
+    void PlacementsRenderer::CullCells(
+        const CellRenderInfo* const cells[], const Float3x4 cellToWorlds[], size_t cellCount,
+        const Float4x4 worldToClips[], unsigned viewCount,
+        std::vector<unsigned> results[])
+    {
+            //  (the culling functions require 16 byte aligned matrices)
+        std::unique_ptr<Float4x4, AlignedDeletor> cellToClips(
+            (Float4x4*)XlMemAlign(sizeof(Float4x4) * std::max(cellCount * viewCount, size_t(1)), 16));
+        std::vector<PlacementsQuadTree::CullJob> jobs;
+        std::vector<size_t> jobResultIndices;
+        jobs.reserve(cellCount * viewCount);
+        jobResultIndices.reserve(cellCount * viewCount);
+        std::vector<std::vector<unsigned>> jobResults;
+
+        for (size_t c=0; c<cellCount; ++c) {
+            auto& renderInfo = *cells[c];
+            for (unsigned v=0; v<viewCount; ++v) {
+                auto resultIndex = c*viewCount+v;
+                auto& cellToClip = cellToClips.get()[resultIndex];
+                cellToClip = Combine(cellToWorlds[c], worldToClips[v]);
+                results[resultIndex].clear();
+
+                auto objCount = renderInfo._placements->GetObjectReferenceCount();
+                if (!objCount) continue;
+                auto* objRef = renderInfo._placements->GetObjectReferences();
+
+                if (renderInfo._quadTree) {
+                    PlacementsQuadTree::CullJob job;
+                    job._tree = renderInfo._quadTree.get();
+                    job._cellToClipAligned = AsFloatArray(cellToClip);
+                    job._objCellSpaceBoundingBoxes = &objRef->_cellSpaceBoundary;
+                    job._objStride = sizeof(Placements::ObjectReference);
+                    jobs.push_back(job);
+                    jobResultIndices.push_back(resultIndex);
                 } else {
-                        // check if we need to reload placements
-                    if (i2->second._placements->GetDependencyValidation().GetValidationIndex() != 0) {
-                        i2->second._placements = &::Assets::GetAssetDep<Placements>(cell._filename);
-                        i2->second._quadTree.reset();
+                        // no quad tree (eg, overridden cells) -- just test every object
+                    for (unsigned o=0; o<objCount; ++o) {
+                        if (!CullAABB_Aligned(AsFloatArray(cellToClip), objRef[o]._cellSpaceBoundary.first, objRef[o]._cellSpaceBoundary.second)) {
+                            results[resultIndex].push_back(o);
+                        }
                     }
                 }
+            }
+        }
 
-                if (!i2->second._quadTree) {
-                    i2->second._quadTree = std::make_unique<PlacementsQuadTree>(
-                        &i2->second._placements->GetObjectReferences()->_cellSpaceBoundary,
-                        sizeof(Placements::ObjectReference), 
-                        i2->second._placements->GetObjectReferenceCount());
-                }
+        jobResults.resize(jobs.size());
+        PlacementsQuadTree::CalculateVisibleObjects_Parallel(
+            AsPointer(jobs.cbegin()), jobs.size(), AsPointer(jobResults.begin()),
+            *_jobSystem);
 
-                Render(context, parserContext, i2->second, cell._cellToWorld, filterStart, filterEnd);
-            }
-        } 
-        CATCH(const ::Assets::Exceptions::InvalidResource& e) { parserContext.Process(e); }
-        CATCH(const ::Assets::Exceptions::PendingResource& e) { parserContext.Process(e); }
-        CATCH (...) {} 
-        CATCH_END
+        for (size_t c=0; c<jobs.size(); ++c) {
+            results[jobResultIndices[c]] = std::move(jobResults[c]);
+        }
     }
 
     namespace Internal
@@ -695,9 +912,66 @@ namespace SceneEngine
                 _currentRenderer = hashedRenderer;
             }
 
-            auto localToWorld = Combine(obj._localToCell, cellToWorld);
-            _renderer->Prepare(cache._preparedRenders, cache._sharedStates, AsFloat4x4(localToWorld));
+            PlacementsRenderer::PendingObject pending;
+            pending._renderer = _renderer;
+            pending._localToWorld = AsFloat4x4(Combine(obj._localToCell, cellToWorld));
+            cache._pendingObjects.push_back(pending);
+        }
+    }
+
+    void PlacementsRenderer::PrepareObjects()
+    {
+        auto& cache = *_cache;
+        auto objectCount = cache._pendingObjects.size();
+        if (!objectCount) return;
+
+            //  Small numbers of objects aren't worth splitting up
+        const size_t minObjectsPerJob = 64;
+        auto jobCount = std::min(
+            size_t(_jobSystem->GetWorkerCount() + 1),
+            (objectCount + minObjectsPerJob - 1) / minObjectsPerJob);
+        if (jobCount <= 1) {
+            for (auto o=cache._pendingObjects.cbegin(); o!=cache._pendingObjects.cend(); ++o) {
+                o->_renderer->Prepare(cache._preparedRenders, cache._sharedStates, o->_localToWorld);
+            }
+            cache._pendingObjects.clear();
+            return;
+        }
+
+        while (cache._prepareBuckets.size() < jobCount) {
+            cache._prepareBuckets.push_back(std::make_unique<PreparedState>());
+        }
+
+        std::vector<PreparedState*> buckets;
+        buckets.reserve(jobCount);
+        for (size_t c=0; c<jobCount; ++c) {
+            cache._prepareBuckets[c]->Reset();
+            buckets.push_back(cache._prepareBuckets[c].get());
+        }
+
+            //  Each job is a contiguous range of objects, and writes to its own bucket
+        auto* objects = AsPointer(cache._pendingObjects.cbegin());
+        auto* bucketPtrs = AsPointer(buckets.cbegin());
+        auto* sharedStates = &cache._sharedStates;
+        _jobSystem->ParallelFor(
+            0, unsigned(jobCount), 1,
+            [objects, objectCount, jobCount, bucketPtrs, sharedStates](unsigned begin, unsigned end)
+            {
+                for (auto jobIndex=begin; jobIndex<end; ++jobIndex) {
+                    auto objBegin = objectCount * jobIndex / jobCount;
+                    auto objEnd = objectCount * (jobIndex+1) / jobCount;
+                    auto& bucket = *bucketPtrs[jobIndex];
+                    for (auto o=objBegin; o<objEnd; ++o) {
+                        objects[o]._renderer->Prepare(bucket, *sharedStates, objects[o]._localToWorld);
+                    }
+                }
+            },
+            "PlacementsPrepare");
+
+        for (size_t c=0; c<jobCount; ++c) {
+            cache._preparedRenders.Merge(*buckets[c]);
         }
+        cache._pendingObjects.clear();
     }
 
     void PlacementsRenderer::Render(
@@ -763,26 +1037,19 @@ namespace SceneEngine
 
             unsigned visibleObjs[10*1024];
             unsigned visibleObjCount = 0;
+            PlacementsQuadTree::WorkingStorage workingStorage;
             renderInfo._quadTree->CalculateVisibleObjects(
                 AsFloatArray(cellToCullSpace), &objRef->_cellSpaceBoundary,
                 sizeof(Placements::ObjectReference),
-                visibleObjs, visibleObjCount, dimof(visibleObjs));
+                visibleObjs, visibleObjCount, dimof(visibleObjs),
+                workingStorage);
 
                 // we have to sort to return to our expected order
             std::sort(visibleObjs, &visibleObjs[visibleObjCount]);
 
-            for (unsigned c=0; c<visibleObjCount; ++c) {
-                auto& obj = objRef[visibleObjs[c]];
-
-                if (doFilter) {
-                    while (filterIterator != filterEnd && *filterIterator < obj._guid) { ++filterIterator; }
-                    if (filterIterator == filterEnd || *filterIterator != obj._guid) { continue; }
-                }
-
-                helper.Render(
-                    *_cache, *_modelFormat, 
-                    filenamesBuffer, obj, cellToWorld, cameraPosition);
-            }
+            RenderObjects(
+                parserContext, renderInfo, cellToWorld, 
+                visibleObjs, visibleObjCount, filterStart, filterEnd);
 
         } else {
             for (unsigned c=0; c<placementCount; ++c) {
@@ -808,12 +1075,47 @@ namespace SceneEngine
         }
     }
 
+    void PlacementsRenderer::RenderObjects(
+        LightingParserContext& parserContext, 
+        const CellRenderInfo& renderInfo,
+        const Float3x4& cellToWorld,
+        const unsigned visibleObjs[], size_t visibleObjCount,
+        const uint64* filterStart, const uint64* filterEnd)
+    {
+            //  "visibleObjs" must be sorted (which also means the objects
+            //  are sorted by guid, and so we can step through the filter list)
+        auto& placements = *renderInfo._placements;
+        auto cameraPosition = ExtractTranslation(parserContext.GetProjectionDesc()._cameraToWorld);
+        cameraPosition = TransformPoint(InvertOrthonormalTransform(cellToWorld), cameraPosition);
+
+        const uint64* filterIterator = filterStart;
+        const bool doFilter = filterStart != filterEnd;
+        Internal::RendererHelper helper;
+
+        const auto* filenamesBuffer = placements.GetFilenamesBuffer();
+        const auto* objRef = placements.GetObjectReferences();
+
+        for (size_t c=0; c<visibleObjCount; ++c) {
+            auto& obj = objRef[visibleObjs[c]];
+
+            if (doFilter) {
+                while (filterIterator != filterEnd && *filterIterator < obj._guid) { ++filterIterator; }
+                if (filterIterator == filterEnd || *filterIterator != obj._guid) { continue; }
+            }
+
+            helper.Render(
+                *_cache, *_modelFormat, 
+                filenamesBuffer, obj, cellToWorld, cameraPosition);
+        }
+    }
+
     PlacementsRenderer::PlacementsRenderer(std::shared_ptr<RenderCore::Assets::IModelFormat> modelFormat)
     {
         assert(modelFormat);
         auto cache = std::make_unique<Cache>();
         _cache = std::move(cache);
         _modelFormat = std::move(modelFormat);
+        _jobSystem = GetSharedJobSystem();
     }
 
     PlacementsRenderer::~PlacementsRenderer() {}
@@ -826,9 +1128,9 @@ namespace SceneEngine
     {
             // render every registered cell
         _pimpl->_renderer->BeginRender(context);
-        for (auto i=_pimpl->_cells.begin(); i!=_pimpl->_cells.end(); ++i) {
-            _pimpl->_renderer->Render(context, parserContext, *i);
-        }
+        _pimpl->_renderer->Render(
+            context, parserContext, 
+            AsPointer(_pimpl->_cells.cbegin()), AsPointer(_pimpl->_cells.cend()));
         _pimpl->_renderer->EndRender(context, parserContext, techniqueIndex);
     }
 
@@ -7,8 +7,10 @@
 #include "PlacementsQuadTree.h"
 #include "../Math/ProjectionMath.h"
 #include "../Utility/PtrUtils.h"
+#include "../Utility/Threading/JobSystem.h"
+#include "../Utility/Threading/ThreadingUtils.h"
 #include "../Core/Prefix.h"
-#include <stack>
+#include <algorithm>
 
 #include "PlacementsQuadTreeDebugger.h"
 #include "PlacementsManager.h"
@@ -41,6 +43,7 @@ namespace SceneEngine
 
         std::vector<Node> _nodes;
         std::vector<Payload> _payloads;
+        unsigned _objectCount;
 
         class WorkingObject
         {
@@ -361,7 +364,8 @@ namespace SceneEngine
     bool PlacementsQuadTree::CalculateVisibleObjects(
         const float cellToClipAligned[], 
         const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
-        unsigned visObjs[], unsigned& visObjsCount, unsigned visObjMaxCount) const
+        unsigned visObjs[], unsigned& visObjsCount, unsigned visObjMaxCount,
+        WorkingStorage& workingStorage) const
     {
         visObjsCount = 0;
         assert((size_t(cellToClipAligned) & 0xf) == 0);
@@ -370,12 +374,18 @@ namespace SceneEngine
 
             //  Traverse through the quad tree, and find do bounding box level 
             //  culling on each object
-        static std::stack<unsigned> workingStack;
-        static std::stack<unsigned> entirelyVisibleStack;
-        workingStack.push(0);
+            //  Note that the working stacks are owned by the caller, so that 
+            //  multiple threads can be culling at the same time.
+        const FrustumPlanes frustum(cellToClipAligned);
+        auto& workingStack = workingStorage._workingStack;
+        auto& entirelyVisibleStack = workingStorage._entirelyVisibleStack;
+        workingStack.clear();
+        entirelyVisibleStack.clear();
+
+        workingStack.push_back(0);
         while (!workingStack.empty()) {
-            auto nodeIndex = workingStack.top();
-            workingStack.pop();
+            auto nodeIndex = workingStack.back();
+            workingStack.pop_back();
             
             auto& node = _pimpl->_nodes[nodeIndex];
             auto test = TestAABB_Aligned(cellToClipAligned, node._boundary.first, node._boundary.second);
@@ -388,35 +398,47 @@ namespace SceneEngine
 
                     //  this node and all children are "visible" without any further
                     //  culling tests
-                entirelyVisibleStack.push(nodeIndex);
+                entirelyVisibleStack.push_back(nodeIndex);
 
             } else {
 
                 for (unsigned c=0; c<4; ++c) {
                     if (node._children[c] < _pimpl->_nodes.size()) {
-                        workingStack.push(node._children[c]);
+                        workingStack.push_back(node._children[c]);
                     }
                 }
 
                 if (node._payloadID < _pimpl->_payloads.size()) {
                     auto& payload = _pimpl->_payloads[node._payloadID];
-                    for (auto i=payload._objects.cbegin(); i!=payload._objects.cend(); ++i) {
-
-                            //  Test the "cell" space bounding box of the object itself
-                            //  This must be done inside of this function, we can't
-                            //  drop the responsibility to the caller. Because:
-                            //      * sometimes we can skip it entirely, when quad tree
-                            //          node bounding boxes are considered entirely within the frustum
-                            //      * it's best to reduce the result arrays to as small as
-                            //          possible (because the caller may need to sort them)
-
-                        const auto& boundary = *PtrAdd(objCellSpaceBoundingBoxes, (*i) * objStride);
-                        ++payloadAabbTestCount;
-                        if (!CullAABB_Aligned(cellToClipAligned, boundary.first, boundary.second)) {
-                            if ((visObjsCount+1) > visObjMaxCount) {
-                                return false;
+
+                        //  Test the "cell" space bounding box of the object itself
+                        //  This must be done inside of this function, we can't
+                        //  drop the responsibility to the caller. Because:
+                        //      * sometimes we can skip it entirely, when quad tree
+                        //          node bounding boxes are considered entirely within the frustum
+                        //      * it's best to reduce the result arrays to as small as
+                        //          possible (because the caller may need to sort them)
+                        //
+                        //  The objects are tested in packets against the frustum planes,
+                        //  (see TestAABBs)
+                    const size_t packetSize = 64;
+                    AABBIntersection::Enum testResults[packetSize];
+                    const unsigned* objects = AsPointer(payload._objects.cbegin());
+                    for (size_t i=0; i<payload._objects.size(); i+=packetSize) {
+                        auto count = std::min(packetSize, payload._objects.size()-i);
+                        TestAABBs(
+                            testResults, frustum, 
+                            objCellSpaceBoundingBoxes, objStride, 
+                            &objects[i], count);
+                        payloadAabbTestCount += unsigned(count);
+
+                        for (size_t c=0; c<count; ++c) {
+                            if (testResults[c] != AABBIntersection::Culled) {
+                                if ((visObjsCount+1) > visObjMaxCount) {
+                                    return false;
+                                }
+                                visObjs[visObjsCount++] = objects[i+c]; 
                             }
-                            visObjs[visObjsCount++] = *i; 
                         }
                     }
                 }
@@ -428,13 +450,13 @@ namespace SceneEngine
             //  within the culling frustum. In these cases, we can skip the rest of the culling
             //  checks and just add these objects as visible
         while (!entirelyVisibleStack.empty()) {
-            auto nodeIndex = entirelyVisibleStack.top();
-            entirelyVisibleStack.pop();
+            auto nodeIndex = entirelyVisibleStack.back();
+            entirelyVisibleStack.pop_back();
 
             auto& node = _pimpl->_nodes[nodeIndex];
             for (unsigned c=0; c<4; ++c) {
                 if (node._children[c] < _pimpl->_nodes.size()) {
-                    entirelyVisibleStack.push(node._children[c]);
+                    entirelyVisibleStack.push_back(node._children[c]);
                 }
             }
 
@@ -457,6 +479,52 @@ namespace SceneEngine
         return true;
     }
 
+    bool PlacementsQuadTree::CalculateVisibleObjects(
+        const float cellToClipAligned[], 
+        const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
+        unsigned visObjs[], unsigned& visObjsCount, unsigned visObjMaxCount) const
+    {
+        WorkingStorage workingStorage;
+        return CalculateVisibleObjects(
+            cellToClipAligned, objCellSpaceBoundingBoxes, objStride,
+            visObjs, visObjsCount, visObjMaxCount, workingStorage);
+    }
+
+    void PlacementsQuadTree::CalculateVisibleObjects_Parallel(
+        const CullJob jobs[], size_t jobCount,
+        std::vector<unsigned> results[],
+        Utility::JobSystem& jobSystem)
+    {
+        jobSystem.ParallelFor(
+            0, unsigned(jobCount), 1,
+            [jobs, results](unsigned begin, unsigned end)
+            {
+                WorkingStorage workingStorage;
+                for (auto c=begin; c<end; ++c) {
+                    const auto& job = jobs[c];
+                    auto& result = results[c];
+                    result.resize(job._tree->GetObjectCount());
+                    unsigned visObjsCount = 0;
+                    bool success = job._tree->CalculateVisibleObjects(
+                        job._cellToClipAligned, job._objCellSpaceBoundingBoxes, job._objStride,
+                        AsPointer(result.begin()), visObjsCount, unsigned(result.size()),
+                        workingStorage);
+                    assert(success); (void)success;
+                    result.resize(visObjsCount);
+
+                        //  Sort, so that the result doesn't depend on the order of traversal.
+                        //  The caller normally wants the objects in this order, anyway.
+                    std::sort(result.begin(), result.end());
+                }
+            },
+            "PlacementsCull");
+    }
+
+    unsigned PlacementsQuadTree::GetObjectCount() const
+    {
+        return _pimpl->_objectCount;
+    }
+
     PlacementsQuadTree::PlacementsQuadTree(
         const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
         size_t objCount)
@@ -492,6 +560,7 @@ namespace SceneEngine
             //  node based on the objects assigned to it.
 
         auto pimpl = std::make_unique<Pimpl>();
+        pimpl->_objectCount = unsigned(objCount);
         pimpl->PushNode(~unsigned(0x0), 0, workingObjects);
 
         _pimpl = std::move(pimpl);
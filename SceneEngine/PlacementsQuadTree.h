@@ -10,6 +10,9 @@
 #include "../Math/Matrix.h"
 #include <utility>
 #include <memory>
+#include <vector>
+
+namespace Utility { class JobSystem; }
 
 
 namespace SceneEngine
@@ -33,11 +36,53 @@ namespace SceneEngine
     public:
         typedef std::pair<Float3, Float3> BoundingBox;
 
+            /// <summary>Scratch space used while traversing the tree</summary>
+            /// Owned by the caller, so that CalculateVisibleObjects can be called
+            /// from multiple threads at the same time. Reuse the same storage
+            /// across calls to avoid allocations.
+        class WorkingStorage
+        {
+        public:
+            std::vector<unsigned> _workingStack;
+            std::vector<unsigned> _entirelyVisibleStack;
+        };
+
+        bool CalculateVisibleObjects(
+            const float cellToClipAligned[],
+            const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
+            unsigned visObjs[], unsigned& visObjsCount, unsigned visObjMaxCount,
+            WorkingStorage& workingStorage) const;
+
         bool CalculateVisibleObjects(
             const float cellToClipAligned[],
             const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
             unsigned visObjs[], unsigned& visObjsCount, unsigned visObjMaxCount) const;
 
+            /// <summary>A single tree to test against a single view</summary>
+        class CullJob
+        {
+        public:
+            const PlacementsQuadTree*   _tree;
+            const float*                _cellToClipAligned;     // (must be 16 byte aligned)
+            const BoundingBox*          _objCellSpaceBoundingBoxes;
+            size_t                      _objStride;
+        };
+
+            /// <summary>Perform many cull jobs in parallel</summary>
+            /// Typically there is one job for every visible cell, for every view (eg, 
+            /// main camera and each shadow cascade). The jobs are distributed across
+            /// the workers of the given job system, and the calling thread also 
+            /// processes jobs while it waits.
+            ///
+            /// "results[c]" receives the visible objects for "jobs[c]", in sorted order.
+            /// So the results don't depend on how the jobs were distributed across threads.
+        static void CalculateVisibleObjects_Parallel(
+            const CullJob jobs[], size_t jobCount,
+            std::vector<unsigned> results[],
+            Utility::JobSystem& jobSystem);
+
+        unsigned GetObjectCount() const;
+
         PlacementsQuadTree(
             const BoundingBox objCellSpaceBoundingBoxes[], size_t objStride,
             size_t objCount);
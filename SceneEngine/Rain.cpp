@@ -89,8 +89,8 @@ namespace SceneEngine
                 "");
             Metal::BoundUniforms uniforms(shader);
             Techniques::TechniqueContext::BindGlobalUniforms(uniforms);
-            static uint64 HashRainSpawn = Hash64("RainSpawn");
-            static uint64 HashRandomValuesTexture = Hash64("RandomValuesTexture");
+            static uint64 HashRainSpawn = ConstExprHash64("RainSpawn");
+            static uint64 HashRandomValuesTexture = ConstExprHash64("RandomValuesTexture");
             uniforms.BindConstantBuffer(HashRainSpawn, 0, 1);
             uniforms.BindShaderResource(HashRandomValuesTexture, 0, 1);
 
@@ -210,11 +210,11 @@ namespace SceneEngine
                 "");
             Metal::BoundUniforms simUniforms(simulationShaderByteCode);
             Techniques::TechniqueContext::BindGlobalUniforms(simUniforms);
-            static uint64 HashSimulationParameters  = Hash64("SimulationParameters");
-            static uint64 HashRandomValuesTexture   = Hash64("RandomValuesTexture");
-            static uint64 HashParticlesInput        = Hash64("ParticlesInput");
-            static uint64 HashDepthBuffer           = Hash64("DepthBuffer");
-            static uint64 HashNormalsBuffer         = Hash64("NormalsBuffer");
+            static uint64 HashSimulationParameters  = ConstExprHash64("SimulationParameters");
+            static uint64 HashRandomValuesTexture   = ConstExprHash64("RandomValuesTexture");
+            static uint64 HashParticlesInput        = ConstExprHash64("ParticlesInput");
+            static uint64 HashDepthBuffer           = ConstExprHash64("DepthBuffer");
+            static uint64 HashNormalsBuffer         = ConstExprHash64("NormalsBuffer");
             simUniforms.BindConstantBuffer(HashSimulationParameters, 0, 1);
             simUniforms.BindShaderResource(HashRandomValuesTexture, 0, 1);
             simUniforms.BindShaderResource(HashParticlesInput, 1, 1);
@@ -349,11 +349,11 @@ namespace SceneEngine
                 "");
             Metal::BoundUniforms simUniforms(simulationShaderByteCode);
             Techniques::TechniqueContext::BindGlobalUniforms(simUniforms);
-            static uint64 HashSimulationParameters  = Hash64("SimulationParameters");
-            static uint64 HashRandomValuesTexture   = Hash64("RandomValuesTexture");
-            static uint64 HashParticlesInput        = Hash64("ParticlesInput");
-            static uint64 HashDepthBuffer           = Hash64("DepthBuffer");
-            static uint64 HashNormalsBuffer         = Hash64("NormalsBuffer");
+            static uint64 HashSimulationParameters  = ConstExprHash64("SimulationParameters");
+            static uint64 HashRandomValuesTexture   = ConstExprHash64("RandomValuesTexture");
+            static uint64 HashParticlesInput        = ConstExprHash64("ParticlesInput");
+            static uint64 HashDepthBuffer           = ConstExprHash64("DepthBuffer");
+            static uint64 HashNormalsBuffer         = ConstExprHash64("NormalsBuffer");
             simUniforms.BindConstantBuffer(HashSimulationParameters, 0, 1);
             simUniforms.BindShaderResource(HashRandomValuesTexture, 0, 1);
             simUniforms.BindShaderResource(HashParticlesInput, 1, 1);
@@ -66,7 +66,7 @@ namespace SceneEngine
                                 sizeof(Vertex), 0);
 
             BoundUniforms boundLayout(shaderProgram);
-            static const auto HashLocalTransform = Hash64("LocalTransform");
+            static const auto HashLocalTransform = ConstExprHash64("LocalTransform");
             boundLayout.BindConstantBuffer(HashLocalTransform, 0, 1, RenderCore::Assets::LocalTransform_Elements, RenderCore::Assets::LocalTransform_ElementsCount);
             TechniqueContext::BindGlobalUniforms(boundLayout);
             boundLayout.Apply(*context, 
@@ -453,8 +453,8 @@ namespace SceneEngine
             Metal::ConstantBuffer globalConstantsBuffer(globalConstants, sizeof(globalConstants));
             // context->BindPS(MakeResourceList(globalConstantsBuffer, res._samplingPatternConstants));
             Metal::BoundUniforms boundUniforms(debuggingShader);
-            boundUniforms.BindConstantBuffer(Hash64("BasicGlobals"), 0, 1);
-            boundUniforms.BindConstantBuffer(Hash64("SamplingPattern"), 1, 1);
+            boundUniforms.BindConstantBuffer(ConstExprHash64("BasicGlobals"), 0, 1);
+            boundUniforms.BindConstantBuffer(ConstExprHash64("SamplingPattern"), 1, 1);
             Techniques::TechniqueContext::BindGlobalUniforms(boundUniforms);
             const Metal::ConstantBuffer* prebuiltBuffers[] = { &globalConstantsBuffer, &resources._samplingPatternConstants };
             boundUniforms.Apply(*context, 
@@ -900,8 +900,8 @@ namespace SceneEngine
             shaderDefines);
         BoundUniforms boundUniforms(patchRender);
         Techniques::TechniqueContext::BindGlobalUniforms(boundUniforms);
-        boundUniforms.BindConstantBuffer(Hash64("OceanMaterialSettings"), 0, 1);
-        boundUniforms.BindConstantBuffer(Hash64("ShallowWaterGridConstants"), 1, 1);
+        boundUniforms.BindConstantBuffer(ConstExprHash64("OceanMaterialSettings"), 0, 1);
+        boundUniforms.BindConstantBuffer(ConstExprHash64("ShallowWaterGridConstants"), 1, 1);
 
         context->Bind(patchRender);
 
@@ -955,8 +955,8 @@ namespace SceneEngine
             shaderDefines);
         BoundUniforms boundUniforms(patchRender);
         Techniques::TechniqueContext::BindGlobalUniforms(boundUniforms);
-        boundUniforms.BindConstantBuffer(Hash64("OceanMaterialSettings"), 0, 1);
-        boundUniforms.BindConstantBuffer(Hash64("ShallowWaterGridConstants"), 1, 1);
+        boundUniforms.BindConstantBuffer(ConstExprHash64("OceanMaterialSettings"), 0, 1);
+        boundUniforms.BindConstantBuffer(ConstExprHash64("ShallowWaterGridConstants"), 1, 1);
 
         context->Bind(patchRender);
 
@@ -177,7 +177,7 @@ namespace SceneEngine
         }
         Techniques::TechniqueContext::BindGlobalUniforms(uniforms);
         Techniques::TechniqueContext::BindGlobalUniforms(postFogUniforms);
-        postFogUniforms.BindConstantBuffer(Hash64("SkySettings"), 0, 1);
+        postFogUniforms.BindConstantBuffer(ConstExprHash64("SkySettings"), 0, 1);
 
         auto validationCallback = std::make_shared<::Assets::DependencyValidation>();
         ::Assets::RegisterAssetDependency(validationCallback, &_shader->GetDependencyValidation());
@@ -37,6 +37,7 @@
 #include "../Utility/BitUtils.h"
 #include "../Utility/HeapUtils.h"
 #include "../Utility/Streams/FileUtils.h"
+#include "../Utility/Streams/AsyncFileReader.h"
 #include "../Utility/Streams/PathUtils.h"
 #include "../Utility/Conversion.h"
 #include "../ConsoleRig/Console.h"
@@ -144,6 +145,7 @@ namespace SceneEngine
         UnorderedAccessView&        GetUnorderedAccessView() { return _uav; }
         
         TextureTileSet( BufferUploads::IManager& bufferUploads,
+                        AsyncFileReader& fileReader,
                         Int2 elementSize, unsigned elementCount,
                         RenderCore::Metal::NativeFormat::Enum format,
                         bool allowModification);
@@ -162,8 +164,10 @@ namespace SceneEngine
 
         Int2                        _elementsPerArraySlice;
         Int2                        _elementSize;
+        RenderCore::Metal::NativeFormat::Enum _format;
         std::vector<ArraySlice>     _slices;
         BufferUploads::IManager *   _bufferUploads;
+        AsyncFileReader *           _fileReader;
         bool                        _allowModification;
 
         std::vector<unsigned>       _uploadIds;
@@ -267,7 +271,14 @@ namespace SceneEngine
         tile._uploadId = uploadId;
         assert(tile._width != ~unsigned(0x0) && tile._height != ~unsigned(0x0));
 
-        auto dataPacket = BufferUploads::CreateFileDataSource(fileHandle, offset, dataSize);
+            //  the file data is a single tile, tightly packed. Pitches are
+            //  calculated from the tile dimensions & format
+        auto tileDesc = BufferUploads::CreateDesc(
+            0, 0, 0, 
+            BufferUploads::TextureDesc::Plain2D(_elementSize[0], _elementSize[1], _format),
+            "TerrainTile");
+        auto dataPacket = BufferUploads::CreateFileDataSource(
+            *_fileReader, fileHandle, offset, dataSize, tileDesc);
         _bufferUploads->UpdateData(
             tile._transaction, dataPacket.get(),
             BufferUploads::PartialResource(destinationBox, 0, 0, address[2]));
@@ -313,6 +324,7 @@ namespace SceneEngine
     }
 
     TextureTileSet::TextureTileSet( BufferUploads::IManager& bufferUploads,
+                                    AsyncFileReader& fileReader,
                                     Int2 elementSize, unsigned elementCount,
                                     RenderCore::Metal::NativeFormat::Enum format,
                                     bool allowModification)
@@ -371,10 +383,12 @@ namespace SceneEngine
         uploadIds.resize(elementsPerPage * pageCount, ~unsigned(0x0));
 
         _bufferUploads = &bufferUploads;
+        _fileReader = &fileReader;
         _resource = std::move(resource);
         _slices = std::move(slices);
         _elementsPerArraySlice = Int2(elementsH, elementsV);
         _elementSize = elementSize;
+        _format = format;
         _shaderResource = std::move(shaderResource);
         _uav = std::move(uav);
         _uploadIds = std::move(uploadIds);
@@ -509,6 +523,7 @@ namespace SceneEngine
 
         typedef std::pair<uint64, std::unique_ptr<CellRenderInfo>> CRIPair;
 
+        std::unique_ptr<AsyncFileReader> _fileReader;
         std::unique_ptr<TextureTileSet> _heightMapTileSet;
         std::unique_ptr<TextureTileSet> _coverageTileSet[TerrainCellId::CoverageCount];
         std::vector<CRIPair>            _renderInfos;
@@ -1659,9 +1674,9 @@ namespace SceneEngine
             const ShaderResourceView* srv[] = { upd._srv.get(), &_heightMapTileSet->GetShaderResource() };
 
             BoundUniforms boundLayout(byteCode);
-            boundLayout.BindConstantBuffer(Hash64("Parameters"), 0, 1);
-            boundLayout.BindShaderResource(Hash64("Input"), 0, 1);
-            boundLayout.BindShaderResource(Hash64("OldHeights"), 1, 1);
+            boundLayout.BindConstantBuffer(ConstExprHash64("Parameters"), 0, 1);
+            boundLayout.BindShaderResource(ConstExprHash64("Input"), 0, 1);
+            boundLayout.BindShaderResource(ConstExprHash64("OldHeights"), 1, 1);
 
             boundLayout.Apply(context, UniformsStream(), UniformsStream(pkts, nullptr, dimof(pkts), srv, dimof(srv)));
 
@@ -1760,16 +1775,21 @@ namespace SceneEngine
 
     TerrainCellRenderer::TerrainCellRenderer(std::shared_ptr<ITerrainFormat> ioFormat, BufferUploads::IManager* bufferUploads, Int2 heightMapNodeElementWidth)
     {
+            //  All of the tile sets share a single reader for streaming from the terrain
+            //  files. Tile reads are small, so we want plenty of them in flight at once
+        auto fileReader = std::make_unique<AsyncFileReader>(32);
+
         auto heightMapTextureTileSet = std::unique_ptr<TextureTileSet>(
-            new TextureTileSet(*bufferUploads, heightMapNodeElementWidth, 16*1024, RenderCore::Metal::NativeFormat::R16_UINT, true));
+            new TextureTileSet(*bufferUploads, *fileReader, heightMapNodeElementWidth, 16*1024, RenderCore::Metal::NativeFormat::R16_UINT, true));
         Int2 coverageElementSize(33, 33);
         std::unique_ptr<TextureTileSet> coverageTileSets[TerrainCellId::CoverageCount];
         for (unsigned c=0; c<TerrainCellId::CoverageCount; ++c) {
             coverageTileSets[c] = std::unique_ptr<TextureTileSet>(
-                new TextureTileSet(*bufferUploads, coverageElementSize, 16*1024, CoverageFileFormat[c], false));
+                new TextureTileSet(*bufferUploads, *fileReader, coverageElementSize, 16*1024, CoverageFileFormat[c], false));
         }
 
         _renderInfos.reserve(64);
+        _fileReader = std::move(fileReader);
         _heightMapTileSet = std::move(heightMapTextureTileSet);
         for (unsigned c=0; c<TerrainCellId::CoverageCount; ++c) {
             _coverageTileSet[c] = std::move(coverageTileSets[c]);
@@ -554,9 +554,9 @@ namespace SceneEngine
             } parameters = { center, radius, adjustment, _pimpl->_gpuCacheMins, _pimpl->_gpuCacheMaxs, adjMins, 0, 0 };
 
             BoundUniforms uniforms(cbBytecode);
-            uniforms.BindConstantBuffer(Hash64("Parameters"), 0, 1);
+            uniforms.BindConstantBuffer(ConstExprHash64("Parameters"), 0, 1);
 
-            const auto InputSurfaceHash = Hash64("InputSurface");
+            const auto InputSurfaceHash = ConstExprHash64("InputSurface");
             ShaderResourceView cacheCopySRV;
             if (uniforms.BindShaderResource(InputSurfaceHash, 0, 1)) {
                 context.GetUnderlying()->CopyResource(_pimpl->_gpucache[1].get(), _pimpl->_gpucache[0].get());
@@ -638,7 +638,7 @@ namespace SceneEngine
 
         std::tuple<uint64, void*, size_t> extraPackets[] = 
         {
-            std::make_tuple(Hash64("RaiseLowerParameters"), &raiseLowerParameters, sizeof(RaiseLowerParameters))
+            std::make_tuple(ConstExprHash64("RaiseLowerParameters"), &raiseLowerParameters, sizeof(RaiseLowerParameters))
         };
 
         ApplyTool(adjMins, adjMaxs, "RaiseLower", center, radius, adjustment, extraPackets, dimof(extraPackets));
@@ -683,7 +683,7 @@ namespace SceneEngine
 
         std::tuple<uint64, void*, size_t> extraPackets[] = 
         {
-            std::make_tuple(Hash64("CopyHeightParameters"), &copyHeightParameters, sizeof(CopyHeightParameters))
+            std::make_tuple(ConstExprHash64("CopyHeightParameters"), &copyHeightParameters, sizeof(CopyHeightParameters))
         };
 
         ApplyTool(adjMins, adjMaxs, "CopyHeight", center, radius, adjustment, extraPackets, dimof(extraPackets));
@@ -713,7 +713,7 @@ namespace SceneEngine
 
         std::tuple<uint64, void*, size_t> extraPackets[] = 
         {
-            std::make_tuple(Hash64("RotateParameters"), &rotateParameters, sizeof(RotateParamaters))
+            std::make_tuple(ConstExprHash64("RotateParameters"), &rotateParameters, sizeof(RotateParamaters))
         };
 
         ApplyTool(adjMins, adjMaxs, "Rotate", center, radius, 1.f, extraPackets, dimof(extraPackets));
@@ -756,7 +756,7 @@ namespace SceneEngine
     
         std::tuple<uint64, void*, size_t> extraPackets[] = 
         {
-            std::make_tuple(Hash64("GaussianParameters"), &blurParameters, sizeof(BlurParameters))
+            std::make_tuple(ConstExprHash64("GaussianParameters"), &blurParameters, sizeof(BlurParameters))
         };
             
         ApplyTool(adjMins, adjMaxs, "Smooth", center, radius, strength, extraPackets, dimof(extraPackets));
@@ -782,7 +782,7 @@ namespace SceneEngine
     
         std::tuple<uint64, void*, size_t> extraPackets[] = 
         {
-            std::make_tuple(Hash64("FillWithNoiseParameters"), &fillWithNoiseParameters, sizeof(FillWithNoiseParameters))
+            std::make_tuple(ConstExprHash64("FillWithNoiseParameters"), &fillWithNoiseParameters, sizeof(FillWithNoiseParameters))
         };
             
         ApplyTool(adjMins, adjMaxs, "FillWithNoise", LinearInterpolate(mins, maxs, 0.5f), 1.f, 1.f, extraPackets, dimof(extraPackets));
@@ -367,9 +367,9 @@ namespace SceneEngine
                     isShadowsPass?"SHADOWS=1;SHADOW_CASCADE_MODE=1":"");    // hack -- SHADOW_CASCADE_MODE let explicitly here
 
                 Metal::BoundUniforms uniforms(debuggingShader);
-                uniforms.BindConstantBuffer(Hash64("RecordedTransform"), 0, 1);
-                uniforms.BindConstantBuffer(Hash64("GlobalTransform"), 1, 1);
-                uniforms.BindConstantBuffer(Hash64("$Globals"), 2, 1);
+                uniforms.BindConstantBuffer(ConstExprHash64("RecordedTransform"), 0, 1);
+                uniforms.BindConstantBuffer(ConstExprHash64("GlobalTransform"), 1, 1);
+                uniforms.BindConstantBuffer(ConstExprHash64("$Globals"), 2, 1);
                 const unsigned TileWidth = 16, TileHeight = 16;
                 uint32 globals[4] = {   (mainViewportWidth + TileWidth - 1) / TileWidth, 
                                         (mainViewportHeight + TileHeight + 1) / TileHeight, 
@@ -497,8 +497,8 @@ namespace SceneEngine
             shaderDefines);
 
         RenderCore::Metal::BoundUniforms uniforms(shaderProgram);
-        uniforms.BindConstantBuffer(Hash64("ToneMapSettings"), 0, 1);
-        uniforms.BindConstantBuffer(Hash64("ColorGradingSettings"), 1, 1);
+        uniforms.BindConstantBuffer(ConstExprHash64("ToneMapSettings"), 0, 1);
+        uniforms.BindConstantBuffer(ConstExprHash64("ColorGradingSettings"), 1, 1);
 
         auto validationCallback = std::make_shared<::Assets::DependencyValidation>();
         ::Assets::RegisterAssetDependency(validationCallback, &shaderProgram.GetDependencyValidation());
@@ -686,18 +686,18 @@ namespace SceneEngine
             "game/xleres/Effects/separablefilter.psh:VerticalBlur:ps_*");
 
         auto horizontalFilterBinding = std::make_unique<BoundUniforms>(std::ref(*horizontalFilter));
-        horizontalFilterBinding->BindConstantBuffer(Hash64("Constants"), 0, 1);
+        horizontalFilterBinding->BindConstantBuffer(ConstExprHash64("Constants"), 0, 1);
 
         auto verticalFilterBinding = std::make_unique<BoundUniforms>(std::ref(*verticalFilter));
-        verticalFilterBinding->BindConstantBuffer(Hash64("Constants"), 0, 1);
+        verticalFilterBinding->BindConstantBuffer(ConstExprHash64("Constants"), 0, 1);
 
         auto* integrateDistantBlur = &Assets::GetAssetDep<ShaderProgram>(
             "game/xleres/basic2D.vsh:fullscreen:vs_*", 
             "game/xleres/Effects/distantblur.psh:integrate:ps_*");
         auto integrateDistantBlurBinding = std::make_unique<BoundUniforms>(std::ref(*integrateDistantBlur));
         Techniques::TechniqueContext::BindGlobalUniforms(*integrateDistantBlurBinding.get());
-        integrateDistantBlurBinding->BindShaderResource(Hash64("BlurredBufferInput"), 0, 1);
-        integrateDistantBlurBinding->BindShaderResource(Hash64("DepthsInput"), 1, 1);
+        integrateDistantBlurBinding->BindShaderResource(ConstExprHash64("BlurredBufferInput"), 0, 1);
+        integrateDistantBlurBinding->BindShaderResource(ConstExprHash64("DepthsInput"), 1, 1);
 
         RenderCore::Metal::BlendState integrateBlend;
         RenderCore::Metal::BlendState noBlending = RenderCore::Metal::BlendOp::NoBlending;
@@ -89,29 +89,29 @@ namespace SceneEngine
 
         auto buildExponentialShadowMapBinding = std::make_unique<BoundUniforms>(std::ref(*buildExponentialShadowMap));
         Techniques::TechniqueContext::BindGlobalUniforms(*buildExponentialShadowMapBinding);
-        buildExponentialShadowMapBinding->BindConstantBuffer(Hash64("VolumetricFogConstants"), 0, 1);
-        buildExponentialShadowMapBinding->BindConstantBuffer(Hash64("$Globals"), 1, 1);
+        buildExponentialShadowMapBinding->BindConstantBuffer(ConstExprHash64("VolumetricFogConstants"), 0, 1);
+        buildExponentialShadowMapBinding->BindConstantBuffer(ConstExprHash64("$Globals"), 1, 1);
 
         auto horizontalFilterBinding = std::make_unique<BoundUniforms>(std::ref(*horizontalFilter));
-        horizontalFilterBinding->BindConstantBuffer(Hash64("$Globals"), 0, 1);
-        horizontalFilterBinding->BindConstantBuffer(Hash64("Filtering"), 1, 1);
+        horizontalFilterBinding->BindConstantBuffer(ConstExprHash64("$Globals"), 0, 1);
+        horizontalFilterBinding->BindConstantBuffer(ConstExprHash64("Filtering"), 1, 1);
 
         auto verticalFilterBinding = std::make_unique<BoundUniforms>(std::ref(*verticalFilter));
-        verticalFilterBinding->BindConstantBuffer(Hash64("$Globals"), 0, 1);
-        verticalFilterBinding->BindConstantBuffer(Hash64("Filtering"), 1, 1);
+        verticalFilterBinding->BindConstantBuffer(ConstExprHash64("$Globals"), 0, 1);
+        verticalFilterBinding->BindConstantBuffer(ConstExprHash64("Filtering"), 1, 1);
 
         auto* injectLight = &Assets::GetAssetDep<ComputeShader>("game/xleres/volumetriceffect/injectlight.csh:InjectLighting:cs_*", defines);
         auto* propagateLight = &Assets::GetAssetDep<ComputeShader>("game/xleres/volumetriceffect/injectlight.csh:PropagateLighting:cs_*", defines);
 
         auto injectLightBinding = std::make_unique<BoundUniforms>(std::ref(Assets::GetAssetDep<CompiledShaderByteCode>("game/xleres/volumetriceffect/injectlight.csh:InjectLighting:cs_*", defines)));
         Techniques::TechniqueContext::BindGlobalUniforms(*injectLightBinding);
-        injectLightBinding->BindConstantBuffer(Hash64("VolumetricFogConstants"), 0, 1);
-        injectLightBinding->BindConstantBuffer(Hash64("ArbitraryShadowProjection"), 2, 1);
+        injectLightBinding->BindConstantBuffer(ConstExprHash64("VolumetricFogConstants"), 0, 1);
+        injectLightBinding->BindConstantBuffer(ConstExprHash64("ArbitraryShadowProjection"), 2, 1);
 
         auto propagateLightBinding = std::make_unique<BoundUniforms>(std::ref(Assets::GetAssetDep<CompiledShaderByteCode>("game/xleres/volumetriceffect/injectlight.csh:PropagateLighting:cs_*", defines)));
         Techniques::TechniqueContext::BindGlobalUniforms(*propagateLightBinding);
-        propagateLightBinding->BindConstantBuffer(Hash64("VolumetricFogConstants"), 0, 1);
-        injectLightBinding->BindConstantBuffer(Hash64("ArbitraryShadowProjection"), 2, 1);
+        propagateLightBinding->BindConstantBuffer(ConstExprHash64("VolumetricFogConstants"), 0, 1);
+        injectLightBinding->BindConstantBuffer(ConstExprHash64("ArbitraryShadowProjection"), 2, 1);
 
         const char* vertexShader = 
             desc._flipDirection
@@ -130,7 +130,7 @@ namespace SceneEngine
             vertexShader, "game/xleres/VolumetricEffect/resolvefog.psh:ResolveFog:ps_*", definesTable);
 
         auto resolveLightBinding = std::make_unique<BoundUniforms>(std::ref(*resolveLight));
-        resolveLightBinding->BindConstantBuffer(Hash64("GlobalTransform"), 0, 0);
+        resolveLightBinding->BindConstantBuffer(ConstExprHash64("GlobalTransform"), 0, 0);
 
         auto validationCallback = std::make_shared<Assets::DependencyValidation>();
         Assets::RegisterAssetDependency(validationCallback, &buildExponentialShadowMap->GetDependencyValidation());
@@ -0,0 +1,370 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "ArithmeticUtils.h"
+#include "BitUtils.h"
+#include "../Core/Prefix.h"
+#include "../Core/Types.h"
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <assert.h>
+
+#if (COMPILER_ACTIVE == COMPILER_TYPE_MSVC && (defined(_M_IX86) || defined(_M_AMD64))) || defined(__SSE2__)
+    #define FLATHASHMAP_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace Utility
+{
+    /// <summary>Open addressing hash table, keyed by 64 bit hash values</summary>
+    /// Most lookups in the engine are by a precalculated 64 bit hash (shader variation
+    /// hashes, parameter box hashes, asset ids...). This table is for those cases, where
+    /// a sorted vector would otherwise grow large, or be inserted into frequently.
+    ///
+    /// The layout follows the "swiss table" design. Every slot has a control byte, which is
+    /// either "empty", "deleted" or 7 bits of the hash of the key in that slot. Lookups test
+    /// 16 control bytes at a time (with SSE2, where available), and only compare full keys
+    /// for slots whose 7 bits match. So a lookup normally touches one cache line of control
+    /// bytes and one slot. The table grows when it's 7/8ths full.
+    ///
+    /// Pointers returned by Find() and Insert() remain valid until the next insert that
+    /// grows the table (or the next Erase() of that key).
+    template<typename Value>
+        class FlatHashMap
+    {
+    public:
+        Value*          Find(uint64 key);
+        const Value*    Find(uint64 key) const;
+
+            /// <summary>Insert a value, unless the key already exists</summary>
+            /// Returns the value in the table (either the new one, or the existing one), and
+            /// true if a new value was inserted.
+        std::pair<Value*, bool> Insert(uint64 key, const Value& value);
+        std::pair<Value*, bool> Insert(uint64 key, Value&& value);
+
+        bool            Erase(uint64 key);
+        void            Clear();
+        void            Reserve(size_t count);
+
+        size_t          size() const { return _size; }
+        bool            empty() const { return _size == 0; }
+
+        template<typename Fn>
+            void        ForEach(Fn&& fn) const;
+
+        FlatHashMap();
+        FlatHashMap(FlatHashMap&& moveFrom);
+        FlatHashMap& operator=(FlatHashMap&& moveFrom);
+        ~FlatHashMap();
+
+    private:
+        static const unsigned GroupWidth = 16;
+        static const int8 Ctrl_Empty = -128;        // (0x80)
+        static const int8 Ctrl_Deleted = -2;        // (0xfe)
+            // full slots have the 7 bit hash value (0 - 127)
+
+        class Slot
+        {
+        public:
+            uint64 _key;
+            typename std::aligned_storage<sizeof(Value), std::alignment_of<Value>::value>::type _value;
+            Value& Get()                { return *(Value*)&_value; }
+            const Value& Get() const    { return *(const Value*)&_value; }
+        };
+
+            //  _control has capacity + GroupWidth bytes. The last GroupWidth bytes mirror
+            //  the first group, so a group can be loaded from any position without wrapping
+        std::unique_ptr<int8[]>     _control;
+        std::unique_ptr<Slot[]>     _slots;
+        size_t                      _capacity;      // (always 0 or a power of two, at least GroupWidth)
+        size_t                      _size;
+        size_t                      _growthLeft;    // number of empty slots we can fill before rehashing
+
+        static uint64   Mix(uint64 key)     { return key * 0x9E3779B97F4A7C15ull; }
+        static size_t   H1(uint64 mixed)    { return size_t(mixed ^ (mixed >> 32ull)); }
+        static int8     H2(uint64 mixed)    { return int8(mixed >> 57ull); }
+
+        static uint32   MatchByte(const int8* group, int8 value);
+        static uint32   MatchEmpty(const int8* group);
+        static uint32   MatchEmptyOrDeleted(const int8* group);
+
+        void            SetControl(size_t index, int8 value);
+        size_t          FindSlot(uint64 key) const;
+        size_t          FindInsertSlot(uint64 mixed) const;
+        void            Resize(size_t newCapacity);
+        static size_t   GrowthLimit(size_t capacity) { return capacity - capacity/8; }
+
+        template<typename V>
+            std::pair<Value*, bool> InsertInternal(uint64 key, V&& value);
+
+        FlatHashMap(const FlatHashMap&);
+        FlatHashMap& operator=(const FlatHashMap&);
+    };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template<typename Value>
+        uint32 FlatHashMap<Value>::MatchByte(const int8* group, int8 value)
+    {
+        #if defined(FLATHASHMAP_USE_SSE2)
+            auto ctrl = _mm_loadu_si128((const __m128i*)group);
+            return uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), ctrl)));
+        #else
+            uint32 result = 0;
+            for (unsigned c=0; c<GroupWidth; ++c) {
+                result |= uint32(group[c] == value) << c;
+            }
+            return result;
+        #endif
+    }
+
+    template<typename Value>
+        uint32 FlatHashMap<Value>::MatchEmpty(const int8* group)
+    {
+        return MatchByte(group, Ctrl_Empty);
+    }
+
+    template<typename Value>
+        uint32 FlatHashMap<Value>::MatchEmptyOrDeleted(const int8* group)
+    {
+            //  Empty and deleted are the only negative values below -1
+        #if defined(FLATHASHMAP_USE_SSE2)
+            auto ctrl = _mm_loadu_si128((const __m128i*)group);
+            return uint32(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+        #else
+            uint32 result = 0;
+            for (unsigned c=0; c<GroupWidth; ++c) {
+                result |= uint32(group[c] < -1) << c;
+            }
+            return result;
+        #endif
+    }
+
+    template<typename Value>
+        void FlatHashMap<Value>::SetControl(size_t index, int8 value)
+    {
+        _control[index] = value;
+        if (index < GroupWidth) {
+            _control[_capacity + index] = value;
+        }
+    }
+
+    template<typename Value>
+        size_t FlatHashMap<Value>::FindSlot(uint64 key) const
+    {
+            //  Probe whole groups at a time, with triangular steps between groups. Because
+            //  the table is never full, we will always hit a group with an empty slot.
+        if (!_capacity) { return ~size_t(0); }
+        auto mixed = Mix(key);
+        auto h2 = H2(mixed);
+        const auto mask = _capacity-1;
+        auto pos = H1(mixed) & mask;
+        for (size_t step = GroupWidth;; step += GroupWidth) {
+            const int8* group = &_control[pos];
+            for (auto m = MatchByte(group, h2); m; m &= m-1) {
+                auto index = (pos + xl_ctz4(m)) & mask;
+                if (_slots[index]._key == key) {
+                    return index;
+                }
+            }
+            if (MatchEmpty(group)) {
+                return ~size_t(0);
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template<typename Value>
+        size_t FlatHashMap<Value>::FindInsertSlot(uint64 mixed) const
+    {
+        const auto mask = _capacity-1;
+        auto pos = H1(mixed) & mask;
+        for (size_t step = GroupWidth;; step += GroupWidth) {
+            auto m = MatchEmptyOrDeleted(&_control[pos]);
+            if (m) {
+                return (pos + xl_ctz4(m)) & mask;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template<typename Value>
+        Value* FlatHashMap<Value>::Find(uint64 key)
+    {
+        auto index = FindSlot(key);
+        return (index != ~size_t(0)) ? &_slots[index].Get() : nullptr;
+    }
+
+    template<typename Value>
+        const Value* FlatHashMap<Value>::Find(uint64 key) const
+    {
+        auto index = FindSlot(key);
+        return (index != ~size_t(0)) ? &_slots[index].Get() : nullptr;
+    }
+
+    #undef new
+
+    template<typename Value>
+        template<typename V>
+            std::pair<Value*, bool> FlatHashMap<Value>::InsertInternal(uint64 key, V&& value)
+    {
+        auto existing = FindSlot(key);
+        if (existing != ~size_t(0)) {
+            return std::make_pair(&_slots[existing].Get(), false);
+        }
+
+        auto mixed = Mix(key);
+        auto index = _capacity ? FindInsertSlot(mixed) : 0;
+        if (!_capacity || (!_growthLeft && _control[index] == Ctrl_Empty)) {
+                //  Out of space. If there are many deleted slots, rehashing at the
+                //  same size is enough to reclaim them
+            auto newCapacity = std::max(size_t(GroupWidth), _capacity);
+            if (_size >= GrowthLimit(newCapacity)/2) {
+                newCapacity *= 2;
+            }
+            Resize(newCapacity);
+            index = FindInsertSlot(mixed);
+        }
+
+        if (_control[index] == Ctrl_Empty) {
+            --_growthLeft;
+        }
+        SetControl(index, H2(mixed));
+        _slots[index]._key = key;
+        new(&_slots[index]._value) Value(std::forward<V>(value));
+        ++_size;
+        return std::make_pair(&_slots[index].Get(), true);
+    }
+
+    template<typename Value>
+        void FlatHashMap<Value>::Resize(size_t newCapacity)
+    {
+        assert(IsPowerOfTwo(newCapacity) && newCapacity >= GroupWidth);
+        auto oldControl = std::move(_control);
+        auto oldSlots = std::move(_slots);
+        auto oldCapacity = _capacity;
+
+        _control.reset(new int8[newCapacity + GroupWidth]);
+        _slots.reset(new Slot[newCapacity]);
+        _capacity = newCapacity;
+        std::fill(_control.get(), _control.get() + newCapacity + GroupWidth, int8(Ctrl_Empty));
+        _growthLeft = GrowthLimit(newCapacity) - _size;
+
+        for (size_t c=0; c<oldCapacity; ++c) {
+            if (oldControl[c] >= 0) {
+                auto& src = oldSlots[c];
+                auto mixed = Mix(src._key);
+                auto index = FindInsertSlot(mixed);
+                SetControl(index, H2(mixed));
+                _slots[index]._key = src._key;
+                new(&_slots[index]._value) Value(std::move(src.Get()));
+                src.Get().~Value();
+            }
+        }
+    }
+
+    #if defined(DEBUG_NEW)
+        #define new DEBUG_NEW
+    #endif
+
+    template<typename Value>
+        std::pair<Value*, bool> FlatHashMap<Value>::Insert(uint64 key, const Value& value)
+    {
+        return InsertInternal(key, value);
+    }
+
+    template<typename Value>
+        std::pair<Value*, bool> FlatHashMap<Value>::Insert(uint64 key, Value&& value)
+    {
+        return InsertInternal(key, std::move(value));
+    }
+
+    template<typename Value>
+        bool FlatHashMap<Value>::Erase(uint64 key)
+    {
+        auto index = FindSlot(key);
+        if (index == ~size_t(0)) { return false; }
+        _slots[index].Get().~Value();
+        SetControl(index, Ctrl_Deleted);    // (must not become empty, or we would break probe sequences through here)
+        --_size;
+        return true;
+    }
+
+    template<typename Value>
+        void FlatHashMap<Value>::Clear()
+    {
+        for (size_t c=0; c<_capacity; ++c) {
+            if (_control[c] >= 0) {
+                _slots[c].Get().~Value();
+            }
+        }
+        if (_capacity) {
+            std::fill(_control.get(), _control.get() + _capacity + GroupWidth, int8(Ctrl_Empty));
+        }
+        _size = 0;
+        _growthLeft = GrowthLimit(_capacity);
+    }
+
+    template<typename Value>
+        void FlatHashMap<Value>::Reserve(size_t count)
+    {
+        size_t newCapacity = GroupWidth;
+        while (GrowthLimit(newCapacity) < count) { newCapacity *= 2; }
+        if (newCapacity > _capacity) {
+            Resize(newCapacity);
+        }
+    }
+
+    template<typename Value>
+        template<typename Fn>
+            void FlatHashMap<Value>::ForEach(Fn&& fn) const
+    {
+        for (size_t c=0; c<_capacity; ++c) {
+            if (_control[c] >= 0) {
+                fn(_slots[c]._key, _slots[c].Get());
+            }
+        }
+    }
+
+    template<typename Value>
+        FlatHashMap<Value>::FlatHashMap()
+    : _capacity(0), _size(0), _growthLeft(0)
+    {}
+
+    template<typename Value>
+        FlatHashMap<Value>::FlatHashMap(FlatHashMap&& moveFrom)
+    : _control(std::move(moveFrom._control))
+    , _slots(std::move(moveFrom._slots))
+    , _capacity(moveFrom._capacity), _size(moveFrom._size), _growthLeft(moveFrom._growthLeft)
+    {
+        moveFrom._capacity = moveFrom._size = moveFrom._growthLeft = 0;
+    }
+
+    template<typename Value>
+        auto FlatHashMap<Value>::operator=(FlatHashMap&& moveFrom) -> FlatHashMap&
+    {
+        Clear();
+        _control = std::move(moveFrom._control);
+        _slots = std::move(moveFrom._slots);
+        _capacity = moveFrom._capacity;
+        _size = moveFrom._size;
+        _growthLeft = moveFrom._growthLeft;
+        moveFrom._capacity = moveFrom._size = moveFrom._growthLeft = 0;
+        return *this;
+    }
+
+    template<typename Value>
+        FlatHashMap<Value>::~FlatHashMap()
+    {
+        Clear();
+    }
+}
+
+using namespace Utility;
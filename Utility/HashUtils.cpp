@@ -7,11 +7,23 @@
 #include "MemoryUtils.h"
 #include "PtrUtils.h"
 #include "StringUtils.h"
-#include "../Foreign/Hash/MurmurHash2.h"
-#include "../Foreign/Hash/MurmurHash3.h"
+
+#if HASH_FAMILY_ACTIVE == HASH_FAMILY_MURMUR
+    #include "../Foreign/Hash/MurmurHash2.h"
+    #include "../Foreign/Hash/MurmurHash3.h"
+#elif HASH_FAMILY_ACTIVE == HASH_FAMILY_WYHASH
+    #if (COMPILER_ACTIVE == COMPILER_TYPE_MSVC) && TARGET_64BIT
+        #include <intrin.h>
+        #pragma intrinsic(_umul128)
+    #endif
+#else
+    #error Unknown hash family selected by HASH_FAMILY_ACTIVE
+#endif
 
 namespace Utility
 {
+#if HASH_FAMILY_ACTIVE == HASH_FAMILY_MURMUR
+
     uint64 Hash64(const void* begin, const void* end, uint64 seed)
     {
                 //
@@ -33,21 +45,135 @@ namespace Utility
         #endif
     }
 
-    uint64 Hash64(const char str[], uint64 seed)
+    uint32 Hash32(const void* begin, const void* end, uint32 seed)
     {
-        return Hash64(str, &str[XlStringLen(str)], seed);
+        uint32 temp;
+        MurmurHash3_x86_32(begin, int(size_t(end)-size_t(begin)), seed, &temp);
+        return temp;
     }
 
-    uint64 Hash64(const std::string& str, uint64 seed)
+#elif HASH_FAMILY_ACTIVE == HASH_FAMILY_WYHASH
+
+    namespace Internal
     {
-        return Hash64(AsPointer(str.begin()), AsPointer(str.end()), seed);
+            //
+            //      This follows the structure of wyhash (final version 4, by Wang Yi,
+            //      released into the public domain). The core operation is a 64x64->128 bit
+            //      multiply, folded back to 64 bits. Long inputs are consumed 48 bytes at a 
+            //      time, in 3 independent lanes (so the multiplies can overlap in the pipeline).
+            //      Short inputs (which is most of our keys) are handled with just a few 
+            //      overlapping reads, and no loops.
+            //
+            //      Like MurmurHash, input is read as little endian.
+            //
+        static const uint64 WySecret[4] = { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6dbull, 0x589965cc75374cc3ull };
+
+        static inline void WyMultiply(uint64& A, uint64& B)
+        {
+            #if (COMPILER_ACTIVE == COMPILER_TYPE_MSVC) && TARGET_64BIT
+                uint64 high;
+                A = _umul128(A, B, &high);
+                B = high;
+            #elif defined(__SIZEOF_INT128__)
+                unsigned __int128 r = A; r *= B;
+                A = uint64(r); B = uint64(r >> 64ull);
+            #else
+                uint64 ha = A >> 32ull, hb = B >> 32ull, la = uint32(A), lb = uint32(B);
+                uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+                uint64 t = rl + (rm0 << 32ull), c = t < rl;
+                uint64 lo = t + (rm1 << 32ull); c += lo < t;
+                uint64 hi = rh + (rm0 >> 32ull) + (rm1 >> 32ull) + c;
+                A = lo; B = hi;
+            #endif
+        }
+
+        static inline uint64 WyMix(uint64 A, uint64 B)  { WyMultiply(A, B); return A ^ B; }
+        static inline uint64 WyRead8(const uint8* p)    { uint64 v; XlCopyMemory(&v, p, 8); return v; }
+        static inline uint64 WyRead4(const uint8* p)    { uint32 v; XlCopyMemory(&v, p, 4); return v; }
+        static inline uint64 WyRead3(const uint8* p, size_t k) { return (uint64(p[0]) << 16ull) | (uint64(p[k >> 1]) << 8ull) | p[k - 1]; }
+
+        static uint64 WyHash(const void* key, size_t len, uint64 seed)
+        {
+            auto p = (const uint8*)key;
+            seed ^= WyMix(seed ^ WySecret[0], WySecret[1]);
+            uint64 a, b;
+            if (len <= 16) {
+                if (len >= 4) {
+                    a = (WyRead4(p) << 32ull) | WyRead4(p + ((len >> 3) << 2));
+                    b = (WyRead4(p + len - 4) << 32ull) | WyRead4(p + len - 4 - ((len >> 3) << 2));
+                } else if (len > 0) {
+                    a = WyRead3(p, len);
+                    b = 0;
+                } else {
+                    a = b = 0;
+                }
+            } else {
+                size_t i = len;
+                if (i > 48) {
+                    uint64 see1 = seed, see2 = seed;
+                    do {
+                        seed = WyMix(WyRead8(p) ^ WySecret[1], WyRead8(p + 8) ^ seed);
+                        see1 = WyMix(WyRead8(p + 16) ^ WySecret[2], WyRead8(p + 24) ^ see1);
+                        see2 = WyMix(WyRead8(p + 32) ^ WySecret[3], WyRead8(p + 40) ^ see2);
+                        p += 48; i -= 48;
+                    } while (i > 48);
+                    seed ^= see1 ^ see2;
+                }
+                while (i > 16) {
+                    seed = WyMix(WyRead8(p) ^ WySecret[1], WyRead8(p + 8) ^ seed);
+                    i -= 16; p += 16;
+                }
+                a = WyRead8(p + i - 16);
+                b = WyRead8(p + i - 8);
+            }
+            a ^= WySecret[1];
+            b ^= seed;
+            WyMultiply(a, b);
+            return WyMix(a ^ WySecret[0] ^ uint64(len), b ^ WySecret[1]);
+        }
+    }
+
+    uint64 Hash64(const void* begin, const void* end, uint64 seed)
+    {
+        return Internal::WyHash(begin, size_t(end)-size_t(begin), seed);
     }
 
     uint32 Hash32(const void* begin, const void* end, uint32 seed)
     {
-        uint32 temp;
-        MurmurHash3_x86_32(begin, int(size_t(end)-size_t(begin)), seed, &temp);
-        return temp;
+            // (the full 64 bit hash is cheap enough that there's no value in a separate 32 bit kernel)
+        auto result = Internal::WyHash(begin, size_t(end)-size_t(begin), uint64(seed));
+        return uint32(result ^ (result >> 32ull));
+    }
+
+    #if defined(CONSTEXPR14_SUPPORTED)
+            //  ConstExprHash64 (in MemoryUtils.h) must produce exactly the same values as 
+            //  Internal::WyHash, or compile time hashes will fail to match runtime hashes.
+            //  These values were generated by the runtime implementation, and cover every
+            //  path through the algorithm (empty, 1-3, 4-16, 17-48 and >48 bytes).
+        static_assert(""_h == 0x126e572504ff073eull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("a"_h == 0x5f6907d0b98e8903ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("abc"_h == 0x5b66fa351b8a3149ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("Skel"_h == 0xc74c3c3a015181e7ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("LocalTransform"_h == 0x5da2a3c264ada982ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("DiffuseTexture"_h == 0x71856e7b51e866cfull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("BasicMaterialConstants"_h == 0x6f2e81c9ab5d0b9eull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("0123456789abcdef"_h == 0xc79172c3698446d5ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("0123456789abcdefg"_h == 0x2bba2047dcccfb5aull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("FillWithNoiseParameters"_h == 0xf861516a0b652755ull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("The quick brown fox jumps over the lazy dog, repeatedly"_h == 0xae16f8012545585dull, "ConstExprHash64 does not match the runtime Hash64");
+        static_assert("The quick brown fox jumps over the lazy dog, and then it jumps again, and again, and again."_h == 0x6d019de9fe09b2f8ull, "ConstExprHash64 does not match the runtime Hash64");
+    #endif
+
+#endif
+
+    uint64 Hash64(const char str[], uint64 seed)
+    {
+        return Hash64(str, &str[XlStringLen(str)], seed);
+    }
+
+    uint64 Hash64(const std::string& str, uint64 seed)
+    {
+        return Hash64(AsPointer(str.begin()), AsPointer(str.end()), seed);
     }
 }
 
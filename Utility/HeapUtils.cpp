@@ -7,6 +7,7 @@
 #include "HeapUtils.h"
 #include "PtrUtils.h"
 #include "MemoryUtils.h"
+#include "ArithmeticUtils.h"
 #include <assert.h>
 
 namespace Utility
@@ -74,303 +75,463 @@ namespace Utility
         /////////////////////////////////////////////////////////////////////////////////
 
     template <typename Marker>
-        unsigned    SpanningHeap<Marker>::Allocate(unsigned size)
+        void    SpanningHeap<Marker>::MapSize(uint32 size, unsigned& fl, unsigned& sl)
     {
-        const Marker sentinel = Marker(~0x0);
-        Marker bestSize = sentinel;
-        Marker internalSize = ToInternalSize(AlignSize(size));
-        assert(ToExternalSize(internalSize)>=size);
-
-        if ((_largestFreeBlockValid && _largestFreeBlock<internalSize) || !_markers.size()) {
-            return ~unsigned(0x0);  // threading can cause false return here -- but that shouldn't be a major issue
+            //  Small blocks get a linear first level bin of their own. Otherwise the first
+            //  level is the position of the highest bit, and the second level is the next
+            //  SLBits bits below it.
+        if (size < SLCount) {
+            fl = 0;
+            sl = size;
+        } else {
+            unsigned highBit = 31 - xl_clz4(size);
+            fl = highBit - SLBits + 1;
+            sl = (size >> (highBit - SLBits)) - SLCount;
         }
+        assert(fl < FLCount && sl < SLCount);
+    }
 
-        ScopedLock(_lock);
+    template <typename Marker>
+        void    SpanningHeap<Marker>::LinkToBin_Internal(uint32 block)
+    {
+        unsigned fl, sl;
+        auto& b = _freeBlocks[block];
+        MapSize(b._size, fl, sl);
+        b._prev = Invalid;
+        b._next = _bins[fl][sl];
+        if (b._next != Invalid) { _freeBlocks[b._next]._prev = block; }
+        _bins[fl][sl] = block;
+        _slBitmap[fl] |= 1u << sl;
+        _flBitmap |= 1u << fl;
+    }
 
-            //  Marker array is simple -- just a list of positions. It will alternate between
-            //  allocated and unallocated
-        Marker largestFreeBlock[2] = {0,0};
-        Marker largestFreeBlockPosition = 0;
-
-        std::vector<Marker>::iterator best = _markers.end();
-        for (std::vector<Marker>::iterator i=_markers.begin(); i<(_markers.end()-1);i+=2) {
-            Marker blockSize = *(i+1) - *i;
-            if (blockSize >= internalSize && blockSize < bestSize) {
-                bestSize = blockSize;
-                best = i;
-            }
-            if (blockSize >= largestFreeBlock[0]) {
-                largestFreeBlock[1] = largestFreeBlock[0];
-                largestFreeBlock[0] = blockSize;
-                largestFreeBlockPosition = *i;
-            } else if (blockSize > largestFreeBlock[1]) {
-                largestFreeBlock[1] = blockSize;
+    template <typename Marker>
+        void    SpanningHeap<Marker>::UnlinkFromBin_Internal(uint32 block)
+    {
+        auto& b = _freeBlocks[block];
+        if (b._next != Invalid) { _freeBlocks[b._next]._prev = b._prev; }
+        if (b._prev != Invalid) {
+            _freeBlocks[b._prev]._next = b._next;
+        } else {
+            unsigned fl, sl;
+            MapSize(b._size, fl, sl);
+            assert(_bins[fl][sl] == block);
+            _bins[fl][sl] = b._next;
+            if (b._next == Invalid) {
+                _slBitmap[fl] &= ~(1u << sl);
+                if (!_slBitmap[fl]) { _flBitmap &= ~(1u << fl); }
             }
         }
+        b._prev = b._next = Invalid;
+    }
 
-        if (bestSize == sentinel) {
-            _largestFreeBlock = largestFreeBlock[0];
-            _largestFreeBlockValid = true;
-            assert(largestFreeBlock[0] < size);
-            return ~unsigned(0x0);
-        } 
+    template <typename Marker>
+        void    SpanningHeap<Marker>::AddFreeBlock_Internal(uint32 start, uint32 size)
+    {
+        assert(size != 0);
+        uint32 block;
+        if (_firstUnused != Invalid) {
+            block = _firstUnused;
+            _firstUnused = _freeBlocks[block]._next;
+        } else {
+            block = uint32(_freeBlocks.size());
+            _freeBlocks.push_back(FreeBlock());
+        }
 
-        {
-            if (largestFreeBlockPosition==*best) {
-                _largestFreeBlock = std::max(Marker(largestFreeBlock[0]-internalSize), largestFreeBlock[1]);
-            } else {
-                _largestFreeBlock = largestFreeBlock[0];
-            }
-            _largestFreeBlockValid = true;
+        auto& b = _freeBlocks[block];
+        b._start = start;
+        b._size = size;
+        LinkToBin_Internal(block);
+        _freeByStart.Insert(start, block);
+        _freeByEnd.Insert(start+size, block);
+    }
+
+    template <typename Marker>
+        void    SpanningHeap<Marker>::RemoveFreeBlock_Internal(uint32 block)
+    {
+        UnlinkFromBin_Internal(block);
+        auto& b = _freeBlocks[block];
+        _freeByStart.Erase(b._start);
+        _freeByEnd.Erase(b._start+b._size);
+        b._size = 0;
+        b._next = _firstUnused;
+        _firstUnused = block;
+    }
+
+    template <typename Marker>
+        uint32  SpanningHeap<Marker>::FindFreeBlock_Internal(uint32 size) const
+    {
+            //  Round the size up to the next second level boundary, so that any block in
+            //  the bin we find is guaranteed to be large enough. The search is then just
+            //  a couple of bit scans.
+        uint64 roundedSize = size;
+        if (size >= SLCount) {
+            roundedSize += (uint64(1) << ((31 - xl_clz4(size)) - SLBits)) - 1;
         }
-        
-        if (bestSize == internalSize) {
-                //  Got an exact match. In this case we remove 2 markers, because the entire span has become 
-                //  allocated, and should just merge into the spans around it.
-            unsigned result = ToExternalSize(*best);
-            if (best == _markers.begin()) {
-                if (_markers.size()==2) {   // special case for unallocated heap to fully allocated heap (0,0) -> (0,0,size)
-                    _markers.insert(_markers.begin(), 0);
-                } else {
-                    *(best+1) = 0;
-                }
-            } else {
-                if (best+2 >= _markers.end()) {
-                    _markers.erase(best);
-                } else {
-                    _markers.erase(best, best+2);
+        if (roundedSize <= std::numeric_limits<uint32>::max()) {
+            unsigned fl, sl;
+            MapSize(uint32(roundedSize), fl, sl);
+            uint32 slMap = _slBitmap[fl] & (~uint32(0x0) << sl);
+            if (!slMap && (fl+1) < FLCount) {
+                uint32 flMap = _flBitmap & (~uint32(0x0) << (fl+1));
+                if (flMap) {
+                    fl = xl_ctz4(flMap);
+                    slMap = _slBitmap[fl];
                 }
             }
-            assert(_markers[0]==0);
-            assert(_largestFreeBlock==CalculateLargestFreeBlock_Internal());
-            if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-            return result;
-        } else {
-                //  We'll allocate from the start of the span space. 
-            unsigned result = ToExternalSize(*best);
-            if (best == _markers.begin()) {
-                    //      We're allocating from the start of the heap. But we can't move the marker
-                    //      at the start of the heap, so we have to insert 2 more...
-                Marker insertion[] = {0, internalSize};
-                _markers.insert(_markers.begin()+1, insertion, &insertion[dimof(insertion)]);
-            } else {
-                *best += internalSize;
+            if (slMap) {
+                return _bins[fl][xl_ctz4(slMap)];
             }
-            if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-            assert(_largestFreeBlock==CalculateLargestFreeBlock_Internal());
-            return result;
         }
+
+            //  The rounding means blocks in the same bin as the request are skipped.
+            //  Before failing, check that bin directly, so that an allocation only fails
+            //  when there really is no free block large enough.
+        unsigned fl, sl;
+        MapSize(size, fl, sl);
+        for (auto b=_bins[fl][sl]; b!=Invalid; b=_freeBlocks[b]._next) {
+            if (_freeBlocks[b]._size >= size) {
+                return b;
+            }
+        }
+        return Invalid;
     }
 
     template <typename Marker>
-        bool        SpanningHeap<Marker>::Allocate(unsigned ptr, unsigned size)
+        uint32  SpanningHeap<Marker>::CalculateLargestFreeBlock_Internal() const
     {
-        return BlockAdjust_Internal(ptr, size, true);
+            // the largest block must be in the highest non-empty bin
+        if (!_flBitmap) {
+            return 0;
+        }
+        unsigned fl = 31 - xl_clz4(_flBitmap);
+        unsigned sl = 31 - xl_clz4(_slBitmap[fl]);
+        uint32 largestBlock = 0;
+        for (auto b=_bins[fl][sl]; b!=Invalid; b=_freeBlocks[b]._next) {
+            largestBlock = std::max(largestBlock, _freeBlocks[b]._size);
+        }
+        return largestBlock;
     }
-    
+
     template <typename Marker>
-        bool        SpanningHeap<Marker>::Deallocate(unsigned ptr, unsigned size)
+        void    SpanningHeap<Marker>::AdjustStatistic_Internal(Interlocked::Value64 volatile* stat, int64 delta)
     {
-        return BlockAdjust_Internal(ptr, size, false);
+            //  Statistics are only written while holding _lock, so a plain read-modify-write
+            //  is enough. The exchange (along with Interlocked::Load64, which is atomic even
+            //  on 32 bit targets) makes sure readers never see a torn value.
+        Interlocked::Exchange64(stat, Interlocked::Load64(stat) + delta);
     }
 
     template <typename Marker>
-        bool        SpanningHeap<Marker>::BlockAdjust_Internal(unsigned ptr, unsigned size, bool allocateOperation)
+        void    SpanningHeap<Marker>::ResetStatistics_Internal()
     {
+        int64 availableSpace = 0;
+        for (auto i=_freeBlocks.cbegin(); i!=_freeBlocks.cend(); ++i) {
+            availableSpace += i->_size;
+        }
+        Interlocked::Exchange64(&_statHeapSize, _heapEnd);
+        Interlocked::Exchange64(&_statAvailableSpace, availableSpace);
+        Interlocked::Exchange64(&_statFreeBlockCount, int64(_freeByStart.size()));
+    }
+
+    template <typename Marker>
+        unsigned    SpanningHeap<Marker>::Allocate(unsigned size)
+    {
+        uint32 internalSize = ToInternalSize32(AlignSize32(size));
+        assert(ToExternalSize32(internalSize)>=size);
+        if (!internalSize) {
+            return ~unsigned(0x0);
+        }
+
         ScopedLock(_lock);
-        Marker internalOffset = ToInternalSize(ptr);
-        Marker internalSize = ToInternalSize(AlignSize(size));
-        if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-
-        _largestFreeBlockValid = false; // have to recalculate largest free after deallocate. We could update based on local changes, but...
-
-            // find the span in which this belongs, and mark the space deallocated
-        std::vector<Marker>::iterator i = _markers.begin()+(allocateOperation?0:1);
-        for (; (i+1)<_markers.end();i+=2) {
-            Marker start = *i;
-            Marker end = *(i+1);
-            if (internalOffset >= start && internalOffset < end) {
-                assert((internalOffset+internalSize) <= end);
-                if (start == internalOffset) {
-                    if (end == (internalOffset+internalSize)) {
-                            // the entire span is begin destroyed.
-                        if (i == _markers.begin() && allocateOperation) {
-                            *(i+1) = 0;
-                        } else if (i+2 >= _markers.end()) {
-                            _markers.erase(i);
-                        } else {
-                            _markers.erase(i, i+2);
-                        }
-                        assert(_markers[0]==0);
-                        if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-                        return true;
-                    }
-
-                        // we can just move the start marker up to cover the unallocated space
-                    if (i == _markers.begin() && allocateOperation) {
-                        Marker insertion[] = {internalOffset, Marker(internalOffset+internalSize)};
-                        _markers.insert(i+1, insertion, &insertion[dimof(insertion)]);
-                    } else {
-                        *i = internalOffset+internalSize;
-                    }
-                    assert(_markers[0]==0);
-                    if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-                    return true;
-                } else if (end == (internalOffset+internalSize)) {
-                        // move the end marker back to cover the space (but not if it's the end sentinel)
-                    if (i+2 >= _markers.end()) {
-                        _markers.insert(i+1, internalOffset);
-                    } else {
-                        *(i+1) = internalOffset;
-                    }
-                    assert(_markers[0]==0);
-                    if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-                    return true;
-                } else {
-                        // create new markers to match the deallocated space
-                    Marker insertion[] = {internalOffset, Marker(internalOffset+internalSize)};
-                    _markers.insert(i+1, insertion, &insertion[dimof(insertion)]);
-                    if (_markers.size()==2) {assert(_markers[0]==0 && _markers[1]!=0);}
-                    return true;
+        auto block = FindFreeBlock_Internal(internalSize);
+        if (block == Invalid) {
+            return ~unsigned(0x0);
+        }
+
+            //  We'll allocate from the start of the free block. If there's space left over,
+            //  the same FreeBlock entry is reused for the remainder (its end doesn't change).
+        auto& b = _freeBlocks[block];
+        uint32 result = b._start;
+        if (b._size == internalSize) {
+            RemoveFreeBlock_Internal(block);
+            AdjustStatistic_Internal(&_statFreeBlockCount, -1);
+        } else {
+            UnlinkFromBin_Internal(block);
+            _freeByStart.Erase(b._start);
+            b._start += internalSize;
+            b._size -= internalSize;
+            _freeByStart.Insert(b._start, block);
+            LinkToBin_Internal(block);
+        }
+
+        AdjustStatistic_Internal(&_statAvailableSpace, -int64(internalSize));
+        AdjustStatistic_Internal(&_statAllocationCount, 1);
+        return ToExternalSize32(result);
+    }
+
+    template <typename Marker>
+        bool        SpanningHeap<Marker>::Allocate(unsigned ptr, unsigned size)
+    {
+        uint32 internalOffset = ToInternalSize32(ptr);
+        uint32 internalSize = ToInternalSize32(AlignSize32(size));
+        if (!internalSize) {
+            return true;
+        }
+
+        ScopedLock(_lock);
+
+            //  Allocating at a specific address is uncommon, so we just search through the
+            //  free blocks for the one that contains the requested span
+        for (uint32 block=0; block<uint32(_freeBlocks.size()); ++block) {
+            auto& b = _freeBlocks[block];
+            if (b._size && internalOffset >= b._start && internalOffset < (b._start+b._size)) {
+                assert((internalOffset+internalSize) <= (b._start+b._size));
+                uint32 start = b._start, end = b._start+b._size;
+                RemoveFreeBlock_Internal(block);
+                if (start < internalOffset) {
+                    AddFreeBlock_Internal(start, internalOffset-start);
                 }
+                if ((internalOffset+internalSize) < end) {
+                    AddFreeBlock_Internal(internalOffset+internalSize, end-(internalOffset+internalSize));
+                }
+
+                Interlocked::Exchange64(&_statFreeBlockCount, int64(_freeByStart.size()));
+                AdjustStatistic_Internal(&_statAvailableSpace, -int64(internalSize));
+                AdjustStatistic_Internal(&_statAllocationCount, 1);
+                return true;
             }
         }
 
-        assert(0);      // couldn't find it within our heap
+        assert(0);      // the requested space isn't free
         return false;
     }
-
+    
     template <typename Marker>
-        auto SpanningHeap<Marker>::CalculateLargestFreeBlock_Internal() const -> Marker
+        bool        SpanningHeap<Marker>::Deallocate(unsigned ptr, unsigned size)
     {
-        Marker largestBlock = 0;
-        assert(!_markers.empty());
-        std::vector<Marker>::const_iterator i = _markers.begin();
-        for (; i<(_markers.end()-1);i+=2) {
-            Marker start = *i;
-            Marker end = *(i+1);
-            largestBlock = std::max(largestBlock, Marker(end-start));
+        uint32 internalOffset = ToInternalSize32(ptr);
+        uint32 internalSize = ToInternalSize32(AlignSize32(size));
+        if (!internalSize) {
+            return true;
         }
-        return largestBlock;
+
+        ScopedLock(_lock);
+        if (uint64(internalOffset) + uint64(internalSize) > _heapEnd) {
+            assert(0);      // couldn't find it within our heap
+            return false;
+        }
+        assert(!_freeByStart.Find(internalOffset));                     // (span is already free)
+        assert(!_freeByEnd.Find(internalOffset+internalSize));
+
+            //  Merge with the free blocks immediately before and after (if they exist), so
+            //  that adjacent free blocks are always coalesced. When merging, we extend
+            //  the existing FreeBlock entry, rather than creating a new one.
+        uint32 end = internalOffset+internalSize;
+        auto* beforePtr = _freeByEnd.Find(internalOffset);
+        auto* afterPtr = _freeByStart.Find(end);
+        auto before = beforePtr ? *beforePtr : Invalid;
+        auto after = afterPtr ? *afterPtr : Invalid;
+
+        int64 freeBlockCountChange;
+        if (before != Invalid) {
+            if (after != Invalid) {
+                end = _freeBlocks[after]._start + _freeBlocks[after]._size;
+                RemoveFreeBlock_Internal(after);
+            }
+            auto& b = _freeBlocks[before];
+            UnlinkFromBin_Internal(before);
+            _freeByEnd.Erase(internalOffset);
+            b._size = end - b._start;
+            _freeByEnd.Insert(end, before);
+            LinkToBin_Internal(before);
+            freeBlockCountChange = (after != Invalid) ? -1 : 0;
+        } else if (after != Invalid) {
+            auto& b = _freeBlocks[after];
+            UnlinkFromBin_Internal(after);
+            _freeByStart.Erase(end);
+            b._start = internalOffset;
+            b._size += internalSize;
+            _freeByStart.Insert(internalOffset, after);
+            LinkToBin_Internal(after);
+            freeBlockCountChange = 0;
+        } else {
+            AddFreeBlock_Internal(internalOffset, internalSize);
+            freeBlockCountChange = 1;
+        }
+
+        AdjustStatistic_Internal(&_statFreeBlockCount, freeBlockCountChange);
+        AdjustStatistic_Internal(&_statAvailableSpace, int64(internalSize));
+        AdjustStatistic_Internal(&_statDeallocationCount, 1);
+        return true;
     }
 
     template <typename Marker>
         unsigned    SpanningHeap<Marker>::CalculateAvailableSpace() const
     {
-        ScopedLock(_lock);
-        unsigned result = 0;
-        std::vector<Marker>::const_iterator i = _markers.begin();
-        for (; (i+1)<_markers.end();i+=2) {
-            Marker start = *i;
-            Marker end = *(i+1);
-            result += end-start;
-        }
-        return ToExternalSize(Marker(result));
+        return unsigned(Interlocked::Load64(&_statAvailableSpace)<<4);
     }
 
     template <typename Marker>
         unsigned    SpanningHeap<Marker>::CalculateLargestFreeBlock() const
     {
         ScopedLock(_lock);
-        if (!_largestFreeBlockValid) {
-            _largestFreeBlock = CalculateLargestFreeBlock_Internal();
-            _largestFreeBlockValid = true;
-        }
-        return ToExternalSize(_largestFreeBlock);
+        return ToExternalSize32(CalculateLargestFreeBlock_Internal());
     }
 
     template <typename Marker>
         unsigned    SpanningHeap<Marker>::CalculateAllocatedSpace() const
     {
-        ScopedLock(_lock);
-        if (_markers.empty()) return 0;
-
-        unsigned result = 0;
-        std::vector<Marker>::const_iterator i = _markers.begin()+1;
-        for (; i<(_markers.end()-1);i+=2) {
-            Marker start = *i;
-            Marker end = *(i+1);
-            result += end-start;
-        }
-        return ToExternalSize(Marker(result));
+        auto heapSize = Interlocked::Load64(&_statHeapSize);
+        auto availableSpace = Interlocked::Load64(&_statAvailableSpace);
+        return unsigned(std::max(heapSize - availableSpace, int64(0))<<4);
     }
 
     template <typename Marker>
         unsigned    SpanningHeap<Marker>::CalculateHeapSize() const
     {
-        ScopedLock(_lock);
-        if (_markers.empty()) {
-            return 0;
-        }
-        return ToExternalSize(_markers[_markers.size()-1]);
+        return unsigned(Interlocked::Load64(&_statHeapSize)<<4);
     }
 
     template <typename Marker>
-        unsigned        SpanningHeap<Marker>::AppendNewBlock(unsigned size)
+        auto SpanningHeap<Marker>::GetStatistics() const -> Statistics
     {
-        ScopedLock(_lock);
-        if (!_markers.size()) {
-            _markers.push_back(0);
-            _markers.push_back(0);
-            _markers.push_back(ToInternalSize(AlignSize(size)));
-            return 0;
-        }
+        Statistics result;
+        result._heapSize            = uint64(Interlocked::Load64(&_statHeapSize))<<4;
+        result._availableSpace      = uint64(Interlocked::Load64(&_statAvailableSpace))<<4;
+        result._freeBlockCount      = unsigned(Interlocked::Load64(&_statFreeBlockCount));
+        result._allocationCount     = uint64(Interlocked::Load64(&_statAllocationCount));
+        result._deallocationCount   = uint64(Interlocked::Load64(&_statDeallocationCount));
+        return result;
+    }
 
+    template <typename Marker>
+        unsigned        SpanningHeap<Marker>::AppendNewBlock(unsigned size)
+    {
             // append a new block in an allocated status
-
-        const bool endsInAllocatedBlock = _markers.size()&1;  // odd markers == ends in allocated block
-        auto finalMarker = _markers[_markers.size()-1];
-        auto newBlockInternalSize = ToInternalSize(AlignSize(size));
-        assert((unsigned(finalMarker) + unsigned(newBlockInternalSize)) <= std::numeric_limits<Marker>::max());
-        auto newEnd = Marker(finalMarker + newBlockInternalSize);
-        if (endsInAllocatedBlock) {
-            _markers[_markers.size()-1] = newEnd;     // just shift the end marker back
-        } else {
-            _markers.push_back(newEnd);               // add a final allocated block
-        }
-
-        return ToExternalSize(finalMarker);
+        ScopedLock(_lock);
+        uint32 newBlockInternalSize = ToInternalSize32(AlignSize32(size));
+        assert((uint64(_heapEnd) + uint64(newBlockInternalSize)) <= std::numeric_limits<uint32>::max());
+        uint32 result = _heapEnd;
+        _heapEnd += newBlockInternalSize;
+        AdjustStatistic_Internal(&_statHeapSize, int64(newBlockInternalSize));
+        return ToExternalSize32(result);
     }
     
     template <typename Marker>
         uint64      SpanningHeap<Marker>::CalculateHash() const
     {
         ScopedLock(_lock);
-        return Hash64(AsPointer(_markers.begin()), AsPointer(_markers.end()));
+        auto markers = BuildMarkers_Internal();
+        return Hash64(AsPointer(markers.begin()), AsPointer(markers.end()));
     }
 
     template <typename Marker>
         bool        SpanningHeap<Marker>::IsEmpty() const
     {
-        ScopedLock(_lock);
-        return _markers.size() <= 2;
+            // free blocks are always coalesced, so if everything is free, it's all in one block
+        return Interlocked::Load64(&_statAvailableSpace) == Interlocked::Load64(&_statHeapSize);
     }
 
     template <typename Marker>
         std::vector<unsigned> SpanningHeap<Marker>::CalculateMetrics() const
     {
         ScopedLock(_lock);
+        auto markers = BuildMarkers_Internal();
         std::vector<unsigned> result;
-        result.reserve(_markers.size());
-        std::vector<Marker>::const_iterator i = _markers.begin();
-        for (; i!=_markers.end();++i) {
-            result.push_back(ToExternalSize(*i));
-        }
-        #if defined(XL_DEBUG)
-            assert(!_largestFreeBlockValid || _largestFreeBlock==CalculateLargestFreeBlock_Internal());
-        #endif
+        result.reserve(markers.size());
+        for (auto i=markers.cbegin(); i!=markers.cend(); ++i) {
+            result.push_back(ToExternalSize32(*i));
+        }
         return result;
     }
 
+    template <typename Marker>
+        auto SpanningHeap<Marker>::BuildMarkers_Internal() const -> std::vector<uint32>
+    {
+            //  Build the marker representation (the format used by Flatten() and 
+            //  CalculateMetrics()). It's just a list of positions that alternates between
+            //  the start of a free span and the start of an allocated span. The first
+            //  marker is always 0 (so the first free span can be empty), and the last is
+            //  always the end of the heap.
+        std::vector<std::pair<uint32, uint32>> freeSpans;
+        freeSpans.reserve(_freeByStart.size());
+        for (auto i=_freeBlocks.cbegin(); i!=_freeBlocks.cend(); ++i) {
+            if (i->_size) {
+                freeSpans.push_back(std::make_pair(i->_start, i->_start+i->_size));
+            }
+        }
+        std::sort(freeSpans.begin(), freeSpans.end());
+
+        std::vector<uint32> result;
+        result.reserve(freeSpans.size()*2+3);
+        result.push_back(0);
+        auto i = freeSpans.cbegin();
+        if (i != freeSpans.cend() && i->first == 0) {
+            result.push_back(i->second);
+            ++i;
+        } else {
+            result.push_back(0);
+        }
+        for (; i!=freeSpans.cend(); ++i) {
+            assert(i->first > result[result.size()-1]);
+            result.push_back(i->first);
+            result.push_back(i->second);
+        }
+        if (result[result.size()-1] != _heapEnd) {
+            result.push_back(_heapEnd);
+        }
+        return result;
+    }
+
+    template <typename Marker>
+        void        SpanningHeap<Marker>::Reset_Internal()
+    {
+        _freeBlocks.clear();
+        _firstUnused = Invalid;
+        _freeByStart.Clear();
+        _freeByEnd.Clear();
+        _flBitmap = 0;
+        XlZeroMemory(_slBitmap);
+        for (unsigned fl=0; fl<FLCount; ++fl) {
+            for (unsigned sl=0; sl<SLCount; ++sl) {
+                _bins[fl][sl] = Invalid;
+            }
+        }
+        _heapEnd = 0;
+    }
+
+    template <typename Marker>
+        void        SpanningHeap<Marker>::LoadMarkers_Internal(const uint32* begin, const uint32* end)
+    {
+        Reset_Internal();
+        if (begin == end) {
+            ResetStatistics_Internal();
+            return;
+        }
+
+            // make sure things are in the right order
+        for (auto i=begin+1; i<end; ++i) {
+            assert(*(i-1) <= *i);
+        }
+
+        _heapEnd = *(end-1);
+        for (auto i=begin; (i+1)<end; i+=2) {
+            if (*(i+1) > *i) {
+                AddFreeBlock_Internal(*i, *(i+1) - *i);
+            }
+        }
+        ResetStatistics_Internal();
+    }
+
     // static bool SortAllocatedBlocks_LargestToSmallest(const std::pair<MarkerHeap::Marker, MarkerHeap::Marker>& lhs, const std::pair<MarkerHeap::Marker, MarkerHeap::Marker>& rhs)
     // {
     //     return (lhs.second-lhs.first)>(rhs.second-rhs.first);
     // }
 
-    template<typename Marker>
-        static bool SortAllocatedBlocks_SmallestToLargest(
-            const std::pair<Marker, Marker>& lhs, 
-            const std::pair<Marker, Marker>& rhs)
+    static bool SortAllocatedBlocks_SmallestToLargest(
+            const std::pair<uint32, uint32>& lhs, 
+            const std::pair<uint32, uint32>& rhs)
     {
         return (lhs.second-lhs.first)<(rhs.second-rhs.first);
     }
@@ -389,13 +550,14 @@ namespace Utility
         std::vector<DefragStep> SpanningHeap<Marker>::CalculateDefragSteps() const
     {
         ScopedLock(_lock);
-
-        std::vector<std::pair<Marker, Marker> > allocatedBlocks;
-        allocatedBlocks.reserve(_markers.size()/2);
-        std::vector<Marker>::const_iterator i = _markers.begin()+1;
-        for (; (i+1)<_markers.end();i+=2) {
-            Marker start = *i;
-            Marker end   = *(i+1);
+        auto markers = BuildMarkers_Internal();
+
+        std::vector<std::pair<uint32, uint32> > allocatedBlocks;
+        allocatedBlocks.reserve(markers.size()/2);
+        auto i = markers.cbegin()+1;
+        for (; (i+1)<markers.cend();i+=2) {
+            uint32 start = *i;
+            uint32 end   = *(i+1);
             assert(start < end);
             allocatedBlocks.push_back(std::make_pair(start, end));
         }
@@ -411,34 +573,25 @@ namespace Utility
             //      area in a resource to another -- and that might not be possible efficiently in D3D.
             //
 
-        std::sort(allocatedBlocks.begin(), allocatedBlocks.end(), SortAllocatedBlocks_SmallestToLargest<Marker>);
+        std::sort(allocatedBlocks.begin(), allocatedBlocks.end(), SortAllocatedBlocks_SmallestToLargest);
 
         std::vector<DefragStep> result;
         result.reserve(allocatedBlocks.size());
 
-        Marker compressedPosition = 0;
-        for (std::vector<std::pair<Marker, Marker> >::const_iterator i=allocatedBlocks.begin(); i!=allocatedBlocks.end(); ++i) {
+        uint32 compressedPosition = 0;
+        for (auto i=allocatedBlocks.cbegin(); i!=allocatedBlocks.cend(); ++i) {
             assert(i->first < i->second);
             DefragStep step;
-            step._sourceStart    = ToExternalSize(i->first);
-            step._sourceEnd      = ToExternalSize(i->second);
-            step._destination    = ToExternalSize(compressedPosition);
-            assert(step._destination < 512*1024);
-            assert((step._destination + step._sourceEnd - step._sourceStart) <= ToExternalSize(_markers[_markers.size()-1]));
+            step._sourceStart    = ToExternalSize32(i->first);
+            step._sourceEnd      = ToExternalSize32(i->second);
+            step._destination    = ToExternalSize32(compressedPosition);
+            assert((step._destination + step._sourceEnd - step._sourceStart) <= ToExternalSize32(_heapEnd));
             assert(step._sourceStart < step._sourceEnd);
             compressedPosition += i->second - i->first;
             result.push_back(step);
         }
 
         std::sort(result.begin(), result.end(), SortDefragStep_SourceStart);
-
-            // check for sane boundary
-        #if defined(XL_DEBUG)
-            for (std::vector<DefragStep>::iterator i=result.begin(); i!=result.end(); ++i) {
-                assert(i->_destination < 512*1024);
-            }
-        #endif
-
         return result;
     }
 
@@ -451,41 +604,42 @@ namespace Utility
             //      All of the spans in the heap have moved about we have to recalculate the
             //      allocated spans from scratch, based on the positions of the new blocks
             //
-        unsigned startingAvailableSize = CalculateAvailableSpace(); (void)startingAvailableSize;
-        unsigned startingLargestBlock = CalculateLargestFreeBlock(); (void)startingLargestBlock;
+        auto startingAvailableSize = Interlocked::Load64(&_statAvailableSpace); (void)startingAvailableSize;
+        auto startingLargestBlock = CalculateLargestFreeBlock_Internal(); (void)startingLargestBlock;
 
-        Marker heapEnd = _markers[_markers.size()-1];
-        _markers.erase(_markers.begin(), _markers.end());
-        _markers.push_back(0);
+        uint32 heapEnd = _heapEnd;
+        std::vector<uint32> markers;
+        markers.reserve(defrag.size()*2+3);
+        markers.push_back(0);
         if (!defrag.empty()) {
             std::vector<DefragStep> defragByDestination(defrag);
             std::sort(defragByDestination.begin(), defragByDestination.end(), SortDefragStep_Destination);
 
-            Marker currentAllocatedBlockBegin    = ToInternalSize(defragByDestination.begin()->_destination);
-            Marker currentAllocatedBlockEnd      = ToInternalSize(defragByDestination.begin()->_destination + AlignSize(defragByDestination.begin()->_sourceEnd-defragByDestination.begin()->_sourceStart));
+            uint32 currentAllocatedBlockBegin    = ToInternalSize32(defragByDestination.begin()->_destination);
+            uint32 currentAllocatedBlockEnd      = ToInternalSize32(defragByDestination.begin()->_destination + AlignSize32(defragByDestination.begin()->_sourceEnd-defragByDestination.begin()->_sourceStart));
 
             for (std::vector<DefragStep>::const_iterator i=defragByDestination.begin()+1; i!=defragByDestination.end(); ++i) {
-                Marker blockBegin    = ToInternalSize(i->_destination);
-                Marker blockEnd      = ToInternalSize(i->_destination+AlignSize(i->_sourceEnd-i->_sourceStart));
+                uint32 blockBegin    = ToInternalSize32(i->_destination);
+                uint32 blockEnd      = ToInternalSize32(i->_destination+AlignSize32(i->_sourceEnd-i->_sourceStart));
 
                 if (blockBegin == currentAllocatedBlockEnd) {
                     currentAllocatedBlockEnd = blockEnd;
                 } else {
-                    _markers.push_back(currentAllocatedBlockBegin);
-                    _markers.push_back(currentAllocatedBlockEnd);
+                    markers.push_back(currentAllocatedBlockBegin);
+                    markers.push_back(currentAllocatedBlockEnd);
                     currentAllocatedBlockBegin = blockBegin;
                     currentAllocatedBlockEnd = blockEnd;
                 }
             }
 
-            _markers.push_back(currentAllocatedBlockBegin);
-            _markers.push_back(currentAllocatedBlockEnd);
+            markers.push_back(currentAllocatedBlockBegin);
+            markers.push_back(currentAllocatedBlockEnd);
         }
-        _markers.push_back(heapEnd);
-        _largestFreeBlockValid = false;
+        markers.push_back(heapEnd);
+        LoadMarkers_Internal(AsPointer(markers.cbegin()), AsPointer(markers.cend()));
 
-        unsigned newAvailableSpace = CalculateAvailableSpace(); (void)newAvailableSpace;
-        unsigned newLargestBlock = CalculateLargestFreeBlock(); (void)newLargestBlock;
+        auto newAvailableSpace = Interlocked::Load64(&_statAvailableSpace); (void)newAvailableSpace;
+        auto newLargestBlock = CalculateLargestFreeBlock_Internal(); (void)newLargestBlock;
         assert(newAvailableSpace == startingAvailableSize);
         assert(newLargestBlock >= startingLargestBlock);        // sometimes the tests will run a defrag that doesn't reduce the largest block
     }
@@ -495,53 +649,69 @@ namespace Utility
     {
         // return a "serialized" / flattened representation of this heap
         //  -- useful to write it out to disk, or store in a compact form
+        //  This is the only place we narrow to the "Marker" type
         ScopedLock(_lock);
+        auto markers = BuildMarkers_Internal();
 
-        if (_markers.size() >= 2) {
-            for (auto i=_markers.cbegin()+1; i!=_markers.cend(); ++i) {
-                assert(*(i-1) <= *i);
-            }
-        }
-
-        size_t resultSize = sizeof(Marker) * _markers.size();
+        size_t resultSize = sizeof(Marker) * markers.size();
         auto result = std::make_unique<uint8[]>(resultSize);
-        XlCopyMemory(result.get(), AsPointer(_markers.begin()), resultSize);
+        auto* dst = (Marker*)result.get();
+        for (auto i=markers.cbegin(); i!=markers.cend(); ++i, ++dst) {
+            assert(*i <= std::numeric_limits<Marker>::max());      // heap is too big for this flattened format
+            *dst = Marker(*i);
+        }
         return std::make_pair(std::move(result), resultSize);
     }
 
     template <typename Marker>
         SpanningHeap<Marker>::SpanningHeap(unsigned size)
     {
-        _markers.reserve(64);
-        _markers.push_back(0);
-        _markers.push_back(ToInternalSize(AlignSize(size)));
-        _largestFreeBlockValid = false;
-        _largestFreeBlock = 0;
+        Interlocked::Exchange64(&_statAllocationCount, 0);
+        Interlocked::Exchange64(&_statDeallocationCount, 0);
+        Reset_Internal();
+        _heapEnd = ToInternalSize32(AlignSize32(size));
+        if (_heapEnd) {
+            AddFreeBlock_Internal(0, _heapEnd);
+        }
+        ResetStatistics_Internal();
     }
 
     template <typename Marker>
         SpanningHeap<Marker>::SpanningHeap(const uint8 flattened[], size_t flattenedSize)
     {
-        _largestFreeBlockValid = false;
-        _largestFreeBlock = 0;
-            // flattened rep is just a copy of the markers array... we can copy it straight in...
+            // flattened rep is just a copy of the markers array
+        Interlocked::Exchange64(&_statAllocationCount, 0);
+        Interlocked::Exchange64(&_statDeallocationCount, 0);
         auto markerCount = flattenedSize / sizeof(Marker);
-        _markers.resize(markerCount);
+        std::vector<uint32> markers(markerCount);
         std::copy(
             (const Marker*)flattened, (const Marker*)PtrAdd(flattened, markerCount * sizeof(Marker)), 
-            _markers.begin());
+            markers.begin());
+        LoadMarkers_Internal(AsPointer(markers.cbegin()), AsPointer(markers.cend()));
+    }
 
-            // make sure things are in the right order
-        if (_markers.size() >= 2) {
-            for (auto i=_markers.cbegin()+1; i!=_markers.cend(); ++i) {
-                assert(*(i-1) <= *i);
-            }
+    template <typename Marker>
+        SpanningHeap<Marker>::SpanningHeap(const SpanningHeap<Marker>& cloneFrom) 
+    {
+        std::vector<uint32> markers;
+        {
+            ScopedLock(cloneFrom._lock);
+            markers = cloneFrom.BuildMarkers_Internal();
+            Interlocked::Exchange64(&_statAllocationCount, Interlocked::Load64(&cloneFrom._statAllocationCount));
+            Interlocked::Exchange64(&_statDeallocationCount, Interlocked::Load64(&cloneFrom._statDeallocationCount));
         }
+        LoadMarkers_Internal(AsPointer(markers.cbegin()), AsPointer(markers.cend()));
     }
 
     template <typename Marker>
-        SpanningHeap<Marker>::SpanningHeap(const SpanningHeap<Marker>& cloneFrom) 
-    : _markers(cloneFrom._markers), _largestFreeBlock(cloneFrom._largestFreeBlock), _largestFreeBlockValid(cloneFrom._largestFreeBlockValid) {}
+        SpanningHeap<Marker>::SpanningHeap(SpanningHeap<Marker>&& moveFrom)
+    {
+        Interlocked::Exchange64(&_statAllocationCount, 0);
+        Interlocked::Exchange64(&_statDeallocationCount, 0);
+        Reset_Internal();
+        ResetStatistics_Internal();
+        *this = std::move(moveFrom);
+    }
 
     template <typename Marker>
         SpanningHeap<Marker>::~SpanningHeap()
@@ -550,13 +720,49 @@ namespace Utility
     template <typename Marker>
         const SpanningHeap<Marker>& SpanningHeap<Marker>::operator=(const SpanningHeap<Marker>& cloneFrom)
     {
-        _markers = cloneFrom._markers;
-        _largestFreeBlock = cloneFrom._largestFreeBlock;
-        _largestFreeBlockValid = cloneFrom._largestFreeBlockValid;
+        if (&cloneFrom == this) return *this;
+
+        std::vector<uint32> markers;
+        Interlocked::Value64 allocationCount, deallocationCount;
+        {
+            ScopedLock(cloneFrom._lock);
+            markers = cloneFrom.BuildMarkers_Internal();
+            allocationCount = Interlocked::Load64(&cloneFrom._statAllocationCount);
+            deallocationCount = Interlocked::Load64(&cloneFrom._statDeallocationCount);
+        }
+
+        ScopedLock(_lock);
+        LoadMarkers_Internal(AsPointer(markers.cbegin()), AsPointer(markers.cend()));
+        Interlocked::Exchange64(&_statAllocationCount, allocationCount);
+        Interlocked::Exchange64(&_statDeallocationCount, deallocationCount);
+        return *this;
+    }
+
+    template <typename Marker>
+        const SpanningHeap<Marker>& SpanningHeap<Marker>::operator=(SpanningHeap<Marker>&& moveFrom)
+    {
+        if (&moveFrom == this) return *this;
+
+            // (the mutexes themselves aren't moved; each heap keeps its own)
+        ScopedLock(_lock);
+        _freeBlocks = std::move(moveFrom._freeBlocks);
+        _firstUnused = moveFrom._firstUnused;
+        _freeByStart = std::move(moveFrom._freeByStart);
+        _freeByEnd = std::move(moveFrom._freeByEnd);
+        _flBitmap = moveFrom._flBitmap;
+        XlCopyMemory(_slBitmap, moveFrom._slBitmap, sizeof(_slBitmap));
+        XlCopyMemory(_bins, moveFrom._bins, sizeof(_bins));
+        _heapEnd = moveFrom._heapEnd;
+        ResetStatistics_Internal();
+        Interlocked::Exchange64(&_statAllocationCount, Interlocked::Load64(&moveFrom._statAllocationCount));
+        Interlocked::Exchange64(&_statDeallocationCount, Interlocked::Load64(&moveFrom._statDeallocationCount));
+
+        moveFrom.Reset_Internal();
+        moveFrom.ResetStatistics_Internal();
         return *this;
     }
 
-    template SpanningHeap<uint16>;
-    template SpanningHeap<uint32>;
+    template class SpanningHeap<uint16>;
+    template class SpanningHeap<uint32>;
 }
 
@@ -7,7 +7,9 @@
 #pragma once
 
 #include "../Core/Types.h"
+#include "FlatHashMap.h"
 #include "Threading/Mutex.h"
+#include "Threading/ThreadingUtils.h"
 #include <vector>
 #include <algorithm>
 #include <memory>
@@ -33,83 +35,277 @@ namespace Utility
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    /// <summary>Cache of shared objects, with least-recently-used eviction</summary>
+    /// Objects are identified by a 64 bit hash name. Get(), Insert() and eviction
+    /// are all constant time operations. Objects are stored in a fixed array of slots
+    /// that are linked together in LRU order, and an open addressing hash table
+    /// (with linear probing) maps from hash names to slots.
+    ///
+    /// The cache is limited to a fixed number of objects. Optionally, it can also be
+    /// limited by the total size of the objects in bytes (as given to Insert()).
+    /// Insert() will evict the oldest objects until the new object fits within the budget.
+    ///
+    /// LRUCache is not thread safe. See ThreadSafeLRUCache.
     template<typename Type> class LRUCache
     {
     public:
-        void Insert(uint64 hashName, std::shared_ptr<Type> object);
+        void Insert(uint64 hashName, std::shared_ptr<Type> object, size_t sizeInBytes = 0);
         std::shared_ptr<Type>& Get(uint64 hashName);
 
-        LRUCache(unsigned cacheSize);
+        class Metrics
+        {
+        public:
+            uint64      _hits, _misses, _evictions;
+            unsigned    _objectCount;
+            size_t      _bytesUsed;
+        };
+        Metrics GetMetrics() const;
+        void ResetMetrics();
+
+        LRUCache(unsigned cacheSize, size_t byteBudget = 0);
         ~LRUCache();
     protected:
-        std::vector<std::shared_ptr<Type>>   _objects;
-        std::vector<std::pair<uint64, unsigned>> _lookupTable;
-        LRUQueue _queue;
-        unsigned _cacheSize;
+        class Slot
+        {
+        public:
+            std::shared_ptr<Type>   _object;
+            uint64                  _hashName;
+            size_t                  _size;
+            unsigned                _newer, _older;     // links in the LRU list (or the free list, using _older)
+        };
+        std::vector<Slot>       _slots;
+        std::vector<unsigned>   _index;         // open addressing table of slot indices
+        unsigned                _indexMask;
+        unsigned                _newest, _oldest, _firstFree;
+        unsigned                _objectCount;
+        size_t                  _byteBudget, _bytesUsed;
+        uint64                  _hits, _misses, _evictions;
+
+        static const unsigned Invalid = ~unsigned(0x0);
+        static unsigned IndexHash(uint64 hashName);
+        unsigned    FindIndexPosition(uint64 hashName) const;
+        void        RemoveIndexPosition(unsigned position);
+        void        Unlink(unsigned slot);
+        void        LinkAsNewest(unsigned slot);
+        void        Evict(unsigned slot);
+
+        LRUCache(const LRUCache&);
+        LRUCache& operator=(const LRUCache&);
     };
 
     template<typename Type>
-        void LRUCache<Type>::Insert(uint64 hashName, std::shared_ptr<Type> object)
+        inline unsigned LRUCache<Type>::IndexHash(uint64 hashName)
     {
-            // try to insert this object into the cache (if it's not already here)
-        auto i = std::lower_bound(_lookupTable.cbegin(), _lookupTable.cend(), hashName, CompareFirst<uint64, unsigned>());
-        if (i != _lookupTable.cend() && i->first == hashName)
-            return;     // already here
+            // hash names are sometimes built from pointers; so mix the bits before using them
+        hashName ^= hashName >> 33ull;
+        hashName *= 0xff51afd7ed558ccdull;
+        hashName ^= hashName >> 33ull;
+        return unsigned(hashName);
+    }
 
-        if (_objects.size() < _cacheSize) {
-            _objects.push_back(object);
-            _lookupTable.insert(i, std::make_pair(hashName, _objects.size()-1));
-            _queue.BringToFront(_objects.size()-1);
-            return;
+    template<typename Type>
+        unsigned LRUCache<Type>::FindIndexPosition(uint64 hashName) const
+    {
+        unsigned p = IndexHash(hashName) & _indexMask;
+        for (;;) {
+            auto slot = _index[p];
+            if (slot == Invalid) return Invalid;
+            if (_slots[slot]._hashName == hashName) return p;
+            p = (p+1) & _indexMask;
+        }
+    }
+
+    template<typename Type>
+        void LRUCache<Type>::RemoveIndexPosition(unsigned position)
+    {
+            //  Linear probing deletion, without tombstones. Entries after the removed
+            //  entry are shifted back, unless that would move them before their home position
+        unsigned i = position, j = position;
+        for (;;) {
+            _index[i] = Invalid;
+            for (;;) {
+                j = (j+1) & _indexMask;
+                if (_index[j] == Invalid) return;
+                unsigned k = IndexHash(_slots[_index[j]]._hashName) & _indexMask;
+                bool staysPut = (i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j));
+                if (!staysPut) break;
+            }
+            _index[i] = _index[j];
+            i = j;
         }
+    }
+
+    template<typename Type>
+        void LRUCache<Type>::Unlink(unsigned slot)
+    {
+        auto& s = _slots[slot];
+        if (s._newer != Invalid) { _slots[s._newer]._older = s._older; } else { _newest = s._older; }
+        if (s._older != Invalid) { _slots[s._older]._newer = s._newer; } else { _oldest = s._newer; }
+        s._newer = s._older = Invalid;
+    }
+
+    template<typename Type>
+        void LRUCache<Type>::LinkAsNewest(unsigned slot)
+    {
+        auto& s = _slots[slot];
+        s._newer = Invalid;
+        s._older = _newest;
+        if (_newest != Invalid) { _slots[_newest]._newer = slot; } else { _oldest = slot; }
+        _newest = slot;
+    }
+
+    template<typename Type>
+        void LRUCache<Type>::Evict(unsigned slot)
+    {
+        auto& s = _slots[slot];
+        auto position = FindIndexPosition(s._hashName);
+        assert(position != Invalid);
+        RemoveIndexPosition(position);
+        Unlink(slot);
+
+        s._object.reset();
+        _bytesUsed -= s._size;
+        s._size = 0;
+        s._older = _firstFree;
+        _firstFree = slot;
+        --_objectCount;
+        ++_evictions;
+    }
 
-            // we need to evict an existing object.
-        // SelectedModel = nullptr;
+    template<typename Type>
+        void LRUCache<Type>::Insert(uint64 hashName, std::shared_ptr<Type> object, size_t sizeInBytes)
+    {
+            // try to insert this object into the cache (if it's not already here)
+        if (FindIndexPosition(hashName) != Invalid)
+            return;     // already here
 
-        unsigned eviction = _queue.GetOldestValue();
-        if (eviction == ~unsigned(0x0)) {
-            assert(0); return;
+            // we may need to evict existing objects to make space
+        if (_firstFree == Invalid) {
+            assert(_oldest != Invalid);
+            Evict(_oldest);
         }
+        if (_byteBudget) {
+            while (_oldest != Invalid && (_bytesUsed + sizeInBytes) > _byteBudget) {
+                Evict(_oldest);
+            }
+        }
+
+        auto slot = _firstFree;
+        auto& s = _slots[slot];
+        _firstFree = s._older;
 
-        _objects[eviction] = object;
-        auto oldLookup = std::find_if(_lookupTable.cbegin(), _lookupTable.cend(), 
-            [=](const std::pair<uint64, unsigned>& p) { return p.second == eviction; });
-        assert(oldLookup != _lookupTable.cend());
-        _lookupTable.erase(oldLookup);
+        s._object = std::move(object);
+        s._hashName = hashName;
+        s._size = sizeInBytes;
+        LinkAsNewest(slot);
 
-            // have to search again after the erase above
-        i = std::lower_bound(_lookupTable.cbegin(), _lookupTable.cend(), hashName, CompareFirst<uint64, unsigned>());
-        _lookupTable.insert(i, std::make_pair(hashName, eviction));
+        unsigned p = IndexHash(hashName) & _indexMask;
+        while (_index[p] != Invalid) { p = (p+1) & _indexMask; }
+        _index[p] = slot;
 
-        _queue.BringToFront(eviction);
+        _bytesUsed += sizeInBytes;
+        ++_objectCount;
     }
 
     template<typename Type>
         std::shared_ptr<Type>& LRUCache<Type>::Get(uint64 hashName)
     {
             // find the given object, and move it to the front of the queue
-        auto i = std::lower_bound(_lookupTable.cbegin(), _lookupTable.cend(), hashName, CompareFirst<uint64, unsigned>());
-        if (i != _lookupTable.cend() && i->first == hashName) {
-            _queue.BringToFront(i->second);
-            return _objects[i->second];
+        auto position = FindIndexPosition(hashName);
+        if (position != Invalid) {
+            auto slot = _index[position];
+            if (slot != _newest) {
+                Unlink(slot);
+                LinkAsNewest(slot);
+            }
+            ++_hits;
+            return _slots[slot]._object;
         }
+        ++_misses;
         static std::shared_ptr<Type> dummy;
         return dummy;
     }
 
     template<typename Type>
-        LRUCache<Type>::LRUCache(unsigned cacheSize)
-    : _queue(cacheSize) 
-    , _cacheSize(cacheSize)
+        auto LRUCache<Type>::GetMetrics() const -> Metrics
     {
-        _lookupTable.reserve(cacheSize);
-        _objects.reserve(cacheSize);
+        Metrics result;
+        result._hits = _hits;
+        result._misses = _misses;
+        result._evictions = _evictions;
+        result._objectCount = _objectCount;
+        result._bytesUsed = _bytesUsed;
+        return result;
+    }
+
+    template<typename Type>
+        void LRUCache<Type>::ResetMetrics()
+    {
+        _hits = _misses = _evictions = 0;
+    }
+
+    template<typename Type>
+        LRUCache<Type>::LRUCache(unsigned cacheSize, size_t byteBudget)
+    : _newest(Invalid), _oldest(Invalid), _firstFree(Invalid)
+    , _objectCount(0)
+    , _byteBudget(byteBudget), _bytesUsed(0)
+    , _hits(0), _misses(0), _evictions(0)
+    {
+        assert(cacheSize > 0);
+        _slots.resize(cacheSize);
+        for (unsigned c=0; c<cacheSize; ++c) {
+            _slots[c]._hashName = 0;
+            _slots[c]._size = 0;
+            _slots[c]._newer = Invalid;
+            _slots[c]._older = c+1;
+        }
+        _slots[cacheSize-1]._older = Invalid;
+        _firstFree = 0;
+
+            // index table is kept at most half full, so probe sequences stay short
+        unsigned indexSize = 1;
+        while (indexSize < cacheSize*2) { indexSize <<= 1; }
+        _index.resize(indexSize, ~unsigned(0x0));
+        _indexMask = indexSize-1;
     }
 
     template<typename Type>
         LRUCache<Type>::~LRUCache()
     {}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    /// <summary>LRUCache protected by a mutex</summary>
+    /// Get() returns the object by value (rather than a reference into the cache),
+    /// so the result stays valid even if another thread evicts the object.
+    template<typename Type> class ThreadSafeLRUCache
+    {
+    public:
+        void Insert(uint64 hashName, std::shared_ptr<Type> object, size_t sizeInBytes = 0)
+        {
+            ScopedLock(_lock);
+            _cache.Insert(hashName, std::move(object), sizeInBytes);
+        }
+
+        std::shared_ptr<Type> Get(uint64 hashName)
+        {
+            ScopedLock(_lock);
+            return _cache.Get(hashName);
+        }
+
+        typename LRUCache<Type>::Metrics GetMetrics() const
+        {
+            ScopedLock(_lock);
+            return _cache.GetMetrics();
+        }
+
+        ThreadSafeLRUCache(unsigned cacheSize, size_t byteBudget = 0) : _cache(cacheSize, byteBudget) {}
+        ~ThreadSafeLRUCache() {}
+    protected:
+        LRUCache<Type>              _cache;
+        mutable Threading::Mutex    _lock;
+    };
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     template <typename Marker>
@@ -128,18 +324,32 @@ namespace Utility
         unsigned _destination;
     };
 
+    /// <summary>Heap that deals only in spans of an external resource</summary>
+    /// SpanningHeap doesn't own any memory itself; it just tracks which parts of some
+    /// external range (eg, a GPU buffer or a file) are allocated, and which are free.
+    /// It doesn't record the size of the blocks allocated from within it, so the client
+    /// must deallocate the correct space when it's done.
+    ///
+    /// Free space is managed with a two-level segregated fit (TLSF) scheme, so
+    /// Allocate() and Deallocate() are constant time, regardless of how fragmented the
+    /// heap is. The first level bins free blocks by power of two, and the second level
+    /// splits each power of two into 16 linear sub-ranges. Adjacent free blocks are
+    /// merged on Deallocate().
+    ///
+    /// Offsets are tracked internally in 16 byte units, in 32 bit integers. The "Marker"
+    /// type only determines the format of the flattened representation (see Flatten()).
+    /// That format is a sorted list of positions, alternating between the starts of free
+    /// and allocated spans, and ending with the heap size. So a SpanningHeap<uint16> can
+    /// be larger than 1MB; it just can't be flattened (Flatten() asserts).
+    ///
+    /// The statistics returned from GetStatistics() (and CalculateAvailableSpace(),
+    /// CalculateAllocatedSpace(), CalculateHeapSize() and IsEmpty()) can be read
+    /// without taking the heap lock. They are always internally consistent for a single
+    /// value, but values read together may come from different points in time.
     template <typename Marker>
         class SpanningHeap : public MarkerHeap<Marker>
     {
     public:
-
-            //
-            //      It's a simple heap that deals only in spans. It doesn't record the 
-            //      size of the blocks allocated from within it. It just knows what space
-            //      is allocated, and what is unallocated. The client must deallocate the
-            //      correct space from the buffer when it's done.
-            //
-
         unsigned            Allocate(unsigned size);
         bool                Allocate(unsigned ptr, unsigned size);
         bool                Deallocate(unsigned ptr, unsigned size);
@@ -153,6 +363,15 @@ namespace Utility
 
         unsigned            AppendNewBlock(unsigned size);
 
+        class Statistics
+        {
+        public:
+            uint64      _heapSize, _availableSpace;
+            unsigned    _freeBlockCount;
+            uint64      _allocationCount, _deallocationCount;
+        };
+        Statistics          GetStatistics() const;
+
         std::vector<unsigned>       CalculateMetrics() const;
         std::vector<DefragStep>     CalculateDefragSteps() const;
         void                        PerformDefrag(const std::vector<DefragStep>& defrag);
@@ -161,17 +380,59 @@ namespace Utility
 
         SpanningHeap(unsigned size);
         SpanningHeap(const SpanningHeap& cloneFrom);
+        SpanningHeap(SpanningHeap&& moveFrom);
         SpanningHeap(const uint8 flattened[], size_t flattenedSize);
         ~SpanningHeap();
         const SpanningHeap& operator=(const SpanningHeap& cloneFrom);
+        const SpanningHeap& operator=(SpanningHeap&& moveFrom);
     protected:
-        std::vector<Marker>         _markers;
+        static const unsigned SLBits = 4;
+        static const unsigned SLCount = 1<<SLBits;
+        static const unsigned FLCount = 32-SLBits+1;
+        static const uint32 Invalid = ~uint32(0x0);
+
+        class FreeBlock
+        {
+        public:
+            uint32      _start, _size;          // (_size is 0 for unused entries)
+            uint32      _prev, _next;           // links in the bin list (or the unused list, using _next)
+        };
+        std::vector<FreeBlock>      _freeBlocks;
+        uint32                      _firstUnused;
+        FlatHashMap<uint32>         _freeByStart;
+        FlatHashMap<uint32>         _freeByEnd;
+
+        uint32                      _flBitmap;
+        uint32                      _slBitmap[FLCount];
+        uint32                      _bins[FLCount][SLCount];
+        uint32                      _heapEnd;
+
         mutable Threading::Mutex    _lock;
-        mutable bool                _largestFreeBlockValid;
-        mutable Marker              _largestFreeBlock;
 
-        Marker      CalculateLargestFreeBlock_Internal() const;
-        bool        BlockAdjust_Internal(unsigned ptr, unsigned size, bool allocateOperation);
+        Interlocked::Value64 volatile   _statHeapSize;
+        Interlocked::Value64 volatile   _statAvailableSpace;
+        Interlocked::Value64 volatile   _statFreeBlockCount;
+        Interlocked::Value64 volatile   _statAllocationCount;
+        Interlocked::Value64 volatile   _statDeallocationCount;
+
+        static void     MapSize(uint32 size, unsigned& fl, unsigned& sl);
+        void            LinkToBin_Internal(uint32 block);
+        void            UnlinkFromBin_Internal(uint32 block);
+        void            AddFreeBlock_Internal(uint32 start, uint32 size);
+        void            RemoveFreeBlock_Internal(uint32 block);
+        uint32          FindFreeBlock_Internal(uint32 size) const;
+        uint32          CalculateLargestFreeBlock_Internal() const;
+        void            AdjustStatistic_Internal(Interlocked::Value64 volatile* stat, int64 delta);
+        void            ResetStatistics_Internal();
+
+        std::vector<uint32>     BuildMarkers_Internal() const;
+        void                    LoadMarkers_Internal(const uint32* begin, const uint32* end);
+        void                    Reset_Internal();
+
+            //  (unlike the MarkerHeap versions, these are not limited to the range of Marker)
+        static uint32           ToInternalSize32(unsigned size);
+        static unsigned         ToExternalSize32(uint32 size);
+        static unsigned         AlignSize32(unsigned size);
     };
 
     typedef SpanningHeap<uint16> SimpleSpanningHeap;
@@ -198,6 +459,25 @@ namespace Utility
         assert((size>>4) <= std::numeric_limits<Marker>::max());
         return (size&(~((1<<4)-1)))+((size&((1<<4)-1))?(1<<4):0); 
     }
+
+    template <typename Marker>
+        inline uint32 SpanningHeap<Marker>::ToInternalSize32(unsigned size)
+    {
+        return uint32(size>>4); 
+    }
+
+    template <typename Marker>
+        inline unsigned SpanningHeap<Marker>::ToExternalSize32(uint32 size)      
+    {
+        assert(size <= (std::numeric_limits<unsigned>::max()>>4));
+        return unsigned(size)<<4; 
+    }
+
+    template <typename Marker>
+        inline unsigned SpanningHeap<Marker>::AlignSize32(unsigned size)
+    {
+        return (size&(~((1<<4)-1)))+((size&((1<<4)-1))?(1<<4):0); 
+    }
 }
 
 using namespace Utility;
@@ -89,29 +89,29 @@ namespace Utility
 
             // utilities and operators
         void swap(intrusive_ptr& b) never_throws;
-        template<typename T>
-            friend T* ReleaseOwnership(intrusive_ptr<T>& ptr);
+        template<typename TT>
+            friend TT* ReleaseOwnership(intrusive_ptr<TT>& ptr);
 
-        template<typename T, typename U>
-            friend bool operator==(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs) never_throws;
+        template<typename TT, typename UU>
+            friend bool operator==(const intrusive_ptr<TT>& lhs, const intrusive_ptr<UU>& rhs) never_throws;
 
-        template<typename T, typename U>
-            friend bool operator!=(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs) never_throws;
+        template<typename TT, typename UU>
+            friend bool operator!=(const intrusive_ptr<TT>& lhs, const intrusive_ptr<UU>& rhs) never_throws;
 
-        template<typename T>
-            friend bool operator==(const intrusive_ptr<T>& a, T* b) never_throws;
+        template<typename TT>
+            friend bool operator==(const intrusive_ptr<TT>& a, TT* b) never_throws;
 
-        template<typename T>
-            friend bool operator!=(const intrusive_ptr<T>& a, T* b) never_throws;
+        template<typename TT>
+            friend bool operator!=(const intrusive_ptr<TT>& a, TT* b) never_throws;
 
-        template<typename T>
-            friend bool operator==(T* a, const intrusive_ptr<T>& b) never_throws;
+        template<typename TT>
+            friend bool operator==(TT* a, const intrusive_ptr<TT>& b) never_throws;
 
-        template<typename T>
-            friend bool operator!=(T* a, const intrusive_ptr<T>& b) never_throws;
+        template<typename TT>
+            friend bool operator!=(TT* a, const intrusive_ptr<TT>& b) never_throws;
 
-        template<typename T, typename U>
-            friend bool operator<(const intrusive_ptr<T>& a, const intrusive_ptr<U>& b) never_throws;
+        template<typename TT, typename UU>
+            friend bool operator<(const intrusive_ptr<TT>& a, const intrusive_ptr<UU>& b) never_throws;
 
     private:
         T* _ptr;
@@ -55,7 +55,7 @@ namespace Utility
             // int errorNumber = posix_memalign(&result, size, alignment);
             // assert(!errorNumber);
             // return result;
-            return memalign(size, alignment);
+            return memalign(alignment, size);
         }
         
         inline void XlMemAlignFree(void* data)
@@ -69,6 +69,18 @@ namespace Utility
 
         ////////////   H A S H I N G   ////////////
 
+        //  The hash family used by Hash64 and Hash32 is selected at compile time. Hash values
+        //  are stored in many compiled and cached files (eg, chunk files and archive caches),
+        //  so those record the family they were built with (see HashFamily_Active)
+    #define HASH_FAMILY_MURMUR      1       // MurmurHash64A/B & MurmurHash3_x86_32
+    #define HASH_FAMILY_WYHASH      2       // wyhash-style 64x64->128 multiply kernel
+
+    #if !defined(HASH_FAMILY_ACTIVE)
+        #define HASH_FAMILY_ACTIVE  HASH_FAMILY_WYHASH
+    #endif
+
+    static const uint32 HashFamily_Active = HASH_FAMILY_ACTIVE;
+
     static const uint64 DefaultSeed64 = 0xE49B0E3F5C27F17Eull;
     XL_UTILITY_API uint64 Hash64(const void* begin, const void* end, uint64 seed = DefaultSeed64);
 
@@ -118,6 +130,118 @@ namespace Utility
         static const uint64 Value = Calc<S3, Calc<S2, Calc<S1, Calc<S0, Seed>::Value>::Value>::Value>::Value;
     };
 
+    /// <summary>Hash a string at compile time, with the same result as Hash64</summary>
+    /// ConstExprHash64 is a constexpr implementation of the same algorithm as the runtime
+    /// Hash64 (for the wyhash family only). So, unlike ConstHash64, it can be used to fold
+    /// hashes of names that must match runtime hashes (eg, shader parameter and binding names).
+    /// <code>\code
+    ///     static const auto HashLocalTransform = ConstExprHash64("LocalTransform");
+    ///     // same value as Hash64("LocalTransform"), but calculated by the compiler
+    ///     auto h = "LocalTransform"_h;    // (same again, as a literal -- but only where "_h" is available)
+    /// \endcode</code>
+    ///
+    /// This requires C++14 relaxed constexpr. On older compilers (or with other hash families)
+    /// ConstExprHash64 just calls Hash64, and the "_h" literal isn't available. So code outside
+    /// of Utility should always use the ConstExprHash64("...") form, never "_h".
+    ///
+    /// The single argument form is only for string literals. It hashes all N-1 characters
+    /// of the array, so for a buffer like "char buf[64]" it would not match Hash64(buf). Use
+    /// Hash64 for strings in buffers (a debug build asserts if the array is not a literal).
+    #if HASH_FAMILY_ACTIVE == HASH_FAMILY_WYHASH && defined(CONSTEXPR14_SUPPORTED)
+
+        namespace Internal
+        {
+                // (see Internal::WyHash in HashUtils.cpp -- these must match exactly)
+            class ConstExprU128 { public: uint64 _low, _high; };
+
+            constexpr ConstExprU128 ConstExprMultiply(uint64 A, uint64 B)
+            {
+                uint64 ha = A >> 32ull, hb = B >> 32ull, la = uint32(A), lb = uint32(B);
+                uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+                uint64 t = rl + (rm0 << 32ull), c = t < rl;
+                uint64 lo = t + (rm1 << 32ull); c += lo < t;
+                uint64 hi = rh + (rm0 >> 32ull) + (rm1 >> 32ull) + c;
+                return ConstExprU128 { lo, hi };
+            }
+
+            constexpr uint64 ConstExprMix(uint64 A, uint64 B) { auto r = ConstExprMultiply(A, B); return r._low ^ r._high; }
+
+            constexpr uint64 ConstExprRead(const char p[], unsigned byteCount)
+            {
+                uint64 result = 0;
+                for (unsigned c=0; c<byteCount; ++c) { result |= uint64(uint8(p[c])) << (8ull*c); }
+                return result;
+            }
+
+            constexpr size_t ConstExprStringLength(const char str[], size_t maxLength)
+            {
+                size_t result = 0;
+                while (result < maxLength && str[result]) { ++result; }
+                return result;
+            }
+        }
+
+        constexpr uint64 ConstExprHash64(const char str[], size_t len, uint64 seed = DefaultSeed64)
+        {
+            using namespace Internal;
+            const uint64 s0 = 0xa0761d6478bd642full, s1 = 0xe7037ed1a0b428dbull, s2 = 0x8ebc6af09c88c6dbull, s3 = 0x589965cc75374cc3ull;
+            const char* p = str;
+            seed ^= ConstExprMix(seed ^ s0, s1);
+            uint64 a = 0, b = 0;
+            if (len <= 16) {
+                if (len >= 4) {
+                    a = (ConstExprRead(p, 4) << 32ull) | ConstExprRead(p + ((len >> 3) << 2), 4);
+                    b = (ConstExprRead(p + len - 4, 4) << 32ull) | ConstExprRead(p + len - 4 - ((len >> 3) << 2), 4);
+                } else if (len > 0) {
+                    a = (uint64(uint8(p[0])) << 16ull) | (uint64(uint8(p[len >> 1])) << 8ull) | uint64(uint8(p[len - 1]));
+                }
+            } else {
+                size_t i = len;
+                if (i > 48) {
+                    uint64 see1 = seed, see2 = seed;
+                    do {
+                        seed = ConstExprMix(ConstExprRead(p, 8) ^ s1, ConstExprRead(p + 8, 8) ^ seed);
+                        see1 = ConstExprMix(ConstExprRead(p + 16, 8) ^ s2, ConstExprRead(p + 24, 8) ^ see1);
+                        see2 = ConstExprMix(ConstExprRead(p + 32, 8) ^ s3, ConstExprRead(p + 40, 8) ^ see2);
+                        p += 48; i -= 48;
+                    } while (i > 48);
+                    seed ^= see1 ^ see2;
+                }
+                while (i > 16) {
+                    seed = ConstExprMix(ConstExprRead(p, 8) ^ s1, ConstExprRead(p + 8, 8) ^ seed);
+                    i -= 16; p += 16;
+                }
+                a = ConstExprRead(p + i - 16, 8);
+                b = ConstExprRead(p + i - 8, 8);
+            }
+            auto r = ConstExprMultiply(a ^ s1, b ^ seed);
+            return ConstExprMix(r._low ^ s0 ^ uint64(len), r._high ^ s1);
+        }
+
+        template<size_t N>
+            constexpr uint64 ConstExprHash64(const char (&str)[N])
+            {
+                    // (string literals only -- see above)
+                assert(Internal::ConstExprStringLength(str, N) == N-1);
+                return ConstExprHash64(str, N-1);
+            }
+
+        constexpr uint64 operator"" _h(const char str[], size_t len) { return ConstExprHash64(str, len); }
+
+    #else
+
+        inline uint64 ConstExprHash64(const char str[], size_t len, uint64 seed = DefaultSeed64) { return Hash64(str, &str[len], seed); }
+
+        template<size_t N>
+            uint64 ConstExprHash64(const char (&str)[N])
+            {
+                    // (string literals only -- see above)
+                assert(std::char_traits<char>::length(str) == N-1);
+                return Hash64(str, &str[N-1]);
+            }
+
+    #endif
+
         ////////////   I N L I N E   I M P L E M E N T A T I O N S   ////////////
 
     inline void XlClearMemory(void* p, size_t size)                     { memset(p, 0, size); }
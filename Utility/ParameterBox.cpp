@@ -13,6 +13,8 @@
 
 namespace Utility
 {
+    static const uint64 ParameterNamesHashSeed = 0x7EF5E3B02A75ED13ui64;
+
     ParameterBox::ParameterNameHash ParameterBox::MakeParameterNameHash(const std::string& name)
     {
         return Hash32(AsPointer(name.cbegin()), AsPointer(name.cend()));
@@ -29,8 +31,7 @@ namespace Utility
             _parameterNames.push_back(name);
             _values.resize(offset+sizeof(uint32), 0);
             *(uint32*)&_values[offset] = value;
-            _cachedHash = 0;
-            _cachedParameterNameHash = 0;
+            AddParameterToCachedHashes(hash, name, value);
             return;
         }
 
@@ -45,15 +46,30 @@ namespace Utility
             }
             _values.insert(_values.cbegin()+offset, (byte*)&value, (byte*)PtrAdd(&value, sizeof(uint32)));
             *(uint32*)&_values[offset] = value;
-            _cachedHash = 0;
-            _cachedParameterNameHash = 0;
+            AddParameterToCachedHashes(hash, name, value);
             return;
         }
 
         assert(_parameterNames[index] == name);
         auto offset = _parameterOffsets[index];
-        *(uint32*)&_values[offset] = value;
-        _cachedHash = 0;
+        auto& dest = *(uint32*)&_values[offset];
+        if (_cachedHash) {
+            _cachedHash += ParameterHashContribution(hash, value) - ParameterHashContribution(hash, dest);
+        }
+        dest = value;
+    }
+
+    void        ParameterBox::AddParameterToCachedHashes(ParameterNameHash nameHash, const std::string& name, uint32 value)
+    {
+            //  Both hashes are order independent combinations of the parameters,
+            //  so a new parameter can be added in without rebuilding them.
+            //  (a cached value of 0 means "not calculated yet", and we leave it that way)
+        if (_cachedHash) {
+            _cachedHash += ParameterHashContribution(nameHash, value);
+        }
+        if (_cachedParameterNameHash) {
+            _cachedParameterNameHash ^= Hash64(AsPointer(name.cbegin()), AsPointer(name.cend()));
+        }
     }
 
     uint32      ParameterBox::GetParameter(const std::string& name) const
@@ -86,7 +102,7 @@ namespace Utility
             //  though the xor operation here doesn't depend on order, it should be
             //  ok -- because if the same parameter names appear in two different
             //  parameter boxes, they should have the same order.
-        uint64 result = 0x7EF5E3B02A75ED13ui64;
+        uint64 result = ParameterNamesHashSeed;
         for (auto i=_parameterNames.cbegin(); i!=_parameterNames.cend(); ++i) {
             result ^= Hash64(AsPointer(i->cbegin()), AsPointer(i->cend()));
         }
@@ -102,9 +118,31 @@ namespace Utility
         return 0;    
     }
 
+    uint64      ParameterBox::ParameterHashContribution(ParameterNameHash name, uint32 value)
+    {
+            //  Each (name, value) pair is a unique 64 bit number, and the finalizer from
+            //  MurmurHash3 maps it to a well distributed 64 bit value (it's a bijection, so
+            //  two different pairs can never produce the same contribution)
+        uint64 k = (uint64(name) << 32ull) | uint64(value);
+        k ^= k >> 33ull;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33ull;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33ull;
+        return k;
+    }
+
     uint64      ParameterBox::CalculateHash() const
     {
-        return Hash64(AsPointer(_values.cbegin()), AsPointer(_values.cend()));
+            //  The hash is the sum of the contributions of every parameter. Since addition
+            //  is commutative and invertible, a single parameter can be changed by
+            //  subtracting its old contribution and adding the new one (see SetParameter
+            //  and TranslateHash).
+        uint64 result = DefaultSeed64;
+        for (size_t c=0; c<_parameterHashValues.size(); ++c) {
+            result += ParameterHashContribution(_parameterHashValues[c], GetValue(c));
+        }
+        return result;
     }
 
     uint64      ParameterBox::GetHash() const
@@ -125,13 +163,10 @@ namespace Utility
 
     uint64      ParameterBox::TranslateHash(const ParameterBox& source) const
     {
-        if (_values.size() > 1024) {
-            assert(0);
-            return 0;
-        }
-
-        uint8 temporaryValues[1024];
-        std::copy(_values.cbegin(), _values.cend(), temporaryValues);
+            //  Calculate the hash we would get if we took the values in "source" for every 
+            //  parameter that appears in both boxes. We start from our own hash, and swap
+            //  out the contributions from the overridden parameters.
+        auto result = GetHash();
         auto i  = _parameterHashValues.cbegin();
         auto i2 = source._parameterHashValues.cbegin();
         while (i < _parameterHashValues.cend() && i2 < source._parameterHashValues.cend()) {
@@ -140,15 +175,17 @@ namespace Utility
             } else if (*i > *i2) {
                 ++i2;
             } else if (*i == *i2) {
-                size_t offsetDest   = _parameterOffsets[std::distance(_parameterHashValues.cbegin(), i)];
-                size_t offsetSrc    = source._parameterOffsets[std::distance(source._parameterHashValues.cbegin(), i2)];
-                *(uint32*)PtrAdd(temporaryValues, offsetDest) = *(uint32*)PtrAdd(AsPointer(source._values.cbegin()), offsetSrc);
+                auto ownValue = GetValue(std::distance(_parameterHashValues.cbegin(), i));
+                auto srcValue = source.GetValue(std::distance(source._parameterHashValues.cbegin(), i2));
+                if (ownValue != srcValue) {
+                    result += ParameterHashContribution(*i, srcValue) - ParameterHashContribution(*i, ownValue);
+                }
                 ++i;
                 ++i2;
             }
         }
 
-        return Hash64(temporaryValues, PtrAdd(temporaryValues, _values.size()));
+        return result;
     }
 
     static std::string AsString(uint32 value)
@@ -158,29 +195,31 @@ namespace Utility
         return buffer;
     }
 
+    static void WriteDefine(
+        std::vector<std::pair<std::string, std::string>>& defines,
+        const std::string& name, uint32 value, bool addIfMissing)
+    {
+        auto insertPosition = std::lower_bound(defines.begin(), defines.end(), name, CompareFirst<std::string, std::string>());
+        if (insertPosition!=defines.cend() && insertPosition->first == name) {
+            insertPosition->second = AsString(value);
+        } else if (addIfMissing) {
+            defines.insert(insertPosition, std::make_pair(name, AsString(value)));
+        }
+    }
+
     void        ParameterBox::BuildStringTable(std::vector<std::pair<std::string, std::string>>& defines) const
     {
         for (auto i=_parameterNames.cbegin(); i!=_parameterNames.cend(); ++i) {
-            auto insertPosition     = std::lower_bound(defines.begin(), defines.end(), *i, CompareFirst<std::string, std::string>());
-            auto offset             = _parameterOffsets[std::distance(_parameterNames.cbegin(), i)];
-            auto value              = *(uint32*)&_values[offset];
-            if (insertPosition!=defines.cend() && insertPosition->first == *i) {
-                insertPosition->second = AsString(value);
-            } else {
-                defines.insert(insertPosition, std::make_pair(*i, AsString(value)));
-            }
+            auto offset = _parameterOffsets[std::distance(_parameterNames.cbegin(), i)];
+            WriteDefine(defines, *i, *(uint32*)&_values[offset], true);
         }
     }
 
     void        ParameterBox::OverrideStringTable(std::vector<std::pair<std::string, std::string>>& defines) const
     {
         for (auto i=_parameterNames.cbegin(); i!=_parameterNames.cend(); ++i) {
-            auto insertPosition     = std::lower_bound(defines.begin(), defines.end(), *i, CompareFirst<std::string, std::string>());
-            auto offset             = _parameterOffsets[std::distance(_parameterNames.cbegin(), i)];
-            auto value              = *(uint32*)&_values[offset];
-            if (insertPosition!=defines.cend() && insertPosition->first == *i) {
-                insertPosition->second = AsString(value);
-            }
+            auto offset = _parameterOffsets[std::distance(_parameterNames.cbegin(), i)];
+            WriteDefine(defines, *i, *(uint32*)&_values[offset], false);
         }
     }
 
@@ -208,10 +247,21 @@ namespace Utility
         }
     }
 
+    void ParameterBox::MergeIn(const SmallParameterBox& source)
+    {
+        if (source._overflow) {
+            MergeIn(*source._overflow);
+            return;
+        }
+        for (unsigned c=0; c<source._count; ++c) {
+            SetParameter(source.GetName(c), source._values[c]);
+        }
+    }
+
     void ParameterBox::Serialize(Serialization::NascentBlockSerializer& serializer) const
     {
-        Serialization::Serialize(serializer, _cachedHash);
-        Serialization::Serialize(serializer, _cachedParameterNameHash);
+        Serialization::Serialize(serializer, GetHash());
+        Serialization::Serialize(serializer, GetParameterNamesHash());
         Serialization::Serialize(serializer, _parameterHashValues);
         Serialization::Serialize(serializer, _parameterOffsets);
         Serialization::Serialize(serializer, _parameterNames);
@@ -247,7 +297,154 @@ namespace Utility
     ParameterBox::~ParameterBox()
     {
     }
-}
 
+        //////////////////////////////////////////////////////////////////
+
+    void        SmallParameterBox::SetParameter(const char name[], uint32 value)
+    {
+        SetParameter(name, name + XlStringLen(name), value);
+    }
+
+    void        SmallParameterBox::SetParameter(const std::string& name, uint32 value)
+    {
+        SetParameter(AsPointer(name.cbegin()), AsPointer(name.cend()), value);
+    }
+
+    void        SmallParameterBox::SetParameter(const char nameStart[], const char nameEnd[], uint32 value)
+    {
+        if (_overflow) {
+            _overflow->SetParameter(std::string(nameStart, nameEnd), value);
+            return;
+        }
+
+            //  Same layout rules as ParameterBox: the parameters are sorted by the
+            //  32 bit hash of their names (which is also ParameterBox::MakeParameterNameHash)
+        auto hash = Hash32(nameStart, nameEnd);
+        auto i = std::lower_bound(_parameterHashValues, &_parameterHashValues[_count], hash);
+        unsigned index = unsigned(i - _parameterHashValues);
+        if (index < _count && *i == hash) {
+            assert(XlCompareMemory(GetName(index), nameStart, nameEnd-nameStart) == 0 && GetName(index)[nameEnd-nameStart] == '\0');
+            if (_cachedHash) {
+                _cachedHash += ParameterBox::ParameterHashContribution(hash, value) - ParameterBox::ParameterHashContribution(hash, _values[index]);
+            }
+            _values[index] = value;
+            return;
+        }
+
+        size_t nameLength = nameEnd - nameStart;
+        if (_count >= InlineCapacity || (_nameStorageUsed + nameLength + 1) > InlineNameStorage) {
+            MoveToOverflow();
+            _overflow->SetParameter(std::string(nameStart, nameEnd), value);
+            return;
+        }
+
+        for (unsigned c=_count; c>index; --c) {
+            _parameterHashValues[c] = _parameterHashValues[c-1];
+            _values[c] = _values[c-1];
+            _nameOffsets[c] = _nameOffsets[c-1];
+        }
+        _parameterHashValues[index] = hash;
+        _values[index] = value;
+        _nameOffsets[index] = uint16(_nameStorageUsed);
+        XlCopyMemory(&_names[_nameStorageUsed], nameStart, nameLength);
+        _names[_nameStorageUsed + nameLength] = '\0';
+        _nameStorageUsed += unsigned(nameLength + 1);
+        ++_count;
+
+        if (_cachedHash) {
+            _cachedHash += ParameterBox::ParameterHashContribution(hash, value);
+        }
+        if (_cachedParameterNameHash) {
+            _cachedParameterNameHash ^= Hash64(nameStart, nameEnd);
+        }
+    }
+
+    void        SmallParameterBox::MoveToOverflow()
+    {
+        auto overflow = std::make_unique<ParameterBox>();
+        overflow->MergeIn(*this);
+        _overflow = std::move(overflow);
+        _count = _nameStorageUsed = 0;
+        _cachedHash = _cachedParameterNameHash = 0;
+    }
 
+    uint32      SmallParameterBox::GetParameter(const char name[]) const
+    {
+        return GetParameter(Hash32(name, name + XlStringLen(name)));
+    }
 
+    uint32      SmallParameterBox::GetParameter(ParameterNameHash name) const
+    {
+        if (_overflow) {
+            return _overflow->GetParameter(name);
+        }
+        auto i = std::lower_bound(_parameterHashValues, &_parameterHashValues[_count], name);
+        if (i != &_parameterHashValues[_count] && *i == name) {
+            return _values[i - _parameterHashValues];
+        }
+        return 0;
+    }
+
+    uint64      SmallParameterBox::GetHash() const
+    {
+        if (_overflow) {
+            return _overflow->GetHash();
+        }
+        if (!_cachedHash) {
+            uint64 result = DefaultSeed64;
+            for (unsigned c=0; c<_count; ++c) {
+                result += ParameterBox::ParameterHashContribution(_parameterHashValues[c], _values[c]);
+            }
+            _cachedHash = result;
+        }
+        return _cachedHash;
+    }
+
+    uint64      SmallParameterBox::GetParameterNamesHash() const
+    {
+        if (_overflow) {
+            return _overflow->GetParameterNamesHash();
+        }
+        if (!_cachedParameterNameHash) {
+            uint64 result = ParameterNamesHashSeed;
+            for (unsigned c=0; c<_count; ++c) {
+                auto* name = GetName(c);
+                result ^= Hash64(name, name + XlStringLen(name));
+            }
+            _cachedParameterNameHash = result;
+        }
+        return _cachedParameterNameHash;
+    }
+
+    void        SmallParameterBox::BuildStringTable(std::vector<std::pair<std::string, std::string>>& defines) const
+    {
+        if (_overflow) {
+            _overflow->BuildStringTable(defines);
+            return;
+        }
+        for (unsigned c=0; c<_count; ++c) {
+            WriteDefine(defines, GetName(c), _values[c], true);
+        }
+    }
+
+    void        SmallParameterBox::OverrideStringTable(std::vector<std::pair<std::string, std::string>>& defines) const
+    {
+        if (_overflow) {
+            _overflow->OverrideStringTable(defines);
+            return;
+        }
+        for (unsigned c=0; c<_count; ++c) {
+            WriteDefine(defines, GetName(c), _values[c], false);
+        }
+    }
+
+    SmallParameterBox::SmallParameterBox()
+    {
+        _cachedHash = _cachedParameterNameHash = 0;
+        _count = _nameStorageUsed = 0;
+    }
+
+    SmallParameterBox::~SmallParameterBox()
+    {
+    }
+}
@@ -10,11 +10,13 @@
 #include "../Core/Types.h"
 #include <string>
 #include <vector>
+#include <memory>
 
 namespace Serialization { class NascentBlockSerializer; }
 
 namespace Utility
 {
+    class SmallParameterBox;
 
         //////////////////////////////////////////////////////////////////
             //      P A R A M E T E R   B O X                       //
@@ -43,6 +45,7 @@ namespace Utility
         void        OverrideStringTable(std::vector<std::pair<std::string, std::string>>& defines) const;
 
         void        MergeIn(const ParameterBox& source);
+        void        MergeIn(const SmallParameterBox& source);
 
         static ParameterNameHash    MakeParameterNameHash(const std::string& name);
 
@@ -66,10 +69,76 @@ namespace Utility
         uint32      GetValue(size_t index) const;
         uint64      CalculateHash() const;
         uint64      CalculateParameterNamesHash() const;
+        void        AddParameterToCachedHashes(ParameterNameHash nameHash, const std::string& name, uint32 value);
+
+        static uint64   ParameterHashContribution(ParameterNameHash name, uint32 value);
+
+        friend class SmallParameterBox;
     };
 
     #pragma pack(pop)
 
+        //////////////////////////////////////////////////////////////////
+            //      S M A L L   P A R A M E T E R   B O X           //
+        //////////////////////////////////////////////////////////////////
+
+    /// <summary>Runtime only parameter box with inline storage</summary>
+    /// Temporary boxes built every frame (eg, per draw call material or geometry
+    /// selectors) rarely hold more than a handful of parameters. This keeps up to
+    /// InlineCapacity parameters (and their names) inside the object itself, so
+    /// building one doesn't touch the heap.
+    ///
+    /// GetHash() and GetParameterNamesHash() return exactly the same values as
+    /// a ParameterBox with the same parameters. So the two can be used
+    /// interchangeably as keys for shader variation lookups.
+    ///
+    /// If the inline storage runs out, the parameters are moved into a normal
+    /// ParameterBox on the heap, and everything continues to work (just more
+    /// slowly). This type is never serialized; use ParameterBox for data that
+    /// is written to disk.
+    class SmallParameterBox
+    {
+    public:
+        typedef ParameterBox::ParameterNameHash ParameterNameHash;
+        static const unsigned InlineCapacity = 8;
+        static const unsigned InlineNameStorage = 256;
+
+        void        SetParameter(const char name[], uint32 value);
+        void        SetParameter(const std::string& name, uint32 value);
+        uint32      GetParameter(const char name[]) const;
+        uint32      GetParameter(ParameterNameHash name) const;
+
+        uint64      GetHash() const;
+        uint64      GetParameterNamesHash() const;
+
+        void        BuildStringTable(std::vector<std::pair<std::string, std::string>>& defines) const;
+        void        OverrideStringTable(std::vector<std::pair<std::string, std::string>>& defines) const;
+
+        SmallParameterBox();
+        ~SmallParameterBox();
+    private:
+        mutable uint64      _cachedHash;
+        mutable uint64      _cachedParameterNameHash;
+
+        unsigned            _count;
+        unsigned            _nameStorageUsed;
+        ParameterNameHash   _parameterHashValues[InlineCapacity];      // sorted, as in ParameterBox
+        uint32              _values[InlineCapacity];
+        uint16              _nameOffsets[InlineCapacity];
+        char                _names[InlineNameStorage];
+
+        std::unique_ptr<ParameterBox> _overflow;
+
+        void        SetParameter(const char nameStart[], const char nameEnd[], uint32 value);
+        void        MoveToOverflow();
+        const char* GetName(unsigned index) const { return &_names[_nameOffsets[index]]; }
+
+        SmallParameterBox(const SmallParameterBox&);
+        SmallParameterBox& operator=(const SmallParameterBox&);
+
+        friend class ParameterBox;
+    };
+
 }
 
 using namespace Utility;
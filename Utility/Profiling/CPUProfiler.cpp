@@ -16,17 +16,116 @@ namespace Utility
 
     void HierarchicalCPUProfiler::EndFrame()
     {
-        assert(XlGetCurrentThreadId() == _threadId);
-        assert(_aeStackI==0);
+        #if defined(_DEBUG)
+            assert(XlGetCurrentThreadId() == _threadId);
+            assert(_aeStackI==0);
+        #endif
         static_assert(s_bufferCount > 1, "Expecting at least 2 buffers");
+        if (!_events[0].empty()) {
+            _events[0].back()._end = _writePtr;
+        }
+
+            //  The chunks from 2 frames ago are no longer needed, return them to the pool
+        for (auto i=_events[1].cbegin(); i!=_events[1].cend(); ++i) {
+            _freeChunks.push_back(i->_begin);
+        }
+        _events[1].erase(_events[1].begin(), _events[1].end());     // erase without deleting memory
+
         std::swap(_events[0], _events[1]);  // (actually only the first 2 would be used)
         std::swap(_idAtEventsStart[0], _idAtEventsStart[1]);
-
         _idAtEventsStart[0] = _workingId;
 
-            // erase without deleting memory
-        _events[0].erase(_events[0].begin(), _events[0].end());
-        assert(_aeStackI == 0);
+            //  Make sure there are enough chunks in the pool for the busiest of the
+            //  recent frames (plus any events we had to drop), so that the next frame
+            //  shouldn't need to allocate. This is the only place that allocates in
+            //  Mode::Bounded.
+        auto chunksRequired = unsigned(_events[1].size()) + (_droppedEvents*2 + s_chunkSize-1) / s_chunkSize;
+        _recentChunkCounts[_frameIndex++ % s_recentFrameCount] = chunksRequired;
+        auto peakChunks = *std::max_element(_recentChunkCounts, &_recentChunkCounts[s_recentFrameCount]);
+        while (_freeChunks.size() < (peakChunks+1)) {
+            _freeChunks.push_back(AllocateChunk());
+        }
+        ReserveChunkRecords();
+
+        _droppedEventsLastFrame = _droppedEvents;
+        _droppedEvents = 0;
+
+        _writePtr = _chunkEnd = nullptr;
+        NextChunk();
+        #if defined(_DEBUG)
+            assert(_aeStackI == 0);
+        #endif
+    }
+
+    void HierarchicalCPUProfiler::ReserveChunkRecords()
+    {
+            //  In Mode::Bounded, a frame can't use more chunks than there are in the pool.
+            //  So with this much space, NextChunk() never reallocates _events[0] mid-frame.
+        auto required = std::max(size_t(64), _freeChunks.size() + 1);
+        for (unsigned c=0; c<s_bufferCount; ++c) {
+            _events[c].reserve(required);
+        }
+    }
+
+    bool HierarchicalCPUProfiler::NextChunk()
+    {
+        uint64* chunk;
+        if (!_freeChunks.empty()) {
+            chunk = _freeChunks.back();
+            _freeChunks.pop_back();
+        } else if (_mode == Mode::Growable) {
+            chunk = AllocateChunk();
+        } else {
+            return false;
+        }
+
+        if (_writePtr) {
+            _events[0].back()._end = _writePtr;
+        }
+        Chunk newChunk;
+        newChunk._begin = newChunk._end = chunk;
+        _events[0].push_back(newChunk);
+        _writePtr = chunk;
+        _chunkEnd = chunk + s_chunkSize;
+        return true;
+    }
+
+    uint64* HierarchicalCPUProfiler::AllocateChunk()
+    {
+        _allChunks.push_back(std::unique_ptr<uint64[]>(new uint64[s_chunkSize]));
+        return _allChunks.back().get();
+    }
+
+    static uint64 CalibrateTimestampFrequency()
+    {
+        #if defined(CPUPROFILER_USE_RDTSC)
+                //  Measure the rate of the timestamp counter against the performance
+                //  counter over a short period. We assume an invariant TSC (ie, it
+                //  runs at a constant rate, and is synchronized across cores), which
+                //  is true for all recent x86 processors.
+            auto pcFrequency = GetPerformanceCounterFrequency();
+            auto pcStart = GetPerformanceCounter();
+            auto tscStart = __rdtsc();
+            uint64 pcEnd;
+            do {
+                pcEnd = GetPerformanceCounter();
+            } while ((pcEnd - pcStart) < (pcFrequency / 100));     // (10 milliseconds)
+            auto tscEnd = __rdtsc();
+            return (tscEnd - tscStart) * pcFrequency / (pcEnd - pcStart);
+        #else
+            return GetPerformanceCounterFrequency();
+        #endif
+    }
+
+    static uint64 volatile s_timestampFrequency = 0;
+
+    uint64 HierarchicalCPUProfiler::GetTimestampFrequency()
+    {
+            // (benign race if 2 threads calibrate at the same time)
+        if (!s_timestampFrequency) {
+            s_timestampFrequency = CalibrateTimestampFrequency();
+        }
+        return s_timestampFrequency;
     }
 
     struct ParentAndChildLink
@@ -72,15 +171,25 @@ namespace Utility
             //  This requires iterating through the entire list of events. 
             //  Once it's in breath-first order, it should become
             //  much easier to do the next few operations.
+            //  Events are stored in chunks; we need a single contiguous array here,
+            //  because the pointers into the event list are used for ordering.
+        std::vector<uint64> events;
+        {
+            size_t eventCount = 0;
+            for (auto c=_events[1].cbegin(); c!=_events[1].cend(); ++c) { eventCount += c->_end - c->_begin; }
+            events.reserve(eventCount);
+            for (auto c=_events[1].cbegin(); c!=_events[1].cend(); ++c) { events.insert(events.end(), c->_begin, c->_end); }
+        }
+
         std::vector<ParentAndChildLink> parentsAndChildren;
-        parentsAndChildren.reserve(_events[1].size()/2);    // Approximation of events count
+        parentsAndChildren.reserve(events.size()/2);    // Approximation of events count
 
         unsigned workingStack[s_maxStackDepth];
         unsigned _workingStackIndex = 0;
         auto workingId = _idAtEventsStart[1];
 
-        auto i=_events[1].cbegin();
-        for (; i!=_events[1].cend(); ++i) {
+        auto i=events.cbegin();
+        for (; i!=events.cend(); ++i) {
             uint64 time = *i;
             if (time & (1ull << 63ull)) {
 
@@ -267,14 +376,32 @@ namespace Utility
         return result;
     }
 
-    HierarchicalCPUProfiler::HierarchicalCPUProfiler()
+    HierarchicalCPUProfiler::HierarchicalCPUProfiler(Mode::Enum mode, unsigned initialChunkCount)
     {
         _workingId = 0;
         for (unsigned c=0; c<s_bufferCount; ++c) {
-            _events[c].reserve(16 * 1024);
             _idAtEventsStart[c] = _workingId;
         }
 
+        _mode = mode;
+        _frameIndex = 0;
+        _droppedEvents = _droppedEventsLastFrame = 0;
+        _openDepth = 0;
+        initialChunkCount = std::max(initialChunkCount, 1u);
+        for (unsigned c=0; c<s_recentFrameCount; ++c) {
+            _recentChunkCounts[c] = initialChunkCount;
+        }
+        _freeChunks.reserve(initialChunkCount);
+        for (unsigned c=0; c<initialChunkCount; ++c) {
+            _freeChunks.push_back(AllocateChunk());
+        }
+        ReserveChunkRecords();
+        _writePtr = _chunkEnd = nullptr;
+        NextChunk();
+
+            // calibrate now, so it doesn't happen in the middle of a frame
+        GetTimestampFrequency();
+
         #if defined(_DEBUG)
             _threadId = XlGetCurrentThreadId();
             XlZeroMemory(_aeStack);
@@ -9,8 +9,14 @@
 #include "../TimeUtils.h"
 #include "../../Core/Types.h"
 #include <vector>
+#include <memory>
 #include <assert.h>
 
+#if (COMPILER_ACTIVE == COMPILER_TYPE_MSVC) && (defined(_M_IX86) || defined(_M_AMD64))
+    #define CPUPROFILER_USE_RDTSC
+    #include <intrin.h>
+#endif
+
 namespace Utility
 {
     /// <summary>Hierarchical CPU call Profiler</summary>
@@ -71,7 +77,26 @@ namespace Utility
     /// disabled at compile time.
     ///
     /// This is intended to be used on a single thread. When profiling
-    /// multiple threads, use multiple instances.
+    /// multiple threads, use multiple instances (or CPUProfilerRegistry).
+    ///
+    /// Events are written into fixed size chunks of preallocated memory. When a
+    /// chunk fills up, the profiler moves onto the next chunk from a pool (so there
+    /// is never any reallocation or copying of the events recorded so far). The pool
+    /// is topped up in EndFrame(), based on the number of chunks used in recent
+    /// frames. So normally no allocations occur during a frame at all. If the pool
+    /// does run out mid-frame:
+    /// <list>
+    ///   <item> Mode::Growable -- a new chunk is allocated (the allocation happens before
+    ///         the timestamp is taken, so it's not counted against the event)
+    ///   <item> Mode::Bounded -- the event is dropped (see GetDroppedEventCount()),
+    ///         and the pool is grown in the next EndFrame(). This mode never
+    ///         allocates during a frame.
+    /// </list>
+    ///
+    /// On MSVC x86/x64 targets timestamps come from the CPU timestamp counter (rdtsc),
+    /// which is much cheaper to read than QueryPerformanceCounter. The rate of the
+    /// counter is calibrated against GetPerformanceCounter() once, on construction.
+    /// Always use GetTimestampFrequency() to convert profiler times into seconds.
     ///
     /// I've written variations of this class so many times! But this
     /// one is open-source. It's forever!
@@ -99,47 +124,110 @@ namespace Utility
         };
         std::vector<ResolvedEvent> CalculateResolvedEvents() const;
 
-        HierarchicalCPUProfiler();
+        struct Mode { enum Enum { Growable, Bounded }; };
+
+            /// <summary>Number of events dropped in the last complete frame (Mode::Bounded only)</summary>
+        unsigned    GetDroppedEventCount() const { return _droppedEventsLastFrame; }
+
+        static uint64   GetTimestamp();
+        static uint64   GetTimestampFrequency();
+
+        HierarchicalCPUProfiler(Mode::Enum mode = Mode::Growable, unsigned initialChunkCount = 4);
         ~HierarchicalCPUProfiler();
     private:
         static const unsigned s_bufferCount = 2;
         static const unsigned s_maxStackDepth = 16;
-        std::vector<uint64> _events[s_bufferCount];
+        static const unsigned s_chunkSize = 4 * 1024;      // (in uint64 entries)
+        static const unsigned s_recentFrameCount = 8;
+        static const EventId s_droppedEventId = ~EventId(0x0);
+
+        class Chunk
+        {
+        public:
+            uint64* _begin;
+            uint64* _end;       // end of the used part of the chunk (only updated when we move on from the chunk)
+        };
+        std::vector<Chunk> _events[s_bufferCount];
+
+        uint64*     _writePtr;
+        uint64*     _chunkEnd;
+        unsigned    _openDepth;
 
         uint32 _workingId;
         uint32 _idAtEventsStart[s_bufferCount];
 
+        Mode::Enum  _mode;
+        std::vector<std::unique_ptr<uint64[]>> _allChunks;
+        std::vector<uint64*> _freeChunks;
+        unsigned    _recentChunkCounts[s_recentFrameCount];
+        unsigned    _frameIndex;
+        unsigned    _droppedEvents;
+        unsigned    _droppedEventsLastFrame;
+
+        bool        NextChunk();
+        uint64*     AllocateChunk();
+        void        ReserveChunkRecords();
+
         #if defined(_DEBUG)
             uint32 _threadId;
             uint32 _aeStack[s_maxStackDepth];
             uint32 _aeStackI;
         #endif
+
+        HierarchicalCPUProfiler(const HierarchicalCPUProfiler&);
+        HierarchicalCPUProfiler& operator=(const HierarchicalCPUProfiler&);
     };
 
-    #if PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
+    #if !defined(CPUPROFILER_USE_RDTSC) && PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
         typedef union _LARGE_INTEGER LARGE_INTEGER;
         extern "C" __declspec(dllimport) int __stdcall QueryPerformanceCounter(LARGE_INTEGER *);
     #endif
     
     uint32 XlGetCurrentThreadId();
 
-    inline unsigned HierarchicalCPUProfiler::BeginEvent(const char eventLiteral[])
+    inline uint64 HierarchicalCPUProfiler::GetTimestamp()
     {
-        assert(XlGetCurrentThreadId() == _threadId);
-        uint64 time;
-        #if PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
+        #if defined(CPUPROFILER_USE_RDTSC)
+            return __rdtsc();
+        #elif PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
                 // special case inlined version for Windows API platforms
                 // provides a little more performance, by avoiding one unnecessary
                 // function call
+            uint64 time;
             QueryPerformanceCounter((LARGE_INTEGER*)&time);
+            return time;
         #else
-            time = GetPerformanceCounter();
+            return GetPerformanceCounter();
+        #endif
+    }
+
+    inline unsigned HierarchicalCPUProfiler::BeginEvent(const char eventLiteral[])
+    {
+        #if defined(_DEBUG)
+            assert(XlGetCurrentThreadId() == _threadId);
         #endif
+
+            //  We always keep enough space in the current chunk for the end events of
+            //  every open event. So EndEvent() never has to change chunks.
+        if ((_chunkEnd - _writePtr) < ptrdiff_t(_openDepth + 3)) {
+            if (!NextChunk()) {
+                ++_droppedEvents;
+                #if defined(_DEBUG)
+                    assert(_aeStackI < dimof(_aeStack));
+                    _aeStack[_aeStackI++] = s_droppedEventId;
+                #endif
+                return s_droppedEventId;
+            }
+        }
+
             //  We use the very top bit to distinguish between a begin event, and an end event.
             //  This means the results will not be correct if the profile event straddles a time
             //  when the top bit changes. But that seems extremely unlikely.
-        _events[0].push_back(~(1ull << 63ull) & time);
-        _events[0].push_back(uint64(eventLiteral));     // should be ok for 32 or 64bit modes (but not 128bit+)!
+        uint64 time = GetTimestamp();
+        _writePtr[0] = ~(1ull << 63ull) & time;
+        _writePtr[1] = uint64(eventLiteral);     // should be ok for 32 or 64bit modes (but not 128bit+)!
+        _writePtr += 2;
+        ++_openDepth;
         auto result = _workingId++;
         #if defined(_DEBUG)
             assert(_aeStackI < dimof(_aeStack));
@@ -150,19 +238,19 @@ namespace Utility
 
     inline void HierarchicalCPUProfiler::EndEvent(unsigned eventId)
     {
-        assert(XlGetCurrentThreadId() == _threadId);
-        uint64 time;
-        #if PLATFORMOS_TARGET == PLATFORMOS_WINDOWS
-            QueryPerformanceCounter((LARGE_INTEGER*)&time);
-        #else
-            time = GetPerformanceCounter();
+        #if defined(_DEBUG)
+            assert(XlGetCurrentThreadId() == _threadId);
         #endif
+        uint64 time = GetTimestamp();
         #if defined(_DEBUG)
             assert(_aeStackI > 0);
             assert(_aeStack[_aeStackI-1] == eventId);   // verify that this is the right event we're removing
             --_aeStackI;
         #endif
-        _events[0].push_back((1ull << 63ull) | time);
+        if (eventId == s_droppedEventId) { return; }
+        assert(_writePtr < _chunkEnd && _openDepth > 0);
+        *_writePtr++ = (1ull << 63ull) | time;
+        --_openDepth;
     }
 
     /// <summary>Begin and end a profiler event</summary>
@@ -0,0 +1,309 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "CPUProfilerRegistry.h"
+#include "../Streams/Stream.h"
+#include "../StringFormat.h"
+#include "../StringUtils.h"
+#include "../IteratorUtils.h"
+#include <algorithm>
+#include <string>
+
+namespace Utility
+{
+    unsigned ThreadProfiler::GetDroppedEventCount() const
+    {
+        return unsigned(Interlocked::Load(const_cast<Interlocked::Value volatile*>(&_droppedEvents)));
+    }
+
+    ThreadProfiler::ThreadProfiler()
+    : _events(new uint64[s_capacity])
+    {
+        _writeIndex = _readIndex = 0;
+        _droppedEvents = 0;
+        _openDepth = 0;
+        _workingId = 0;
+        #if defined(_DEBUG)
+            _threadId = XlGetCurrentThreadId();
+        #endif
+    }
+
+    ThreadProfiler::~ThreadProfiler() {}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    class CPUProfilerRegistry::ThreadRecord
+    {
+    public:
+        ThreadProfiler  _profiler;
+        std::string     _name;
+
+            //  Events that have begun, but whose end event hasn't been drained yet.
+            //  Only touched by the thread calling EndFrame()
+        class OpenEvent
+        {
+        public:
+            uint64          _beginTime;
+            const char*     _label;
+        };
+        std::vector<OpenEvent> _openEvents;
+    };
+
+    ThreadProfiler& CPUProfilerRegistry::GetThreadProfiler(const char threadName[])
+    {
+        auto threadId = XlGetCurrentThreadId();
+        ScopedLock(_threadsLock);
+        auto i = LowerBound(_threadLookup, threadId);
+        if (i != _threadLookup.end() && i->first == threadId) {
+            return _threads[i->second]->_profiler;
+        }
+
+            // (the ThreadProfiler must be constructed on the thread that will use it)
+        auto newRecord = std::make_unique<ThreadRecord>();
+        if (threadName) {
+            newRecord->_name = threadName;
+        } else {
+            char buffer[32];
+            XlFormatString(buffer, dimof(buffer), "Thread %u", threadId);
+            newRecord->_name = buffer;
+        }
+
+        auto& result = newRecord->_profiler;
+        _threadLookup.insert(i, std::make_pair(threadId, unsigned(_threads.size())));
+        _threads.push_back(std::move(newRecord));
+        return result;
+    }
+
+    void CPUProfilerRegistry::Drain(ThreadRecord& thread, unsigned threadIndex)
+    {
+        auto& profiler = thread._profiler;
+        const auto mask = ThreadProfiler::s_capacity-1;
+        auto readIndex = uint32(Interlocked::Load(&profiler._readIndex));
+        auto writeIndex = uint32(Interlocked::Load(&profiler._writeIndex));
+
+            //  The producer publishes begin events (2 entries) atomically, so we will
+            //  never see half of one here
+        while (readIndex != writeIndex) {
+            auto entry = profiler._events[readIndex & mask];
+            if (entry & (1ull << 63ull)) {
+                assert(!thread._openEvents.empty());
+                if (!thread._openEvents.empty()) {
+                    auto& open = thread._openEvents.back();
+                    Event evnt;
+                    evnt._beginTime = open._beginTime;
+                    evnt._endTime = entry & ~(1ull << 63ull);
+                    evnt._label = open._label;
+                    evnt._threadIndex = threadIndex;
+                    evnt._depth = unsigned(thread._openEvents.size()-1);
+                    _frameEvents.push_back(evnt);
+                    thread._openEvents.pop_back();
+                }
+                ++readIndex;
+            } else {
+                ThreadRecord::OpenEvent open;
+                open._beginTime = entry;
+                open._label = (const char*)profiler._events[(readIndex+1) & mask];
+                thread._openEvents.push_back(open);
+                readIndex += 2;
+            }
+        }
+
+        Interlocked::Exchange(&profiler._readIndex, Interlocked::Value(readIndex));     // release the space back to the producer
+    }
+
+    void CPUProfilerRegistry::EndFrame()
+    {
+        _frameEvents.erase(_frameEvents.begin(), _frameEvents.end());
+        {
+            ScopedLock(_threadsLock);
+            for (unsigned c=0; c<unsigned(_threads.size()); ++c) {
+                Drain(*_threads[c], c);
+            }
+        }
+
+        if (_capturing) {
+            _capture.insert(_capture.end(), _frameEvents.begin(), _frameEvents.end());
+        }
+    }
+
+    void CPUProfilerRegistry::BeginCapture()
+    {
+        _capture.clear();
+        _capturing = true;
+    }
+
+    void CPUProfilerRegistry::EndCapture()
+    {
+        _capturing = false;
+    }
+
+    auto CPUProfilerRegistry::GetOutputEvents() const -> const std::vector<Event>&
+    {
+        return _capture.empty() ? _frameEvents : _capture;
+    }
+
+    static void WriteJSONString(OutputStream& stream, const char str[])
+    {
+        stream.WriteChar(utf8('"'));
+        for (const char* c = str; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                stream.WriteChar(utf8('\\'));
+                stream.WriteChar(utf8(*c));
+            } else if (unsigned(*c) < 0x20) {
+                stream.WriteChar(utf8(' '));
+            } else {
+                stream.WriteChar(utf8(*c));
+            }
+        }
+        stream.WriteChar(utf8('"'));
+    }
+
+    void CPUProfilerRegistry::WriteChromeTrace(OutputStream& stream) const
+    {
+        auto& events = GetOutputEvents();
+
+        uint64 baseTime = ~0ull;
+        for (auto i=events.cbegin(); i!=events.cend(); ++i) {
+            baseTime = std::min(baseTime, i->_beginTime);
+        }
+        const double toMicroseconds = 1000000.0 / double(_frequency);
+
+        char buffer[256];
+        stream.WriteString((const utf8*)"{\"traceEvents\":[\n");
+        bool first = true;
+
+            //  Metadata events give the thread names
+        {
+            ScopedLock(_threadsLock);
+            for (unsigned c=0; c<unsigned(_threads.size()); ++c) {
+                XlFormatString(buffer, dimof(buffer),
+                    "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":",
+                    first ? "" : ",\n", c);
+                stream.WriteString((const utf8*)buffer);
+                WriteJSONString(stream, _threads[c]->_name.c_str());
+                stream.WriteString((const utf8*)"}}");
+                first = false;
+            }
+        }
+
+            //  Every event is a "complete" event (with a begin time and duration)
+        for (auto i=events.cbegin(); i!=events.cend(); ++i) {
+            stream.WriteString((const utf8*)(first ? "{\"name\":" : ",\n{\"name\":"));
+            WriteJSONString(stream, i->_label);
+            XlFormatString(buffer, dimof(buffer),
+                ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                i->_threadIndex,
+                double(i->_beginTime - baseTime) * toMicroseconds,
+                double(i->_endTime - i->_beginTime) * toMicroseconds);
+            stream.WriteString((const utf8*)buffer);
+            first = false;
+        }
+
+        stream.WriteString((const utf8*)"\n],\"displayTimeUnit\":\"ms\"}\n");
+    }
+
+    namespace Internal
+    {
+        static const uint32 ProfileCapture_Magic = 0x50434c58;     // 'XLCP' when read as little endian bytes
+        static const uint32 ProfileCapture_Version = 1;
+
+        class ProfileCaptureHeader
+        {
+        public:
+            uint32  _magic;
+            uint32  _version;
+            uint64  _frequency;
+            uint32  _threadCount;
+            uint32  _labelCount;
+            uint32  _eventCount;
+            uint32  _padding;
+        };
+
+        class ProfileCaptureEvent
+        {
+        public:
+            uint64  _beginTime;
+            uint64  _endTime;
+            uint32  _labelIndex;
+            uint32  _threadIndex;
+            uint32  _depth;
+            uint32  _padding;
+        };
+
+        static void WriteCaptureString(OutputStream& stream, const char str[])
+        {
+            auto length = uint32(XlStringLen(str));
+            stream.Write(&length, sizeof(length));
+            stream.Write(str, int(length));
+        }
+    }
+
+    void CPUProfilerRegistry::WriteBinaryCapture(OutputStream& stream) const
+    {
+            //  Layout:
+            //      ProfileCaptureHeader
+            //      thread names    (uint32 length + chars, for each thread)
+            //      labels          (uint32 length + chars, for each label)
+            //      ProfileCaptureEvent[eventCount]
+        auto& events = GetOutputEvents();
+
+            //  Labels are pooled string literals, so we can build the table by pointer
+        std::vector<std::pair<const char*, unsigned>> labels;
+        for (auto i=events.cbegin(); i!=events.cend(); ++i) {
+            auto l = LowerBound(labels, i->_label);
+            if (l == labels.end() || l->first != i->_label) {
+                labels.insert(l, std::make_pair(i->_label, 0u));
+            }
+        }
+        for (unsigned c=0; c<unsigned(labels.size()); ++c) { labels[c].second = c; }
+
+        ScopedLock(_threadsLock);
+
+        Internal::ProfileCaptureHeader header;
+        header._magic = Internal::ProfileCapture_Magic;
+        header._version = Internal::ProfileCapture_Version;
+        header._frequency = _frequency;
+        header._threadCount = uint32(_threads.size());
+        header._labelCount = uint32(labels.size());
+        header._eventCount = uint32(events.size());
+        header._padding = 0;
+        stream.Write(&header, sizeof(header));
+
+        for (auto i=_threads.cbegin(); i!=_threads.cend(); ++i) {
+            Internal::WriteCaptureString(stream, (*i)->_name.c_str());
+        }
+        for (auto i=labels.cbegin(); i!=labels.cend(); ++i) {
+            Internal::WriteCaptureString(stream, i->first);
+        }
+
+        for (auto i=events.cbegin(); i!=events.cend(); ++i) {
+            Internal::ProfileCaptureEvent e;
+            e._beginTime = i->_beginTime;
+            e._endTime = i->_endTime;
+            e._labelIndex = LowerBound(labels, i->_label)->second;
+            e._threadIndex = i->_threadIndex;
+            e._depth = i->_depth;
+            e._padding = 0;
+            stream.Write(&e, sizeof(e));
+        }
+    }
+
+    CPUProfilerRegistry::CPUProfilerRegistry()
+    {
+        _capturing = false;
+        _frequency = GetPerformanceCounterFrequency();
+    }
+
+    CPUProfilerRegistry::~CPUProfilerRegistry() {}
+
+    static CPUProfilerRegistry s_globalRegistry;
+
+    CPUProfilerRegistry& CPUProfilerRegistry::GetInstance()
+    {
+        return s_globalRegistry;
+    }
+}
+
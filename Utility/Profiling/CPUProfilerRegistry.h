@@ -0,0 +1,222 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../TimeUtils.h"
+#include "../Threading/ThreadingUtils.h"
+#include "../Threading/Mutex.h"
+#include "../../Core/Types.h"
+#include <vector>
+#include <memory>
+#include <assert.h>
+
+namespace Utility
+{
+    class OutputStream;
+
+    /// <summary>Per-thread event buffer for CPUProfilerRegistry</summary>
+    /// Records begin/end events in the same way as HierarchicalCPUProfiler (and with the
+    /// same string literal labels). But rather than owning its frames, the events go into
+    /// a ring buffer that is drained by the CPUProfilerRegistry on another thread. The ring
+    /// has a single producer (the owning thread) and a single consumer (the thread calling
+    /// CPUProfilerRegistry::EndFrame()), so it needs no locks.
+    ///
+    /// If the consumer falls too far behind, new events are dropped (and counted). Space is
+    /// always kept for the end events of every open event, so the recorded events always
+    /// nest correctly.
+    ///
+    /// All threads take their timestamps from GetPerformanceCounter(), so events from
+    /// different threads can be compared directly.
+    class ThreadProfiler
+    {
+    public:
+        typedef unsigned EventId;
+
+        EventId     BeginEvent(const char eventLiteral[]);
+        void        EndEvent(EventId eventId);
+
+        unsigned    GetDroppedEventCount() const;
+
+        ThreadProfiler();
+        ~ThreadProfiler();
+    private:
+        static const unsigned s_capacity = 64 * 1024;       // (in uint64 entries; must be a power of two)
+        static const EventId s_droppedEventId = ~EventId(0x0);
+
+        std::unique_ptr<uint64[]>   _events;
+        Interlocked::Value volatile _writeIndex;
+        Interlocked::Value volatile _readIndex;
+        Interlocked::Value volatile _droppedEvents;
+        unsigned                    _openDepth;
+        EventId                     _workingId;
+
+        #if defined(_DEBUG)
+            uint32 _threadId;
+        #endif
+
+        unsigned    SpaceUsed() const;
+        friend class CPUProfilerRegistry;
+
+        ThreadProfiler(const ThreadProfiler&);
+        ThreadProfiler& operator=(const ThreadProfiler&);
+    };
+
+    /// <summary>Collects CPU profiler events from many threads</summary>
+    /// Each thread that wants to record events gets its own ThreadProfiler from
+    /// GetThreadProfiler() (the result should be cached by the caller; it remains valid
+    /// for the lifetime of the registry). Once per frame, EndFrame() drains every thread's
+    /// buffer, and builds the list of the events that completed during that frame.
+    ///
+    /// Between BeginCapture() and EndCapture(), the events from every frame are kept, and
+    /// can be written out for offline analysis, either as Chrome trace-event JSON (which can
+    /// be loaded into chrome://tracing) or a compact binary capture file.
+    ///
+    /// Engine threads (the main thread in FrameRig, the BufferUploads background thread
+    /// and the JobSystem workers) register with the registry returned by GetInstance().
+    class CPUProfilerRegistry
+    {
+    public:
+        ThreadProfiler& GetThreadProfiler(const char threadName[] = nullptr);
+
+            /// <summary>The registry shared by all engine threads</summary>
+            /// It lives for the whole process, so ThreadProfilers from it can be
+            /// cached by long lived threads. Must not be used during static initialization.
+        static CPUProfilerRegistry& GetInstance();
+
+        void    EndFrame();
+
+        class Event
+        {
+        public:
+            uint64          _beginTime;
+            uint64          _endTime;
+            const char*     _label;
+            unsigned        _threadIndex;
+            unsigned        _depth;
+        };
+        const std::vector<Event>& GetFrameEvents() const { return _frameEvents; }
+
+        void    BeginCapture();
+        void    EndCapture();
+        bool    IsCapturing() const { return _capturing; }
+
+            /// <summary>Write the captured events (or the last frame, if there is no capture)</summary>
+        void    WriteChromeTrace(OutputStream& stream) const;
+        void    WriteBinaryCapture(OutputStream& stream) const;
+
+        CPUProfilerRegistry();
+        ~CPUProfilerRegistry();
+
+    private:
+        class ThreadRecord;
+        std::vector<std::unique_ptr<ThreadRecord>>  _threads;
+        std::vector<std::pair<uint32, unsigned>>    _threadLookup;      // thread id -> index in _threads
+        mutable Threading::Mutex                    _threadsLock;
+
+        std::vector<Event>  _frameEvents;
+        std::vector<Event>  _capture;
+        bool                _capturing;
+        uint64              _frequency;
+
+        const std::vector<Event>& GetOutputEvents() const;
+        void Drain(ThreadRecord& thread, unsigned threadIndex);
+
+        CPUProfilerRegistry(const CPUProfilerRegistry&);
+        CPUProfilerRegistry& operator=(const CPUProfilerRegistry&);
+    };
+
+    uint32 XlGetCurrentThreadId();
+
+    inline unsigned ThreadProfiler::SpaceUsed() const
+    {
+        return unsigned(uint32(_writeIndex) - uint32(Interlocked::Load(const_cast<Interlocked::Value volatile*>(&_readIndex))));
+    }
+
+    inline auto ThreadProfiler::BeginEvent(const char eventLiteral[]) -> EventId
+    {
+        #if defined(_DEBUG)
+            assert(XlGetCurrentThreadId() == _threadId);
+        #endif
+
+            //  Reserve space for this begin event (2 entries) and the end events of
+            //  all of the open events (including this one)
+        if ((SpaceUsed() + 2 + _openDepth + 1) > s_capacity) {
+            Interlocked::Increment(&_droppedEvents);
+            return s_droppedEventId;
+        }
+
+        uint64 time = GetPerformanceCounter();
+        auto writeIndex = uint32(_writeIndex);
+        _events[writeIndex & (s_capacity-1)] = ~(1ull << 63ull) & time;
+        _events[(writeIndex+1) & (s_capacity-1)] = uint64(eventLiteral);
+        Interlocked::Exchange(&_writeIndex, Interlocked::Value(writeIndex+2));     // publish to the consumer
+        ++_openDepth;
+        return _workingId++;
+    }
+
+    inline void ThreadProfiler::EndEvent(EventId eventId)
+    {
+        #if defined(_DEBUG)
+            assert(XlGetCurrentThreadId() == _threadId);
+        #endif
+        if (eventId == s_droppedEventId) { return; }
+
+        uint64 time = GetPerformanceCounter();
+        auto writeIndex = uint32(_writeIndex);
+        assert(_openDepth > 0);
+        _events[writeIndex & (s_capacity-1)] = (1ull << 63ull) | time;
+        Interlocked::Exchange(&_writeIndex, Interlocked::Value(writeIndex+1));
+        --_openDepth;
+    }
+
+    /// <summary>Begin and end a ThreadProfiler event with RAII</summary>
+    class ThreadProfileEvent
+    {
+    public:
+        ThreadProfileEvent(const char label[], ThreadProfiler& profiler)
+        : _profiler(&profiler)
+        {
+            _id = _profiler->BeginEvent(label);
+        }
+
+        ~ThreadProfileEvent()
+        {
+            _profiler->EndEvent(_id);
+        }
+
+    private:
+        ThreadProfiler* _profiler;
+        ThreadProfiler::EventId _id;
+    };
+
+    class ThreadProfileEvent_Conditional
+    {
+    public:
+        ThreadProfileEvent_Conditional(const char label[], ThreadProfiler* profiler)
+        : _profiler(profiler)
+        {
+            if (_profiler) {
+                _id = _profiler->BeginEvent(label);
+            } else {
+                _id = ~ThreadProfiler::EventId(0x0);
+            }
+        }
+
+        ~ThreadProfileEvent_Conditional()
+        {
+            if (_profiler) {
+                _profiler->EndEvent(_id);
+            }
+        }
+
+    private:
+        ThreadProfiler* _profiler;
+        ThreadProfiler::EventId _id;
+    };
+}
+
+using namespace Utility;
@@ -240,7 +240,16 @@ namespace Utility
             const Type * AsPointer( const typename std::vector<Type>::const_iterator & i )       { return &(*i); }
 
         template <typename Type> 
-            Type * AsPointer( const __gnu_cxx::__normal_iterator<Type, std::vector<Type> > & i )       { return &(*i); }
+            Type * AsPointer( const __gnu_cxx::__normal_iterator<Type*, std::vector<Type> > & i )       { return &(*i); }
+
+        template <typename Type> 
+            const Type * AsPointer( const __gnu_cxx::__normal_iterator<const Type*, std::vector<Type> > & i )       { return &(*i); }
+
+        template <typename Type, typename Traits, typename Alloc> 
+            Type * AsPointer( const __gnu_cxx::__normal_iterator<Type*, std::basic_string<Type, Traits, Alloc> > & i )       { return &(*i); }
+
+        template <typename Type, typename Traits, typename Alloc> 
+            const Type * AsPointer( const __gnu_cxx::__normal_iterator<const Type*, std::basic_string<Type, Traits, Alloc> > & i )       { return &(*i); }
 
     #endif
 
@@ -0,0 +1,151 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "AsyncFileReader.h"
+#include "AsyncFileReaderInternal.h"
+#include "../Threading/CompletionThreadPool.h"
+#include "../MemoryUtils.h"
+#include "../PtrUtils.h"
+#include "../../Core/SelectConfiguration.h"
+#include <assert.h>
+
+#if PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
+    #include "../../Core/WinAPI/IncludeWindows.h"
+#else
+    #include <unistd.h>
+    #include <errno.h>
+#endif
+
+namespace Utility
+{
+    namespace Internal
+    {
+        AsyncReadBackend::~AsyncReadBackend() {}
+
+        size_t PositionalRead(const void* fileHandle, uint64 offset, void* destination, size_t size)
+        {
+            #if PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
+                    //  Reading with an explicit offset in the OVERLAPPED structure works
+                    //  for handles opened with and without FILE_FLAG_OVERLAPPED. It doesn't
+                    //  use the file pointer, so many reads on the same handle can happen
+                    //  at the same time.
+                OVERLAPPED overlapped;
+                XlSetMemory(&overlapped, 0, sizeof(overlapped));
+                overlapped.Offset = (DWORD)offset;
+                overlapped.OffsetHigh = (DWORD)(offset>>32ull);
+                overlapped.hEvent = ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+                DWORD bytesRead = 0;
+                auto result = ::ReadFile((HANDLE)fileHandle, destination, (DWORD)size, nullptr, &overlapped);
+                if (result || ::GetLastError() == ERROR_IO_PENDING) {
+                    if (!::GetOverlappedResult((HANDLE)fileHandle, &overlapped, &bytesRead, TRUE)) {
+                        bytesRead = 0;
+                    }
+                }
+                ::CloseHandle(overlapped.hEvent);
+                return bytesRead;
+            #else
+                int fd = int(intptr_t(fileHandle));
+                size_t bytesRead = 0;
+                while (bytesRead < size) {
+                    auto result = ::pread(fd, PtrAdd(destination, bytesRead), size - bytesRead, off_t(offset + bytesRead));
+                    if (result < 0 && errno == EINTR) continue;
+                    if (result <= 0) break;
+                    bytesRead += size_t(result);
+                }
+                return bytesRead;
+            #endif
+        }
+
+        class ReadThreadPoolBackend : public AsyncReadBackend
+        {
+        public:
+            void Submit(AsyncFileReader::Request* begin, AsyncFileReader::Request* end)
+            {
+                for (auto i=begin; i!=end; ++i) {
+                    auto fileHandle = i->_fileHandle;
+                    auto offset = i->_offset;
+                    auto destination = i->_destination;
+                    auto size = i->_size;
+                    auto onCompletion = std::move(i->_onCompletion);
+                    _pool.Enqueue(
+                        [fileHandle, offset, destination, size, onCompletion]()
+                        {
+                            auto bytesRead = PositionalRead(fileHandle, offset, destination, size);
+                            if (onCompletion) onCompletion(bytesRead);
+                        });
+                }
+            }
+
+            AsyncFileReader::Backend::Enum GetBackend() const   { return AsyncFileReader::Backend::ReadThreadPool; }
+            unsigned GetQueueDepth() const                      { return _pool.GetWorkerCount(); }
+
+            ReadThreadPoolBackend(unsigned queueDepth) : _pool(queueDepth) {}
+            ~ReadThreadPoolBackend() {}     // (the pool destructor completes any queued reads)
+
+        protected:
+                //  each worker does one blocking read at a time, so the number
+                //  of workers is the queue depth
+            CompletionThreadPool _pool;
+        };
+
+        #if PLATFORMOS_ACTIVE != PLATFORMOS_LINUX
+            std::unique_ptr<AsyncReadBackend> CreateIOUringBackend(unsigned) { return nullptr; }
+        #endif
+    }
+
+    void AsyncFileReader::Submit(Request* begin, Request* end)
+    {
+        if (begin != end) {
+            _backend->Submit(begin, end);
+        }
+    }
+
+    void AsyncFileReader::Submit(Request&& request)
+    {
+        _backend->Submit(&request, &request+1);
+    }
+
+    auto AsyncFileReader::GetBackend() const -> Backend::Enum   { return _backend->GetBackend(); }
+    unsigned AsyncFileReader::GetQueueDepth() const             { return _backend->GetQueueDepth(); }
+
+    const void* AsyncFileReader::DuplicateFileHandle(const void* fileHandle)
+    {
+        #if PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
+            HANDLE duplicatedFileHandle = INVALID_HANDLE_VALUE;
+            ::DuplicateHandle(
+                ::GetCurrentProcess(), (HANDLE)fileHandle, ::GetCurrentProcess(),
+                &duplicatedFileHandle, 0, FALSE, DUPLICATE_SAME_ACCESS);
+            return duplicatedFileHandle;
+        #else
+            return (const void*)intptr_t(::dup(int(intptr_t(fileHandle))));
+        #endif
+    }
+
+    void AsyncFileReader::CloseFileHandle(const void* fileHandle)
+    {
+        #if PLATFORMOS_ACTIVE == PLATFORMOS_WINDOWS
+            if (fileHandle && fileHandle != INVALID_HANDLE_VALUE) {
+                ::CloseHandle((HANDLE)fileHandle);
+            }
+        #else
+            if (intptr_t(fileHandle) >= 0) {
+                ::close(int(intptr_t(fileHandle)));
+            }
+        #endif
+    }
+
+    AsyncFileReader::AsyncFileReader(unsigned queueDepth)
+    {
+        assert(queueDepth);
+        _backend = Internal::CreateIOUringBackend(queueDepth);
+        if (!_backend) {
+            _backend = std::make_unique<Internal::ReadThreadPoolBackend>(queueDepth);
+        }
+    }
+
+    AsyncFileReader::~AsyncFileReader() {}
+}
@@ -0,0 +1,73 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "../../Core/Types.h"
+#include "../Mixins.h"
+#include <functional>
+#include <memory>
+
+namespace Utility
+{
+    namespace Internal { class AsyncReadBackend; }
+
+    /// <summary>Positional file reads that complete asynchronously</summary>
+    /// Reads are submitted in batches with Submit(). Each request reads a block of
+    /// bytes from an absolute offset in a file into a buffer owned by the caller.
+    /// The buffer must remain valid until the request's completion function has been
+    /// called.
+    ///
+    /// Completion functions are called from a background thread, and may be called
+    /// in any order. They should be short (for example, pushing a step onto a
+    /// lock free queue). The number of bytes read is passed to the completion function;
+    /// a value less than the requested size means the read hit the end of the file
+    /// or failed.
+    ///
+    /// On Linux, reads are issued through io_uring, so a single system call can
+    /// submit an entire batch. Everywhere else (or if io_uring isn't available) a
+    /// pool of threads issues blocking positional reads (pread or ReadFile with an
+    /// OVERLAPPED offset). In both cases, up to "queueDepth" reads can be in flight
+    /// at the same time.
+    ///
+    /// File handles are HANDLEs on Windows and file descriptors (cast to a pointer)
+    /// elsewhere. The destructor waits for all reads to complete.
+    class AsyncFileReader : noncopyable
+    {
+    public:
+        typedef std::function<void(size_t bytesRead)> CompletionFn;
+
+        struct Request
+        {
+            const void*     _fileHandle;
+            uint64          _offset;
+            void*           _destination;
+            size_t          _size;
+            CompletionFn    _onCompletion;
+        };
+
+            /// <summary>Submits a batch of reads</summary>
+            /// The completion functions are moved out of the requests.
+        void Submit(Request* begin, Request* end);
+        void Submit(Request&& request);
+
+        struct Backend { enum Enum { IOUring, ReadThreadPool }; };
+        Backend::Enum   GetBackend() const;
+        unsigned        GetQueueDepth() const;
+
+            /// <summary>Duplicates a file handle, so reads can outlive the caller's handle</summary>
+        static const void*  DuplicateFileHandle(const void* fileHandle);
+        static void         CloseFileHandle(const void* fileHandle);
+
+        AsyncFileReader(unsigned queueDepth = 32);
+        ~AsyncFileReader();
+
+    protected:
+        std::unique_ptr<Internal::AsyncReadBackend> _backend;
+    };
+}
+
+using namespace Utility;
@@ -0,0 +1,28 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "AsyncFileReader.h"
+
+namespace Utility { namespace Internal
+{
+    class AsyncReadBackend
+    {
+    public:
+        virtual void Submit(AsyncFileReader::Request* begin, AsyncFileReader::Request* end) = 0;
+        virtual AsyncFileReader::Backend::Enum GetBackend() const = 0;
+        virtual unsigned GetQueueDepth() const = 0;
+        virtual ~AsyncReadBackend();
+    };
+
+        /// <summary>Reads a block synchronously, at an absolute file offset</summary>
+        /// Returns the number of bytes read.
+    size_t PositionalRead(const void* fileHandle, uint64 offset, void* destination, size_t size);
+
+        //  returns nullptr if io_uring isn't supported (or has been disabled) on this machine
+    std::unique_ptr<AsyncReadBackend> CreateIOUringBackend(unsigned queueDepth);
+}}
@@ -69,15 +69,22 @@ namespace Utility
 
         void*           GetData()           { return _mappedData; }
         const void*     GetData() const     { return _mappedData; }
-        bool            IsValid()           { return _mappedData != 0; }
+        bool            IsValid() const     { return _mappedData != 0; }
+        uint64          GetSize() const     { return _size; }
 
-        MemoryMappedFile(const char filename[], uint64 size, Access::BitField access);
+        MemoryMappedFile(
+            const char filename[], uint64 size, Access::BitField access, 
+            BasicFile::ShareMode::BitField shareMode = 0);
         ~MemoryMappedFile();
 
     private:
         void* _mapping;
         void* _fileHandle;
         void* _mappedData;
+        uint64 _size;
+
+        MemoryMappedFile(const MemoryMappedFile&);
+        MemoryMappedFile& operator=(const MemoryMappedFile&);
     };
 
     XL_UTILITY_API bool DoesFileExist(const char filename[]);
@@ -0,0 +1,335 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "../AsyncFileReaderInternal.h"
+#include "../../../Core/SelectConfiguration.h"
+
+#if PLATFORMOS_ACTIVE == PLATFORMOS_LINUX
+
+#include "../../Threading/Mutex.h"
+#include "../../Threading/ThreadObject.h"
+#include "../../Threading/ThreadingUtils.h"
+#include "../../MemoryUtils.h"
+#include "../../PtrUtils.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+namespace Utility { namespace Internal
+{
+        //  We talk to the kernel directly, rather than going via liburing. We only
+        //  need a tiny part of the interface: one submission ring, one completion
+        //  ring and readv operations (which are available from the very first
+        //  io_uring kernels).
+    static int IOUringSetup(unsigned entries, io_uring_params* params)
+    {
+        return (int)::syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    static int IOUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return (int)::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    template<typename Type> static Type LoadAcquire(const Type* ptr)   { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+    template<typename Type> static void StoreRelease(Type* ptr, Type value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+
+    class IOUringBackend : public AsyncReadBackend
+    {
+    public:
+        void Submit(AsyncFileReader::Request* begin, AsyncFileReader::Request* end);
+        AsyncFileReader::Backend::Enum GetBackend() const   { return AsyncFileReader::Backend::IOUring; }
+        unsigned GetQueueDepth() const                      { return _queueDepth; }
+
+        bool Initialize(unsigned queueDepth);
+
+        IOUringBackend();
+        ~IOUringBackend();
+
+    protected:
+        class Slot
+        {
+        public:
+            AsyncFileReader::CompletionFn _onCompletion;
+            iovec       _iovec;
+        };
+
+        static const uint64 WakeUpUserData = ~uint64(0x0);
+
+        int         _ringFd;
+        unsigned    _queueDepth;
+
+            // submission ring
+        unsigned*   _sqHead;
+        unsigned*   _sqTail;
+        unsigned    _sqMask;
+        unsigned*   _sqArray;
+        io_uring_sqe* _sqes;
+
+            // completion ring
+        unsigned*   _cqHead;
+        unsigned*   _cqTail;
+        unsigned    _cqMask;
+        io_uring_cqe* _cqes;
+
+        void*       _sqRingMapping;     size_t _sqRingMappingSize;
+        void*       _cqRingMapping;     size_t _cqRingMappingSize;
+        void*       _sqesMapping;       size_t _sqesMappingSize;
+
+            //  "_lock" protects the submission ring, the slot free list and the
+            //  pending queue. The completion ring is only touched by the reaper thread.
+        Threading::Mutex                        _lock;
+        std::vector<Slot>                       _slots;
+        std::vector<unsigned>                   _freeSlots;
+        std::deque<AsyncFileReader::Request>    _pending;
+        bool                                    _shutdown;
+
+        std::unique_ptr<Threading::Thread>      _reaperThread;
+
+        void    QueuePending_AlreadyLocked();
+        void    Enter_AlreadyLocked();
+        static unsigned xl_thread_call ReaperFunction(void* backend);
+    };
+
+    void IOUringBackend::Submit(AsyncFileReader::Request* begin, AsyncFileReader::Request* end)
+    {
+        ScopedLock(_lock);
+        for (auto i=begin; i!=end; ++i) {
+            _pending.push_back(std::move(*i));
+        }
+        QueuePending_AlreadyLocked();
+    }
+
+    void IOUringBackend::QueuePending_AlreadyLocked()
+    {
+            //  Move as many pending requests into the submission ring as we have
+            //  free slots for, and then submit them all with a single system call.
+            //  Anything left over stays in "_pending" until the reaper frees up
+            //  some slots.
+        unsigned tail = *_sqTail, queued = 0;
+        while (!_pending.empty() && !_freeSlots.empty()) {
+            auto slotIndex = _freeSlots.back();
+            _freeSlots.pop_back();
+
+            auto& request = _pending.front();
+            auto& slot = _slots[slotIndex];
+            slot._onCompletion = std::move(request._onCompletion);
+            slot._iovec.iov_base = request._destination;
+            slot._iovec.iov_len = request._size;
+
+            unsigned index = tail & _sqMask;
+            auto& sqe = _sqes[index];
+            XlSetMemory(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = int(intptr_t(request._fileHandle));
+            sqe.off = request._offset;
+            sqe.addr = uint64(size_t(&slot._iovec));
+            sqe.len = 1;
+            sqe.user_data = slotIndex;
+            _sqArray[index] = index;
+            ++tail; ++queued;
+
+            _pending.pop_front();
+        }
+
+        if (queued) {
+            StoreRelease(_sqTail, tail);
+            Enter_AlreadyLocked();
+        }
+    }
+
+    void IOUringBackend::Enter_AlreadyLocked()
+    {
+        for (;;) {
+            unsigned toSubmit = LoadAcquire(_sqTail) - LoadAcquire(_sqHead);
+            if (!toSubmit) break;
+            auto result = IOUringEnter(_ringFd, toSubmit, 0, 0);
+            if (result < 0) {
+                    //  EAGAIN & EBUSY mean the kernel is short on resources; it
+                    //  will recover as soon as some of the in flight reads complete
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EBUSY) { Threading::YieldTimeSlice(); continue; }
+                assert(0);
+                break;
+            }
+        }
+    }
+
+    unsigned xl_thread_call IOUringBackend::ReaperFunction(void* backendPtr)
+    {
+        auto& backend = *(IOUringBackend*)backendPtr;
+
+        struct Completed { unsigned _slot; size_t _bytesRead; };
+        std::vector<Completed> completed;
+        completed.reserve(backend._queueDepth);
+        std::vector<AsyncFileReader::CompletionFn> completionFns;
+        completionFns.reserve(backend._queueDepth);
+
+        for (;;) {
+            auto result = IOUringEnter(backend._ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+            if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                assert(0);
+                break;
+            }
+
+            completed.clear();
+            unsigned head = *backend._cqHead;
+            unsigned tail = LoadAcquire(backend._cqTail);
+            for (; head!=tail; ++head) {
+                auto& cqe = backend._cqes[head & backend._cqMask];
+                if (cqe.user_data == WakeUpUserData) continue;
+                completed.push_back(Completed { unsigned(cqe.user_data), cqe.res > 0 ? size_t(cqe.res) : 0 });
+            }
+            StoreRelease(backend._cqHead, head);
+
+                //  Call the completion functions outside of the lock, so they can
+                //  submit more reads if they want to. The slots can't be reused until
+                //  they are returned to the free list below.
+            completionFns.clear();
+            for (auto i=completed.begin(); i!=completed.end(); ++i) {
+                completionFns.push_back(std::move(backend._slots[i->_slot]._onCompletion));
+            }
+            for (size_t c=0; c<completed.size(); ++c) {
+                if (completionFns[c]) completionFns[c](completed[c]._bytesRead);
+            }
+            completionFns.clear();
+
+            ScopedLock(backend._lock);
+            for (auto i=completed.begin(); i!=completed.end(); ++i) {
+                backend._freeSlots.push_back(i->_slot);
+            }
+            backend.QueuePending_AlreadyLocked();
+
+            if (backend._shutdown && backend._pending.empty() && backend._freeSlots.size() == backend._slots.size()) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    bool IOUringBackend::Initialize(unsigned queueDepth)
+    {
+        io_uring_params params;
+        XlSetMemory(&params, 0, sizeof(params));
+        int ringFd = IOUringSetup(queueDepth, &params);
+        if (ringFd < 0) {
+            return false;   // (kernel too old, or io_uring disabled by policy)
+        }
+
+        _ringFd = ringFd;
+        _sqRingMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        _sqesMappingSize = params.sq_entries * sizeof(io_uring_sqe);
+        bool singleMapping = !!(params.features & IORING_FEAT_SINGLE_MMAP);
+        if (singleMapping) {
+            _sqRingMappingSize = _cqRingMappingSize = std::max(_sqRingMappingSize, _cqRingMappingSize);
+        }
+
+        _sqRingMapping = ::mmap(
+            nullptr, _sqRingMappingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+            ringFd, IORING_OFF_SQ_RING);
+        if (_sqRingMapping == MAP_FAILED) { _sqRingMapping = nullptr; return false; }
+
+        if (singleMapping) {
+            _cqRingMapping = _sqRingMapping;
+        } else {
+            _cqRingMapping = ::mmap(
+                nullptr, _cqRingMappingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                ringFd, IORING_OFF_CQ_RING);
+            if (_cqRingMapping == MAP_FAILED) { _cqRingMapping = nullptr; return false; }
+        }
+
+        _sqesMapping = ::mmap(
+            nullptr, _sqesMappingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+            ringFd, IORING_OFF_SQES);
+        if (_sqesMapping == MAP_FAILED) { _sqesMapping = nullptr; return false; }
+
+        _sqHead     = (unsigned*)PtrAdd(_sqRingMapping, params.sq_off.head);
+        _sqTail     = (unsigned*)PtrAdd(_sqRingMapping, params.sq_off.tail);
+        _sqMask     = *(unsigned*)PtrAdd(_sqRingMapping, params.sq_off.ring_mask);
+        _sqArray    = (unsigned*)PtrAdd(_sqRingMapping, params.sq_off.array);
+        _sqes       = (io_uring_sqe*)_sqesMapping;
+        _cqHead     = (unsigned*)PtrAdd(_cqRingMapping, params.cq_off.head);
+        _cqTail     = (unsigned*)PtrAdd(_cqRingMapping, params.cq_off.tail);
+        _cqMask     = *(unsigned*)PtrAdd(_cqRingMapping, params.cq_off.ring_mask);
+        _cqes       = (io_uring_cqe*)PtrAdd(_cqRingMapping, params.cq_off.cqes);
+
+            //  The kernel rounds the ring size up to a power of two. But we only keep
+            //  "queueDepth" reads in flight at a time (which also guarantees the
+            //  completion ring can never overflow)
+        _queueDepth = std::min(queueDepth, params.sq_entries);
+        _slots.resize(_queueDepth);
+        _freeSlots.reserve(_queueDepth);
+        for (unsigned c=0; c<_queueDepth; ++c) {
+            _freeSlots.push_back(_queueDepth-1-c);
+        }
+
+        _reaperThread = std::make_unique<Threading::Thread>(&ReaperFunction, this);
+        return true;
+    }
+
+    IOUringBackend::IOUringBackend()
+    {
+        _ringFd = -1;
+        _queueDepth = 0;
+        _sqHead = _sqTail = _sqArray = _cqHead = _cqTail = nullptr;
+        _sqMask = _cqMask = 0;
+        _sqes = nullptr;
+        _cqes = nullptr;
+        _sqRingMapping = _cqRingMapping = _sqesMapping = nullptr;
+        _sqRingMappingSize = _cqRingMappingSize = _sqesMappingSize = 0;
+        _shutdown = false;
+    }
+
+    IOUringBackend::~IOUringBackend()
+    {
+        if (_reaperThread) {
+                //  The reaper exits once everything has completed. If nothing is in
+                //  flight right now, it's blocked waiting for a completion -- so we
+                //  give it one, with a no-op.
+            {
+                ScopedLock(_lock);
+                _shutdown = true;
+                if (_pending.empty() && _freeSlots.size() == _slots.size()) {
+                    auto tail = *_sqTail;
+                    unsigned index = tail & _sqMask;
+                    auto& sqe = _sqes[index];
+                    XlSetMemory(&sqe, 0, sizeof(sqe));
+                    sqe.opcode = IORING_OP_NOP;
+                    sqe.user_data = WakeUpUserData;
+                    _sqArray[index] = index;
+                    StoreRelease(_sqTail, tail+1);
+                    Enter_AlreadyLocked();
+                }
+            }
+            _reaperThread->join();
+            _reaperThread.reset();
+        }
+
+        if (_sqesMapping) ::munmap(_sqesMapping, _sqesMappingSize);
+        if (_cqRingMapping && _cqRingMapping != _sqRingMapping) ::munmap(_cqRingMapping, _cqRingMappingSize);
+        if (_sqRingMapping) ::munmap(_sqRingMapping, _sqRingMappingSize);
+        if (_ringFd >= 0) ::close(_ringFd);
+    }
+
+    std::unique_ptr<AsyncReadBackend> CreateIOUringBackend(unsigned queueDepth)
+    {
+        auto result = std::make_unique<IOUringBackend>();
+        if (!result->Initialize(queueDepth)) {
+            return nullptr;
+        }
+        return std::move(result);
+    }
+}}
+
+#endif
@@ -248,11 +248,14 @@ namespace Utility
         return std::move(result);
     }
 
-    MemoryMappedFile::MemoryMappedFile(const char filename[], uint64 size, Access::BitField access)
+    MemoryMappedFile::MemoryMappedFile(
+        const char filename[], uint64 size, Access::BitField access, 
+        BasicFile::ShareMode::BitField shareMode)
     {
         _mapping = INVALID_HANDLE_VALUE;
         _fileHandle = INVALID_HANDLE_VALUE;
         _mappedData = nullptr;
+        _size = 0;
 
         unsigned underlyingAccess = 0;
         if (access & Access::Read)  underlyingAccess |= GENERIC_READ;
@@ -265,12 +268,26 @@ namespace Utility
             creationDisposition = OPEN_ALWAYS;
         }
 
+        unsigned underlyingShareMode = 0;
+        if (shareMode & BasicFile::ShareMode::Write)   { underlyingShareMode |= FILE_SHARE_WRITE; }
+        if (shareMode & BasicFile::ShareMode::Read)    { underlyingShareMode |= FILE_SHARE_READ; }
+
         auto fileHandle = CreateFile(
-            filename, underlyingAccess, 0, nullptr, creationDisposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+            filename, underlyingAccess, underlyingShareMode, nullptr, creationDisposition, FILE_ATTRIBUTE_NORMAL, nullptr);
         if (fileHandle == INVALID_HANDLE_VALUE) {
             return;
         }
 
+            // when no explicit size is given, the mapping covers the entire file
+        if (!size) {
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(fileHandle, &fileSize) || !fileSize.QuadPart) {
+                CloseHandle(fileHandle);
+                return;
+            }
+            size = uint64(fileSize.QuadPart);
+        }
+
         unsigned pageAccessMode = (access & Access::Write) ? PAGE_READWRITE : PAGE_READONLY;
         auto mapping = CreateFileMapping(
             fileHandle, nullptr, pageAccessMode, DWORD(size>>32), DWORD(size), nullptr);
@@ -290,6 +307,7 @@ namespace Utility
         _mappedData = mappingStart;
         _mapping = mapping;
         _fileHandle = fileHandle;
+        _size = size;
     }
 
     MemoryMappedFile::~MemoryMappedFile()
@@ -0,0 +1,79 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "CompletionThreadPool.h"
+#include "LockFree.h"
+#include "../../Core/Exceptions.h"
+#include <algorithm>
+
+namespace Utility
+{
+    void CompletionThreadPool::Enqueue(std::function<void()>&& task)
+    {
+        {
+            ScopedLock(_pendingTasksLock);
+            _pendingTasks.push(std::move(task));
+        }
+        XlReleaseSemaphore(_taskSemaphore, 1, nullptr);
+    }
+
+    unsigned xl_thread_call CompletionThreadPool::WorkerFunction(void* poolPtr)
+    {
+        auto& pool = *(CompletionThreadPool*)poolPtr;
+        for (;;) {
+            XlWaitForSyncObject(pool._taskSemaphore, XL_INFINITE);
+
+            std::function<void()> task;
+            {
+                ScopedLock(pool._pendingTasksLock);
+                if (pool._pendingTasks.empty()) {
+                        //  we only get here without a task when we're shutting down
+                        //  (the destructor releases the semaphore once for every worker)
+                    if (pool._shutdown) break;
+                    continue;
+                }
+                task = std::move(pool._pendingTasks.front());
+                pool._pendingTasks.pop();
+            }
+
+            TRY {
+                task();
+            } CATCH (...) {
+                    // exceptions can't propagate out of the worker thread; the task must handle its own errors
+            } CATCH_END
+        }
+        return 0;
+    }
+
+    unsigned CompletionThreadPool::GetDefaultWorkerCount()
+    {
+        int logicalCPUs = 1;
+        XlGetNumCPUs(nullptr, &logicalCPUs, nullptr);
+        return unsigned(std::max(1, logicalCPUs-1));
+    }
+
+    CompletionThreadPool::CompletionThreadPool(unsigned workerCount)
+    {
+        _shutdown = false;
+        _taskSemaphore = XlCreateSemaphore(0x7fffffff);
+        _workerThreads.reserve(workerCount);
+        for (unsigned c=0; c<workerCount; ++c) {
+            _workerThreads.push_back(std::make_unique<Threading::Thread>(&WorkerFunction, this));
+        }
+    }
+
+    CompletionThreadPool::~CompletionThreadPool()
+    {
+        _shutdown = true;
+        XlReleaseSemaphore(_taskSemaphore, int(_workerThreads.size()), nullptr);
+        for (auto i=_workerThreads.begin(); i!=_workerThreads.end(); ++i) {
+            (*i)->join();
+        }
+        _workerThreads.clear();
+        XlCloseSyncObject(_taskSemaphore);
+    }
+}
+
@@ -0,0 +1,53 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "ThreadObject.h"
+#include "Mutex.h"
+#include "../../Core/Types.h"
+#include <functional>
+#include <vector>
+#include <queue>
+#include <memory>
+
+namespace Utility
+{
+    /// <summary>Simple pool of worker threads</summary>
+    /// Tasks queued with Enqueue() are executed by the next free worker thread,
+    /// in the order they were queued. There is no way to wait for a particular
+    /// task; tasks should signal their own completion (for example, by incrementing
+    /// a counter with Interlocked::Increment).
+    ///
+    /// Worker threads are created in the constructor, and joined in the destructor.
+    /// Any tasks that haven't started by the time the destructor is called will still
+    /// be executed before the destructor returns.
+    class CompletionThreadPool
+    {
+    public:
+        void Enqueue(std::function<void()>&& task);
+        unsigned GetWorkerCount() const { return unsigned(_workerThreads.size()); }
+
+            /// <summary>Pool with one thread for every logical processor, except the calling thread</summary>
+        static unsigned GetDefaultWorkerCount();
+
+        CompletionThreadPool(unsigned workerCount);
+        ~CompletionThreadPool();
+    protected:
+        std::vector<std::unique_ptr<Threading::Thread>> _workerThreads;
+        std::queue<std::function<void()>>   _pendingTasks;
+        Threading::Mutex                    _pendingTasksLock;
+        XlHandle                            _taskSemaphore;
+        bool volatile                       _shutdown;
+
+        static unsigned xl_thread_call WorkerFunction(void* pool);
+
+        CompletionThreadPool(const CompletionThreadPool&);
+        CompletionThreadPool& operator=(const CompletionThreadPool&);
+    };
+}
+
+using namespace Utility;
@@ -0,0 +1,420 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#include "JobSystem.h"
+#include "LockFree.h"
+#include "CompletionThreadPool.h"
+#include "../Profiling/CPUProfilerRegistry.h"
+#include "../../Core/Exceptions.h"
+#include <algorithm>
+
+namespace Utility
+{
+    class JobSystem::Job
+    {
+    public:
+        JobFunction     _function;
+        JobCounter*     _counter;
+        const char*     _label;
+    };
+
+    /// <summary>Chase-Lev work stealing deque of jobs</summary>
+    /// Push() and Pop() may only be called by the owning worker, and operate on the
+    /// bottom of the deque. Steal() can be called from any thread, and takes from the
+    /// top. The only contention between the owner and the thieves is over the very
+    /// last item, which is resolved with a compare exchange on _top.
+    ///
+    /// This is a fixed capacity version (no growing); when it's full the caller falls back
+    /// to the shared injection queue.
+    class JobSystem::Deque
+    {
+    public:
+        bool Push(Job* job);
+        Job* Pop();
+        Job* Steal();
+
+        Deque();
+    private:
+        static const unsigned Capacity = 4096;
+        static const unsigned CacheLineSize = 64;
+
+        Interlocked::Value volatile _top;
+        uint8                       _padding0[CacheLineSize - sizeof(Interlocked::Value)];
+        Interlocked::Value volatile _bottom;
+        uint8                       _padding1[CacheLineSize - sizeof(Interlocked::Value)];
+        Job* volatile               _jobs[Capacity];
+
+            //  (positions wrap at 2^32; Capacity divides that evenly)
+        static Interlocked::Value   Advance(Interlocked::Value pos, int offset)                 { return Interlocked::Value(uint32(pos) + uint32(offset)); }
+        static int32                Difference(Interlocked::Value lhs, Interlocked::Value rhs)  { return int32(uint32(lhs) - uint32(rhs)); }
+        static unsigned             Slot(Interlocked::Value pos)                                { return uint32(pos) & (Capacity-1); }
+    };
+
+    bool JobSystem::Deque::Push(Job* job)
+    {
+        auto b = Interlocked::Load(&_bottom);
+        auto t = Interlocked::Load(&_top);
+        if (Difference(b, t) >= int32(Capacity)) {
+            return false;
+        }
+        _jobs[Slot(b)] = job;
+        Interlocked::Exchange(&_bottom, Advance(b, 1));     // publish to thieves
+        return true;
+    }
+
+    auto JobSystem::Deque::Pop() -> Job*
+    {
+            //  Reserve the bottom item first, and then check for thieves. The exchange is
+            //  a full barrier, so a thief can't read the old _bottom after we read _top.
+        auto b = Advance(Interlocked::Load(&_bottom), -1);
+        Interlocked::Exchange(&_bottom, b);
+        auto t = Interlocked::Load(&_top);
+
+        auto size = Difference(b, t);
+        if (size < 0) {
+            Interlocked::Exchange(&_bottom, t);     // empty; restore
+            return nullptr;
+        }
+
+        Job* job = _jobs[Slot(b)];
+        if (size > 0) {
+            return job;
+        }
+
+            //  This is the last item, so we must race any thieves for it
+        if (Interlocked::CompareExchange(&_top, Advance(t, 1), t) != t) {
+            job = nullptr;
+        }
+        Interlocked::Exchange(&_bottom, Advance(t, 1));
+        return job;
+    }
+
+    auto JobSystem::Deque::Steal() -> Job*
+    {
+        auto t = Interlocked::Load(&_top);
+        auto b = Interlocked::Load(&_bottom);
+        if (Difference(b, t) <= 0) {
+            return nullptr;
+        }
+
+        Job* job = _jobs[Slot(t)];
+        if (Interlocked::CompareExchange(&_top, Advance(t, 1), t) != t) {
+            return nullptr;     // lost to another thief (or the owner)
+        }
+        return job;
+    }
+
+    JobSystem::Deque::Deque()
+    {
+        Interlocked::Exchange(&_top, 0);
+        Interlocked::Exchange(&_bottom, 0);
+        std::fill(_jobs, &_jobs[Capacity], nullptr);
+    }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    class JobSystem::Worker
+    {
+    public:
+        Deque                               _deque;
+        std::unique_ptr<Threading::Thread>  _thread;
+        Interlocked::Value volatile         _threadId;
+        JobSystem*                          _system;
+        uint32                              _stealSeed;
+
+            // profiling (only touched by the worker thread, except for _lastFrameProfile)
+        std::unique_ptr<HierarchicalCPUProfiler>    _profiler;
+        ThreadProfiler*                             _threadProfiler;
+        Interlocked::Value                          _profiledFrame;
+        mutable Threading::Mutex                    _profileLock;
+        std::vector<HierarchicalCPUProfiler::ResolvedEvent> _lastFrameProfile;
+
+        Worker(JobSystem& system, unsigned index)
+        : _threadId(~Interlocked::Value(0x0)), _system(&system), _stealSeed(index * 2654435761u + 1), _threadProfiler(nullptr), _profiledFrame(0) {}
+    };
+
+    class JobSystem::Pimpl
+    {
+    public:
+        LockFree::MPMCQueue<Job*, 1024>     _injectionQueue;
+        XlHandle                            _wakeSemaphore;
+        Interlocked::Value volatile         _sleepingWorkers;
+        Interlocked::Value volatile         _frameIndex;
+        bool volatile                       _shutdown;
+        bool                                _profileJobs;
+
+        Pimpl() : _wakeSemaphore(XlHandle_Invalid), _sleepingWorkers(0), _frameIndex(0), _shutdown(false), _profileJobs(false) {}
+    };
+
+    static const unsigned s_spinsBeforeSleep = 64;
+
+    auto JobSystem::GetCurrentWorker() -> Worker*
+    {
+        auto threadId = Interlocked::Value(XlGetCurrentThreadId());
+        for (auto i=_workers.begin(); i!=_workers.end(); ++i) {
+            if (Interlocked::Load(&(*i)->_threadId) == threadId) {
+                return i->get();
+            }
+        }
+        return nullptr;
+    }
+
+    auto JobSystem::FindJob(Worker* thisWorker) -> Job*
+    {
+            //  Our own deque first (most recently spawned job), then jobs spawned from
+            //  outside of the pool, and finally steal from the other workers. We start
+            //  stealing from a pseudo random victim, so thieves spread out.
+        if (thisWorker) {
+            auto* job = thisWorker->_deque.Pop();
+            if (job) { return job; }
+        }
+
+        Job* job = nullptr;
+        if (_pimpl->_injectionQueue.try_pop(job)) {
+            return job;
+        }
+
+        auto workerCount = unsigned(_workers.size());
+        if (!workerCount) { return nullptr; }
+
+        unsigned start;
+        if (thisWorker) {
+            thisWorker->_stealSeed = thisWorker->_stealSeed * 1664525u + 1013904223u;
+            start = thisWorker->_stealSeed >> 16;
+        } else {
+            start = XlGetCurrentThreadId();
+        }
+
+        for (unsigned c=0; c<workerCount; ++c) {
+            auto* victim = _workers[(start + c) % workerCount].get();
+            if (victim == thisWorker) { continue; }
+            auto* job = victim->_deque.Steal();
+            if (job) { return job; }
+        }
+        return nullptr;
+    }
+
+    void JobSystem::Execute(Job& job, HierarchicalCPUProfiler* profiler, ThreadProfiler* threadProfiler)
+    {
+        {
+            auto* label = job._label ? job._label : "Job";
+            CPUProfileEvent_Conditional profileEvent(label, profiler);
+            ThreadProfileEvent_Conditional threadProfileEvent(label, threadProfiler);
+            TRY {
+                job._function();
+            } CATCH (...) {
+                    // exceptions can't propagate out of a job; the job must handle its own errors
+            } CATCH_END
+        }
+
+            //  The counter must be released last; as soon as it reaches zero, the waiting
+            //  thread is free to destroy it
+        auto* counter = job._counter;
+        delete &job;
+        if (counter) {
+            Interlocked::Decrement(&counter->_pending);
+        }
+    }
+
+    void JobSystem::WakeWorkers(unsigned count)
+    {
+        auto sleeping = Interlocked::Load(&_pimpl->_sleepingWorkers);
+        if (sleeping > 0) {
+            XlReleaseSemaphore(_pimpl->_wakeSemaphore, int(std::min(unsigned(sleeping), count)), nullptr);
+        }
+    }
+
+    void JobSystem::Spawn(JobFunction&& function, JobCounter* counter, const char label[])
+    {
+        auto* job = new Job;
+        job->_function = std::move(function);
+        job->_counter = counter;
+        job->_label = label;
+        if (counter) {
+            Interlocked::Increment(&counter->_pending);
+        }
+
+        auto* worker = GetCurrentWorker();
+        if (!worker || !worker->_deque.Push(job)) {
+            _pimpl->_injectionQueue.push_overflow(job);
+        }
+        WakeWorkers(1);
+    }
+
+    void JobSystem::Wait(JobCounter& counter, HierarchicalCPUProfiler* helperProfiler)
+    {
+        auto* worker = GetCurrentWorker();
+        auto* profiler = worker ? worker->_profiler.get() : helperProfiler;
+        auto* threadProfiler = worker ? worker->_threadProfiler : nullptr;
+        while (!counter.IsComplete()) {
+            auto* job = FindJob(worker);
+            if (job) {
+                Execute(*job, profiler, threadProfiler);
+            } else {
+                Threading::YieldTimeSlice();
+            }
+        }
+    }
+
+    void JobSystem::ParallelFor(
+        unsigned begin, unsigned end, unsigned grainSize,
+        const RangeFunction& function, const char label[])
+    {
+        if (end <= begin) { return; }
+
+            //  Split into a few more chunks than there are threads, so that stealing
+            //  can balance out uneven chunks. The first chunk runs on this thread.
+        auto count = end - begin;
+        auto maxChunks = (GetWorkerCount()+1) * 4;
+        auto chunkSize = std::max(std::max(grainSize, 1u), count / maxChunks + ((count % maxChunks) ? 1 : 0));
+        auto firstEnd = begin + std::min(count, chunkSize);
+
+        JobCounter counter;
+        for (auto b=firstEnd; b<end;) {
+            auto e = (end - b > chunkSize) ? (b + chunkSize) : end;
+            Spawn([&function, b, e]() { function(b, e); }, &counter, label);
+            b = e;
+        }
+
+        TRY {
+            function(begin, firstEnd);
+        } CATCH (...) {
+                // spawned jobs reference "function" and "counter", so they must finish first
+            Wait(counter);
+            RETHROW;
+        } CATCH_END
+        Wait(counter);
+    }
+
+    void JobSystem::UpdateWorkerProfile(Worker& worker)
+    {
+        if (!worker._profiler) { return; }
+        auto frame = Interlocked::Load(&_pimpl->_frameIndex);
+        if (frame == worker._profiledFrame) { return; }
+
+        worker._profiledFrame = frame;
+        worker._profiler->EndFrame();
+        auto resolved = worker._profiler->CalculateResolvedEvents();
+
+        ScopedLock(worker._profileLock);
+        worker._lastFrameProfile = std::move(resolved);
+    }
+
+    void JobSystem::EndFrame()
+    {
+        Interlocked::Increment(&_pimpl->_frameIndex);
+        WakeWorkers(GetWorkerCount());     // so sleeping workers publish their profiles
+    }
+
+    auto JobSystem::GetWorkerProfile(unsigned workerIndex) const -> std::vector<HierarchicalCPUProfiler::ResolvedEvent>
+    {
+        if (workerIndex >= _workers.size()) { return std::vector<HierarchicalCPUProfiler::ResolvedEvent>(); }
+        auto& worker = *_workers[workerIndex];
+        ScopedLock(worker._profileLock);
+        return worker._lastFrameProfile;
+    }
+
+    unsigned xl_thread_call JobSystem::WorkerFunction(void* workerPtr)
+    {
+        auto& worker = *(Worker*)workerPtr;
+        auto& system = *worker._system;
+        auto& pimpl = *system._pimpl;
+
+        Interlocked::Exchange(&worker._threadId, Interlocked::Value(XlGetCurrentThreadId()));
+        if (pimpl._profileJobs) {
+                // (the profiler must be constructed on the thread that uses it)
+            worker._profiler = std::make_unique<HierarchicalCPUProfiler>();
+        }
+        worker._threadProfiler = &CPUProfilerRegistry::GetInstance().GetThreadProfiler("JobSystem worker");
+
+        unsigned spinCount = 0;
+        for (;;) {
+            system.UpdateWorkerProfile(worker);
+
+            auto* job = system.FindJob(&worker);
+            if (job) {
+                system.Execute(*job, worker._profiler.get(), worker._threadProfiler);
+                spinCount = 0;
+                continue;
+            }
+
+            if (++spinCount < s_spinsBeforeSleep) {
+                Threading::YieldTimeSlice();
+                continue;
+            }
+            spinCount = 0;
+
+                //  Register as sleeping before checking for work one last time. Spawn()
+                //  pushes the job before checking for sleeping workers, so either we will
+                //  find the job here, or the spawning thread will see us and wake us.
+            Interlocked::Increment(&pimpl._sleepingWorkers);
+            job = system.FindJob(&worker);
+            if (job) {
+                Interlocked::Decrement(&pimpl._sleepingWorkers);
+                system.Execute(*job, worker._profiler.get(), worker._threadProfiler);
+                continue;
+            }
+            if (pimpl._shutdown) {
+                Interlocked::Decrement(&pimpl._sleepingWorkers);
+                break;
+            }
+            XlWaitForSyncObject(pimpl._wakeSemaphore, XL_INFINITE);
+            Interlocked::Decrement(&pimpl._sleepingWorkers);
+        }
+
+        worker._profiler.reset();
+        return 0;
+    }
+
+    JobSystem::JobSystem(unsigned workerCount, bool profileJobs)
+    {
+        _pimpl = std::make_unique<Pimpl>();
+        _pimpl->_wakeSemaphore = XlCreateSemaphore(0x7fffffff);
+        _pimpl->_profileJobs = profileJobs;
+
+            //  Create all workers before starting any threads, because workers
+            //  steal from each other (so _workers must not change after this)
+        _workers.reserve(workerCount);
+        for (unsigned c=0; c<workerCount; ++c) {
+            _workers.push_back(std::make_unique<Worker>(*this, c));
+        }
+        for (auto i=_workers.begin(); i!=_workers.end(); ++i) {
+            (*i)->_thread = std::make_unique<Threading::Thread>(&WorkerFunction, i->get());
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+            //  Workers only exit once they can't find any more jobs, so everything
+            //  that has been spawned will be executed before this returns
+        _pimpl->_shutdown = true;
+        XlReleaseSemaphore(_pimpl->_wakeSemaphore, int(_workers.size()), nullptr);
+        for (auto i=_workers.begin(); i!=_workers.end(); ++i) {
+            (*i)->_thread->join();
+        }
+        _workers.clear();
+
+        Job* job = nullptr;
+        while (_pimpl->_injectionQueue.try_pop(job)) {
+            delete job;
+        }
+        XlCloseSyncObject(_pimpl->_wakeSemaphore);
+    }
+
+    static Threading::Mutex s_sharedJobSystemLock;
+    static std::weak_ptr<JobSystem> s_sharedJobSystem;
+
+    std::shared_ptr<JobSystem> GetSharedJobSystem()
+    {
+        ScopedLock(s_sharedJobSystemLock);
+        auto result = s_sharedJobSystem.lock();
+        if (!result) {
+            result = std::make_shared<JobSystem>(CompletionThreadPool::GetDefaultWorkerCount());
+            s_sharedJobSystem = result;
+        }
+        return result;
+    }
+}
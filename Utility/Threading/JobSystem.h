@@ -0,0 +1,112 @@
+// Copyright 2015 XLGAMES Inc.
+//
+// Distributed under the MIT License (See
+// accompanying file "LICENSE" or the website
+// http://www.opensource.org/licenses/mit-license.php)
+
+#pragma once
+
+#include "ThreadingUtils.h"
+#include "ThreadObject.h"
+#include "Mutex.h"
+#include "../Profiling/CPUProfiler.h"
+#include "../../Core/Types.h"
+#include <functional>
+#include <vector>
+#include <memory>
+
+namespace Utility
+{
+    class ThreadProfiler;
+
+    /// <summary>Counts the outstanding jobs in a group</summary>
+    /// Every job spawned with a counter increments it, and decrements it after the job
+    /// has finished. Jobs can spawn child jobs on the same counter (or on their own
+    /// counter, and wait on it), so waiting on a counter waits for the whole tree of
+    /// jobs attached to it.
+    class JobCounter
+    {
+    public:
+        bool IsComplete() const { return Interlocked::Load(const_cast<Interlocked::Value volatile*>(&_pending)) == 0; }
+        JobCounter() : _pending(0) {}
+    private:
+        Interlocked::Value volatile _pending;
+        friend class JobSystem;
+
+        JobCounter(const JobCounter&);
+        JobCounter& operator=(const JobCounter&);
+    };
+
+    /// <summary>Work-stealing job scheduler</summary>
+    /// Each worker thread owns a double ended queue of jobs (a Chase-Lev deque). Jobs spawned
+    /// on a worker are pushed onto the bottom of that worker's deque, and the worker pops from
+    /// the bottom (so recently spawned, cache-warm jobs run first). Idle workers steal from the
+    /// top of other workers' deques. Jobs spawned from threads outside of the pool go into a
+    /// shared injection queue.
+    ///
+    /// Wait() doesn't block while there is work available; the waiting thread executes
+    /// pending jobs until the counter reaches zero. This means jobs can safely wait on their
+    /// own child jobs without starving the pool.
+    ///
+    /// Exceptions can't propagate out of jobs; jobs must handle their own errors (as with
+    /// CompletionThreadPool).
+    ///
+    /// When constructed with "profileJobs", each worker records its jobs into its own
+    /// HierarchicalCPUProfiler, using the label passed to Spawn(). Call EndFrame() once per
+    /// frame, and the workers will publish the previous frame's results for GetWorkerProfile().
+    ///
+    /// Every worker also registers with CPUProfilerRegistry::GetInstance(), and records each
+    /// job there (so jobs show up in captures and Chrome traces).
+    class JobSystem
+    {
+    public:
+        typedef std::function<void()> JobFunction;
+        typedef std::function<void(unsigned, unsigned)> RangeFunction;
+
+        void Spawn(JobFunction&& job, JobCounter* counter = nullptr, const char label[] = nullptr);
+        void Wait(JobCounter& counter, HierarchicalCPUProfiler* helperProfiler = nullptr);
+
+            /// <summary>Execute function(rangeBegin, rangeEnd) over [begin, end) in parallel</summary>
+            /// The range is split into chunks of at least "grainSize" elements. The calling thread
+            /// participates, and the function returns after every chunk has completed.
+        void ParallelFor(
+            unsigned begin, unsigned end, unsigned grainSize,
+            const RangeFunction& function, const char label[] = nullptr);
+
+        unsigned GetWorkerCount() const { return unsigned(_workers.size()); }
+
+        void EndFrame();
+        std::vector<HierarchicalCPUProfiler::ResolvedEvent> GetWorkerProfile(unsigned workerIndex) const;
+
+        JobSystem(unsigned workerCount, bool profileJobs = false);
+        ~JobSystem();
+
+    protected:
+        class Job;
+        class Worker;
+        class Deque;
+        class Pimpl;
+        std::unique_ptr<Pimpl> _pimpl;
+        std::vector<std::unique_ptr<Worker>> _workers;
+
+        Job* FindJob(Worker* thisWorker);
+        void Execute(Job& job, HierarchicalCPUProfiler* profiler, ThreadProfiler* threadProfiler);
+        Worker* GetCurrentWorker();
+        void WakeWorkers(unsigned count);
+        void UpdateWorkerProfile(Worker& worker);
+
+        static unsigned xl_thread_call WorkerFunction(void* worker);
+
+        JobSystem(const JobSystem&);
+        JobSystem& operator=(const JobSystem&);
+    };
+
+    /// <summary>Returns the job system shared by all systems in the process</summary>
+    /// The shared job system has one worker for every logical processor, except the
+    /// calling thread. It's created on first use, and destroyed when the last
+    /// reference is released. So systems that want to run jobs in parallel should
+    /// hold on to the result (rather than creating their own threads).
+    std::shared_ptr<JobSystem> GetSharedJobSystem();
+}
+
+using namespace Utility;
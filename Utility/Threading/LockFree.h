@@ -10,6 +10,8 @@
 #include "../PtrUtils.h"
 #include "Mutex.h"
 #include <queue>
+#include <type_traits>
+#include <algorithm>
 #include <assert.h>
 
 namespace Utility
@@ -25,12 +27,15 @@ static const uint32 XL_MAX_WAIT_OBJECTS = 64;
 static const uint32 XL_CRITICALSECTION_SPIN_COUNT = 1000;
 
 XlHandle XlCreateEvent(bool manualReset);
+XlHandle XlCreateSemaphore(int maxCount);
+bool XlReleaseSemaphore(XlHandle semaphore, int releaseCount, int* previousCount);
 bool XlResetEvent(XlHandle event);
 bool XlSetEvent(XlHandle event);
 bool XlCloseSyncObject(XlHandle object);
 uint32 XlWaitForSyncObject(XlHandle object, uint32 waitTime);
 uint32 XlWaitForMultipleSyncObjects(uint32 waitCount, XlHandle waitObjects[], bool waitAll, uint32 waitTime, bool alterable);
 uint32 XlGetCurrentThreadId();
+void XlGetNumCPUs(int* physical, int* logical, int* avail);
 
 static const XlHandle XlHandle_Invalid = XlHandle(~size_t(0x0));
 
@@ -382,6 +387,424 @@ namespace LockFree
         {
             return _event;
         }
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    /// <summary>Bounded multi-producer / multi-consumer queue</summary>
+    /// Ring buffer in which every slot carries its own sequence number. Producers and
+    /// consumers each claim a position with a single compare-exchange on a shared counter,
+    /// and then publish the slot by advancing its sequence number. So, unlike FixedSizeQueue,
+    /// producers never wait on each other to publish, and any number of threads can pop.
+    ///
+    /// The enqueue and dequeue counters are padded into separate cache lines, so producers
+    /// and consumers don't contend over the same line.
+    ///
+    /// "Count" must be a power of two. The full capacity is available (there is no sentinel
+    /// slot). push_overflow() falls back to a locked std::queue when the ring is full, like
+    /// FixedSizeQueue.
+    ///
+    /// try_pop() is safe from any number of threads. try_front()/pop() are provided so that
+    /// this can be used in place of FixedSizeQueue; they hold the front item aside until pop()
+    /// is called, so (as with FixedSizeQueue) only one thread may use that pair at a time, and
+    /// that thread should not mix them with try_pop().
+    template<typename Type, int Count>
+        class MPMCQueue
+    {
+    public:
+        bool push(const Type&);
+        void push_stall(const Type&);
+        void push_overflow(const Type&);
+
+        bool push(Type&&);
+        void push_stall(Type&&);
+        void push_overflow(Type&&);
+
+        bool try_pop(Type&);
+
+        bool try_front(Type*&);
+        void pop();
+        size_t size() const;
+
+        void compress_overflow();
+
+        MPMCQueue();
+        ~MPMCQueue();
+
+    private:
+        static_assert((Count & (Count-1)) == 0 && Count > 1, "MPMCQueue count must be a power of two");
+        static const unsigned CacheLineSize = 64;
+
+        class Cell
+        {
+        public:
+            Interlocked::Value volatile _sequence;
+            typename std::aligned_storage<sizeof(Type), std::alignment_of<Type>::value>::type _storage;
+            Type* Item() { return (Type*)&_storage; }
+        };
+
+        class PaddedCounter
+        {
+        public:
+            Interlocked::Value volatile _value;
+            uint8 _padding[CacheLineSize - sizeof(Interlocked::Value)];
+        };
+
+        uint8           _headPadding[CacheLineSize];
+        PaddedCounter   _enqueuePos;
+        PaddedCounter   _dequeuePos;
+        Cell            _cells[Count];
+
+            //  Single consumer front item, held aside between try_front() and pop()
+        typename std::aligned_storage<sizeof(Type), std::alignment_of<Type>::value>::type _front;
+        bool                _frontValid;
+        bool                _frontFromOverflow;
+
+        Interlocked::Value volatile _overflowCount;
+        bool                        _overflowQueue_needsCompression;
+        mutable Threading::Mutex    _overflowQueue_Lock;
+        std::queue<Type>            _overflowQueue;
+
+        Cell* BeginPush();
+        Cell* BeginPop(Interlocked::Value& pos);
+        bool PopOverflow(Type& result);
+
+            //  positions wrap around at 2^32. Since Count divides 2^32 evenly, the
+            //  slot mapping and the sequence comparisons remain valid across the wrap
+        static Interlocked::Value   Advance(Interlocked::Value pos, unsigned offset)         { return Interlocked::Value(uint32(pos) + offset); }
+        static int32                Difference(Interlocked::Value lhs, Interlocked::Value rhs) { return int32(uint32(lhs) - uint32(rhs)); }
+
+        MPMCQueue(const MPMCQueue<Type,Count>&);
+        const MPMCQueue<Type,Count>& operator=(const MPMCQueue<Type,Count>&);
+    };
+
+    template<typename Type, int Count>
+        MPMCQueue<Type,Count>::MPMCQueue()
+        {
+            for (unsigned c=0; c<Count; ++c) {
+                _cells[c]._sequence = Interlocked::Value(c);
+            }
+            _frontValid = _frontFromOverflow = false;
+            _overflowQueue_needsCompression = false;
+            Interlocked::Exchange(&_overflowCount, 0);
+            Interlocked::Exchange(&_dequeuePos._value, 0);
+            Interlocked::Exchange(&_enqueuePos._value, 0);
+        }
+
+    template<typename Type, int Count>
+        MPMCQueue<Type,Count>::~MPMCQueue()
+        {
+            Type*t = 0;
+            while (try_front(t)) {pop();}   // pop everything to make sure the destructors are called on all remaining things
+        }
+
+    template<typename Type, int Count>
+        auto MPMCQueue<Type,Count>::BeginPush() -> Cell*
+        {
+                //  Claim the next enqueue position, but only if the slot at that position
+                //  has been released by the consumers of the previous lap. The slot sequence
+                //  tells us the state:
+                //      sequence == pos         slot is free for this lap
+                //      sequence < pos          slot still holds an item from the previous lap (queue is full)
+                //      sequence > pos          another producer has claimed it; reload and try again
+            auto pos = Interlocked::Load(&_enqueuePos._value);
+            for (;;) {
+                auto& cell = _cells[uint32(pos) & (Count-1)];
+                auto diff = Difference(Interlocked::Load(&cell._sequence), pos);
+                if (diff == 0) {
+                    auto prev = Interlocked::CompareExchange(&_enqueuePos._value, Advance(pos, 1), pos);
+                    if (prev == pos) { return &cell; }
+                    pos = prev;
+                } else if (diff < 0) {
+                    return nullptr;
+                } else {
+                    pos = Interlocked::Load(&_enqueuePos._value);
+                }
+                Threading::Pause();
+            }
+        }
+
+    template<typename Type, int Count>
+        auto MPMCQueue<Type,Count>::BeginPop(Interlocked::Value& pos) -> Cell*
+        {
+                //  Mirror of BeginPush. The slot is ready for this consumer when the producer
+                //  has published it (sequence == pos+1)
+            pos = Interlocked::Load(&_dequeuePos._value);
+            for (;;) {
+                auto& cell = _cells[uint32(pos) & (Count-1)];
+                auto diff = Difference(Interlocked::Load(&cell._sequence), Advance(pos, 1));
+                if (diff == 0) {
+                    auto prev = Interlocked::CompareExchange(&_dequeuePos._value, Advance(pos, 1), pos);
+                    if (prev == pos) { return &cell; }
+                    pos = prev;
+                } else if (diff < 0) {
+                    return nullptr;
+                } else {
+                    pos = Interlocked::Load(&_dequeuePos._value);
+                }
+                Threading::Pause();
+            }
+        }
+
+    #undef new
+
+    template<typename Type, int Count>
+        bool MPMCQueue<Type,Count>::push(const Type& newItem)
+        {
+            auto* cell = BeginPush();
+            if (!cell) { return false; }
+            auto pos = Interlocked::Load(&cell->_sequence);
+            new(cell->Item()) Type(newItem);
+            Interlocked::Exchange(&cell->_sequence, Advance(pos, 1));    // publish
+            return true;
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue<Type,Count>::push(Type&& newItem)
+        {
+            auto* cell = BeginPush();
+            if (!cell) { return false; }
+            auto pos = Interlocked::Load(&cell->_sequence);
+            new(cell->Item()) Type(std::forward<Type>(newItem));
+            Interlocked::Exchange(&cell->_sequence, Advance(pos, 1));    // publish
+            return true;
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue<Type,Count>::try_front(Type*& result)
+        {
+            if (!_frontValid) {
+                Interlocked::Value pos;
+                auto* cell = BeginPop(pos);
+                if (cell) {
+                    new(&_front) Type(std::move(*cell->Item()));
+                    cell->Item()->~Type();
+                    Interlocked::Exchange(&cell->_sequence, Advance(pos, Count));   // release the slot for the next lap
+                    _frontFromOverflow = false;
+                } else {
+                    if (!Interlocked::Load(&_overflowCount)) { return false; }
+                    ScopedLock(_overflowQueue_Lock);
+                    if (_overflowQueue.empty()) { return false; }
+                    new(&_front) Type(std::move(_overflowQueue.front()));
+                    _overflowQueue.pop();
+                    Interlocked::Decrement(&_overflowCount);
+                    _frontFromOverflow = true;
+                }
+                _frontValid = true;
+            }
+            result = (Type*)&_front;
+            return true;
+        }
+
+    #if defined(DEBUG_NEW)
+        #define new DEBUG_NEW
+    #endif
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::pop()
+        {
+            assert(_frontValid);
+            ((Type*)&_front)->~Type();
+            _frontValid = false;
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue<Type,Count>::PopOverflow(Type& result)
+        {
+            if (!Interlocked::Load(&_overflowCount)) { return false; }
+            ScopedLock(_overflowQueue_Lock);
+            if (_overflowQueue.empty()) { return false; }
+            result = std::move(_overflowQueue.front());
+            _overflowQueue.pop();
+            Interlocked::Decrement(&_overflowCount);
+            return true;
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue<Type,Count>::try_pop(Type& result)
+        {
+            Interlocked::Value pos;
+            auto* cell = BeginPop(pos);
+            if (!cell) {
+                return PopOverflow(result);
+            }
+
+            result = std::move(*cell->Item());
+            cell->Item()->~Type();
+            Interlocked::Exchange(&cell->_sequence, Advance(pos, Count));   // release the slot for the next lap
+            return true;
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::push_stall(const Type& newItem)
+        {
+            while (!push(newItem)) {
+                Threading::YieldTimeSlice();
+            }
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::push_stall(Type&& newItem)
+        {
+            while (!push(std::forward<Type>(newItem))) {
+                Threading::YieldTimeSlice();
+            }
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::push_overflow(const Type& newItem)
+        {
+            if (!push(newItem)) {
+                ScopedLock(_overflowQueue_Lock);
+                _overflowQueue_needsCompression = true;
+                _overflowQueue.push(newItem);
+                Interlocked::Increment(&_overflowCount);
+            }
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::push_overflow(Type&& newItem)
+        {
+            if (!push(std::forward<Type>(newItem))) {
+                ScopedLock(_overflowQueue_Lock);
+                _overflowQueue_needsCompression = true;
+                _overflowQueue.push(std::forward<Type>(newItem));
+                Interlocked::Increment(&_overflowCount);
+            }
+        }
+
+    template<typename Type, int Count>
+        size_t MPMCQueue<Type,Count>::size() const
+        {
+                // approximate, because of threading (as with FixedSizeQueue, the overflow queue isn't included)
+            auto dequeuePos = Interlocked::Load(const_cast<Interlocked::Value volatile*>(&_dequeuePos._value));
+            auto enqueuePos = Interlocked::Load(const_cast<Interlocked::Value volatile*>(&_enqueuePos._value));
+            auto diff = Difference(enqueuePos, dequeuePos);
+            return size_t(std::max(diff, 0)) + size_t(_frontValid);
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue<Type,Count>::compress_overflow()
+        {
+            if (!Interlocked::Load(&_overflowCount) && _overflowQueue_needsCompression) {
+                ScopedLock(_overflowQueue_Lock);
+                if (_overflowQueue.empty()) {
+                    _overflowQueue = std::queue<Type>();    // destroy memory
+                    _overflowQueue_needsCompression = false;
+                }
+            }
+        }
+
+    /// <summary>MPMCQueue with an event that is raised on push</summary>
+    /// The event can be waited on with XlWaitForSyncObject / XlWaitForMultipleSyncObjects
+    /// (as with FixedSizeQueue_Waitable), or consumers can block in pop_wait(). The event
+    /// is auto-reset, so a consumer that wakes and finds more items waiting raises it again
+    /// to pass the wake-up on to the next waiting consumer.
+    template<typename Type, int Count>
+        class MPMCQueue_Waitable : public MPMCQueue<Type,Count>
+    {
+    public:
+        bool push(const Type&);
+        void push_stall(const Type&);
+        void push_overflow(const Type&);
+
+        bool push(Type&&);
+        void push_stall(Type&&);
+        void push_overflow(Type&&);
+
+        bool pop_wait(Type& result, uint32 waitTime = XL_INFINITE);
+
+        XlHandle get_event();
+        MPMCQueue_Waitable();
+        ~MPMCQueue_Waitable();
+    private:
+        XlHandle _event;
+        typedef MPMCQueue<Type,Count> Base;
+    };
+
+    template<typename Type, int Count>
+        bool MPMCQueue_Waitable<Type,Count>::push(const Type& newItem)
+        {
+            bool result = Base::push(newItem);
+            if (result) { XlSetEvent(_event); }
+            return result;
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue_Waitable<Type,Count>::push(Type&& newItem)
+        {
+            bool result = Base::push(std::forward<Type>(newItem));
+            if (result) { XlSetEvent(_event); }
+            return result;
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue_Waitable<Type,Count>::push_stall(const Type& newItem)
+        {
+            while (!Base::push(newItem)) {
+                XlSetEvent(_event); // raise the event, just to make sure the consumers are processing
+                Threading::YieldTimeSlice();
+            }
+            XlSetEvent(_event);
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue_Waitable<Type,Count>::push_stall(Type&& newItem)
+        {
+            while (!Base::push(std::forward<Type>(newItem))) {
+                XlSetEvent(_event);
+                Threading::YieldTimeSlice();
+            }
+            XlSetEvent(_event);
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue_Waitable<Type,Count>::push_overflow(const Type& newItem)
+        {
+            Base::push_overflow(newItem);
+            XlSetEvent(_event);
+        }
+
+    template<typename Type, int Count>
+        void MPMCQueue_Waitable<Type,Count>::push_overflow(Type&& newItem)
+        {
+            Base::push_overflow(std::forward<Type>(newItem));
+            XlSetEvent(_event);
+        }
+
+    template<typename Type, int Count>
+        bool MPMCQueue_Waitable<Type,Count>::pop_wait(Type& result, uint32 waitTime)
+        {
+            for (;;) {
+                if (Base::try_pop(result)) {
+                    if (Base::size() != 0) { XlSetEvent(_event); }
+                    return true;
+                }
+
+                    //  If a producer pushes between try_pop() and here, the event will
+                    //  already be set, and the wait will return immediately
+                if (XlWaitForSyncObject(_event, waitTime) == XL_WAIT_TIMEOUT) {
+                    return Base::try_pop(result);
+                }
+            }
+        }
+
+    template<typename Type, int Count>
+        MPMCQueue_Waitable<Type,Count>::MPMCQueue_Waitable()
+        {
+            _event = XlCreateEvent(false);
+        }
+
+    template<typename Type, int Count>
+        MPMCQueue_Waitable<Type,Count>::~MPMCQueue_Waitable()
+        {
+            XlCloseSyncObject(_event);
+        }
+
+    template<typename Type, int Count>
+        XlHandle MPMCQueue_Waitable<Type,Count>::get_event()
+        {
+            return _event;
+        }
 }
 
 }
@@ -119,10 +119,17 @@
             /* note -- "_InterlockedIncrement" will not return the correct result on Win95 and earlier! Expect crashes and leaks on that platform! */
         force_inline Value Increment(Value volatile* target)              { return _InterlockedIncrement(target)-1; }
         force_inline Value Decrement(Value volatile* target)              { return _InterlockedDecrement(target)+1; }
-        force_inline Value Add(Value volatile* target, Value addition)    { return _InterlockedExchangeAdd(target, addition) - addition; }
+        force_inline Value Add(Value volatile* target, Value addition)    { return _InterlockedExchangeAdd(target, addition); }
 
         force_inline Value Load(Value volatile* target)                   { return *target; }
-        force_inline Value64 Load64(Value64 volatile const* target)       { return *target; }
+        #if TARGET_64BIT
+            force_inline Value64 Load64(Value64 volatile const* target)   { return *target; }
+        #else
+                //  A plain 64 bit read can tear on 32 bit targets (it's done as 2 separate
+                //  32 bit reads). Comparing against 0 and exchanging with 0 never changes the
+                //  value, but reads it atomically.
+            force_inline Value64 Load64(Value64 volatile const* target)   { return CompareExchange64(const_cast<Value64 volatile*>(target), 0, 0); }
+        #endif
         force_inline void* LoadPointer(void* volatile const* target)      { return *target; }
     }}
 
@@ -160,8 +167,13 @@
 
         inline Value64 Load64(Value64 volatile const* target) 
         {
-            return *target;
-            // return *tbb::internal::__TBB_load_full_fence(target);
+            #if TARGET_64BIT
+                return *target;
+                // return *tbb::internal::__TBB_load_full_fence(target);
+            #else
+                    // (a plain 64 bit read can tear on 32 bit targets; see above)
+                return CompareExchange64(const_cast<Value64 volatile*>(target), 0, 0);
+            #endif
         }
 
         inline void* LoadPointer(void* volatile const* target) 
@@ -28,7 +28,7 @@ namespace Utility
         #define a2n(x) (const ucs2*)__L(x)
         #define n2w(x) (const wchar_t*)x
 
-    #elif (PLATFORMOS_ACTIVE == PLATFORMOS_OSX) || (PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID)
+    #elif (PLATFORMOS_ACTIVE == PLATFORMOS_OSX) || (PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID) || (PLATFORMOS_ACTIVE == PLATFORMOS_LINUX)
 
         typedef utf8 nchar;
         #define a2n(x) x
@@ -81,7 +81,7 @@ namespace Utility
         #define nchar_2_utf8    ucs2_2_utf8
         #define nchar_2_ucs2(x) x
         #define nchar_2_ucs4    ucs2_2_utf8
-    #elif (PLATFORMOS_ACTIVE == PLATFORMOS_OSX) || (PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID)
+    #elif (PLATFORMOS_ACTIVE == PLATFORMOS_OSX) || (PLATFORMOS_ACTIVE == PLATFORMOS_ANDROID) || (PLATFORMOS_ACTIVE == PLATFORMOS_LINUX)
         #define nchar_2_utf8(x) x
         #define nchar_2_ucs2    utf8_2_ucs2
         #define nchar_2_ucs4    utf8_2_ucs4